@@ -0,0 +1,2318 @@
+#include <glad/glad.h>
+
+#include "Benchmarks.h"
+#include "OffsetAllocator.h"
+#include "StreamBuffer.h"
+#include "RenderQueue.h"
+#include "JobSystem.h"
+#include "FiberJobSystem.h"
+#include "Fiber.h"
+#include "LinearArena.h"
+#include "Pool.h"
+#include "MemoryTracker.h"
+#include "MathTypes.h"
+#include "MathBatch.h"
+#include "TransformHierarchy.h"
+#include "EntityWorld.h"
+#include "SystemScheduler.h"
+#include "FrustumCulling.h"
+#include "DynamicBvh.h"
+#include "OcclusionCuller.h"
+#include "SoftwareRenderer.h"
+#include "CpuProfiler.h"
+#include "InstanceBatcher.h"
+#include "IndirectRenderer.h"
+#include "GLExtensions.h"
+#include "BufferArena.h"
+#include "Shader.h"
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <future>
+#include <thread>
+#include <cmath>
+#include <memory_resource>
+#include <unordered_map>
+#include <string>
+
+// glm isn't a dependency of the engine, it's only compared against when its headers are around
+#if defined(__has_include)
+#if __has_include(<glm/glm.hpp>)
+#define KNOX_BENCHMARK_GLM 1
+#include <glm/glm.hpp>
+#endif
+#endif
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double elapsedMilliseconds(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// The quad from main.cpp rendered into a small offscreen framebuffer,
+// so GPU benchmarks measure submission cost rather than fill rate
+struct BenchmarkScene
+{
+	unsigned int framebuffer;
+	unsigned int colorBuffer;
+	unsigned int textures[2];
+	Shader* shader;
+	BufferArena* bufferArena;
+	MeshRange quad;
+};
+
+static void createBenchmarkScene(BenchmarkScene& scene)
+{
+	glGenFramebuffers(1, &scene.framebuffer);
+	glGenRenderbuffers(1, &scene.colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, scene.colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, 64, 64);
+	glBindFramebuffer(GL_FRAMEBUFFER, scene.framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, scene.colorBuffer);
+	glViewport(0, 0, 64, 64);
+
+	unsigned char pixel[] = { 255, 255, 255, 255 };
+	glGenTextures(2, scene.textures);
+	for (int i = 0; i < 2; i++)
+	{
+		glBindTexture(GL_TEXTURE_2D, scene.textures[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+	}
+
+	float vertices[] = {
+		 0.5f,  0.5f, 0.0f,		1.0f, 0.0f, 0.0f,		1.0f, 0.0f,
+		 0.5f, -0.5f, 0.0f,		0.0f, 1.0f, 0.0f,		1.0f, 1.0f,
+		-0.5f, -0.5f, 0.0f,		0.0f, 0.0f, 1.0f,		0.0f, 1.0f,
+		-0.5f,  0.5f, 0.0f,		1.0f, 1.0f, 1.0f,		0.0f, 0.0f
+	};
+	unsigned int indices[] = { 0, 1, 3, 1, 2, 3 };
+
+	scene.bufferArena = new BufferArena(1024, 1024);
+	scene.bufferArena->allocate(4, 6, scene.quad);
+	scene.bufferArena->upload(scene.quad, vertices, indices);
+
+	scene.shader = new Shader("resources/shaders/VertexShader.txt", "resources/shaders/FragmentShader.txt");
+	glUseProgram(scene.shader->Id);
+	scene.shader->setInt("texture1", 0);
+	scene.shader->setInt("texture2", 1);
+	scene.shader->setFloat("mixValue", 0.5f);
+	InstanceBatcher::setDefaultTransform();
+}
+
+static void destroyBenchmarkScene(BenchmarkScene& scene)
+{
+	glDeleteProgram(scene.shader->Id);
+	delete scene.shader;
+
+	scene.bufferArena->free(scene.quad);
+	scene.bufferArena->destroy();
+	delete scene.bufferArena;
+
+	glDeleteTextures(2, scene.textures);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &scene.framebuffer);
+	glDeleteRenderbuffers(1, &scene.colorBuffer);
+}
+
+static DrawItem makeQuadDrawItem(const BenchmarkScene& scene)
+{
+	DrawItem item;
+	item.program = scene.shader->Id;
+	item.materialId = 0;
+	item.textures[0] = scene.textures[0];
+	item.textures[1] = scene.textures[1];
+	item.vertexArray = scene.bufferArena->VAO;
+	item.indexCount = scene.quad.indexCount;
+	item.firstIndex = scene.quad.firstIndex();
+	item.baseVertex = scene.quad.baseVertex();
+	return item;
+}
+
+// Column-major transforms laying the instances out on a grid covering clip space
+static void makeGridTransforms(int count, std::vector<float>& transforms)
+{
+	int side = 1;
+	while (side * side < count)
+	{
+		side++;
+	}
+	float scale = 2.0f / side;
+
+	transforms.assign((size_t)count * 16, 0.0f);
+	for (int i = 0; i < count; i++)
+	{
+		float* transform = &transforms[(size_t)i * 16];
+		transform[0] = scale;
+		transform[5] = scale;
+		transform[10] = 1.0f;
+		transform[12] = -1.0f + scale * (i % side + 0.5f);
+		transform[13] = -1.0f + scale * (i / side + 0.5f);
+		transform[15] = 1.0f;
+	}
+}
+
+// One glDrawElements per object, the transform goes through the generic attribute values.
+// This is the baseline the batched paths are compared against
+static void drawDirect(const DrawItem& item, const std::vector<float>& transforms, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		const float* transform = &transforms[(size_t)i * 16];
+		for (GLuint column = 0; column < 4; column++)
+		{
+			glVertexAttrib4fv(InstanceBatcher::TransformLocation + column, transform + column * 4);
+		}
+		glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)item.indexCount, GL_UNSIGNED_INT,
+			(void *)((size_t)item.firstIndex * sizeof(unsigned int)), item.baseVertex);
+	}
+}
+
+bool runCpuBenchmark(const char* name)
+{
+	if (strcmp(name, "offset-allocator") == 0)
+	{
+		runOffsetAllocatorBenchmark();
+		return true;
+	}
+	if (strcmp(name, "render-queue") == 0)
+	{
+		runRenderQueueBenchmark();
+		return true;
+	}
+	if (strcmp(name, "job-system") == 0)
+	{
+		runJobSystemBenchmark();
+		return true;
+	}
+	if (strcmp(name, "fibers") == 0)
+	{
+		runFiberBenchmark();
+		return true;
+	}
+	if (strcmp(name, "frame-arena") == 0)
+	{
+		runFrameArenaBenchmark();
+		return true;
+	}
+	if (strcmp(name, "pool") == 0)
+	{
+		runPoolBenchmark();
+		return true;
+	}
+	if (strcmp(name, "math") == 0)
+	{
+		runMathBenchmark();
+		return true;
+	}
+	if (strcmp(name, "transforms") == 0)
+	{
+		runTransformBenchmark();
+		return true;
+	}
+	if (strcmp(name, "ecs") == 0)
+	{
+		runEntityBenchmark();
+		return true;
+	}
+	if (strcmp(name, "culling") == 0)
+	{
+		runCullingBenchmark();
+		return true;
+	}
+	if (strcmp(name, "bvh") == 0)
+	{
+		runBvhBenchmark();
+		return true;
+	}
+	if (strcmp(name, "occlusion") == 0)
+	{
+		runOcclusionBenchmark();
+		return true;
+	}
+	if (strcmp(name, "software-renderer") == 0)
+	{
+		runSoftwareRendererBenchmark();
+		return true;
+	}
+	if (strcmp(name, "cpu-profiler") == 0)
+	{
+		runCpuProfilerBenchmark();
+		return true;
+	}
+	return false;
+}
+
+bool runGpuBenchmark(const char* name)
+{
+	if (strcmp(name, "stream-buffer") == 0)
+	{
+		runStreamBufferBenchmark();
+		return true;
+	}
+	if (strcmp(name, "instancing") == 0)
+	{
+		runInstancingBenchmark();
+		return true;
+	}
+	if (strcmp(name, "multi-draw-indirect") == 0)
+	{
+		runMultiDrawIndirectBenchmark();
+		return true;
+	}
+	return false;
+}
+
+void runOffsetAllocatorBenchmark()
+{
+	const uint32_t arenaSize = 64 * 1024 * 1024;
+	const int meshCount = 100000;
+	const int churnIterations = 1000000;
+
+	OffsetAllocator allocator(arenaSize);
+	std::vector<OffsetAllocator::Allocation> allocations(meshCount);
+
+	// NOTE Fixed seed, so runs are comparable with each other
+	std::mt19937 random(1337);
+	std::uniform_int_distribution<uint32_t> meshSize(4, 1024);
+	std::uniform_int_distribution<int> meshIndex(0, meshCount - 1);
+
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < meshCount; i++)
+	{
+		allocations[i] = allocator.allocate(meshSize(random));
+	}
+	double fillTime = elapsedMilliseconds(start);
+
+	// Simulate meshes being streamed in and out
+	start = Clock::now();
+	for (int i = 0; i < churnIterations; i++)
+	{
+		int index = meshIndex(random);
+		allocator.free(allocations[index]);
+		allocations[index] = allocator.allocate(meshSize(random));
+	}
+	double churnTime = elapsedMilliseconds(start);
+
+	OffsetAllocator::Stats stats = allocator.getStats();
+
+	start = Clock::now();
+	for (int i = 0; i < meshCount; i++)
+	{
+		allocator.free(allocations[i]);
+	}
+	double freeTime = elapsedMilliseconds(start);
+
+	printf("OffsetAllocator benchmark (%d meshes, %d alloc/free pairs)\n", meshCount, churnIterations);
+	printf("  fill:  %.2f ms (%.1f ns/alloc)\n", fillTime, fillTime * 1e6 / meshCount);
+	printf("  churn: %.2f ms (%.1f ns/alloc+free)\n", churnTime, churnTime * 1e6 / churnIterations);
+	printf("  free:  %.2f ms (%.1f ns/free)\n", freeTime, freeTime * 1e6 / meshCount);
+	printf("  after churn: %u allocations, utilization %.1f%%, %u free blocks, fragmentation %.3f\n",
+		stats.allocationCount, stats.utilization() * 100.0f, stats.freeBlockCount, stats.fragmentation());
+
+	OffsetAllocator::Stats emptyStats = allocator.getStats();
+	if (emptyStats.usedSize != 0 || emptyStats.freeBlockCount != 1)
+	{
+		printf("ERROR: OffsetAllocator did not coalesce back into a single block (%u free blocks)\n", emptyStats.freeBlockCount);
+	}
+}
+
+void runRenderQueueBenchmark()
+{
+	const int drawCount = 100000;
+	const int frameCount = 100;
+
+	std::mt19937 random(1337);
+	std::uniform_int_distribution<unsigned int> program(1, 8);
+	std::uniform_int_distribution<unsigned int> material(1, 256);
+	std::uniform_int_distribution<unsigned int> vertexArray(1, 16);
+	std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+
+	std::vector<DrawItem> items(drawCount);
+	std::vector<float> depths(drawCount);
+	for (int i = 0; i < drawCount; i++)
+	{
+		DrawItem& item = items[i];
+		item.program = program(random);
+		item.materialId = material(random);
+		// NOTE Textures come from the material, like they would in a real scene
+		item.textures[0] = 1 + item.materialId % 64;
+		item.textures[1] = 1 + (item.materialId * 7) % 64;
+		item.vertexArray = vertexArray(random);
+		item.indexCount = 6;
+		item.firstIndex = 0;
+		item.baseVertex = 0;
+		depths[i] = depth(random);
+	}
+
+	RenderQueue queue;
+	for (int i = 0; i < drawCount; i++)
+	{
+		queue.submit(items[i], depths[i], i % 10 == 0);
+	}
+	RenderQueue::Stats unsortedStats = queue.countStateChanges();
+
+	double radixMilliseconds = 0.0;
+	RenderQueue::Stats sortedStats;
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		queue.clear();
+		for (int i = 0; i < drawCount; i++)
+		{
+			queue.submit(items[i], depths[i], i % 10 == 0);
+		}
+		queue.sort();
+		sortedStats = queue.countStateChanges();
+		radixMilliseconds += sortedStats.sortMilliseconds;
+	}
+
+	// std::sort on the same keys as a reference
+	std::vector<uint64_t> keys(drawCount);
+	double stdSortMilliseconds = 0.0;
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		for (int i = 0; i < drawCount; i++)
+		{
+			keys[i] = RenderQueue::makeKey(items[i], items[i].textures[0], depths[i], i % 10 == 0);
+		}
+		Clock::time_point start = Clock::now();
+		std::sort(keys.begin(), keys.end());
+		stdSortMilliseconds += elapsedMilliseconds(start);
+	}
+
+	printf("RenderQueue benchmark (%d draws, 8 programs, 256 materials, 16 VAOs, 10%% transparent)\n", drawCount);
+	printf("  radix sort: %.3f ms/frame, std::sort: %.3f ms/frame\n", radixMilliseconds / frameCount, stdSortMilliseconds / frameCount);
+	printf("  state changes unsorted: %u (program %u, material %u, texture %u, VAO %u)\n",
+		unsortedStats.stateChanges(), unsortedStats.programChanges, unsortedStats.materialChanges,
+		unsortedStats.textureChanges, unsortedStats.vertexArrayChanges);
+	printf("  state changes sorted:   %u (program %u, material %u, texture %u, VAO %u)\n",
+		sortedStats.stateChanges(), sortedStats.programChanges, sortedStats.materialChanges,
+		sortedStats.textureChanges, sortedStats.vertexArrayChanges);
+}
+
+static void emptyJob(void*)
+{
+}
+
+// Binary tree of jobs, every node schedules its two children and waits on them
+struct JobTreeNode
+{
+	JobSystem* jobSystem;
+	int depth;
+};
+
+static void jobTreeNode(void* data)
+{
+	JobTreeNode* node = (JobTreeNode*)data;
+	if (node->depth == 0)
+	{
+		return;
+	}
+
+	JobTreeNode children[2] = { { node->jobSystem, node->depth - 1 }, { node->jobSystem, node->depth - 1 } };
+	JobSystem::Counter counter(0);
+	node->jobSystem->run(jobTreeNode, &children[0], &counter);
+	node->jobSystem->run(jobTreeNode, &children[1], &counter);
+	node->jobSystem->wait(&counter);
+}
+
+static void parallelForWork(std::vector<float>& values, uint32_t begin, uint32_t end)
+{
+	for (uint32_t i = begin; i < end; i++)
+	{
+		values[i] = std::sqrt(std::sin((float)i) * std::sin((float)i) + 1.0f);
+	}
+}
+
+void runJobSystemBenchmark()
+{
+	const int emptyJobCount = 100000;
+	const int asyncJobCount = 2000;
+	const uint32_t elementCount = 8 * 1024 * 1024;
+	const uint32_t batchSize = 16 * 1024;
+	const int treeDepth = 16;
+
+	int coreCount = (int)std::thread::hardware_concurrency();
+	if (coreCount < 1)
+	{
+		coreCount = 1;
+	}
+
+	printf("JobSystem benchmark (%d hardware threads)\n", coreCount);
+
+	// Overhead of scheduling and running jobs that do nothing
+	{
+		JobSystem jobSystem;
+		JobSystem::Counter counter(0);
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < emptyJobCount; i++)
+		{
+			jobSystem.run(emptyJob, NULL, &counter);
+			if ((i & 1023) == 1023)
+			{
+				jobSystem.wait(&counter);
+			}
+		}
+		jobSystem.wait(&counter);
+		double jobMilliseconds = elapsedMilliseconds(start);
+
+		start = Clock::now();
+		std::vector<std::future<void> > futures;
+		futures.reserve(asyncJobCount);
+		for (int i = 0; i < asyncJobCount; i++)
+		{
+			futures.push_back(std::async(std::launch::async, emptyJob, (void*)NULL));
+		}
+		for (int i = 0; i < asyncJobCount; i++)
+		{
+			futures[i].wait();
+		}
+		double asyncMilliseconds = elapsedMilliseconds(start);
+
+		JobSystem::Stats stats = jobSystem.getStats();
+		printf("  empty jobs: %.1f ns/job (%llu stolen), std::async: %.1f ns/task\n",
+			jobMilliseconds * 1e6 / emptyJobCount, (unsigned long long)stats.jobsStolen,
+			asyncMilliseconds * 1e6 / asyncJobCount);
+	}
+
+	// parallel_for scaling with the number of threads
+	std::vector<float> values(elementCount);
+	Clock::time_point start = Clock::now();
+	parallelForWork(values, 0, elementCount);
+	double serialMilliseconds = elapsedMilliseconds(start);
+	printf("  parallelFor over %u elements, serial: %.2f ms\n", elementCount, serialMilliseconds);
+
+	for (int threadCount = 1; threadCount <= coreCount; threadCount *= 2)
+	{
+		JobSystem jobSystem(threadCount - 1);
+		start = Clock::now();
+		jobSystem.parallelFor(elementCount, batchSize, [&values](uint32_t begin, uint32_t end)
+		{
+			parallelForWork(values, begin, end);
+		});
+		double jobMilliseconds = elapsedMilliseconds(start);
+		printf("    %2d threads: %8.2f ms (%.2fx)\n", threadCount, jobMilliseconds, serialMilliseconds / jobMilliseconds);
+
+		if (threadCount < coreCount && threadCount * 2 > coreCount)
+		{
+			threadCount = coreCount / 2;
+		}
+	}
+
+	start = Clock::now();
+	{
+		std::vector<std::future<void> > futures;
+		uint32_t chunkSize = (elementCount + coreCount - 1) / coreCount;
+		for (uint32_t begin = 0; begin < elementCount; begin += chunkSize)
+		{
+			uint32_t end = begin + chunkSize < elementCount ? begin + chunkSize : elementCount;
+			futures.push_back(std::async(std::launch::async, [&values, begin, end]() { parallelForWork(values, begin, end); }));
+		}
+		for (size_t i = 0; i < futures.size(); i++)
+		{
+			futures[i].wait();
+		}
+	}
+	double asyncMilliseconds = elapsedMilliseconds(start);
+	printf("    std::async, %d tasks: %.2f ms (%.2fx)\n", coreCount, asyncMilliseconds, serialMilliseconds / asyncMilliseconds);
+
+	// Dependency graph, every job waits on the two jobs it spawned
+	{
+		JobSystem jobSystem;
+		JobTreeNode root = { &jobSystem, treeDepth };
+		JobSystem::Counter counter(0);
+		start = Clock::now();
+		jobSystem.run(jobTreeNode, &root, &counter);
+		jobSystem.wait(&counter);
+		double treeMilliseconds = elapsedMilliseconds(start);
+
+		int jobCount = (1 << (treeDepth + 1)) - 1;
+		printf("  dependency tree of %d jobs (depth %d): %.2f ms, %.1f ns/job\n",
+			jobCount, treeDepth, treeMilliseconds, treeMilliseconds * 1e6 / jobCount);
+	}
+}
+
+// Two fibers switching back and forth, measures the raw cost of a context switch
+struct FiberPingPong
+{
+	Fiber* main;
+	Fiber* other;
+	int switches;
+};
+
+static void fiberPingPong(void* data)
+{
+	FiberPingPong* pingPong = (FiberPingPong*)data;
+	while (true)
+	{
+		pingPong->switches++;
+		Fiber::switchTo(*pingPong->other, *pingPong->main);
+	}
+}
+
+// Chain of jobs where every job spawns the next one and waits on it, the worst case for
+// JobSystem::wait since each level nests another call on the waiting worker's stack
+template<typename System>
+struct JobChainNode
+{
+	System* jobSystem;
+	int depth;
+
+	static void execute(void* data)
+	{
+		JobChainNode* node = (JobChainNode*)data;
+		if (node->depth == 0)
+		{
+			return;
+		}
+
+		JobChainNode child = { node->jobSystem, node->depth - 1 };
+		typename System::Counter counter(0);
+		node->jobSystem->run(&JobChainNode::execute, &child, &counter);
+		node->jobSystem->wait(&counter);
+	}
+};
+
+struct FiberTreeNode
+{
+	FiberJobSystem* jobSystem;
+	int depth;
+};
+
+static void fiberTreeNode(void* data)
+{
+	FiberTreeNode* node = (FiberTreeNode*)data;
+	if (node->depth == 0)
+	{
+		return;
+	}
+
+	FiberTreeNode children[2] = { { node->jobSystem, node->depth - 1 }, { node->jobSystem, node->depth - 1 } };
+	FiberJobSystem::Counter counter(0);
+	node->jobSystem->run(fiberTreeNode, &children[0], &counter);
+	node->jobSystem->run(fiberTreeNode, &children[1], &counter);
+	node->jobSystem->wait(&counter);
+}
+
+void runFiberBenchmark()
+{
+	const int switchCount = 1000000;
+	const int emptyJobCount = 100000;
+	const int chainDepth = 512;
+	const int chainRepeats = 20;
+	const int treeDepth = 10;
+
+	printf("Fiber benchmark (%d hardware threads)\n", (int)std::thread::hardware_concurrency());
+
+	// Raw context switches on a single thread
+	{
+		Fiber mainFiber;
+		Fiber otherFiber;
+		FiberPingPong pingPong = { &mainFiber, &otherFiber, 0 };
+		if (mainFiber.convertCurrentThread() && otherFiber.create(fiberPingPong, &pingPong, 16 * 1024))
+		{
+			Clock::time_point start = Clock::now();
+			for (int i = 0; i < switchCount; i++)
+			{
+				Fiber::switchTo(mainFiber, otherFiber);
+			}
+			double milliseconds = elapsedMilliseconds(start);
+			mainFiber.revertCurrentThread();
+
+			// Every iteration is two switches, there and back
+			printf("  context switch: %.1f ns\n", milliseconds * 1e6 / (2.0 * pingPong.switches));
+		}
+	}
+
+	// NOTE The fibers run on the job system's workers, both share the same pool
+	JobSystem jobSystem;
+
+	// Scheduling overhead compared to the plain job system
+	{
+		FiberJobSystem fiberJobSystem(jobSystem);
+		FiberJobSystem::Counter counter(0);
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < emptyJobCount; i++)
+		{
+			fiberJobSystem.run(emptyJob, NULL, &counter);
+			if ((i & 1023) == 1023)
+			{
+				fiberJobSystem.wait(&counter);
+			}
+		}
+		fiberJobSystem.wait(&counter);
+		double milliseconds = elapsedMilliseconds(start);
+		printf("  empty jobs: %.1f ns/job on %d workers\n", milliseconds * 1e6 / emptyJobCount, fiberJobSystem.getWorkerCount());
+	}
+
+	// Deep dependency chains, every level waits on the next one
+	{
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < chainRepeats; i++)
+		{
+			JobChainNode<JobSystem> root = { &jobSystem, chainDepth };
+			JobSystem::Counter counter(0);
+			jobSystem.run(&JobChainNode<JobSystem>::execute, &root, &counter);
+			jobSystem.wait(&counter);
+		}
+		double jobMilliseconds = elapsedMilliseconds(start);
+
+		// NOTE Every level of the chain keeps a fiber parked, so there have to be more fibers than levels
+		FiberJobSystem fiberJobSystem(jobSystem, chainDepth + 64);
+		start = Clock::now();
+		for (int i = 0; i < chainRepeats; i++)
+		{
+			JobChainNode<FiberJobSystem> root = { &fiberJobSystem, chainDepth };
+			FiberJobSystem::Counter counter(0);
+			fiberJobSystem.run(&JobChainNode<FiberJobSystem>::execute, &root, &counter);
+			fiberJobSystem.wait(&counter);
+		}
+		double fiberMilliseconds = elapsedMilliseconds(start);
+
+		FiberJobSystem::Stats stats = fiberJobSystem.getStats();
+		int jobCount = chainRepeats * (chainDepth + 1);
+		printf("  dependency chain of depth %d x%d:\n", chainDepth, chainRepeats);
+		printf("    JobSystem:      %8.2f ms, %.1f ns/job\n", jobMilliseconds, jobMilliseconds * 1e6 / jobCount);
+		printf("    FiberJobSystem: %8.2f ms, %.1f ns/job (%llu fiber switches, %llu waits parked, %llu skipped)\n",
+			fiberMilliseconds, fiberMilliseconds * 1e6 / jobCount, (unsigned long long)stats.fiberSwitches,
+			(unsigned long long)stats.waitsParked, (unsigned long long)stats.waitsSkipped);
+	}
+
+	// Same dependency tree as the job system benchmark, in the worst case every inner node is parked at the same time
+	{
+		FiberJobSystem fiberJobSystem(jobSystem, (1 << treeDepth) + 64);
+		FiberTreeNode root = { &fiberJobSystem, treeDepth };
+		FiberJobSystem::Counter counter(0);
+		Clock::time_point start = Clock::now();
+		fiberJobSystem.run(fiberTreeNode, &root, &counter);
+		fiberJobSystem.wait(&counter);
+		double treeMilliseconds = elapsedMilliseconds(start);
+
+		int jobCount = (1 << (treeDepth + 1)) - 1;
+		printf("  dependency tree of %d jobs (depth %d): %.2f ms, %.1f ns/job\n",
+			jobCount, treeDepth, treeMilliseconds, treeMilliseconds * 1e6 / jobCount);
+	}
+}
+
+// Forwards to the regular heap and counts how often it gets called
+class CountingHeapResource : public std::pmr::memory_resource
+{
+public:
+	uint64_t allocationCount;
+	uint64_t bytesAllocated;
+
+	CountingHeapResource() : allocationCount(0), bytesAllocated(0) {}
+
+protected:
+	void* do_allocate(size_t size, size_t alignment) override
+	{
+		allocationCount++;
+		bytesAllocated += size;
+		return std::pmr::new_delete_resource()->allocate(size, alignment);
+	}
+
+	void do_deallocate(void* pointer, size_t size, size_t alignment) override
+	{
+		std::pmr::new_delete_resource()->deallocate(pointer, size, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+};
+
+// The kind of throwaway containers a frame builds: a visible list, sort keys, a lookup table and some strings
+static uint64_t simulateFrameAllocations(std::pmr::memory_resource* resource, int frame, int drawCount)
+{
+	std::pmr::vector<DrawItem> visible(resource);
+	std::pmr::vector<uint64_t> keys(resource);
+	std::pmr::unordered_map<uint32_t, uint32_t> materialCounts(resource);
+	std::pmr::vector<std::pmr::string> labels(resource);
+
+	for (int i = 0; i < drawCount; i++)
+	{
+		if ((i + frame) % 3 == 0)
+		{
+			continue;
+		}
+
+		DrawItem item = DrawItem();
+		item.program = 1 + i % 4;
+		item.materialId = (uint32_t)(i % 97);
+		item.indexCount = 6;
+		visible.push_back(item);
+		keys.push_back(RenderQueue::makeKey(item, 0, (float)i / drawCount, false));
+		materialCounts[item.materialId]++;
+	}
+
+	for (int i = 0; i < 64; i++)
+	{
+		labels.push_back(std::pmr::string("per frame debug label for entity number ", resource));
+		labels.back() += std::to_string(i).c_str();
+	}
+
+	uint64_t checksum = visible.size() + materialCounts.size();
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		checksum ^= keys[i];
+	}
+	return checksum + labels.back().size();
+}
+
+void runFrameArenaBenchmark()
+{
+	const int frameCount = 2000;
+	const int drawCount = 2000;
+
+	printf("Frame arena benchmark (%d frames, %d draws per frame)\n", frameCount, drawCount);
+
+	uint64_t checksum = 0;
+
+	CountingHeapResource heap;
+	Clock::time_point start = Clock::now();
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		checksum += simulateFrameAllocations(&heap, frame, drawCount);
+	}
+	double heapMilliseconds = elapsedMilliseconds(start);
+
+	LinearArena frameArena(1024 * 1024, "Benchmark frame");
+	uint64_t arenaAllocations = 0;
+	uint64_t arenaBytes = 0;
+	uint64_t arenaOverflows = 0;
+	start = Clock::now();
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		checksum += simulateFrameAllocations(&frameArena, frame, drawCount);
+
+		LinearArena::Stats stats = frameArena.getStats();
+		arenaAllocations += stats.allocationCount;
+		arenaBytes += stats.bytesAllocated;
+		arenaOverflows += stats.overflowAllocations;
+		frameArena.reset();
+	}
+	double arenaMilliseconds = elapsedMilliseconds(start);
+
+	start = Clock::now();
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		ScratchScope scratch;
+		checksum += simulateFrameAllocations(scratch, frame, drawCount);
+	}
+	double scratchMilliseconds = elapsedMilliseconds(start);
+
+	printf("  heap:          %.3f ms/frame, %.1f heap calls/frame, %.1f KB/frame\n",
+		heapMilliseconds / frameCount, (double)heap.allocationCount / frameCount, heap.bytesAllocated / 1024.0 / frameCount);
+	printf("  frame arena:   %.3f ms/frame (%.2fx), %.1f arena allocations/frame, %.1f KB/frame, %llu overflowed to the heap\n",
+		arenaMilliseconds / frameCount, heapMilliseconds / arenaMilliseconds, (double)arenaAllocations / frameCount,
+		arenaBytes / 1024.0 / frameCount, (unsigned long long)arenaOverflows);
+	printf("  scratch scope: %.3f ms/frame (%.2fx)\n", scratchMilliseconds / frameCount, heapMilliseconds / scratchMilliseconds);
+	printf("  (checksum %llu)\n", (unsigned long long)checksum);
+}
+
+// Stand-in for a scene node, roughly the size of a local + world transform
+struct BenchmarkNode
+{
+	float local[16];
+	float world[16];
+	uint32_t flags;
+
+	BenchmarkNode(float value) : flags(0)
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			local[i] = value;
+			world[i] = 0.0f;
+		}
+	}
+};
+
+void runPoolBenchmark()
+{
+	const uint32_t nodeCount = 100000;
+	const int lookupCount = 1000000;
+
+	printf("Pool benchmark (%u nodes of %d bytes)\n", nodeCount, (int)sizeof(BenchmarkNode));
+
+	std::mt19937 random(42);
+	std::vector<uint32_t> lookupIndices(lookupCount);
+	for (int i = 0; i < lookupCount; i++)
+	{
+		lookupIndices[i] = random() % nodeCount;
+	}
+	std::vector<uint32_t> churnOrder(nodeCount);
+	for (uint32_t i = 0; i < nodeCount; i++)
+	{
+		churnOrder[i] = i;
+	}
+	std::shuffle(churnOrder.begin(), churnOrder.end(), random);
+
+	float checksum = 0.0f;
+
+	// new/delete with raw pointers
+	std::vector<BenchmarkNode*> pointers(nodeCount);
+	Clock::time_point start = Clock::now();
+	for (uint32_t i = 0; i < nodeCount; i++)
+	{
+		pointers[i] = new BenchmarkNode((float)i);
+	}
+	double heapCreateMilliseconds = elapsedMilliseconds(start);
+
+	// Free and reallocate half of them in random order, like a scene after a while of spawning and despawning
+	start = Clock::now();
+	for (uint32_t i = 0; i < nodeCount / 2; i++)
+	{
+		delete pointers[churnOrder[i]];
+	}
+	for (uint32_t i = 0; i < nodeCount / 2; i++)
+	{
+		pointers[churnOrder[i]] = new BenchmarkNode((float)i);
+	}
+	double heapChurnMilliseconds = elapsedMilliseconds(start);
+
+	start = Clock::now();
+	for (int i = 0; i < lookupCount; i++)
+	{
+		checksum += pointers[lookupIndices[i]]->local[0];
+	}
+	double heapLookupMilliseconds = elapsedMilliseconds(start);
+
+	start = Clock::now();
+	for (uint32_t i = 0; i < nodeCount; i++)
+	{
+		checksum += pointers[i]->local[5];
+	}
+	double heapIterateMilliseconds = elapsedMilliseconds(start);
+
+	for (uint32_t i = 0; i < nodeCount; i++)
+	{
+		delete pointers[i];
+	}
+
+	// Same with a pool and handles
+	Pool<BenchmarkNode> pool(nodeCount, "Benchmark", "BenchmarkNode");
+	std::vector<Handle<BenchmarkNode> > handles(nodeCount);
+	start = Clock::now();
+	for (uint32_t i = 0; i < nodeCount; i++)
+	{
+		handles[i] = pool.create((float)i);
+	}
+	double poolCreateMilliseconds = elapsedMilliseconds(start);
+
+	std::vector<Handle<BenchmarkNode> > destroyedHandles(nodeCount / 2);
+	start = Clock::now();
+	for (uint32_t i = 0; i < nodeCount / 2; i++)
+	{
+		destroyedHandles[i] = handles[churnOrder[i]];
+		pool.destroy(handles[churnOrder[i]]);
+	}
+	for (uint32_t i = 0; i < nodeCount / 2; i++)
+	{
+		handles[churnOrder[i]] = pool.create((float)i);
+	}
+	double poolChurnMilliseconds = elapsedMilliseconds(start);
+
+	start = Clock::now();
+	for (int i = 0; i < lookupCount; i++)
+	{
+		checksum += pool.get(handles[lookupIndices[i]])->local[0];
+	}
+	double poolLookupMilliseconds = elapsedMilliseconds(start);
+
+	start = Clock::now();
+	for (BenchmarkNode* node = pool.begin(); node != pool.end(); node++)
+	{
+		checksum += node->local[5];
+	}
+	double poolIterateMilliseconds = elapsedMilliseconds(start);
+
+	// Every one of these slots was reused, a raw pointer would silently read the new object
+	uint32_t detected = 0;
+	for (size_t i = 0; i < destroyedHandles.size(); i++)
+	{
+		if (!pool.get(destroyedHandles[i]))
+		{
+			detected++;
+		}
+	}
+
+	printf("                 new/delete      pool\n");
+	printf("  create:     %8.1f ns %8.1f ns\n", heapCreateMilliseconds * 1e6 / nodeCount, poolCreateMilliseconds * 1e6 / nodeCount);
+	printf("  churn:      %8.1f ns %8.1f ns (destroy + create)\n", heapChurnMilliseconds * 1e6 / nodeCount, poolChurnMilliseconds * 1e6 / nodeCount);
+	printf("  lookup:     %8.1f ns %8.1f ns (random)\n", heapLookupMilliseconds * 1e6 / lookupCount, poolLookupMilliseconds * 1e6 / lookupCount);
+	printf("  iterate:    %8.1f ns %8.1f ns (per node)\n", heapIterateMilliseconds * 1e6 / nodeCount, poolIterateMilliseconds * 1e6 / nodeCount);
+	printf("  use after free detected: %u of %u stale handles\n", detected, (unsigned int)destroyedHandles.size());
+	printf("  (checksum %.1f)\n", checksum);
+
+	printMemoryReport();
+}
+
+static float maxDifference(const float* a, const float* b, size_t count)
+{
+	float difference = 0.0f;
+	for (size_t i = 0; i < count; i++)
+	{
+		difference = std::max(difference, std::fabs(a[i] - b[i]) / (1.0f + std::fabs(b[i])));
+	}
+	return difference;
+}
+
+void runMathBenchmark()
+{
+	const int matrixCount = 100000;
+	const int repeats = 20;
+	const int pointCount = 1000000;
+
+	printf("Math benchmark (%s, %d matrices x%d, %d points)\n", getMathInstructionSet(), matrixCount, repeats, pointCount);
+
+	// Random transforms, invertible by construction
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	std::vector<mat4> a(matrixCount), b(matrixCount), results(matrixCount), reference(matrixCount);
+	for (int i = 0; i < matrixCount; i++)
+	{
+		vec3 axis = normalize(vec3(distribution(random), distribution(random), distribution(random) + 2.0f));
+		quat orientation = quatFromAxisAngle(axis, distribution(random) * 3.0f);
+		vec3 position(distribution(random) * 10.0f, distribution(random) * 10.0f, distribution(random) * 10.0f);
+		a[i] = composeTransform(position, orientation, vec3(1.0f + distribution(random) * 0.5f));
+		b[i] = composeTransform(position * 0.5f, conjugate(orientation), vec3(1.5f));
+	}
+
+	printf("                     scalar        SIMD");
+#if KNOX_BENCHMARK_GLM
+	printf("         glm");
+#endif
+	printf("   (ns per operation)\n");
+
+	// mat4 * mat4
+	Clock::time_point start = Clock::now();
+	for (int repeat = 0; repeat < repeats; repeat++)
+	{
+		for (int i = 0; i < matrixCount; i++)
+		{
+			reference[i] = multiplyScalar(a[i], b[i]);
+		}
+	}
+	double scalarMilliseconds = elapsedMilliseconds(start);
+
+	start = Clock::now();
+	for (int repeat = 0; repeat < repeats; repeat++)
+	{
+		multiplyMatrices(a.data(), b.data(), results.data(), matrixCount);
+	}
+	double simdMilliseconds = elapsedMilliseconds(start);
+	float multiplyError = maxDifference(results[0].m, reference[0].m, (size_t)matrixCount * 16);
+
+	printf("  mat4 multiply: %8.2f    %8.2f", scalarMilliseconds * 1e6 / (repeats * matrixCount), simdMilliseconds * 1e6 / (repeats * matrixCount));
+#if KNOX_BENCHMARK_GLM
+	{
+		std::vector<glm::mat4> glmA(matrixCount), glmB(matrixCount), glmResults(matrixCount);
+		memcpy(glmA.data(), a.data(), sizeof(mat4) * matrixCount);
+		memcpy(glmB.data(), b.data(), sizeof(mat4) * matrixCount);
+		start = Clock::now();
+		for (int repeat = 0; repeat < repeats; repeat++)
+		{
+			for (int i = 0; i < matrixCount; i++)
+			{
+				glmResults[i] = glmA[i] * glmB[i];
+			}
+		}
+		printf("    %8.2f", elapsedMilliseconds(start) * 1e6 / (repeats * matrixCount));
+	}
+#endif
+	printf("   (max relative error %g)\n", multiplyError);
+
+	// General inverse
+	start = Clock::now();
+	for (int repeat = 0; repeat < repeats; repeat++)
+	{
+		for (int i = 0; i < matrixCount; i++)
+		{
+			reference[i] = inverseScalar(a[i]);
+		}
+	}
+	scalarMilliseconds = elapsedMilliseconds(start);
+
+	start = Clock::now();
+	for (int repeat = 0; repeat < repeats; repeat++)
+	{
+		for (int i = 0; i < matrixCount; i++)
+		{
+			results[i] = inverse(a[i]);
+		}
+	}
+	simdMilliseconds = elapsedMilliseconds(start);
+	float inverseError = maxDifference(results[0].m, reference[0].m, (size_t)matrixCount * 16);
+
+	printf("  mat4 inverse:  %8.2f    %8.2f", scalarMilliseconds * 1e6 / (repeats * matrixCount), simdMilliseconds * 1e6 / (repeats * matrixCount));
+#if KNOX_BENCHMARK_GLM
+	{
+		std::vector<glm::mat4> glmA(matrixCount), glmResults(matrixCount);
+		memcpy(glmA.data(), a.data(), sizeof(mat4) * matrixCount);
+		start = Clock::now();
+		for (int repeat = 0; repeat < repeats; repeat++)
+		{
+			for (int i = 0; i < matrixCount; i++)
+			{
+				glmResults[i] = glm::inverse(glmA[i]);
+			}
+		}
+		printf("    %8.2f", elapsedMilliseconds(start) * 1e6 / (repeats * matrixCount));
+	}
+#endif
+	printf("   (max relative error %g)\n", inverseError);
+
+	// Points, AoS one at a time against SoA batches
+	std::vector<vec3> points(pointCount), transformedPoints(pointCount), referencePoints(pointCount);
+	std::vector<float> xs(pointCount), ys(pointCount), zs(pointCount), outX(pointCount), outY(pointCount), outZ(pointCount);
+	for (int i = 0; i < pointCount; i++)
+	{
+		points[i] = vec3(distribution(random), distribution(random), distribution(random)) * 100.0f;
+		xs[i] = points[i].x;
+		ys[i] = points[i].y;
+		zs[i] = points[i].z;
+	}
+	const mat4& m = a[0];
+
+	start = Clock::now();
+	for (int i = 0; i < pointCount; i++)
+	{
+		referencePoints[i] = transformPointScalar(m, points[i]);
+	}
+	scalarMilliseconds = elapsedMilliseconds(start);
+
+	start = Clock::now();
+	transformPoints(m, points.data(), transformedPoints.data(), pointCount);
+	simdMilliseconds = elapsedMilliseconds(start);
+	float pointError = maxDifference(&transformedPoints[0].x, &referencePoints[0].x, (size_t)pointCount * 3);
+
+	printf("  points (AoS):  %8.2f    %8.2f", scalarMilliseconds * 1e6 / pointCount, simdMilliseconds * 1e6 / pointCount);
+#if KNOX_BENCHMARK_GLM
+	{
+		glm::mat4 glmM;
+		memcpy(&glmM, &m, sizeof(mat4));
+		std::vector<glm::vec3> glmPoints(pointCount), glmResults(pointCount);
+		memcpy(glmPoints.data(), points.data(), sizeof(vec3) * pointCount);
+		start = Clock::now();
+		for (int i = 0; i < pointCount; i++)
+		{
+			glmResults[i] = glm::vec3(glmM * glm::vec4(glmPoints[i], 1.0f));
+		}
+		printf("    %8.2f", elapsedMilliseconds(start) * 1e6 / pointCount);
+	}
+#endif
+	printf("   (max relative error %g)\n", pointError);
+
+	PointsSoA input = { xs.data(), ys.data(), zs.data() };
+	PointsSoA output = { outX.data(), outY.data(), outZ.data() };
+	start = Clock::now();
+	transformPointsSoAScalar(m, input, output, pointCount);
+	scalarMilliseconds = elapsedMilliseconds(start);
+
+	start = Clock::now();
+	transformPointsSoA(m, input, output, pointCount);
+	simdMilliseconds = elapsedMilliseconds(start);
+
+	float soaError = 0.0f;
+	for (int i = 0; i < pointCount; i++)
+	{
+		float x = outX[i] - referencePoints[i].x;
+		float y = outY[i] - referencePoints[i].y;
+		float z = outZ[i] - referencePoints[i].z;
+		soaError = std::max(soaError, std::sqrt(x * x + y * y + z * z) / (1.0f + length(referencePoints[i])));
+	}
+	printf("  points (SoA):  %8.2f    %8.2f", scalarMilliseconds * 1e6 / pointCount, simdMilliseconds * 1e6 / pointCount);
+#if KNOX_BENCHMARK_GLM
+	printf("           -");
+#endif
+	printf("   (max relative error %g)\n", soaError);
+#if !KNOX_BENCHMARK_GLM
+	printf("  (glm headers not found, comparison skipped)\n");
+#endif
+}
+
+// Local transform of a benchmark node, kept on the side to compute the reference world matrices
+struct BenchmarkTransform
+{
+	TransformId parent;
+	vec3 position;
+	quat rotation;
+};
+
+// Depth first on purpose, so the hierarchy has to sort its arrays by level
+static void createTransformSubtree(TransformHierarchy& hierarchy, std::vector<BenchmarkTransform>& transforms,
+	TransformId parent, const int* fanouts, int depth, std::mt19937& random)
+{
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	BenchmarkTransform transform;
+	transform.parent = parent;
+	transform.position = vec3(distribution(random), distribution(random), distribution(random)) * 4.0f;
+	transform.rotation = quatFromAxisAngle(vec3(0.0f, 1.0f, 0.0f), distribution(random));
+	TransformId id = hierarchy.create(parent, transform.position, transform.rotation, vec3(1.0f));
+	transforms.push_back(transform);
+
+	if (fanouts[depth] == 0)
+	{
+		return;
+	}
+	for (int i = 0; i < fanouts[depth]; i++)
+	{
+		createTransformSubtree(hierarchy, transforms, id, fanouts, depth + 1, random);
+	}
+}
+
+void runTransformBenchmark()
+{
+	// 1000 roots with 9 children each, then 10 and 10: 1,000,000 transforms on 4 levels
+	const int rootCount = 1000;
+	const int fanouts[] = { 9, 10, 10, 0 };
+	const float dirtyRatios[] = { 0.0f, 0.001f, 0.01f, 0.1f, 0.5f, 1.0f };
+	const int frames = 5;
+
+	std::mt19937 random(11);
+	std::vector<BenchmarkTransform> transforms;
+	transforms.reserve(1000000);
+	TransformHierarchy hierarchy(1000000);
+	for (int i = 0; i < rootCount; i++)
+	{
+		createTransformSubtree(hierarchy, transforms, TransformHierarchy::NoParent, fanouts, 0, random);
+	}
+	uint32_t count = hierarchy.size();
+
+	JobSystem jobSystem;
+	hierarchy.update(&jobSystem);
+	TransformHierarchy::Stats stats = hierarchy.getStats();
+	printf("Transform benchmark (%u transforms, %u levels, %s, %d threads)\n",
+		count, stats.levelCount, getMathInstructionSet(), jobSystem.getWorkerCount());
+	printf("  initial sort by level: %.2f ms\n", stats.sortMilliseconds);
+
+	// Reference without any of it: every world matrix from scratch, scalar, in creation order
+	std::vector<mat4> reference(count);
+	Clock::time_point start = Clock::now();
+	for (uint32_t id = 0; id < count; id++)
+	{
+		const BenchmarkTransform& transform = transforms[id];
+		mat4 local = composeTransform(transform.position, transform.rotation, vec3(1.0f));
+		reference[id] = transform.parent == TransformHierarchy::NoParent ? local : multiplyScalar(reference[transform.parent], local);
+	}
+	double referenceMilliseconds = elapsedMilliseconds(start);
+	printf("  full scalar recompute: %.2f ms\n", referenceMilliseconds);
+
+	printf("  dirty     recomputed     1 thread     job system\n");
+	std::uniform_int_distribution<uint32_t> pick(0, count - 1);
+	for (size_t ratio = 0; ratio < sizeof(dirtyRatios) / sizeof(dirtyRatios[0]); ratio++)
+	{
+		uint32_t dirtyCount = (uint32_t)(dirtyRatios[ratio] * count);
+		double milliseconds[2] = { 0.0, 0.0 };
+		uint32_t updatedCount = 0;
+		for (int threaded = 0; threaded < 2; threaded++)
+		{
+			for (int frame = 0; frame < frames; frame++)
+			{
+				// NOTE Same local transforms written back, the reference stays valid
+				for (uint32_t i = 0; i < dirtyCount; i++)
+				{
+					TransformId id = dirtyRatios[ratio] >= 1.0f ? i : pick(random);
+					hierarchy.setLocal(id, transforms[id].position, transforms[id].rotation, vec3(1.0f));
+				}
+				hierarchy.update(threaded ? &jobSystem : NULL);
+				milliseconds[threaded] += hierarchy.getStats().updateMilliseconds;
+				updatedCount += hierarchy.getStats().updatedCount;
+			}
+		}
+		printf("  %5.1f%%  %8u (%3.0f%%)  %8.3f ms    %8.3f ms\n", dirtyRatios[ratio] * 100.0f,
+			updatedCount / (2 * frames), 100.0 * updatedCount / (2.0 * frames * count),
+			milliseconds[0] / frames, milliseconds[1] / frames);
+	}
+
+	float error = 0.0f;
+	for (uint32_t id = 0; id < count; id++)
+	{
+		error = std::max(error, maxDifference(hierarchy.getWorld(id).m, reference[id].m, 16));
+	}
+	printf("  max relative error against the reference: %g\n", error);
+}
+
+struct BenchmarkPosition { float x, y, z; };
+struct BenchmarkVelocity { float x, y, z; };
+struct BenchmarkLifetime { float seconds; };
+struct BenchmarkSpin { float angle, speed; };
+struct BenchmarkHealth { float value; };
+
+// Components that only exist to spread entities over many archetypes
+template<int N>
+struct BenchmarkTag { uint8_t value; };
+
+// What the ECS replaces: heap allocated objects updated through a virtual call
+class BenchmarkGameObject
+{
+public:
+	BenchmarkPosition position;
+	BenchmarkVelocity velocity;
+	BenchmarkLifetime lifetime;
+	BenchmarkSpin spin;
+
+	virtual ~BenchmarkGameObject() {}
+	virtual void update(float deltaTime)
+	{
+		position.x += velocity.x * deltaTime;
+		position.y += velocity.y * deltaTime;
+		position.z += velocity.z * deltaTime;
+	}
+};
+
+static void moveChunk(const ChunkView& chunk, float deltaTime)
+{
+	BenchmarkPosition* positions = chunk.get<BenchmarkPosition>();
+	const BenchmarkVelocity* velocities = chunk.get<BenchmarkVelocity>();
+	for (uint32_t i = 0; i < chunk.count; i++)
+	{
+		positions[i].x += velocities[i].x * deltaTime;
+		positions[i].y += velocities[i].y * deltaTime;
+		positions[i].z += velocities[i].z * deltaTime;
+	}
+}
+
+struct BenchmarkSystemData
+{
+	JobSystem* jobSystem;
+	Query* query;
+};
+
+static void gravitySystem(EntityWorld& world, void* data)
+{
+	BenchmarkSystemData* system = (BenchmarkSystemData*)data;
+	world.forEachChunkParallel(*system->query, *system->jobSystem, [](const ChunkView& chunk)
+	{
+		BenchmarkVelocity* velocities = chunk.get<BenchmarkVelocity>();
+		for (uint32_t i = 0; i < chunk.count; i++)
+		{
+			velocities[i].y -= 9.81f / 60.0f;
+		}
+	});
+}
+
+static void moveSystem(EntityWorld& world, void* data)
+{
+	BenchmarkSystemData* system = (BenchmarkSystemData*)data;
+	world.forEachChunkParallel(*system->query, *system->jobSystem, [](const ChunkView& chunk)
+	{
+		moveChunk(chunk, 1.0f / 60.0f);
+	});
+}
+
+static void lifetimeSystem(EntityWorld& world, void* data)
+{
+	BenchmarkSystemData* system = (BenchmarkSystemData*)data;
+	world.forEachChunkParallel(*system->query, *system->jobSystem, [](const ChunkView& chunk)
+	{
+		BenchmarkLifetime* lifetimes = chunk.get<BenchmarkLifetime>();
+		for (uint32_t i = 0; i < chunk.count; i++)
+		{
+			lifetimes[i].seconds -= 1.0f / 60.0f;
+		}
+	});
+}
+
+static void spinSystem(EntityWorld& world, void* data)
+{
+	BenchmarkSystemData* system = (BenchmarkSystemData*)data;
+	world.forEachChunkParallel(*system->query, *system->jobSystem, [](const ChunkView& chunk)
+	{
+		BenchmarkSpin* spins = chunk.get<BenchmarkSpin>();
+		for (uint32_t i = 0; i < chunk.count; i++)
+		{
+			spins[i].angle += spins[i].speed * (1.0f / 60.0f);
+		}
+	});
+}
+
+template<int N>
+static void addTagIfBitSet(EntityWorld& world, Entity entity, uint32_t bits)
+{
+	if (bits & (1u << N))
+	{
+		world.addComponent(entity, BenchmarkTag<N>());
+	}
+}
+
+void runEntityBenchmark()
+{
+	const uint32_t entityCount = 1000000;
+	const uint32_t structuralCount = 100000;
+	const int frames = 10;
+	const uint32_t tagCombinations = 1 << 12;
+	const float deltaTime = 1.0f / 60.0f;
+
+	printf("ECS benchmark (%u entities, %u byte chunks)\n", entityCount, Chunk::Size);
+
+	EntityWorld world(entityCount + tagCombinations);
+	ComponentMask moverMask = componentMask<BenchmarkPosition, BenchmarkVelocity, BenchmarkLifetime, BenchmarkSpin>();
+
+	// Creation
+	std::vector<Entity> entities(entityCount);
+	Clock::time_point start = Clock::now();
+	for (uint32_t i = 0; i < entityCount; i++)
+	{
+		entities[i] = world.createEntity(moverMask);
+		BenchmarkVelocity* velocity = world.getComponent<BenchmarkVelocity>(entities[i]);
+		velocity->x = (float)(i % 100);
+		velocity->y = 1.0f;
+		world.getComponent<BenchmarkSpin>(entities[i])->speed = 1.0f;
+	}
+	double createMilliseconds = elapsedMilliseconds(start);
+
+	std::vector<BenchmarkGameObject*> gameObjects(entityCount);
+	std::vector<char*> padding(entityCount);
+	start = Clock::now();
+	for (uint32_t i = 0; i < entityCount; i++)
+	{
+		// NOTE Other allocations in between, like in a real heap, so objects don't end up back to back
+		gameObjects[i] = new BenchmarkGameObject();
+		gameObjects[i]->velocity.x = (float)(i % 100);
+		gameObjects[i]->velocity.y = 1.0f;
+		padding[i] = new char[16 + (i % 7) * 16];
+	}
+	double heapCreateMilliseconds = elapsedMilliseconds(start);
+
+	EntityWorld::Stats stats = world.getStats();
+	printf("  create: %.1f ns/entity (heap objects %.1f ns), %u archetypes, %u chunks\n",
+		createMilliseconds * 1e6 / entityCount, heapCreateMilliseconds * 1e6 / entityCount, stats.archetypeCount, stats.chunkCount);
+
+	// Iteration: position += velocity * deltaTime
+	Query movers(componentMask<BenchmarkPosition, BenchmarkVelocity>());
+	start = Clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		for (uint32_t i = 0; i < entityCount; i++)
+		{
+			gameObjects[i]->update(deltaTime);
+		}
+	}
+	double heapMilliseconds = elapsedMilliseconds(start) / frames;
+
+	start = Clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		world.forEachChunk(movers, [deltaTime](const ChunkView& chunk)
+		{
+			moveChunk(chunk, deltaTime);
+		});
+	}
+	double chunkMilliseconds = elapsedMilliseconds(start) / frames;
+
+	JobSystem jobSystem;
+	start = Clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		world.forEachChunkParallel(movers, jobSystem, [deltaTime](const ChunkView& chunk)
+		{
+			moveChunk(chunk, deltaTime);
+		});
+	}
+	double parallelMilliseconds = elapsedMilliseconds(start) / frames;
+
+	float checksum = 0.0f;
+	for (uint32_t i = 0; i < entityCount; i += 1000)
+	{
+		checksum += world.getComponent<BenchmarkPosition>(entities[i])->x - gameObjects[i]->position.x * 2.0f;
+	}
+	printf("  iterate position += velocity:\n");
+	printf("    virtual update on heap objects: %8.3f ms (%.2f ns/entity)\n", heapMilliseconds, heapMilliseconds * 1e6 / entityCount);
+	printf("    chunks:                         %8.3f ms (%.2f ns/entity)\n", chunkMilliseconds, chunkMilliseconds * 1e6 / entityCount);
+	printf("    chunks, %2d threads:             %8.3f ms (%.2f ns/entity)\n", jobSystem.getWorkerCount(), parallelMilliseconds, parallelMilliseconds * 1e6 / entityCount);
+	printf("    (checksum %g, 0 when both agree)\n", checksum);
+
+	for (uint32_t i = 0; i < entityCount; i++)
+	{
+		delete gameObjects[i];
+		delete[] padding[i];
+	}
+
+	// Structural changes, every entity moves to another archetype and back
+	std::mt19937 random(3);
+	std::vector<Entity> changed(structuralCount);
+	for (uint32_t i = 0; i < structuralCount; i++)
+	{
+		changed[i] = entities[random() % entityCount];
+	}
+	BenchmarkHealth health = { 100.0f };
+	start = Clock::now();
+	for (uint32_t i = 0; i < structuralCount; i++)
+	{
+		world.addComponent(changed[i], health);
+	}
+	double addMilliseconds = elapsedMilliseconds(start);
+
+	start = Clock::now();
+	for (uint32_t i = 0; i < structuralCount; i++)
+	{
+		world.removeComponent<BenchmarkHealth>(changed[i]);
+	}
+	double removeMilliseconds = elapsedMilliseconds(start);
+
+	start = Clock::now();
+	for (uint32_t i = 0; i < structuralCount; i++)
+	{
+		world.destroyEntity(entities[i]);
+		entities[i] = world.createEntity(moverMask);
+	}
+	double recreateMilliseconds = elapsedMilliseconds(start);
+	printf("  structural changes (%u random entities): add %.1f ns, remove %.1f ns, destroy + create %.1f ns\n",
+		structuralCount, addMilliseconds * 1e6 / structuralCount, removeMilliseconds * 1e6 / structuralCount,
+		recreateMilliseconds * 1e6 / structuralCount);
+
+	// Query matching against thousands of archetypes, one entity in each
+	for (uint32_t bits = 0; bits < tagCombinations; bits++)
+	{
+		Entity entity = world.createEntity(componentMask<BenchmarkPosition>());
+		addTagIfBitSet<0>(world, entity, bits);
+		addTagIfBitSet<1>(world, entity, bits);
+		addTagIfBitSet<2>(world, entity, bits);
+		addTagIfBitSet<3>(world, entity, bits);
+		addTagIfBitSet<4>(world, entity, bits);
+		addTagIfBitSet<5>(world, entity, bits);
+		addTagIfBitSet<6>(world, entity, bits);
+		addTagIfBitSet<7>(world, entity, bits);
+		addTagIfBitSet<8>(world, entity, bits);
+		addTagIfBitSet<9>(world, entity, bits);
+		addTagIfBitSet<10>(world, entity, bits);
+		addTagIfBitSet<11>(world, entity, bits);
+	}
+	stats = world.getStats();
+
+	uint32_t visited = 0;
+	Query tagged(componentMask<BenchmarkPosition, BenchmarkTag<3>, BenchmarkTag<7>>(), componentMask<BenchmarkTag<11>>());
+	start = Clock::now();
+	world.forEachChunk(tagged, [&visited](const ChunkView& chunk) { visited += chunk.count; });
+	double firstMilliseconds = elapsedMilliseconds(start);
+
+	start = Clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		world.forEachChunk(tagged, [&visited](const ChunkView& chunk) { visited += chunk.count; });
+	}
+	double cachedMilliseconds = elapsedMilliseconds(start) / frames;
+	printf("  query over %u archetypes: first run %.3f ms (%.1f ns/archetype tested), cached %.3f ms, %zu archetypes matched\n",
+		stats.archetypeCount, firstMilliseconds, firstMilliseconds * 1e6 / stats.archetypeCount, cachedMilliseconds, tagged.getArchetypeCount());
+
+	// Systems scheduled from their read/write sets
+	Query velocityQuery(componentMask<BenchmarkVelocity>());
+	Query moveQuery(componentMask<BenchmarkPosition, BenchmarkVelocity>());
+	Query lifetimeQuery(componentMask<BenchmarkLifetime>());
+	Query spinQuery(componentMask<BenchmarkSpin>());
+	BenchmarkSystemData gravityData = { &jobSystem, &velocityQuery };
+	BenchmarkSystemData moveData = { &jobSystem, &moveQuery };
+	BenchmarkSystemData lifetimeData = { &jobSystem, &lifetimeQuery };
+	BenchmarkSystemData spinData = { &jobSystem, &spinQuery };
+
+	SystemScheduler scheduler;
+	scheduler.addSystem("gravity", 0, componentMask<BenchmarkVelocity>(), gravitySystem, &gravityData);
+	scheduler.addSystem("move", componentMask<BenchmarkVelocity>(), componentMask<BenchmarkPosition>(), moveSystem, &moveData);
+	scheduler.addSystem("lifetime", 0, componentMask<BenchmarkLifetime>(), lifetimeSystem, &lifetimeData);
+	scheduler.addSystem("spin", 0, componentMask<BenchmarkSpin>(), spinSystem, &spinData);
+	printf("  4 systems in %u stages:\n", scheduler.getStageCount());
+	scheduler.printSchedule();
+
+	start = Clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		scheduler.run(world, NULL);
+	}
+	double serialMilliseconds = elapsedMilliseconds(start) / frames;
+
+	start = Clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		scheduler.run(world, &jobSystem);
+	}
+	double scheduledMilliseconds = elapsedMilliseconds(start) / frames;
+	printf("  systems: %.3f ms/frame one after the other, %.3f ms/frame scheduled\n", serialMilliseconds, scheduledMilliseconds);
+
+	printMemoryReport();
+}
+
+void runCullingBenchmark()
+{
+	const uint32_t objectCounts[] = { 100000, 250000, 1000000 };
+	const int repeats = 10;
+	const float worldSize = 1000.0f;
+
+	JobSystem jobSystem;
+	printf("Culling benchmark (%s, %d threads, objects culled per ms)\n", getMathInstructionSet(), jobSystem.getWorkerCount());
+
+	// Camera in the middle of the objects looking along -z, sees about a tenth of them
+	mat4 view = lookAt(vec3(0.0f, 0.0f, worldSize * 0.5f), vec3(0.0f), vec3(0.0f, 1.0f, 0.0f));
+	mat4 projection = perspective(1.0f, 16.0f / 9.0f, 0.1f, worldSize * 0.6f);
+	Frustum frustum = extractFrustum(projection * view);
+
+	std::mt19937 random(5);
+	std::uniform_real_distribution<float> position(-worldSize * 0.5f, worldSize * 0.5f);
+	std::uniform_real_distribution<float> size(0.5f, 5.0f);
+
+	for (size_t test = 0; test < sizeof(objectCounts) / sizeof(objectCounts[0]); test++)
+	{
+		uint32_t count = objectCounts[test];
+		std::vector<float> centerX(count), centerY(count), centerZ(count), extentX(count), extentY(count), extentZ(count), radius(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			centerX[i] = position(random);
+			centerY[i] = position(random);
+			centerZ[i] = position(random);
+			extentX[i] = size(random);
+			extentY[i] = size(random);
+			extentZ[i] = size(random);
+			radius[i] = std::sqrt(extentX[i] * extentX[i] + extentY[i] * extentY[i] + extentZ[i] * extentZ[i]);
+		}
+		BoxesSoA boxes = { centerX.data(), centerY.data(), centerZ.data(), extentX.data(), extentY.data(), extentZ.data() };
+		SpheresSoA spheres = { centerX.data(), centerY.data(), centerZ.data(), radius.data() };
+
+		std::vector<uint32_t> reference(count), visible(count);
+		uint32_t referenceCount = 0, visibleCount = 0;
+		double milliseconds[6];
+		bool matches = true;
+		for (int kernel = 0; kernel < 6; kernel++)
+		{
+			Clock::time_point start = Clock::now();
+			for (int repeat = 0; repeat < repeats; repeat++)
+			{
+				switch (kernel)
+				{
+				case 0: referenceCount = cullBoxesScalar(frustum, boxes, 0, count, reference.data()); break;
+				case 1: visibleCount = cullBoxes(frustum, boxes, 0, count, visible.data()); break;
+				case 2: visibleCount = cullBoxesParallel(jobSystem, frustum, boxes, count, visible.data()); break;
+				case 3: referenceCount = cullSpheresScalar(frustum, spheres, 0, count, reference.data()); break;
+				case 4: visibleCount = cullSpheres(frustum, spheres, 0, count, visible.data()); break;
+				case 5: visibleCount = cullSpheresParallel(jobSystem, frustum, spheres, count, visible.data()); break;
+				}
+			}
+			milliseconds[kernel] = elapsedMilliseconds(start) / repeats;
+
+			// Every kernel has to produce exactly the visible list of the scalar one
+			if (kernel % 3 != 0)
+			{
+				matches = matches && visibleCount == referenceCount && memcmp(visible.data(), reference.data(), visibleCount * sizeof(uint32_t)) == 0;
+			}
+		}
+
+		printf("  %7u objects, %5.1f%% visible:\n", count, 100.0 * referenceCount / count);
+		printf("    boxes:   scalar %8.0f, SIMD %8.0f, job system %8.0f\n", count / milliseconds[0], count / milliseconds[1], count / milliseconds[2]);
+		printf("    spheres: scalar %8.0f, SIMD %8.0f, job system %8.0f\n", count / milliseconds[3], count / milliseconds[4], count / milliseconds[5]);
+		printf("    visible lists %s the scalar ones\n", matches ? "match" : "DON'T MATCH");
+	}
+}
+
+void runBvhBenchmark()
+{
+	const uint32_t objectCounts[] = { 100000, 1000000 };
+	const float worldSize = 1000.0f;
+	const int frames = 10;
+	const float movingRatio = 0.1f;
+	const int queryCount = 1000;
+	const int bruteForceQueryCount = 50;
+
+	printf("BVH benchmark (times per operation, brute force tests every object)\n");
+
+	// Wide view sees about a sixth of the objects, narrow one is a picking sized cone
+	mat4 view = lookAt(vec3(0.0f, 0.0f, worldSize * 0.5f), vec3(0.0f), vec3(0.0f, 1.0f, 0.0f));
+	Frustum wideFrustum = extractFrustum(perspective(1.0f, 16.0f / 9.0f, 0.1f, worldSize * 0.6f) * view);
+	Frustum narrowFrustum = extractFrustum(perspective(0.05f, 1.0f, 0.1f, worldSize * 0.6f) * view);
+
+	std::mt19937 random(9);
+	std::uniform_real_distribution<float> position(-worldSize * 0.5f, worldSize * 0.5f);
+	std::uniform_real_distribution<float> size(0.5f, 5.0f);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	for (size_t test = 0; test < sizeof(objectCounts) / sizeof(objectCounts[0]); test++)
+	{
+		uint32_t count = objectCounts[test];
+		std::vector<Aabb> bounds(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			vec3 center(position(random), position(random), position(random));
+			vec3 extents(size(random), size(random), size(random));
+			bounds[i].min = center - extents;
+			bounds[i].max = center + extents;
+		}
+		printf("  %u objects:\n", count);
+
+		// Incremental inserts, then a full SAH rebuild over the same leaves
+		DynamicBvh bvh;
+		Clock::time_point start = Clock::now();
+		for (uint32_t i = 0; i < count; i++)
+		{
+			bvh.insert(bounds[i]);
+		}
+		double insertMilliseconds = elapsedMilliseconds(start);
+		DynamicBvh::Stats insertStats = bvh.getStats();
+
+		start = Clock::now();
+		bvh.build();
+		double buildMilliseconds = elapsedMilliseconds(start);
+		DynamicBvh::Stats buildStats = bvh.getStats();
+		printf("    insert one by one: %8.2f ms (%.0f ns/object), height %u, SAH cost %.0f\n",
+			insertMilliseconds, insertMilliseconds * 1e6 / count, insertStats.height, insertStats.cost);
+		printf("    SAH build:         %8.2f ms (%.0f ns/object), height %u, SAH cost %.0f\n",
+			buildMilliseconds, buildMilliseconds * 1e6 / count, buildStats.height, buildStats.cost);
+
+		// A tenth of the objects move a bit every frame, refit instead of rebuilding
+		uint32_t movingCount = (uint32_t)(count * movingRatio);
+		double refitMilliseconds = 0.0;
+		for (int frame = 0; frame < frames; frame++)
+		{
+			start = Clock::now();
+			for (uint32_t i = 0; i < movingCount; i++)
+			{
+				uint32_t object = (uint32_t)(random() % count);
+				vec3 offset(unit(random), unit(random), unit(random));
+				bounds[object].min = bounds[object].min + offset;
+				bounds[object].max = bounds[object].max + offset;
+				bvh.setBounds(object, bounds[object]);
+			}
+			bvh.refit();
+			refitMilliseconds += elapsedMilliseconds(start);
+		}
+		DynamicBvh::Stats refitStats = bvh.getStats();
+		printf("    refit, %u moving:  %8.2f ms/frame, SAH cost after %d frames %.0f\n",
+			movingCount, refitMilliseconds / frames, frames, refitStats.cost);
+
+		std::vector<float> centerX(count), centerY(count), centerZ(count), extentX(count), extentY(count), extentZ(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			centerX[i] = (bounds[i].min.x + bounds[i].max.x) * 0.5f;
+			centerY[i] = (bounds[i].min.y + bounds[i].max.y) * 0.5f;
+			centerZ[i] = (bounds[i].min.z + bounds[i].max.z) * 0.5f;
+			extentX[i] = (bounds[i].max.x - bounds[i].min.x) * 0.5f;
+			extentY[i] = (bounds[i].max.y - bounds[i].min.y) * 0.5f;
+			extentZ[i] = (bounds[i].max.z - bounds[i].min.z) * 0.5f;
+		}
+		BoxesSoA boxes = { centerX.data(), centerY.data(), centerZ.data(), extentX.data(), extentY.data(), extentZ.data() };
+
+		// Frustum queries against the SIMD linear culling
+		std::vector<uint32_t> result, linear(count);
+		const Frustum* frustums[2] = { &wideFrustum, &narrowFrustum };
+		const char* frustumNames[2] = { "wide", "narrow" };
+		for (int f = 0; f < 2; f++)
+		{
+			start = Clock::now();
+			for (int repeat = 0; repeat < frames; repeat++)
+			{
+				result.clear();
+				bvh.queryFrustum(*frustums[f], result);
+			}
+			double bvhMilliseconds = elapsedMilliseconds(start) / frames;
+
+			start = Clock::now();
+			uint32_t linearCount = 0;
+			for (int repeat = 0; repeat < frames; repeat++)
+			{
+				linearCount = cullBoxes(*frustums[f], boxes, 0, count, linear.data());
+			}
+			double linearMilliseconds = elapsedMilliseconds(start) / frames;
+
+			std::sort(result.begin(), result.end());
+			bool matches = result.size() == linearCount && std::equal(result.begin(), result.end(), linear.begin());
+			printf("    frustum (%s, %6zu visible): BVH %8.3f ms, linear SIMD %8.3f ms%s\n", frustumNames[f], result.size(),
+				bvhMilliseconds, linearMilliseconds, matches ? "" : " (results DON'T MATCH)");
+		}
+
+		// Ray picking
+		std::vector<vec3> rayOrigins(queryCount), rayDirections(queryCount);
+		for (int i = 0; i < queryCount; i++)
+		{
+			rayOrigins[i] = vec3(position(random), position(random), position(random));
+			rayDirections[i] = normalize(vec3(unit(random), unit(random), unit(random)));
+		}
+		std::vector<uint32_t> hits(queryCount, DynamicBvh::NullIndex);
+		start = Clock::now();
+		for (int i = 0; i < queryCount; i++)
+		{
+			float distance;
+			bvh.raycast(rayOrigins[i], rayDirections[i], worldSize, hits[i], distance);
+		}
+		double rayMilliseconds = elapsedMilliseconds(start);
+
+		int rayMismatches = 0;
+		start = Clock::now();
+		for (int i = 0; i < bruteForceQueryCount; i++)
+		{
+			vec3 inverseDirection(1.0f / rayDirections[i].x, 1.0f / rayDirections[i].y, 1.0f / rayDirections[i].z);
+			float closest = worldSize;
+			uint32_t hit = DynamicBvh::NullIndex;
+			for (uint32_t object = 0; object < count; object++)
+			{
+				float distance = intersectRay(bounds[object], rayOrigins[i], inverseDirection, closest);
+				if (distance >= 0.0f && (hit == DynamicBvh::NullIndex || distance < closest))
+				{
+					closest = distance;
+					hit = object;
+				}
+			}
+			rayMismatches += hit != hits[i];
+		}
+		double bruteRayMilliseconds = elapsedMilliseconds(start);
+		printf("    ray picking:  BVH %8.2f us, brute force %8.2f us (%d of %d differ)\n", rayMilliseconds * 1e3 / queryCount,
+			bruteRayMilliseconds * 1e3 / bruteForceQueryCount, rayMismatches, bruteForceQueryCount);
+
+		// Range queries, boxes of 20 units
+		std::vector<Aabb> ranges(queryCount);
+		for (int i = 0; i < queryCount; i++)
+		{
+			vec3 center(position(random), position(random), position(random));
+			ranges[i].min = center - vec3(10.0f);
+			ranges[i].max = center + vec3(10.0f);
+		}
+		size_t found = 0;
+		start = Clock::now();
+		for (int i = 0; i < queryCount; i++)
+		{
+			result.clear();
+			bvh.queryRange(ranges[i], result);
+			found += result.size();
+		}
+		double rangeMilliseconds = elapsedMilliseconds(start);
+
+		size_t bvhFound = 0, bruteFound = 0;
+		start = Clock::now();
+		for (int i = 0; i < bruteForceQueryCount; i++)
+		{
+			for (uint32_t object = 0; object < count; object++)
+			{
+				bruteFound += overlaps(bounds[object], ranges[i]);
+			}
+		}
+		double bruteRangeMilliseconds = elapsedMilliseconds(start);
+		for (int i = 0; i < bruteForceQueryCount; i++)
+		{
+			result.clear();
+			bvh.queryRange(ranges[i], result);
+			bvhFound += result.size();
+		}
+		printf("    range query:  BVH %8.2f us, brute force %8.2f us (%.1f objects per query, %s)\n", rangeMilliseconds * 1e3 / queryCount,
+			bruteRangeMilliseconds * 1e3 / bruteForceQueryCount, (double)found / queryCount, bvhFound == bruteFound ? "same results" : "results DON'T MATCH");
+	}
+}
+
+// 8 corners and 12 triangles of a box, vertices are just positions
+static void appendBoxMesh(const vec3& center, const vec3& extents, std::vector<float>& vertices, std::vector<uint32_t>& indices)
+{
+	static const uint32_t faces[36] = {
+		0, 1, 3, 0, 3, 2,	4, 6, 7, 4, 7, 5,	0, 4, 5, 0, 5, 1,
+		2, 3, 7, 2, 7, 6,	0, 2, 6, 0, 6, 4,	1, 5, 7, 1, 7, 3
+	};
+
+	uint32_t first = (uint32_t)(vertices.size() / 3);
+	for (int corner = 0; corner < 8; corner++)
+	{
+		vertices.push_back(center.x + (corner & 1 ? extents.x : -extents.x));
+		vertices.push_back(center.y + (corner & 2 ? extents.y : -extents.y));
+		vertices.push_back(center.z + (corner & 4 ? extents.z : -extents.z));
+	}
+	for (int i = 0; i < 36; i++)
+	{
+		indices.push_back(first + faces[i]);
+	}
+}
+
+void runOcclusionBenchmark()
+{
+	const uint32_t objectCount = 100000;
+	const int frames = 20;
+	const int resolutions[][2] = { { 128, 64 }, { 256, 128 }, { 512, 256 } };
+	const float wallFrontZ = 12.0f;
+
+	printf("Occlusion culling benchmark (%u objects, frustum culled first)\n", objectCount);
+
+	// A street: two rows of buildings on the sides and a wall across, objects scattered behind and in front
+	std::vector<float> occluderVertices;
+	std::vector<uint32_t> occluderIndices;
+	for (int i = 0; i < 8; i++)
+	{
+		appendBoxMesh(vec3(-30.0f, 15.0f, 5.0f - i * 40.0f), vec3(15.0f, 15.0f, 15.0f), occluderVertices, occluderIndices);
+		appendBoxMesh(vec3(30.0f, 15.0f, 5.0f - i * 40.0f), vec3(15.0f, 15.0f, 15.0f), occluderVertices, occluderIndices);
+	}
+	appendBoxMesh(vec3(0.0f, 10.0f, 10.0f), vec3(16.0f, 10.0f, 1.0f), occluderVertices, occluderIndices);
+
+	std::mt19937 random(13);
+	std::uniform_real_distribution<float> positionX(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> positionY(0.0f, 20.0f);
+	std::uniform_real_distribution<float> positionZ(-300.0f, 40.0f);
+	std::uniform_real_distribution<float> size(0.2f, 1.5f);
+	BoxBuffer objects;
+	for (uint32_t i = 0; i < objectCount; i++)
+	{
+		objects.add(vec3(positionX(random), positionY(random), positionZ(random)), vec3(size(random)));
+	}
+	BoxesSoA boxes = objects.getBoxes();
+
+	mat4 viewProjection = perspective(1.2f, 16.0f / 9.0f, 0.1f, 500.0f) * lookAt(vec3(0.0f, 4.0f, 60.0f), vec3(0.0f, 4.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum = extractFrustum(viewProjection);
+	std::vector<uint32_t> frustumVisible(objectCount), visible(objectCount);
+	uint32_t frustumCount = cullBoxes(frustum, boxes, 0, objectCount, frustumVisible.data());
+	printf("  %u occluder triangles, %u objects in the frustum\n", (uint32_t)occluderIndices.size() / 3, frustumCount);
+
+	for (size_t r = 0; r < sizeof(resolutions) / sizeof(resolutions[0]); r++)
+	{
+		OcclusionCuller culler(resolutions[r][0], resolutions[r][1]);
+		double rasterMilliseconds = 0.0, hierarchyMilliseconds = 0.0, testMilliseconds = 0.0;
+		uint32_t visibleCount = 0;
+		for (int frame = 0; frame < frames; frame++)
+		{
+			culler.beginFrame(viewProjection);
+			culler.drawOccluder(mat4::identity(), occluderVertices.data(), 3, occluderIndices.data(), (uint32_t)occluderIndices.size());
+			culler.buildHierarchy();
+			memcpy(visible.data(), frustumVisible.data(), frustumCount * sizeof(uint32_t));
+			visibleCount = culler.filterVisible(boxes, visible.data(), frustumCount);
+
+			OcclusionCuller::Stats stats = culler.getStats();
+			rasterMilliseconds += stats.rasterMilliseconds;
+			hierarchyMilliseconds += stats.hierarchyMilliseconds;
+			testMilliseconds += stats.testMilliseconds;
+		}
+
+		// Sanity check: nothing fully in front of the closest occluder can be hidden
+		uint32_t wronglyOccluded = 0;
+		for (uint32_t i = 0, v = 0; i < frustumCount; i++)
+		{
+			uint32_t index = frustumVisible[i];
+			bool kept = v < visibleCount && visible[v] == index;
+			v += kept;
+			wronglyOccluded += !kept && boxes.centerZ[index] - boxes.extentZ[index] > wallFrontZ + 8.0f;
+		}
+
+		uint32_t occluded = frustumCount - visibleCount;
+		printf("  %3dx%-3d: %5.1f%% occluded (%u), raster %.3f ms, hi-z %.3f ms, tests %.3f ms (%.0f ns/object), %.3f ms/frame, %u wrongly occluded\n",
+			culler.getWidth(), culler.getHeight(), 100.0 * occluded / frustumCount, occluded,
+			rasterMilliseconds / frames, hierarchyMilliseconds / frames, testMilliseconds / frames, testMilliseconds * 1e6 / ((double)frames * frustumCount),
+			(rasterMilliseconds + hierarchyMilliseconds + testMilliseconds) / frames, wronglyOccluded);
+	}
+}
+
+static void createCheckerTexture(SoftwareTexture& texture, int size, int cellSize, uint32_t colorA, uint32_t colorB)
+{
+	std::vector<unsigned char> data((size_t)size * size * 4);
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			uint32_t color = ((x / cellSize + y / cellSize) & 1) ? colorA : colorB;
+			memcpy(&data[((size_t)y * size + x) * 4], &color, 4);
+		}
+	}
+	texture.create(data.data(), size, size, 4);
+}
+
+void runSoftwareRendererBenchmark()
+{
+	const int width = 1280;
+	const int height = 720;
+	const int frames = 10;
+	const int quadCount = 2000;
+	const int gridSize = 256;	// vertices per side of the dense mesh
+
+	int coreCount = (int)std::thread::hardware_concurrency();
+	if (coreCount < 1)
+	{
+		coreCount = 1;
+	}
+
+	// NOTE Procedural textures, so the benchmark doesn't depend on the working directory
+	SoftwareTexture textures[2];
+	createCheckerTexture(textures[0], 256, 16, 0xFFA06030, 0xFF90C0D0);
+	createCheckerTexture(textures[1], 512, 4, 0xFFFFFFFF, 0xFF000000);
+
+	// The quad of main.cpp, same vertex layout
+	const float quadVertices[] = {
+		 0.5f,  0.5f, 0.0f,		1.0f, 0.0f, 0.0f,		1.0f, 0.0f,
+		 0.5f, -0.5f, 0.0f,		0.0f, 1.0f, 0.0f,		1.0f, 1.0f,
+		-0.5f, -0.5f, 0.0f,		0.0f, 0.0f, 1.0f,		0.0f, 1.0f,
+		-0.5f,  0.5f, 0.0f,		1.0f, 1.0f, 1.0f,		0.0f, 0.0f
+	};
+	const uint32_t quadIndices[] = { 0, 1, 3, 1, 2, 3 };
+
+	// Big quads in front of a perspective camera: fill rate with a lot of overdraw
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> positionX(-20.0f, 20.0f);
+	std::uniform_real_distribution<float> positionY(-12.0f, 12.0f);
+	std::uniform_real_distribution<float> positionZ(-60.0f, -5.0f);
+	std::uniform_real_distribution<float> axis(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+	std::uniform_real_distribution<float> size(1.0f, 4.0f);
+	mat4 projection = perspective(1.0f, (float)width / height, 0.1f, 100.0f);
+	std::vector<mat4> quadTransforms(quadCount);
+	for (int i = 0; i < quadCount; i++)
+	{
+		vec3 rotationAxis = normalize(vec3(axis(random), axis(random), axis(random)) + vec3(0.0f, 0.0f, 2.0f));
+		quat orientation = quatFromAxisAngle(rotationAxis, angle(random));
+		quadTransforms[i] = projection * composeTransform(vec3(positionX(random), positionY(random), positionZ(random)), orientation, vec3(size(random)));
+	}
+
+	// Small triangles: a grid over the whole screen, a few pixels per triangle
+	std::vector<float> gridVertices;
+	std::vector<uint32_t> gridIndices;
+	for (int y = 0; y < gridSize; y++)
+	{
+		for (int x = 0; x < gridSize; x++)
+		{
+			float s = (float)x / (gridSize - 1), t = (float)y / (gridSize - 1);
+			float vertex[8] = { s * 2.0f - 1.0f, t * 2.0f - 1.0f, 0.0f, 1.0f, 1.0f, 1.0f, s * 4.0f, t * 4.0f };
+			gridVertices.insert(gridVertices.end(), vertex, vertex + 8);
+		}
+	}
+	for (int y = 0; y + 1 < gridSize; y++)
+	{
+		for (int x = 0; x + 1 < gridSize; x++)
+		{
+			uint32_t corner = y * gridSize + x;
+			uint32_t cell[6] = { corner, corner + 1, corner + gridSize, corner + 1, corner + gridSize + 1, corner + gridSize };
+			gridIndices.insert(gridIndices.end(), cell, cell + 6);
+		}
+	}
+
+	struct Scene
+	{
+		const char* name;
+		TextureFilter filter;
+		bool grid;
+	};
+	const Scene scenes[] = {
+		{ "quads, bilinear", TextureFilterBilinear, false },
+		{ "quads, mipmapped", TextureFilterBilinearMipmapped, false },
+		{ "grid, bilinear", TextureFilterBilinear, true }
+	};
+
+	printf("Software renderer benchmark (%dx%d, %d hardware threads, %d quads or a %u triangle grid)\n",
+		width, height, coreCount, quadCount, (uint32_t)gridIndices.size() / 3);
+
+	for (size_t s = 0; s < sizeof(scenes) / sizeof(scenes[0]); s++)
+	{
+		const Scene& scene = scenes[s];
+		printf("  %s\n", scene.name);
+
+		std::vector<uint32_t> reference;
+		double singleThreadMilliseconds = 0.0;
+		for (int threadCount = 1; threadCount <= coreCount; threadCount *= 2)
+		{
+			JobSystem jobSystem(threadCount - 1);
+			SoftwareRenderer renderer(width, height, &jobSystem);
+			renderer.setTextures(&textures[0], &textures[1]);
+			renderer.setMixValue(0.3f);
+			renderer.setFilter(scene.filter);
+
+			for (int frame = 0; frame < frames; frame++)
+			{
+				renderer.clear(0.2f, 0.3f, 0.3f, 1.0f);
+				if (scene.grid)
+				{
+					renderer.draw(gridVertices.data(), gridIndices.data(), (uint32_t)gridIndices.size(), mat4::identity());
+				}
+				else
+				{
+					for (int i = 0; i < quadCount; i++)
+					{
+						renderer.draw(quadVertices, quadIndices, 6, quadTransforms[i]);
+					}
+				}
+				renderer.flush();
+			}
+
+			SoftwareRenderer::Stats stats = renderer.getStats();
+			double milliseconds = stats.setupMilliseconds + stats.rasterMilliseconds;
+			if (threadCount == 1)
+			{
+				singleThreadMilliseconds = milliseconds;
+			}
+
+			// Tiles never share pixels, so every thread count has to give the same image
+			const uint32_t* colors = renderer.getColorBuffer();
+			if (reference.empty())
+			{
+				reference.assign(colors, colors + (size_t)width * height);
+			}
+			bool identical = memcmp(reference.data(), colors, reference.size() * sizeof(uint32_t)) == 0;
+
+			printf("    %2d threads: %7.2f ms/frame (%.2fx, setup %.2f ms), %6.1f Mpixels/s, %7.0f Ktriangles/s, %.1f tiles/triangle, overdraw %.1f%s\n",
+				threadCount, milliseconds / frames, singleThreadMilliseconds / milliseconds, stats.setupMilliseconds / frames,
+				stats.shadedPixels / (milliseconds * 1000.0), (double)stats.triangles / milliseconds,
+				(double)stats.binnedTriangles / stats.triangles, (double)stats.shadedPixels / ((double)frames * width * height),
+				identical ? "" : ", IMAGE DIFFERS FROM 1 THREAD");
+
+			if (threadCount < coreCount && threadCount * 2 > coreCount)
+			{
+				threadCount = coreCount / 2;
+			}
+		}
+	}
+}
+
+void runCpuProfilerBenchmark()
+{
+	const int rounds = 5;
+	const int zones = (int)CpuProfiler::EventsPerThread - 1;
+
+	std::cout << "CPU profiler benchmark: " << zones << " zones per round" << std::endl;
+
+	// NOTE The counter keeps the loop from being optimized away, zones are timed from outside
+	volatile int counter = 0;
+	volatile uint64_t timestamps = 0;
+	double bestMilliseconds = 1e9;
+	for (int round = 0; round < rounds; round++)
+	{
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < zones; i++)
+		{
+			timestamps = timestamps + CpuProfiler::now();
+		}
+		bestMilliseconds = std::min(bestMilliseconds, elapsedMilliseconds(start));
+	}
+	// A zone reads two, on virtual machines that can be most of its cost
+	std::cout << "  Timestamp: " << bestMilliseconds * 1e6 / zones << " ns" << std::endl;
+
+	bestMilliseconds = 1e9;
+	for (int round = 0; round < rounds; round++)
+	{
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < zones; i++)
+		{
+			CpuZone zone("Disabled");
+			counter = counter + 1;
+		}
+		bestMilliseconds = std::min(bestMilliseconds, elapsedMilliseconds(start));
+	}
+	std::cout << "  Disabled: " << bestMilliseconds * 1e6 / zones << " ns/zone" << std::endl;
+
+	// Every round on a new thread, so it starts with an empty buffer and nothing is dropped
+	CpuProfiler::start();
+	bestMilliseconds = 1e9;
+	for (int round = 0; round < rounds; round++)
+	{
+		double milliseconds = 0.0;
+		std::thread thread([&milliseconds, &counter, zones]()
+		{
+			// First event allocates the buffer
+			{
+				CpuZone zone("Warmup");
+			}
+
+			Clock::time_point start = Clock::now();
+			for (int i = 1; i < zones; i++)
+			{
+				CpuZone zone("Enabled");
+				counter = counter + 1;
+			}
+			milliseconds = elapsedMilliseconds(start);
+		});
+		thread.join();
+		bestMilliseconds = std::min(bestMilliseconds, milliseconds);
+	}
+	CpuProfiler::stop();
+	std::cout << "  Enabled: " << bestMilliseconds * 1e6 / (zones - 1) << " ns/zone" << std::endl;
+
+	CpuProfiler::Stats stats = CpuProfiler::getStats();
+	std::cout << "  " << stats.events << " events on " << stats.threads << " threads, " << stats.droppedEvents << " dropped" << std::endl;
+}
+
+void runStreamBufferBenchmark()
+{
+	const size_t bytesPerFrame = 8 * 1024 * 1024;
+	const size_t chunkSize = 64 * 1024;
+	const int frameCount = 600;
+
+	// NOTE The GPU copies each frame into this buffer, so it really has to wait for our writes
+	unsigned int destinationBuffer;
+	glGenBuffers(1, &destinationBuffer);
+	glBindBuffer(GL_COPY_READ_BUFFER, destinationBuffer);
+	glBufferData(GL_COPY_READ_BUFFER, bytesPerFrame, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	std::vector<unsigned char> sourceData(chunkSize, 0x5A);
+
+	// Streaming through the ring buffer, one memcpy per chunk
+	StreamBuffer streamBuffer(bytesPerFrame);
+	Clock::time_point start = Clock::now();
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		streamBuffer.beginFrame();
+
+		size_t firstOffset = 0;
+		size_t offset = 0;
+		for (size_t written = 0; written < bytesPerFrame; written += chunkSize)
+		{
+			streamBuffer.write(sourceData.data(), chunkSize, 16, offset);
+			if (written == 0)
+			{
+				firstOffset = offset;
+			}
+		}
+		streamBuffer.finishWrites();
+
+		glBindBuffer(GL_COPY_READ_BUFFER, streamBuffer.Id);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, destinationBuffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, firstOffset, 0, bytesPerFrame);
+
+		streamBuffer.endFrame();
+		glFlush();
+	}
+	glFinish();
+	double ringTime = elapsedMilliseconds(start);
+	StreamBuffer::Stats ringStats = streamBuffer.getStats();
+	bool persistent = streamBuffer.isPersistent();
+	streamBuffer.destroy();
+
+	// Re-specifying the whole buffer with glBufferData every frame, like the STATIC_DRAW upload in main
+	unsigned int respecifiedBuffer;
+	glGenBuffers(1, &respecifiedBuffer);
+	std::vector<unsigned char> frameData(bytesPerFrame, 0x5A);
+	start = Clock::now();
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, respecifiedBuffer);
+		glBufferData(GL_COPY_READ_BUFFER, bytesPerFrame, frameData.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, destinationBuffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, bytesPerFrame);
+		glFlush();
+	}
+	glFinish();
+	double respecifyTime = elapsedMilliseconds(start);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glDeleteBuffers(1, &respecifiedBuffer);
+	glDeleteBuffers(1, &destinationBuffer);
+
+	double megabytesPerFrame = (double)bytesPerFrame / (1024.0 * 1024.0);
+	printf("StreamBuffer benchmark (%.1f MB/frame, %d frames)\n", megabytesPerFrame, frameCount);
+	printf("  ring buffer (%s): %.3f ms/frame, %.1f MB/s, %d fence waits (%.2f ms total)\n",
+		persistent ? "persistent mapping" : "unsynchronized glMapBufferRange",
+		ringTime / frameCount, megabytesPerFrame * frameCount / (ringTime / 1000.0),
+		ringStats.fenceWaits, ringStats.fenceWaitMilliseconds);
+	printf("  glBufferData:  %.3f ms/frame, %.1f MB/s\n",
+		respecifyTime / frameCount, megabytesPerFrame * frameCount / (respecifyTime / 1000.0));
+}
+
+void runInstancingBenchmark()
+{
+	const int instanceCounts[] = { 10000, 50000, 100000 };
+	const int frameCount = 10;
+
+	BenchmarkScene scene;
+	createBenchmarkScene(scene);
+	DrawItem quadItem = makeQuadDrawItem(scene);
+
+	InstanceBatcher batcher(100000);
+	std::vector<float> transforms;
+
+	printf("Instancing benchmark (%d frames per run)\n", frameCount);
+	for (int run = 0; run < 3; run++)
+	{
+		int instanceCount = instanceCounts[run];
+		makeGridTransforms(instanceCount, transforms);
+
+		double directCpuMilliseconds = 0.0;
+		Clock::time_point frameStart = Clock::now();
+		glBindVertexArray(quadItem.vertexArray);
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			glClear(GL_COLOR_BUFFER_BIT);
+			Clock::time_point start = Clock::now();
+			drawDirect(quadItem, transforms, instanceCount);
+			directCpuMilliseconds += elapsedMilliseconds(start);
+			glFinish();
+		}
+		double directFrameMilliseconds = elapsedMilliseconds(frameStart) / frameCount;
+		InstanceBatcher::setDefaultTransform();
+
+		double batchedCpuMilliseconds = 0.0;
+		frameStart = Clock::now();
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			glClear(GL_COLOR_BUFFER_BIT);
+			Clock::time_point start = Clock::now();
+			for (int i = 0; i < instanceCount; i++)
+			{
+				batcher.submit(quadItem, &transforms[(size_t)i * 16]);
+			}
+			batcher.flush();
+			batchedCpuMilliseconds += elapsedMilliseconds(start);
+			glFinish();
+		}
+		double batchedFrameMilliseconds = elapsedMilliseconds(frameStart) / frameCount;
+		InstanceBatcher::Stats batchStats = batcher.getStats();
+
+		directCpuMilliseconds /= frameCount;
+		batchedCpuMilliseconds /= frameCount;
+		printf("  %6d instances\n", instanceCount);
+		printf("    direct:    %8.3f ms CPU, %8.3f ms frame, %6.2f M draws/s\n",
+			directCpuMilliseconds, directFrameMilliseconds, instanceCount / directCpuMilliseconds / 1000.0);
+		printf("    instanced: %8.3f ms CPU, %8.3f ms frame, %6.2f M instances/s (%u draw calls)\n",
+			batchedCpuMilliseconds, batchedFrameMilliseconds, instanceCount / batchedCpuMilliseconds / 1000.0, batchStats.drawCalls);
+	}
+
+	batcher.destroy();
+	destroyBenchmarkScene(scene);
+}
+
+void runMultiDrawIndirectBenchmark()
+{
+	const int drawCounts[] = { 10000, 50000, 100000 };
+	const int frameCount = 10;
+
+	BenchmarkScene scene;
+	createBenchmarkScene(scene);
+	DrawItem quadItem = makeQuadDrawItem(scene);
+
+	IndirectRenderer indirectRenderer(*scene.bufferArena, 100000);
+	std::vector<float> transforms;
+
+	printf("Multi-draw indirect benchmark (%d frames per run, %s)\n", frameCount,
+		GLExtensions.multiDrawIndirect ? "glMultiDrawElementsIndirect" : "fallback, one draw per command");
+	for (int run = 0; run < 3; run++)
+	{
+		int drawCount = drawCounts[run];
+		makeGridTransforms(drawCount, transforms);
+
+		double directCpuMilliseconds = 0.0;
+		glBindVertexArray(quadItem.vertexArray);
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			glClear(GL_COLOR_BUFFER_BIT);
+			Clock::time_point start = Clock::now();
+			drawDirect(quadItem, transforms, drawCount);
+			directCpuMilliseconds += elapsedMilliseconds(start);
+			glFinish();
+		}
+		InstanceBatcher::setDefaultTransform();
+
+		double indirectCpuMilliseconds = 0.0;
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			glClear(GL_COLOR_BUFFER_BIT);
+			Clock::time_point start = Clock::now();
+			for (int i = 0; i < drawCount; i++)
+			{
+				indirectRenderer.submit(scene.quad, &transforms[(size_t)i * 16]);
+			}
+			indirectRenderer.flush(quadItem.program, quadItem.textures, DrawItem::MaxTextures);
+			indirectCpuMilliseconds += elapsedMilliseconds(start);
+			glFinish();
+		}
+		IndirectRenderer::Stats indirectStats = indirectRenderer.getStats();
+
+		directCpuMilliseconds /= frameCount;
+		indirectCpuMilliseconds /= frameCount;
+		printf("  %6d draws\n", drawCount);
+		printf("    direct:   %8.3f ms CPU, %7.1f ns/draw\n", directCpuMilliseconds, directCpuMilliseconds * 1e6 / drawCount);
+		printf("    indirect: %8.3f ms CPU, %7.1f ns/draw (%u API calls)\n",
+			indirectCpuMilliseconds, indirectCpuMilliseconds * 1e6 / drawCount, indirectStats.apiCalls);
+	}
+
+	indirectRenderer.destroy();
+	destroyBenchmarkScene(scene);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+// Benchmarks that can be launched with "KnoxEngine --bench <name>"
+// Returns false if no benchmark with that name exists
+bool runCpuBenchmark(const char* name);
+
+// Same as runCpuBenchmark, for benchmarks that need a current OpenGL context
+bool runGpuBenchmark(const char* name);
+
+void runOffsetAllocatorBenchmark();
+void runRenderQueueBenchmark();
+void runJobSystemBenchmark();
+void runFiberBenchmark();
+void runFrameArenaBenchmark();
+void runPoolBenchmark();
+void runMathBenchmark();
+void runTransformBenchmark();
+void runEntityBenchmark();
+void runCullingBenchmark();
+void runBvhBenchmark();
+void runOcclusionBenchmark();
+void runSoftwareRendererBenchmark();
+void runCpuProfilerBenchmark();
+void runStreamBufferBenchmark();
+void runInstancingBenchmark();
+void runMultiDrawIndirectBenchmark();
@@ -0,0 +1,133 @@
+#include "BufferArena.h"
+#include "MemoryTracker.h"
+#include "Counters.h"
+
+#include <iostream>
+
+BufferArena::BufferArena(uint32_t maxVertices, uint32_t maxIndices)
+	: vertexAllocator(maxVertices), indexAllocator(maxIndices)
+{
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &EBO);
+
+	glBindVertexArray(VAO);
+
+	// NOTE Storage is allocated once up front, meshes are written later with glBufferSubData
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)maxVertices * VertexStride, NULL, GL_STATIC_DRAW);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)maxIndices * sizeof(unsigned int), NULL, GL_STATIC_DRAW);
+
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VertexStride, (void *)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, VertexStride, (void *)(3 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, VertexStride, (void *)(6 * sizeof(float)));
+	glEnableVertexAttribArray(2);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+
+	trackAllocation("GPU", "BufferArena vertices", (size_t)maxVertices * VertexStride);
+	trackAllocation("GPU", "BufferArena indices", (size_t)maxIndices * sizeof(unsigned int));
+}
+
+void BufferArena::destroy()
+{
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &EBO);
+
+	trackFree("GPU", "BufferArena vertices", (size_t)vertexAllocator.getStats().totalSize * VertexStride);
+	trackFree("GPU", "BufferArena indices", (size_t)indexAllocator.getStats().totalSize * sizeof(unsigned int));
+}
+
+bool BufferArena::allocate(uint32_t vertexCount, uint32_t indexCount, MeshRange& range)
+{
+	range.vertices = vertexAllocator.allocate(vertexCount);
+	if (range.vertices.node == OffsetAllocator::NoSpace)
+	{
+		printf("ERROR: BufferArena is out of vertex space (requested %u vertices)\n", vertexCount);
+		return false;
+	}
+
+	range.indices = indexAllocator.allocate(indexCount);
+	if (range.indices.node == OffsetAllocator::NoSpace)
+	{
+		printf("ERROR: BufferArena is out of index space (requested %u indices)\n", indexCount);
+		vertexAllocator.free(range.vertices);
+		range.vertices = OffsetAllocator::Allocation();
+		return false;
+	}
+
+	range.vertexCount = vertexCount;
+	range.indexCount = indexCount;
+	return true;
+}
+
+void BufferArena::upload(const MeshRange& range, const float* vertices, const unsigned int* indices)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)range.vertices.offset * VertexStride, (GLsizeiptr)range.vertexCount * VertexStride, vertices);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// NOTE Binding the EBO outside of our VAO would overwrite whatever VAO is currently bound
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, (GLintptr)range.indices.offset * sizeof(unsigned int), (GLsizeiptr)range.indexCount * sizeof(unsigned int), indices);
+	glBindVertexArray(0);
+
+	countEvent(CounterBytesUploaded, (uint64_t)range.vertexCount * VertexStride + (uint64_t)range.indexCount * sizeof(unsigned int));
+}
+
+void BufferArena::free(MeshRange& range)
+{
+	vertexAllocator.free(range.vertices);
+	indexAllocator.free(range.indices);
+	range = MeshRange();
+}
+
+void BufferArena::bind()
+{
+	glBindVertexArray(VAO);
+	countEvent(CounterStateChanges);
+}
+
+void BufferArena::draw(const MeshRange& range)
+{
+	// Indices are stored relative to the mesh, baseVertex moves them to where the mesh lives in the VBO
+	glDrawElementsBaseVertex(
+		GL_TRIANGLES,
+		(GLsizei)range.indexCount,
+		GL_UNSIGNED_INT,
+		(void *)((size_t)range.firstIndex() * sizeof(unsigned int)),
+		range.baseVertex()
+	);
+	countEvent(CounterDrawCalls);
+	countEvent(CounterTriangles, range.indexCount / 3);
+}
+
+OffsetAllocator::Stats BufferArena::getVertexStats() const
+{
+	return vertexAllocator.getStats();
+}
+
+OffsetAllocator::Stats BufferArena::getIndexStats() const
+{
+	return indexAllocator.getStats();
+}
+
+void BufferArena::printStats() const
+{
+	OffsetAllocator::Stats vertexStats = vertexAllocator.getStats();
+	OffsetAllocator::Stats indexStats = indexAllocator.getStats();
+
+	printf("BufferArena vertices: %u/%u used (%.1f%%), %u free blocks, fragmentation %.2f\n",
+		vertexStats.usedSize, vertexStats.totalSize, vertexStats.utilization() * 100.0f,
+		vertexStats.freeBlockCount, vertexStats.fragmentation());
+	printf("BufferArena indices: %u/%u used (%.1f%%), %u free blocks, fragmentation %.2f\n",
+		indexStats.usedSize, indexStats.totalSize, indexStats.utilization() * 100.0f,
+		indexStats.freeBlockCount, indexStats.fragmentation());
+}
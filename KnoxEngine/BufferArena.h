@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "OffsetAllocator.h"
+
+// A sub-range of the shared vertex/index buffers owned by a single mesh
+struct MeshRange
+{
+	OffsetAllocator::Allocation vertices;
+	OffsetAllocator::Allocation indices;
+	uint32_t vertexCount = 0;
+	uint32_t indexCount = 0;
+
+	GLint baseVertex() const { return (GLint)vertices.offset; }
+	uint32_t firstIndex() const { return indices.offset; }
+	bool isValid() const { return vertices.node != OffsetAllocator::NoSpace && indices.node != OffsetAllocator::NoSpace; }
+};
+
+// One big VBO + EBO pair shared by many meshes, so they can all be drawn from a single VAO
+// using glDrawElementsBaseVertex instead of binding a VAO per mesh.
+// Vertex layout matches the default shaders: position (3 floats), color (3 floats), texture coords (2 floats)
+class BufferArena
+{
+private:
+	OffsetAllocator vertexAllocator;
+	OffsetAllocator indexAllocator;
+
+public:
+	static const GLsizei VertexStride = sizeof(float) * 8;
+
+	unsigned int VAO, VBO, EBO;
+
+	BufferArena(uint32_t maxVertices, uint32_t maxIndices);
+
+	// NOTE Must be called while the OpenGL context is still alive
+	void destroy();
+
+	bool allocate(uint32_t vertexCount, uint32_t indexCount, MeshRange& range);
+	void upload(const MeshRange& range, const float* vertices, const unsigned int* indices);
+	void free(MeshRange& range);
+
+	void bind();
+	void draw(const MeshRange& range);
+
+	OffsetAllocator::Stats getVertexStats() const;
+	OffsetAllocator::Stats getIndexStats() const;
+	void printStats() const;
+};
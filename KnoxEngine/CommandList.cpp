@@ -0,0 +1,262 @@
+#include "CommandList.h"
+#include "Counters.h"
+
+#include <cstring>
+
+static void copyUniformName(char* destination, const char* name)
+{
+	strncpy(destination, name, Command::MaxUniformNameLength - 1);
+	destination[Command::MaxUniformNameLength - 1] = '\0';
+}
+
+bool RenderResources::resolve(const DrawRequest& request, DrawItem& item)
+{
+	Shader* shader = shaders->get(request.shader);
+	MeshRange* mesh = meshes->get(request.mesh);
+	if (!shader || !mesh)
+	{
+		return false;
+	}
+
+	item.program = shader->Id;
+	item.materialId = request.materialId;
+	for (int unit = 0; unit < DrawItem::MaxTextures; unit++)
+	{
+		item.textures[unit] = 0;
+		if (request.textures[unit].isNull())
+		{
+			continue;
+		}
+
+		Texture* texture = textures->get(request.textures[unit]);
+		if (!texture)
+		{
+			return false;
+		}
+		item.textures[unit] = texture->Id;
+	}
+	item.vertexArray = bufferArena->VAO;
+	item.indexCount = mesh->indexCount;
+	item.firstIndex = mesh->firstIndex();
+	item.baseVertex = mesh->baseVertex();
+	return true;
+}
+
+bool RenderResources::resolve(Handle<Shader> shader, unsigned int& program)
+{
+	Shader* resolved = shaders->get(shader);
+	if (!resolved)
+	{
+		return false;
+	}
+	program = resolved->Id;
+	return true;
+}
+
+CommandList::CommandList() : arena(NULL), commands(NULL), count(0), capacity(0)
+{
+}
+
+void CommandList::reset(LinearArena& arena)
+{
+	// NOTE The previous commands lived in the arena that was just reset, start with room for as many
+	this->arena = &arena;
+	capacity = count > MinCapacity ? count : MinCapacity;
+	commands = arena.allocateArray<Command>(capacity);
+	count = 0;
+}
+
+void CommandList::push(const Command& command)
+{
+	if (count == capacity)
+	{
+		// The old array stays in the arena until the next reset, it's cheaper than a heap round trip
+		Command* grown = arena->allocateArray<Command>(capacity * 2);
+		memcpy(grown, commands, count * sizeof(Command));
+		commands = grown;
+		capacity *= 2;
+	}
+	commands[count++] = command;
+}
+
+void CommandList::setViewport(int x, int y, int width, int height)
+{
+	Command command;
+	command.type = CommandViewport;
+	command.viewport.x = x;
+	command.viewport.y = y;
+	command.viewport.width = width;
+	command.viewport.height = height;
+	push(command);
+}
+
+void CommandList::clear(float red, float green, float blue, float alpha, GLbitfield mask)
+{
+	Command command;
+	command.type = CommandClear;
+	command.clear.red = red;
+	command.clear.green = green;
+	command.clear.blue = blue;
+	command.clear.alpha = alpha;
+	command.clear.mask = mask;
+	push(command);
+}
+
+void CommandList::setInt(Handle<Shader> shader, const char* name, int value)
+{
+	Command command;
+	command.type = CommandSetInt;
+	command.setInt.shader = shader;
+	copyUniformName(command.setInt.name, name);
+	command.setInt.value = value;
+	push(command);
+}
+
+void CommandList::setFloat(Handle<Shader> shader, const char* name, float value)
+{
+	Command command;
+	command.type = CommandSetFloat;
+	command.setFloat.shader = shader;
+	copyUniformName(command.setFloat.name, name);
+	command.setFloat.value = value;
+	push(command);
+}
+
+void CommandList::draw(const DrawRequest& request, float depth, bool transparent, const float* transform)
+{
+	Command command;
+	command.type = CommandDraw;
+	command.draw.request = request;
+	command.draw.depth = depth;
+	command.draw.transparent = transparent;
+	command.draw.transform = NULL;
+	if (transform)
+	{
+		float* copy = arena->allocateArray<float>(16);
+		memcpy(copy, transform, sizeof(float) * 16);
+		command.draw.transform = copy;
+	}
+	push(command);
+}
+
+void CommandList::flushDraws()
+{
+	Command command;
+	command.type = CommandFlushDraws;
+	push(command);
+}
+
+void CommandList::beginGpuZone(const char* name)
+{
+	Command command;
+	command.type = CommandBeginGpuZone;
+	command.gpuZone.name = name;
+	push(command);
+}
+
+void CommandList::endGpuZone()
+{
+	Command command;
+	command.type = CommandEndGpuZone;
+	push(command);
+}
+
+static void flushRenderQueue(RenderQueue& renderQueue, GpuProfiler* profiler)
+{
+	GpuZone zone(profiler, "Draws");
+	renderQueue.flush();
+}
+
+uint32_t CommandList::execute(RenderQueue& renderQueue, RenderResources& resources, GpuProfiler* profiler) const
+{
+	uint32_t staleCommands = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		const Command& command = commands[i];
+		switch (command.type)
+		{
+		case CommandViewport:
+			glViewport(command.viewport.x, command.viewport.y, command.viewport.width, command.viewport.height);
+			break;
+
+		case CommandClear:
+		{
+			GpuZone zone(profiler, "Clear");
+			glClearColor(command.clear.red, command.clear.green, command.clear.blue, command.clear.alpha);
+			glClear(command.clear.mask);
+			break;
+		}
+
+		case CommandSetInt:
+		{
+			unsigned int program;
+			if (!resources.resolve(command.setInt.shader, program))
+			{
+				staleCommands++;
+				break;
+			}
+			glUseProgram(program);
+			glUniform1i(glGetUniformLocation(program, command.setInt.name), command.setInt.value);
+			countEvent(CounterStateChanges);
+			countEvent(CounterUniformUploads);
+			break;
+		}
+
+		case CommandSetFloat:
+		{
+			unsigned int program;
+			if (!resources.resolve(command.setFloat.shader, program))
+			{
+				staleCommands++;
+				break;
+			}
+			glUseProgram(program);
+			glUniform1f(glGetUniformLocation(program, command.setFloat.name), command.setFloat.value);
+			countEvent(CounterStateChanges);
+			countEvent(CounterUniformUploads);
+			break;
+		}
+
+		case CommandDraw:
+		{
+			DrawItem item;
+			if (!resources.resolve(command.draw.request, item))
+			{
+				staleCommands++;
+				break;
+			}
+			renderQueue.submit(item, command.draw.depth, command.draw.transparent, command.draw.transform);
+			break;
+		}
+
+		case CommandFlushDraws:
+			flushRenderQueue(renderQueue, profiler);
+			break;
+
+		case CommandBeginGpuZone:
+		case CommandEndGpuZone:
+			if (renderQueue.size() > 0)
+			{
+				flushRenderQueue(renderQueue, profiler);
+			}
+			if (profiler)
+			{
+				if (command.type == CommandBeginGpuZone)
+				{
+					profiler->beginZone(command.gpuZone.name);
+				}
+				else
+				{
+					profiler->endZone();
+				}
+			}
+			break;
+		}
+	}
+
+	if (renderQueue.size() > 0)
+	{
+		flushRenderQueue(renderQueue, profiler);
+	}
+	return staleCommands;
+}
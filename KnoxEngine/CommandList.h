@@ -0,0 +1,117 @@
+#pragma once
+
+#include "RenderQueue.h"
+#include "LinearArena.h"
+#include "GpuProfiler.h"
+#include "Pool.h"
+#include "Shader.h"
+#include "Texture.h"
+#include "BufferArena.h"
+
+enum CommandType
+{
+	CommandViewport,
+	CommandClear,
+	CommandSetInt,
+	CommandSetFloat,
+	CommandDraw,
+	CommandFlushDraws,
+	CommandBeginGpuZone,
+	CommandEndGpuZone
+};
+
+// What the simulation asks to draw. Resources are referenced by handle and only turned into
+// the GL ids of a DrawItem when the list is executed, so a draw of something destroyed after
+// it was recorded is caught there instead of binding a deleted (or reused) object
+struct DrawRequest
+{
+	Handle<Shader> shader;
+	Handle<Texture> textures[DrawItem::MaxTextures];	// a null handle leaves the unit unbound
+	Handle<MeshRange> mesh;
+	unsigned int materialId;
+};
+
+// Pools the handles of a command list are resolved through, every mesh lives in bufferArena
+// NOTE The pools are read by the render thread while it executes a list, resources can only
+// be created or destroyed while it's not running
+struct RenderResources
+{
+	Pool<Shader>* shaders;
+	Pool<Texture>* textures;
+	Pool<MeshRange>* meshes;
+	BufferArena* bufferArena;
+
+	// Returns false if a handle doesn't resolve, the pool counts it as a stale access
+	bool resolve(const DrawRequest& request, DrawItem& item);
+	bool resolve(Handle<Shader> shader, unsigned int& program);
+};
+
+struct Command
+{
+	static const int MaxUniformNameLength = 32;
+
+	CommandType type;
+	union
+	{
+		struct { int x, y, width, height; } viewport;
+		struct { float red, green, blue, alpha; GLbitfield mask; } clear;
+		struct { Handle<Shader> shader; char name[MaxUniformNameLength]; int value; } setInt;
+		struct { Handle<Shader> shader; char name[MaxUniformNameLength]; float value; } setFloat;
+		struct { DrawRequest request; float depth; bool transparent; const float* transform; } draw;
+		struct { const char* name; } gpuZone;
+	};
+
+	// NOTE Handles have a constructor, which deletes the implicit one. Only the member of the type gets filled in
+	Command() {}
+};
+
+// Frame description recorded by the simulation without touching OpenGL,
+// so it can be replayed later on the thread that owns the context.
+//
+// Draws are collected in a RenderQueue while replaying and only submitted (sorted)
+// at a flushDraws command or at the end of the list. Uniform and clear commands run
+// immediately, so they apply to all the draws of the following flush.
+//
+// GPU zones mark the passes of the frame for a GpuProfiler. Both ends of a zone flush the
+// pending draws, so a pass times its own draws, with or without a profiler.
+//
+// Shaders, textures and meshes are recorded as handles and resolved at execution, a command
+// that refers to a destroyed resource is skipped
+class CommandList
+{
+private:
+	static const size_t MinCapacity = 64;
+
+	LinearArena* arena;
+	Command* commands;
+	size_t count;
+	size_t capacity;
+
+	void push(const Command& command);
+
+public:
+	CommandList();
+
+	// Starts recording a new frame, the commands are stored in arena which has to
+	// stay untouched until the list was executed
+	void reset(LinearArena& arena);
+
+	void setViewport(int x, int y, int width, int height);
+	void clear(float red, float green, float blue, float alpha, GLbitfield mask);
+	void setInt(Handle<Shader> shader, const char* name, int value);
+	void setFloat(Handle<Shader> shader, const char* name, float value);
+	// transform (column-major 4x4) is copied into the arena, NULL draws with the identity
+	void draw(const DrawRequest& request, float depth, bool transparent, const float* transform = NULL);
+	void flushDraws();
+
+	// NOTE name is kept as a pointer until execute, use string literals
+	void beginGpuZone(const char* name);
+	void endGpuZone();
+
+	// NOTE Must be called on the thread that owns the OpenGL context.
+	// With a profiler clears and draw flushes get zones of their own too.
+	// Returns how many commands were skipped because of a stale handle
+	uint32_t execute(RenderQueue& renderQueue, RenderResources& resources, GpuProfiler* profiler = NULL) const;
+
+	size_t size() const { return count; }
+};
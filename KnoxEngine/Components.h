@@ -0,0 +1,32 @@
+#pragma once
+
+#include "CommandList.h"
+#include "MathTypes.h"
+
+// Components of the entities in main.cpp, stored in an EntityWorld
+
+// Something the render loop draws every frame
+struct Renderable
+{
+	DrawRequest request;
+	float depth;
+	bool transparent;
+};
+
+// Axis aligned box around the object, objects outside of the view aren't drawn
+struct Bounds
+{
+	vec3 center;
+	vec3 extents;
+};
+
+// Mesh drawn into the occlusion culling depth buffer, whatever is behind it isn't drawn.
+// Positions are the first 3 floats of every vertex, stride is in floats
+// NOTE The vertex and index data has to outlive the entity
+struct Occluder
+{
+	const float* vertices;
+	uint32_t stride;
+	const uint32_t* indices;
+	uint32_t indexCount;
+};
@@ -0,0 +1,137 @@
+#include "Counters.h"
+
+#include <mutex>
+#include <vector>
+#include <cstdio>
+
+thread_local CounterBlock* threadCounterBlock = NULL;
+
+// NOTE Blocks are never freed, threads can count until the end of the program
+static std::mutex& getCounterMutex()
+{
+	static std::mutex mutex;
+	return mutex;
+}
+
+static std::vector<CounterBlock*>& getCounterBlocks()
+{
+	static std::vector<CounterBlock*> blocks;
+	return blocks;
+}
+
+static CounterValues previousTotals;
+static CounterValues frameCounters;
+static uint64_t frameIndex;
+static FILE* csvFile;
+
+CounterBlock* registerCounterThread()
+{
+	CounterBlock* block = new CounterBlock();
+	for (int i = 0; i < CounterCount; i++)
+	{
+		block->values[i].store(0, std::memory_order_relaxed);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(getCounterMutex());
+		getCounterBlocks().push_back(block);
+	}
+
+	threadCounterBlock = block;
+	return block;
+}
+
+const char* getCounterName(Counter counter)
+{
+	switch (counter)
+	{
+	case CounterDrawCalls:
+		return "drawCalls";
+	case CounterTriangles:
+		return "triangles";
+	case CounterStateChanges:
+		return "stateChanges";
+	case CounterUniformUploads:
+		return "uniformUploads";
+	case CounterTextureBinds:
+		return "textureBinds";
+	case CounterBytesUploaded:
+		return "bytesUploaded";
+	case CounterAllocations:
+		return "allocations";
+	default:
+		return "unknown";
+	}
+}
+
+void endCounterFrame(double frameMilliseconds)
+{
+	std::lock_guard<std::mutex> lock(getCounterMutex());
+
+	CounterValues totals = {};
+	std::vector<CounterBlock*>& blocks = getCounterBlocks();
+	for (size_t i = 0; i < blocks.size(); i++)
+	{
+		for (int counter = 0; counter < CounterCount; counter++)
+		{
+			totals.values[counter] += blocks[i]->values[counter].load(std::memory_order_relaxed);
+		}
+	}
+
+	for (int counter = 0; counter < CounterCount; counter++)
+	{
+		frameCounters.values[counter] = totals.values[counter] - previousTotals.values[counter];
+	}
+	previousTotals = totals;
+
+	if (csvFile)
+	{
+		fprintf(csvFile, "%llu,%.4f", (unsigned long long)frameIndex, frameMilliseconds);
+		for (int counter = 0; counter < CounterCount; counter++)
+		{
+			fprintf(csvFile, ",%llu", (unsigned long long)frameCounters.values[counter]);
+		}
+		fprintf(csvFile, "\n");
+	}
+	frameIndex++;
+}
+
+CounterValues getFrameCounters()
+{
+	std::lock_guard<std::mutex> lock(getCounterMutex());
+	return frameCounters;
+}
+
+bool openCounterCsv(const char* filePath)
+{
+	std::lock_guard<std::mutex> lock(getCounterMutex());
+	if (csvFile)
+	{
+		fclose(csvFile);
+	}
+
+	csvFile = fopen(filePath, "w");
+	if (!csvFile)
+	{
+		printf("ERROR: Failed to open %s for writing\n", filePath);
+		return false;
+	}
+
+	fprintf(csvFile, "frame,milliseconds");
+	for (int counter = 0; counter < CounterCount; counter++)
+	{
+		fprintf(csvFile, ",%s", getCounterName((Counter)counter));
+	}
+	fprintf(csvFile, "\n");
+	return true;
+}
+
+void closeCounterCsv()
+{
+	std::lock_guard<std::mutex> lock(getCounterMutex());
+	if (csvFile)
+	{
+		fclose(csvFile);
+		csvFile = NULL;
+	}
+}
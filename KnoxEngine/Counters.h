@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Per-frame engine counters, incremented by the GL wrappers (RenderQueue, InstanceBatcher,
+// IndirectRenderer, BufferArena, StreamBuffer, CommandList, Shader) and summed per frame.
+//
+// Every thread counts into a block of its own, so counting is a relaxed load and store
+// without a lock or a read-modify-write. endCounterFrame sums the blocks of all threads
+// and keeps the difference to the previous call as the counts of the frame.
+// NOTE The render thread ends frames at its swap, so what the simulation counts while
+// the render thread replays lands in the frame being replayed, not the one being recorded
+enum Counter
+{
+	CounterDrawCalls,
+	CounterTriangles,
+	CounterStateChanges,	// program, vertex array and texture binds, blend state
+	CounterUniformUploads,
+	CounterTextureBinds,
+	CounterBytesUploaded,	// buffer data written by the CPU
+	CounterAllocations,	// heap blocks: tracked allocations and frame arena overflows
+	CounterCount
+};
+
+struct CounterValues
+{
+	uint64_t values[CounterCount];
+};
+
+struct CounterBlock
+{
+	std::atomic<uint64_t> values[CounterCount];
+};
+
+extern thread_local CounterBlock* threadCounterBlock;
+CounterBlock* registerCounterThread();
+
+inline void countEvent(Counter counter, uint64_t amount = 1)
+{
+	CounterBlock* block = threadCounterBlock;
+	if (!block)
+	{
+		block = registerCounterThread();
+	}
+
+	// NOTE Only this thread writes the block, the load and store don't need to be one atomic step
+	std::atomic<uint64_t>& value = block->values[counter];
+	value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+const char* getCounterName(Counter counter);
+
+// Closes the current frame, frameMilliseconds goes to the CSV with its counts
+void endCounterFrame(double frameMilliseconds);
+
+// Counts of the last frame that was ended, thread safe
+CounterValues getFrameCounters();
+
+// Streams the counts of every frame ended from now on, one line each, for headless and benchmark runs
+bool openCounterCsv(const char* filePath);
+void closeCounterCsv();
@@ -0,0 +1,154 @@
+#include "CpuProfiler.h"
+#include "MemoryTracker.h"
+
+#include <cstdio>
+
+std::atomic<bool> CpuProfiler::enabled(false);
+thread_local CpuProfiler::ThreadRecord* CpuProfiler::threadRecord = NULL;
+std::mutex CpuProfiler::registryMutex;
+std::vector<CpuProfiler::ThreadRecord*> CpuProfiler::records;
+
+typedef std::chrono::steady_clock Clock;
+
+// Timestamps and steady clock times at start and stop, to convert ticks to microseconds
+static uint64_t startTicks;
+static uint64_t stopTicks;
+static Clock::time_point startTime;
+static Clock::time_point stopTime;
+static bool stopped;
+
+CpuProfiler::ThreadRecord* CpuProfiler::registerThread()
+{
+	ThreadRecord* thread = new ThreadRecord();
+	thread->events = NULL;
+	thread->count.store(0, std::memory_order_relaxed);
+	thread->dropped.store(0, std::memory_order_relaxed);
+	thread->name = NULL;
+
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		thread->index = (uint32_t)records.size();
+		records.push_back(thread);
+	}
+
+	threadRecord = thread;
+	return thread;
+}
+
+CpuProfiler::ThreadRecord* CpuProfiler::allocateEvents()
+{
+	ThreadRecord* thread = threadRecord;
+	if (!thread)
+	{
+		thread = registerThread();
+	}
+
+	// NOTE Readers only look at the events once count is above 0, which is stored after this
+	thread->events = new Event[EventsPerThread];
+	trackAllocation("Profiling", "CpuProfiler", sizeof(Event) * EventsPerThread);
+	return thread;
+}
+
+void CpuProfiler::start()
+{
+	startTime = Clock::now();
+	startTicks = now();
+	stopped = false;
+	enabled.store(true, std::memory_order_relaxed);
+}
+
+void CpuProfiler::stop()
+{
+	enabled.store(false, std::memory_order_relaxed);
+	stopTicks = now();
+	stopTime = Clock::now();
+	stopped = true;
+}
+
+void CpuProfiler::setThreadName(const char* name)
+{
+	ThreadRecord* thread = threadRecord;
+	if (!thread)
+	{
+		thread = registerThread();
+	}
+	thread->name = name;
+}
+
+CpuProfiler::Stats CpuProfiler::getStats()
+{
+	Stats stats = {};
+	std::lock_guard<std::mutex> lock(registryMutex);
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		ThreadRecord* thread = records[i];
+		uint32_t count = thread->count.load(std::memory_order_acquire);
+		uint32_t dropped = thread->dropped.load(std::memory_order_relaxed);
+		if (count > 0 || dropped > 0)
+		{
+			stats.threads++;
+		}
+		stats.events += count;
+		stats.droppedEvents += dropped;
+	}
+	return stats;
+}
+
+bool CpuProfiler::writeChromeTrace(const char* filePath)
+{
+	FILE* file = fopen(filePath, "w");
+	if (!file)
+	{
+		printf("ERROR: Failed to open %s for writing\n", filePath);
+		return false;
+	}
+
+	// Still running, calibrate up to now
+	uint64_t endTicks = stopped ? stopTicks : now();
+	Clock::time_point endTime = stopped ? stopTime : Clock::now();
+	double microseconds = std::chrono::duration<double, std::micro>(endTime - startTime).count();
+	double microsecondsPerTick = endTicks > startTicks ? microseconds / (double)(endTicks - startTicks) : 0.0;
+
+	std::vector<ThreadRecord*> threadRecords;
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		threadRecords = records;
+	}
+
+	// NOTE Zone names are string literals from the engine, they aren't escaped
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"KnoxEngine\"}}");
+	for (size_t i = 0; i < threadRecords.size(); i++)
+	{
+		const ThreadRecord& thread = *threadRecords[i];
+		if (thread.name)
+		{
+			fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", thread.index, thread.name);
+		}
+		else
+		{
+			fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"Thread %u\"}}", thread.index, thread.index);
+		}
+
+		uint32_t count = thread.count.load(std::memory_order_acquire);
+		for (uint32_t j = 0; j < count; j++)
+		{
+			const Event& event = thread.events[j];
+			// Zones that started before start (or ticks from another core going backwards) clamp to 0
+			double start = event.start > startTicks ? (event.start - startTicks) * microsecondsPerTick : 0.0;
+			if (!event.name)
+			{
+				fprintf(file, ",\n{\"name\":\"Frame\",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":%u,\"ts\":%.3f}", thread.index, start);
+			}
+			else
+			{
+				double duration = event.end > event.start ? (event.end - event.start) * microsecondsPerTick : 0.0;
+				fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", event.name, thread.index, start, duration);
+			}
+		}
+	}
+	fprintf(file, "\n]}\n");
+
+	fclose(file);
+	return true;
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define KNOX_PROFILER_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define KNOX_PROFILER_RDTSC 1
+#endif
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+// Timeline of the zones the CPU threads went through, for looking at a run offline in
+// chrome://tracing or Perfetto (both open the Chrome trace JSON written by writeChromeTrace).
+//
+// Every thread records into a buffer of its own, so recording takes no lock and no atomic
+// read-modify-write: a zone is two timestamp reads (rdtsc where there is one) and one event
+// written at its end. Event buffers are allocated the first time a thread records while profiling
+// and hold EventsPerThread events, later ones are dropped and counted. Naming a thread only takes
+// a small record, so runs without a capture don't pay for the buffers.
+// Timestamps are converted to microseconds when writing, against the steady clock time
+// between start and stop.
+// NOTE There's one capture per run: start, stop, then write. Names are stored by pointer, pass string literals
+class CpuProfiler
+{
+public:
+	static const uint32_t EventsPerThread = 1 << 16;
+
+	struct Stats
+	{
+		uint32_t threads;
+		uint64_t events;
+		uint64_t droppedEvents;
+	};
+
+private:
+	struct Event
+	{
+		const char* name;	// NULL for a frame marker
+		uint64_t start;
+		uint64_t end;
+	};
+
+	struct ThreadRecord
+	{
+		Event* events;					// NULL until the thread records, only read below count
+		std::atomic<uint32_t> count;	// NOTE Only the owning thread writes, events below count are complete
+		std::atomic<uint32_t> dropped;
+		uint32_t index;
+		const char* name;
+	};
+
+	static std::atomic<bool> enabled;
+	static thread_local ThreadRecord* threadRecord;
+
+	// NOTE Records and their events are never freed, a thread can record until the end of the program
+	static std::mutex registryMutex;
+	static std::vector<ThreadRecord*> records;
+
+	static ThreadRecord* registerThread();
+	static ThreadRecord* allocateEvents();
+
+public:
+	static uint64_t now()
+	{
+#ifdef KNOX_PROFILER_RDTSC
+		return __rdtsc();
+#else
+		return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+	}
+
+	static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+	static void record(const char* name, uint64_t start, uint64_t end)
+	{
+		// NOTE Zones and frame markers only get here while profiling
+		ThreadRecord* thread = threadRecord;
+		if (!thread || !thread->events)
+		{
+			thread = allocateEvents();
+		}
+
+		uint32_t count = thread->count.load(std::memory_order_relaxed);
+		if (count == EventsPerThread)
+		{
+			thread->dropped.store(thread->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return;
+		}
+
+		Event& event = thread->events[count];
+		event.name = name;
+		event.start = start;
+		event.end = end;
+		thread->count.store(count + 1, std::memory_order_release);
+	}
+
+	static void start();
+	static void stop();
+
+	// Name of the calling thread in the trace, threads without one show up as "Thread <n>"
+	static void setThreadName(const char* name);
+
+	// Instant marking the end of a frame, meant to be called at the buffer swap
+	static void markFrame()
+	{
+		if (isEnabled())
+		{
+			uint64_t time = now();
+			record(NULL, time, time);
+		}
+	}
+
+	static Stats getStats();
+
+	// One complete event per zone and a global instant per frame marker, on a track per thread.
+	// Safe to call while threads are still recording, events after the call aren't written
+	static bool writeChromeTrace(const char* filePath);
+};
+
+// Zone for a scope, records nothing while the profiler isn't started
+class CpuZone
+{
+private:
+	const char* name;
+	uint64_t start;
+
+public:
+	explicit CpuZone(const char* name) : name(name), start(CpuProfiler::isEnabled() ? CpuProfiler::now() : 0)
+	{
+	}
+
+	~CpuZone()
+	{
+		end();
+	}
+
+	// Ends the zone before the scope does
+	void end()
+	{
+		if (start != 0)
+		{
+			CpuProfiler::record(name, start, CpuProfiler::now());
+			start = 0;
+		}
+	}
+
+	CpuZone(const CpuZone&) = delete;
+	CpuZone& operator=(const CpuZone&) = delete;
+};
@@ -0,0 +1,678 @@
+#include "DynamicBvh.h"
+
+#include <algorithm>
+
+float intersectRay(const Aabb& box, const vec3& origin, const vec3& inverseDirection, float maxDistance)
+{
+	float x1 = (box.min.x - origin.x) * inverseDirection.x, x2 = (box.max.x - origin.x) * inverseDirection.x;
+	float y1 = (box.min.y - origin.y) * inverseDirection.y, y2 = (box.max.y - origin.y) * inverseDirection.y;
+	float z1 = (box.min.z - origin.z) * inverseDirection.z, z2 = (box.max.z - origin.z) * inverseDirection.z;
+
+	float entry = std::fmax(std::fmax(std::fmin(x1, x2), std::fmin(y1, y2)), std::fmax(std::fmin(z1, z2), 0.0f));
+	float exit = std::fmin(std::fmin(std::fmax(x1, x2), std::fmax(y1, y2)), std::fmin(std::fmax(z1, z2), maxDistance));
+	return entry <= exit ? entry : -1.0f;
+}
+
+enum FrustumOverlap
+{
+	FrustumOutside,
+	FrustumIntersecting,
+	FrustumInside
+};
+
+static FrustumOverlap testFrustum(const Frustum& frustum, const Aabb& box)
+{
+	vec3 center = (box.min + box.max) * 0.5f;
+	vec3 extents = (box.max - box.min) * 0.5f;
+
+	FrustumOverlap overlap = FrustumInside;
+	for (int p = 0; p < 6; p++)
+	{
+		const vec4& plane = frustum.planes[p];
+		float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		float radius = std::fabs(plane.x) * extents.x + std::fabs(plane.y) * extents.y + std::fabs(plane.z) * extents.z;
+		if (distance + radius < 0.0f)
+		{
+			return FrustumOutside;
+		}
+		if (distance - radius < 0.0f)
+		{
+			overlap = FrustumIntersecting;
+		}
+	}
+	return overlap;
+}
+
+DynamicBvh::DynamicBvh() : root(NullIndex), objectCount(0)
+{
+}
+
+uint32_t DynamicBvh::allocateNode()
+{
+	uint32_t index;
+	if (!freeNodes.empty())
+	{
+		index = freeNodes.back();
+		freeNodes.pop_back();
+	}
+	else
+	{
+		index = (uint32_t)nodes.size();
+		nodes.push_back(Node());
+	}
+
+	Node& node = nodes[index];
+	node.parent = NullIndex;
+	node.left = NullIndex;
+	node.right = NullIndex;
+	node.object = InternalNode;
+	node.dirty = false;
+	return index;
+}
+
+void DynamicBvh::freeNode(uint32_t index)
+{
+	nodes[index].object = NullIndex;
+	freeNodes.push_back(index);
+}
+
+uint32_t DynamicBvh::insert(const Aabb& bounds)
+{
+	uint32_t object;
+	if (!freeObjects.empty())
+	{
+		object = freeObjects.back();
+		freeObjects.pop_back();
+	}
+	else
+	{
+		object = (uint32_t)objectLeaves.size();
+		objectLeaves.push_back(NullIndex);
+	}
+
+	uint32_t leaf = allocateNode();
+	nodes[leaf].bounds = bounds;
+	nodes[leaf].object = object;
+	objectLeaves[object] = leaf;
+	objectCount++;
+
+	insertLeaf(leaf);
+	return object;
+}
+
+void DynamicBvh::remove(uint32_t object)
+{
+	uint32_t leaf = objectLeaves[object];
+	removeLeaf(leaf);
+	freeNode(leaf);
+
+	objectLeaves[object] = NullIndex;
+	freeObjects.push_back(object);
+	objectCount--;
+}
+
+void DynamicBvh::insertLeaf(uint32_t leaf)
+{
+	if (root == NullIndex)
+	{
+		root = leaf;
+		nodes[leaf].parent = NullIndex;
+		return;
+	}
+
+	// Walk down to the sibling that makes the tree grow the least: making a new parent here costs
+	// the area of the merged box, going down a child costs what that child would grow, plus the
+	// growth of the current node that every path below pays anyway
+	const Aabb bounds = nodes[leaf].bounds;
+	uint32_t index = root;
+	while (!isLeaf(index))
+	{
+		const Node& node = nodes[index];
+		float combinedArea = surfaceArea(merge(node.bounds, bounds));
+		float cost = 2.0f * combinedArea;
+		float inheritedCost = 2.0f * (combinedArea - surfaceArea(node.bounds));
+
+		const Node& left = nodes[node.left];
+		const Node& right = nodes[node.right];
+		float leftCost = surfaceArea(merge(left.bounds, bounds)) + inheritedCost;
+		float rightCost = surfaceArea(merge(right.bounds, bounds)) + inheritedCost;
+		if (!isLeaf(node.left))
+		{
+			leftCost -= surfaceArea(left.bounds);
+		}
+		if (!isLeaf(node.right))
+		{
+			rightCost -= surfaceArea(right.bounds);
+		}
+
+		if (cost < leftCost && cost < rightCost)
+		{
+			break;
+		}
+		index = leftCost < rightCost ? node.left : node.right;
+	}
+
+	uint32_t sibling = index;
+	uint32_t oldParent = nodes[sibling].parent;
+	uint32_t newParent = allocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].left = sibling;
+	nodes[newParent].right = leaf;
+	nodes[newParent].bounds = merge(nodes[sibling].bounds, bounds);
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if (oldParent == NullIndex)
+	{
+		root = newParent;
+	}
+	else
+	{
+		if (nodes[oldParent].left == sibling)
+		{
+			nodes[oldParent].left = newParent;
+		}
+		else
+		{
+			nodes[oldParent].right = newParent;
+		}
+		refitUpwards(oldParent);
+	}
+}
+
+void DynamicBvh::removeLeaf(uint32_t leaf)
+{
+	if (leaf == root)
+	{
+		root = NullIndex;
+		return;
+	}
+
+	// The sibling takes the place of the parent
+	uint32_t parent = nodes[leaf].parent;
+	uint32_t grandParent = nodes[parent].parent;
+	uint32_t sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+	freeNode(parent);
+
+	nodes[sibling].parent = grandParent;
+	if (grandParent == NullIndex)
+	{
+		root = sibling;
+		return;
+	}
+
+	if (nodes[grandParent].left == parent)
+	{
+		nodes[grandParent].left = sibling;
+	}
+	else
+	{
+		nodes[grandParent].right = sibling;
+	}
+	refitUpwards(grandParent);
+}
+
+void DynamicBvh::refitUpwards(uint32_t index)
+{
+	while (index != NullIndex)
+	{
+		Node& node = nodes[index];
+		node.bounds = merge(nodes[node.left].bounds, nodes[node.right].bounds);
+		rotate(index);
+		index = node.parent;
+	}
+}
+
+// Swaps a child of the node with a grandchild on the other side when that shrinks the child
+// that changes. The node's own bounds stay the same since it still holds the same leaves
+void DynamicBvh::rotate(uint32_t index)
+{
+	Node& node = nodes[index];
+	uint32_t b = node.left;
+	uint32_t c = node.right;
+
+	enum Rotation { None, BWithF, BWithG, CWithD, CWithE };
+	Rotation best = None;
+	float bestCost = 0.0f;
+
+	if (!isLeaf(c))
+	{
+		// c = (f, g), swapping b with f leaves c = (b, g)
+		uint32_t f = nodes[c].left, g = nodes[c].right;
+		float area = surfaceArea(nodes[c].bounds);
+		float cost = surfaceArea(merge(nodes[b].bounds, nodes[g].bounds)) - area;
+		if (cost < bestCost)
+		{
+			best = BWithF;
+			bestCost = cost;
+		}
+		cost = surfaceArea(merge(nodes[f].bounds, nodes[b].bounds)) - area;
+		if (cost < bestCost)
+		{
+			best = BWithG;
+			bestCost = cost;
+		}
+	}
+	if (!isLeaf(b))
+	{
+		// b = (d, e), swapping c with d leaves b = (c, e)
+		uint32_t d = nodes[b].left, e = nodes[b].right;
+		float area = surfaceArea(nodes[b].bounds);
+		float cost = surfaceArea(merge(nodes[c].bounds, nodes[e].bounds)) - area;
+		if (cost < bestCost)
+		{
+			best = CWithD;
+			bestCost = cost;
+		}
+		cost = surfaceArea(merge(nodes[d].bounds, nodes[c].bounds)) - area;
+		if (cost < bestCost)
+		{
+			best = CWithE;
+			bestCost = cost;
+		}
+	}
+
+	switch (best)
+	{
+	case None:
+		break;
+	case BWithF:
+	{
+		uint32_t f = nodes[c].left;
+		node.left = f;
+		nodes[f].parent = index;
+		nodes[c].left = b;
+		nodes[b].parent = c;
+		nodes[c].bounds = merge(nodes[b].bounds, nodes[nodes[c].right].bounds);
+		break;
+	}
+	case BWithG:
+	{
+		uint32_t g = nodes[c].right;
+		node.left = g;
+		nodes[g].parent = index;
+		nodes[c].right = b;
+		nodes[b].parent = c;
+		nodes[c].bounds = merge(nodes[nodes[c].left].bounds, nodes[b].bounds);
+		break;
+	}
+	case CWithD:
+	{
+		uint32_t d = nodes[b].left;
+		node.right = d;
+		nodes[d].parent = index;
+		nodes[b].left = c;
+		nodes[c].parent = b;
+		nodes[b].bounds = merge(nodes[c].bounds, nodes[nodes[b].right].bounds);
+		break;
+	}
+	case CWithE:
+	{
+		uint32_t e = nodes[b].right;
+		node.right = e;
+		nodes[e].parent = index;
+		nodes[b].right = c;
+		nodes[c].parent = b;
+		nodes[b].bounds = merge(nodes[nodes[b].left].bounds, nodes[c].bounds);
+		break;
+	}
+	}
+}
+
+void DynamicBvh::setBounds(uint32_t object, const Aabb& bounds)
+{
+	uint32_t index = objectLeaves[object];
+	nodes[index].bounds = bounds;
+
+	// NOTE Stops at the first node already marked, everything above it is marked too
+	while (index != NullIndex && !nodes[index].dirty)
+	{
+		nodes[index].dirty = true;
+		index = nodes[index].parent;
+	}
+}
+
+void DynamicBvh::refit()
+{
+	if (root == NullIndex || !nodes[root].dirty)
+	{
+		return;
+	}
+
+	// Dirty nodes parents first, processed backwards so children are done before their parents
+	std::vector<uint32_t> order;
+	std::vector<uint32_t> stack;
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		uint32_t index = stack.back();
+		stack.pop_back();
+
+		Node& node = nodes[index];
+		node.dirty = false;
+		if (isLeaf(index))
+		{
+			continue;
+		}
+
+		order.push_back(index);
+		if (nodes[node.left].dirty)
+		{
+			stack.push_back(node.left);
+		}
+		if (nodes[node.right].dirty)
+		{
+			stack.push_back(node.right);
+		}
+	}
+
+	for (size_t i = order.size(); i-- > 0;)
+	{
+		Node& node = nodes[order[i]];
+		node.bounds = merge(nodes[node.left].bounds, nodes[node.right].bounds);
+		rotate(order[i]);
+	}
+}
+
+void DynamicBvh::build()
+{
+	std::vector<uint32_t> leaves;
+	leaves.reserve(objectCount);
+	for (uint32_t i = 0; i < (uint32_t)nodes.size(); i++)
+	{
+		if (nodes[i].object == InternalNode)
+		{
+			freeNode(i);
+		}
+		else if (nodes[i].object != NullIndex)
+		{
+			nodes[i].dirty = false;
+			leaves.push_back(i);
+		}
+	}
+
+	root = leaves.empty() ? NullIndex : buildRange(leaves.data(), (uint32_t)leaves.size());
+	if (root != NullIndex)
+	{
+		nodes[root].parent = NullIndex;
+	}
+}
+
+uint32_t DynamicBvh::buildRange(uint32_t* leaves, uint32_t count)
+{
+	if (count == 1)
+	{
+		return leaves[0];
+	}
+
+	// Split along the longest axis of the leaf centers
+	vec3 centerMin(INFINITY), centerMax(-INFINITY);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const Aabb& bounds = nodes[leaves[i]].bounds;
+		vec3 center = bounds.min + bounds.max;
+		centerMin = vec3(std::fmin(centerMin.x, center.x), std::fmin(centerMin.y, center.y), std::fmin(centerMin.z, center.z));
+		centerMax = vec3(std::fmax(centerMax.x, center.x), std::fmax(centerMax.y, center.y), std::fmax(centerMax.z, center.z));
+	}
+	vec3 extent = centerMax - centerMin;
+	int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+	float axisMin = axis == 0 ? centerMin.x : (axis == 1 ? centerMin.y : centerMin.z);
+	float axisExtent = axis == 0 ? extent.x : (axis == 1 ? extent.y : extent.z);
+
+	uint32_t middle = count / 2;
+	if (axisExtent > 0.0f)
+	{
+		// Binned SAH: leaves sorted into bins by center, the best split between bins
+		// minimizes area * leaf count on both sides
+		float binScale = BuildBinCount / axisExtent;
+		uint32_t binCounts[BuildBinCount] = {};
+		Aabb binBounds[BuildBinCount];
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const Aabb& bounds = nodes[leaves[i]].bounds;
+			vec3 center = bounds.min + bounds.max;
+			float position = axis == 0 ? center.x : (axis == 1 ? center.y : center.z);
+			int bin = std::min(BuildBinCount - 1, (int)((position - axisMin) * binScale));
+			binBounds[bin] = binCounts[bin] == 0 ? bounds : merge(binBounds[bin], bounds);
+			binCounts[bin]++;
+		}
+
+		float leftCosts[BuildBinCount];
+		uint32_t leftCount = 0;
+		Aabb accumulated;
+		for (int bin = 0; bin < BuildBinCount - 1; bin++)
+		{
+			if (binCounts[bin] > 0)
+			{
+				accumulated = leftCount == 0 ? binBounds[bin] : merge(accumulated, binBounds[bin]);
+				leftCount += binCounts[bin];
+			}
+			leftCosts[bin] = leftCount == 0 ? INFINITY : surfaceArea(accumulated) * leftCount;
+		}
+
+		int bestSplit = -1;
+		float bestCost = INFINITY;
+		uint32_t rightCount = 0;
+		for (int bin = BuildBinCount - 1; bin > 0; bin--)
+		{
+			if (binCounts[bin] > 0)
+			{
+				accumulated = rightCount == 0 ? binBounds[bin] : merge(accumulated, binBounds[bin]);
+				rightCount += binCounts[bin];
+			}
+			float cost = rightCount == 0 ? INFINITY : leftCosts[bin - 1] + surfaceArea(accumulated) * rightCount;
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = bin;
+			}
+		}
+
+		if (bestSplit > 0)
+		{
+			uint32_t* split = std::partition(leaves, leaves + count, [this, axis, axisMin, binScale, bestSplit](uint32_t leaf)
+			{
+				const Aabb& bounds = nodes[leaf].bounds;
+				vec3 center = bounds.min + bounds.max;
+				float position = axis == 0 ? center.x : (axis == 1 ? center.y : center.z);
+				return std::min(BuildBinCount - 1, (int)((position - axisMin) * binScale)) < bestSplit;
+			});
+			if (split != leaves && split != leaves + count)
+			{
+				middle = (uint32_t)(split - leaves);
+			}
+		}
+	}
+
+	uint32_t left = buildRange(leaves, middle);
+	uint32_t right = buildRange(leaves + middle, count - middle);
+
+	uint32_t index = allocateNode();
+	Node& node = nodes[index];
+	node.left = left;
+	node.right = right;
+	node.bounds = merge(nodes[left].bounds, nodes[right].bounds);
+	nodes[left].parent = index;
+	nodes[right].parent = index;
+	return index;
+}
+
+void DynamicBvh::queryFrustum(const Frustum& frustum, std::vector<uint32_t>& result) const
+{
+	if (root == NullIndex)
+	{
+		return;
+	}
+
+	// NOTE Subtrees completely inside are collected without testing anything under them
+	std::vector<uint32_t> stack;
+	std::vector<uint32_t> insideStack;
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		uint32_t index = stack.back();
+		stack.pop_back();
+
+		const Node& node = nodes[index];
+		FrustumOverlap overlap = testFrustum(frustum, node.bounds);
+		if (overlap == FrustumOutside)
+		{
+			continue;
+		}
+		if (isLeaf(index))
+		{
+			result.push_back(node.object);
+			continue;
+		}
+		if (overlap == FrustumIntersecting)
+		{
+			stack.push_back(node.left);
+			stack.push_back(node.right);
+			continue;
+		}
+
+		insideStack.push_back(index);
+		while (!insideStack.empty())
+		{
+			uint32_t inside = insideStack.back();
+			insideStack.pop_back();
+			if (isLeaf(inside))
+			{
+				result.push_back(nodes[inside].object);
+			}
+			else
+			{
+				insideStack.push_back(nodes[inside].left);
+				insideStack.push_back(nodes[inside].right);
+			}
+		}
+	}
+}
+
+void DynamicBvh::queryRange(const Aabb& range, std::vector<uint32_t>& result) const
+{
+	if (root == NullIndex)
+	{
+		return;
+	}
+
+	std::vector<uint32_t> stack;
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		uint32_t index = stack.back();
+		stack.pop_back();
+
+		const Node& node = nodes[index];
+		if (!overlaps(node.bounds, range))
+		{
+			continue;
+		}
+		if (isLeaf(index))
+		{
+			result.push_back(node.object);
+		}
+		else
+		{
+			stack.push_back(node.left);
+			stack.push_back(node.right);
+		}
+	}
+}
+
+bool DynamicBvh::raycast(const vec3& origin, const vec3& direction, float maxDistance, uint32_t& hitObject, float& hitDistance) const
+{
+	if (root == NullIndex)
+	{
+		return false;
+	}
+
+	vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	float closest = maxDistance;
+	bool hit = false;
+
+	struct Entry
+	{
+		uint32_t index;
+		float distance;
+	};
+	std::vector<Entry> stack;
+
+	float rootDistance = intersectRay(nodes[root].bounds, origin, inverseDirection, closest);
+	if (rootDistance >= 0.0f)
+	{
+		stack.push_back({ root, rootDistance });
+	}
+
+	while (!stack.empty())
+	{
+		Entry entry = stack.back();
+		stack.pop_back();
+
+		// Something closer was found since this one was pushed
+		if (entry.distance > closest)
+		{
+			continue;
+		}
+
+		const Node& node = nodes[entry.index];
+		if (isLeaf(entry.index))
+		{
+			closest = entry.distance;
+			hitObject = node.object;
+			hit = true;
+			continue;
+		}
+
+		// Nearest child on top of the stack, so it's searched first and shortens the ray for the other one
+		float leftDistance = intersectRay(nodes[node.left].bounds, origin, inverseDirection, closest);
+		float rightDistance = intersectRay(nodes[node.right].bounds, origin, inverseDirection, closest);
+		Entry left = { node.left, leftDistance };
+		Entry right = { node.right, rightDistance };
+		if (leftDistance > rightDistance)
+		{
+			std::swap(left, right);
+		}
+		if (right.distance >= 0.0f)
+		{
+			stack.push_back(right);
+		}
+		if (left.distance >= 0.0f)
+		{
+			stack.push_back(left);
+		}
+	}
+
+	hitDistance = closest;
+	return hit;
+}
+
+uint32_t DynamicBvh::getHeight(uint32_t index) const
+{
+	if (isLeaf(index))
+	{
+		return 0;
+	}
+	uint32_t left = getHeight(nodes[index].left);
+	uint32_t right = getHeight(nodes[index].right);
+	return 1 + (left > right ? left : right);
+}
+
+DynamicBvh::Stats DynamicBvh::getStats() const
+{
+	Stats stats;
+	stats.objectCount = objectCount;
+	stats.nodeCount = (uint32_t)(nodes.size() - freeNodes.size());
+	stats.height = root == NullIndex ? 0 : getHeight(root);
+
+	float internalArea = 0.0f;
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		if (nodes[i].object == InternalNode)
+		{
+			internalArea += surfaceArea(nodes[i].bounds);
+		}
+	}
+	stats.cost = root == NullIndex ? 0.0f : internalArea / surfaceArea(nodes[root].bounds);
+	return stats;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "MathTypes.h"
+#include "FrustumCulling.h"
+
+#include <vector>
+#include <cstdint>
+
+struct Aabb
+{
+	vec3 min;
+	vec3 max;
+};
+
+inline Aabb merge(const Aabb& a, const Aabb& b)
+{
+	Aabb result;
+	result.min = vec3(std::fmin(a.min.x, b.min.x), std::fmin(a.min.y, b.min.y), std::fmin(a.min.z, b.min.z));
+	result.max = vec3(std::fmax(a.max.x, b.max.x), std::fmax(a.max.y, b.max.y), std::fmax(a.max.z, b.max.z));
+	return result;
+}
+
+// Half the surface area, the constant factor doesn't matter to the SAH
+inline float surfaceArea(const Aabb& box)
+{
+	vec3 size = box.max - box.min;
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+inline bool overlaps(const Aabb& a, const Aabb& b)
+{
+	return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y && a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+// Distance along the ray to where it enters the box, or a negative value if it misses within maxDistance.
+// inverseDirection is 1 / direction per component
+float intersectRay(const Aabb& box, const vec3& origin, const vec3& inverseDirection, float maxDistance);
+
+// Bounding volume hierarchy over the bounds of the scene objects, a binary tree with one object per leaf.
+// Queries skip every subtree whose bounds are rejected, so they cost about log(n) plus the size of the
+// result instead of one test per object.
+//
+// The tree can be built in one go with the surface area heuristic (build), or kept up to date as objects
+// come and go (insert/remove pick the place that grows the tree the least). Moving objects only update
+// their leaf (setBounds), refit then recomputes the bounds of the touched branches and applies tree
+// rotations on the way up, so the tree stays good without rebuilding.
+class DynamicBvh
+{
+public:
+	static constexpr uint32_t NullIndex = 0xFFFFFFFF;
+
+	struct Stats
+	{
+		uint32_t objectCount;
+		uint32_t nodeCount;
+		uint32_t height;
+		float cost;	// SAH cost, sum of the internal node areas relative to the root
+	};
+
+private:
+	// object of internal nodes, free nodes have NullIndex
+	static constexpr uint32_t InternalNode = 0xFFFFFFFE;
+	static const int BuildBinCount = 16;
+
+	struct Node
+	{
+		Aabb bounds;
+		uint32_t parent;
+		uint32_t left;
+		uint32_t right;
+		uint32_t object;
+		bool dirty;	// bounds of something under it changed since the last refit
+	};
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> freeNodes;
+	std::vector<uint32_t> objectLeaves;	// leaf node of every object id, NullIndex for free ids
+	std::vector<uint32_t> freeObjects;
+	uint32_t root;
+	uint32_t objectCount;
+
+	uint32_t allocateNode();
+	void freeNode(uint32_t index);
+	bool isLeaf(uint32_t index) const { return nodes[index].object != InternalNode; }
+
+	void insertLeaf(uint32_t leaf);
+	void removeLeaf(uint32_t leaf);
+	void refitUpwards(uint32_t index);
+	void rotate(uint32_t index);
+	uint32_t buildRange(uint32_t* leaves, uint32_t count);
+	uint32_t getHeight(uint32_t index) const;
+
+public:
+	DynamicBvh();
+
+	// Returns the id of the object, ids of removed objects get reused
+	uint32_t insert(const Aabb& bounds);
+	void remove(uint32_t object);
+
+	// The tree isn't valid for queries until the next refit
+	void setBounds(uint32_t object, const Aabb& bounds);
+	void refit();
+
+	// Rebuilds the whole tree top down with a binned surface area heuristic
+	void build();
+
+	// Appends the ids of the objects intersecting the frustum / overlapping the box
+	void queryFrustum(const Frustum& frustum, std::vector<uint32_t>& result) const;
+	void queryRange(const Aabb& range, std::vector<uint32_t>& result) const;
+
+	// Closest object whose bounds the ray hits, false if there's none within maxDistance
+	bool raycast(const vec3& origin, const vec3& direction, float maxDistance, uint32_t& hitObject, float& hitDistance) const;
+
+	const Aabb& getBounds(uint32_t object) const { return nodes[objectLeaves[object]].bounds; }
+	uint32_t size() const { return objectCount; }
+	Stats getStats() const;
+};
@@ -0,0 +1,301 @@
+#include "EntityWorld.h"
+#include "MemoryTracker.h"
+
+#include <mutex>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+static std::mutex componentTypeMutex;
+static ComponentTypeInfo componentTypes[MaxComponentTypes];
+static int componentTypeCount = 0;
+
+int registerComponentType(uint32_t size, uint32_t alignment)
+{
+	std::lock_guard<std::mutex> lock(componentTypeMutex);
+	if (componentTypeCount == MaxComponentTypes)
+	{
+		// NOTE Fatal, handing out an id twice would make two types share their chunk columns
+		printf("ERROR: More than %d component types\n", MaxComponentTypes);
+		fflush(stdout);
+		abort();
+	}
+	if (alignment > 64)
+	{
+		printf("ERROR: Component alignment of %u is bigger than the chunk alignment\n", alignment);
+	}
+
+	componentTypes[componentTypeCount].size = size;
+	componentTypes[componentTypeCount].alignment = alignment;
+	return componentTypeCount++;
+}
+
+const ComponentTypeInfo& getComponentTypeInfo(int type)
+{
+	return componentTypes[type];
+}
+
+EntityWorld::EntityWorld(uint32_t maxEntities)
+	: entities(maxEntities, "ECS", "Entities"), chunkCount(0), entityMoves(0)
+{
+	// Entities without components live in the empty archetype
+	getArchetype(0);
+}
+
+EntityWorld::~EntityWorld()
+{
+	for (size_t i = 0; i < archetypes.size(); i++)
+	{
+		for (size_t chunk = 0; chunk < archetypes[i]->chunks.size(); chunk++)
+		{
+			freeChunks.push_back(archetypes[i]->chunks[chunk].memory);
+		}
+		delete archetypes[i];
+	}
+
+	for (size_t i = 0; i < freeChunks.size(); i++)
+	{
+		::operator delete(freeChunks[i], std::align_val_t(64));
+	}
+	trackFree("ECS", "Chunks", (size_t)freeChunks.size() * Chunk::Size);
+}
+
+Archetype* EntityWorld::getArchetype(ComponentMask mask)
+{
+	std::unordered_map<ComponentMask, Archetype*>::iterator found = archetypesByMask.find(mask);
+	if (found != archetypesByMask.end())
+	{
+		return found->second;
+	}
+
+	Archetype* archetype = new Archetype();
+	archetype->mask = mask;
+	archetype->entityCount = 0;
+	memset(archetype->columns, -1, sizeof(archetype->columns));
+	memset(archetype->addEdges, 0, sizeof(archetype->addEdges));
+	memset(archetype->removeEdges, 0, sizeof(archetype->removeEdges));
+
+	uint32_t bytesPerEntity = sizeof(Entity);
+	for (int type = 0; type < MaxComponentTypes; type++)
+	{
+		if (mask & (ComponentMask(1) << type))
+		{
+			archetype->columns[type] = (int8_t)archetype->types.size();
+			archetype->types.push_back(type);
+			bytesPerEntity += getComponentTypeInfo(type).size;
+		}
+	}
+	archetype->offsets.resize(archetype->types.size());
+
+	// As many entities as fit, with every array starting on a 16 byte boundary for SIMD loads
+	uint32_t capacity = Chunk::Size / bytesPerEntity;
+	for (; capacity > 0; capacity--)
+	{
+		uint32_t offset = capacity * sizeof(Entity);
+		for (size_t i = 0; i < archetype->types.size(); i++)
+		{
+			const ComponentTypeInfo& info = getComponentTypeInfo(archetype->types[i]);
+			uint32_t alignment = info.alignment > 16 ? info.alignment : 16;
+			offset = (offset + alignment - 1) & ~(alignment - 1);
+			archetype->offsets[i] = offset;
+			offset += info.size * capacity;
+		}
+		if (offset <= Chunk::Size)
+		{
+			break;
+		}
+	}
+	if (capacity == 0)
+	{
+		printf("ERROR: Components of archetype %llx don't fit in a chunk\n", (unsigned long long)mask);
+	}
+	archetype->chunkCapacity = capacity;
+
+	archetypes.push_back(archetype);
+	archetypesByMask[mask] = archetype;
+	return archetype;
+}
+
+Archetype* EntityWorld::getAddTarget(Archetype* archetype, int type)
+{
+	if (!archetype->addEdges[type])
+	{
+		Archetype* target = getArchetype(archetype->mask | (ComponentMask(1) << type));
+		archetype->addEdges[type] = target;
+		target->removeEdges[type] = archetype;
+	}
+	return archetype->addEdges[type];
+}
+
+Archetype* EntityWorld::getRemoveTarget(Archetype* archetype, int type)
+{
+	if (!archetype->removeEdges[type])
+	{
+		Archetype* target = getArchetype(archetype->mask & ~(ComponentMask(1) << type));
+		archetype->removeEdges[type] = target;
+		target->addEdges[type] = archetype;
+	}
+	return archetype->removeEdges[type];
+}
+
+EntityLocation EntityWorld::allocateRow(Archetype* archetype, Entity entity)
+{
+	if (archetype->chunks.empty() || archetype->chunks.back().count == archetype->chunkCapacity)
+	{
+		Chunk chunk;
+		if (!freeChunks.empty())
+		{
+			chunk.memory = freeChunks.back();
+			freeChunks.pop_back();
+		}
+		else
+		{
+			chunk.memory = (char*)::operator new(Chunk::Size, std::align_val_t(64));
+			trackAllocation("ECS", "Chunks", Chunk::Size);
+		}
+		chunk.count = 0;
+		archetype->chunks.push_back(chunk);
+		chunkCount++;
+	}
+
+	EntityLocation location;
+	location.archetype = archetype;
+	location.chunk = (uint32_t)archetype->chunks.size() - 1;
+	location.row = archetype->chunks.back().count++;
+	((Entity*)archetype->chunks.back().memory)[location.row] = entity;
+	archetype->entityCount++;
+	return location;
+}
+
+void EntityWorld::removeRow(Archetype* archetype, uint32_t chunk, uint32_t row)
+{
+	Chunk& last = archetype->chunks.back();
+	uint32_t lastRow = last.count - 1;
+	char* destination = archetype->chunks[chunk].memory;
+
+	// Keep the chunks packed by moving the last entity of the archetype into the hole
+	if (chunk != archetype->chunks.size() - 1 || row != lastRow)
+	{
+		Entity moved = ((Entity*)last.memory)[lastRow];
+		((Entity*)destination)[row] = moved;
+		for (size_t i = 0; i < archetype->types.size(); i++)
+		{
+			uint32_t size = getComponentTypeInfo(archetype->types[i]).size;
+			uint32_t offset = archetype->offsets[i];
+			memcpy(destination + offset + row * size, last.memory + offset + lastRow * size, size);
+		}
+
+		EntityLocation* movedLocation = entities.get(moved);
+		movedLocation->chunk = chunk;
+		movedLocation->row = row;
+	}
+
+	last.count--;
+	archetype->entityCount--;
+	if (last.count == 0)
+	{
+		freeChunks.push_back(last.memory);
+		archetype->chunks.pop_back();
+		chunkCount--;
+	}
+}
+
+void EntityWorld::moveEntity(Entity entity, EntityLocation* location, Archetype* target)
+{
+	Archetype* source = location->archetype;
+	char* sourceMemory = source->chunks[location->chunk].memory;
+	uint32_t sourceRow = location->row;
+
+	EntityLocation targetLocation = allocateRow(target, entity);
+	char* targetMemory = target->chunks[targetLocation.chunk].memory;
+
+	// Components in both archetypes are copied, new ones start zeroed
+	for (size_t i = 0; i < target->types.size(); i++)
+	{
+		int type = target->types[i];
+		uint32_t size = getComponentTypeInfo(type).size;
+		char* destination = targetMemory + target->offsets[i] + targetLocation.row * size;
+
+		int sourceColumn = source->columns[type];
+		if (sourceColumn >= 0)
+		{
+			memcpy(destination, sourceMemory + source->offsets[sourceColumn] + sourceRow * size, size);
+		}
+		else
+		{
+			memset(destination, 0, size);
+		}
+	}
+
+	removeRow(source, location->chunk, sourceRow);
+	*location = targetLocation;
+	entityMoves++;
+}
+
+void* EntityWorld::getComponent(const EntityLocation* location, int type)
+{
+	const Archetype* archetype = location->archetype;
+	int column = archetype->columns[type];
+	if (column < 0)
+	{
+		return NULL;
+	}
+
+	uint32_t size = getComponentTypeInfo(type).size;
+	return archetype->chunks[location->chunk].memory + archetype->offsets[column] + location->row * size;
+}
+
+Entity EntityWorld::createEntity(ComponentMask mask)
+{
+	Entity entity = entities.create();
+	if (entity.isNull())
+	{
+		return entity;
+	}
+
+	Archetype* archetype = getArchetype(mask);
+	EntityLocation location = allocateRow(archetype, entity);
+	char* memory = archetype->chunks[location.chunk].memory;
+	for (size_t i = 0; i < archetype->types.size(); i++)
+	{
+		uint32_t size = getComponentTypeInfo(archetype->types[i]).size;
+		memset(memory + archetype->offsets[i] + location.row * size, 0, size);
+	}
+
+	*entities.get(entity) = location;
+	return entity;
+}
+
+bool EntityWorld::destroyEntity(Entity entity)
+{
+	EntityLocation* location = entities.get(entity);
+	if (!location)
+	{
+		return false;
+	}
+
+	removeRow(location->archetype, location->chunk, location->row);
+	return entities.destroy(entity);
+}
+
+void EntityWorld::updateQuery(Query& query)
+{
+	for (; query.archetypesChecked < archetypes.size(); query.archetypesChecked++)
+	{
+		Archetype* archetype = archetypes[query.archetypesChecked];
+		if ((archetype->mask & query.required) == query.required && !(archetype->mask & query.excluded))
+		{
+			query.archetypes.push_back(archetype);
+		}
+	}
+}
+
+EntityWorld::Stats EntityWorld::getStats() const
+{
+	Stats stats;
+	stats.entityCount = entities.size();
+	stats.archetypeCount = (uint32_t)archetypes.size();
+	stats.chunkCount = chunkCount;
+	stats.entityMoves = entityMoves;
+	return stats;
+}
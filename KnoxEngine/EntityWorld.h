@@ -0,0 +1,268 @@
+#pragma once
+
+#include "Pool.h"
+#include "JobSystem.h"
+
+#include <vector>
+#include <unordered_map>
+#include <type_traits>
+#include <cstring>
+#include <cstdint>
+
+// Set of component types, one bit per type
+typedef uint64_t ComponentMask;
+
+static const int MaxComponentTypes = 64;
+
+struct ComponentTypeInfo
+{
+	uint32_t size;
+	uint32_t alignment;
+};
+
+// Component types get sequential ids the first time they're used
+int registerComponentType(uint32_t size, uint32_t alignment);
+const ComponentTypeInfo& getComponentTypeInfo(int type);
+
+template<typename T>
+int getComponentType()
+{
+	// NOTE Components are moved between chunks with memcpy
+	static_assert(std::is_trivially_copyable<T>::value, "Components have to be trivially copyable");
+	static const int type = registerComponentType(sizeof(T), alignof(T));
+	return type;
+}
+
+template<typename... T>
+ComponentMask componentMask()
+{
+	return (ComponentMask(0) | ... | (ComponentMask(1) << getComponentType<T>()));
+}
+
+struct Archetype;
+
+// Where the components of an entity are, lives in a Pool<EntityLocation>
+struct EntityLocation
+{
+	Archetype* archetype;
+	uint32_t chunk;
+	uint32_t row;
+};
+
+typedef Handle<EntityLocation> Entity;
+
+// Fixed size block holding the components of up to chunkCapacity entities of one archetype,
+// structure of arrays: all the entity handles, then all the components of the first type, ...
+struct Chunk
+{
+	static const uint32_t Size = 16 * 1024;
+
+	char* memory;
+	uint32_t count;
+};
+
+// All the entities that have exactly the same set of components
+struct Archetype
+{
+	ComponentMask mask;
+	std::vector<int> types;
+	std::vector<uint32_t> offsets;	// of every component array inside a chunk, same order as types
+	int8_t columns[MaxComponentTypes];	// position of every component type in types, -1 if it isn't in the archetype
+	uint32_t chunkCapacity;
+
+	// NOTE Only the last chunk can be partly filled
+	std::vector<Chunk> chunks;
+	uint32_t entityCount;
+
+	// Archetype reached by adding or removing one component, filled in as they're used
+	Archetype* addEdges[MaxComponentTypes];
+	Archetype* removeEdges[MaxComponentTypes];
+};
+
+// Component arrays of one chunk, what queries hand out
+struct ChunkView
+{
+	const Archetype* archetype;
+	char* memory;
+	uint32_t count;
+
+	// NULL if the archetype doesn't have the component (only possible for types the query didn't require)
+	template<typename T>
+	T* get() const
+	{
+		int column = archetype->columns[getComponentType<T>()];
+		return column < 0 ? NULL : (T*)(memory + archetype->offsets[column]);
+	}
+
+	const Entity* getEntities() const { return (const Entity*)memory; }
+};
+
+// Entities matching all of required and none of excluded. The matching archetypes are cached,
+// running the query again only tests the archetypes created since the last time
+class Query
+{
+private:
+	friend class EntityWorld;
+
+	ComponentMask required;
+	ComponentMask excluded;
+	std::vector<Archetype*> archetypes;
+	size_t archetypesChecked;
+	std::vector<ChunkView> chunkViews;	// scratch for forEachChunkParallel
+
+public:
+	Query(ComponentMask required, ComponentMask excluded = 0)
+		: required(required), excluded(excluded), archetypesChecked(0) {}
+
+	size_t getArchetypeCount() const { return archetypes.size(); }
+};
+
+// Archetype based entity component system. Entities with the same set of components share an
+// archetype and are stored packed in 16KB chunks, one array per component, so a query walks
+// contiguous arrays instead of chasing pointers per object.
+// Adding or removing a component moves the entity to another archetype (a copy of its components),
+// destroying one moves the last entity of the archetype into the hole.
+// NOTE Component pointers are only valid until the next structural change
+class EntityWorld
+{
+public:
+	struct Stats
+	{
+		uint32_t entityCount;
+		uint32_t archetypeCount;
+		uint32_t chunkCount;
+		uint64_t entityMoves;	// between archetypes
+	};
+
+private:
+	Pool<EntityLocation> entities;
+	std::vector<Archetype*> archetypes;
+	std::unordered_map<ComponentMask, Archetype*> archetypesByMask;
+	std::vector<char*> freeChunks;
+	uint32_t chunkCount;
+	uint64_t entityMoves;
+
+	Archetype* getArchetype(ComponentMask mask);
+	Archetype* getAddTarget(Archetype* archetype, int type);
+	Archetype* getRemoveTarget(Archetype* archetype, int type);
+
+	EntityLocation allocateRow(Archetype* archetype, Entity entity);
+	void removeRow(Archetype* archetype, uint32_t chunk, uint32_t row);
+	void moveEntity(Entity entity, EntityLocation* location, Archetype* target);
+	void* getComponent(const EntityLocation* location, int type);
+
+	void updateQuery(Query& query);
+
+public:
+	EntityWorld(uint32_t maxEntities);
+	~EntityWorld();
+
+	EntityWorld(const EntityWorld&) = delete;
+	EntityWorld& operator=(const EntityWorld&) = delete;
+
+	// Components start zeroed, returns a null entity when the world is full
+	Entity createEntity(ComponentMask mask = 0);
+	bool destroyEntity(Entity entity);
+	bool isAlive(Entity entity) const { return entities.isAlive(entity); }
+
+	template<typename T>
+	void addComponent(Entity entity, const T& value);
+	template<typename T>
+	void removeComponent(Entity entity);
+
+	// NULL if the entity is dead or doesn't have the component
+	template<typename T>
+	T* getComponent(Entity entity);
+
+	// Calls function(const ChunkView&) for every non empty chunk matching the query
+	template<typename Function>
+	void forEachChunk(Query& query, const Function& function);
+
+	// Same, with the chunks split across the job system. Chunks are independent, but function
+	// must not make structural changes
+	template<typename Function>
+	void forEachChunkParallel(Query& query, JobSystem& jobSystem, const Function& function);
+
+	Stats getStats() const;
+};
+
+template<typename T>
+void EntityWorld::addComponent(Entity entity, const T& value)
+{
+	EntityLocation* location = entities.get(entity);
+	if (!location)
+	{
+		return;
+	}
+
+	int type = getComponentType<T>();
+	if (!(location->archetype->mask & (ComponentMask(1) << type)))
+	{
+		moveEntity(entity, location, getAddTarget(location->archetype, type));
+	}
+	memcpy(getComponent(location, type), &value, sizeof(T));
+}
+
+template<typename T>
+void EntityWorld::removeComponent(Entity entity)
+{
+	EntityLocation* location = entities.get(entity);
+	if (!location)
+	{
+		return;
+	}
+
+	int type = getComponentType<T>();
+	if (location->archetype->mask & (ComponentMask(1) << type))
+	{
+		moveEntity(entity, location, getRemoveTarget(location->archetype, type));
+	}
+}
+
+template<typename T>
+T* EntityWorld::getComponent(Entity entity)
+{
+	EntityLocation* location = entities.get(entity);
+	return location ? (T*)getComponent(location, getComponentType<T>()) : NULL;
+}
+
+template<typename Function>
+void EntityWorld::forEachChunk(Query& query, const Function& function)
+{
+	updateQuery(query);
+	for (size_t i = 0; i < query.archetypes.size(); i++)
+	{
+		const Archetype* archetype = query.archetypes[i];
+		for (size_t chunk = 0; chunk < archetype->chunks.size(); chunk++)
+		{
+			ChunkView view = { archetype, archetype->chunks[chunk].memory, archetype->chunks[chunk].count };
+			function(view);
+		}
+	}
+}
+
+template<typename Function>
+void EntityWorld::forEachChunkParallel(Query& query, JobSystem& jobSystem, const Function& function)
+{
+	updateQuery(query);
+	query.chunkViews.clear();
+	for (size_t i = 0; i < query.archetypes.size(); i++)
+	{
+		const Archetype* archetype = query.archetypes[i];
+		for (size_t chunk = 0; chunk < archetype->chunks.size(); chunk++)
+		{
+			ChunkView view = { archetype, archetype->chunks[chunk].memory, archetype->chunks[chunk].count };
+			query.chunkViews.push_back(view);
+		}
+	}
+
+	// NOTE A few chunks per job, a single chunk is too little work to be worth a job
+	const std::vector<ChunkView>& views = query.chunkViews;
+	jobSystem.parallelFor((uint32_t)views.size(), 8, [&views, &function](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			function(views[i]);
+		}
+	});
+}
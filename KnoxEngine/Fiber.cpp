@@ -0,0 +1,218 @@
+#include "Fiber.h"
+
+#include <iostream>
+#include <cstdint>
+
+#ifdef _WIN32
+
+Fiber::Fiber() : handle(NULL), function(NULL), data(NULL), isThreadFiber(false)
+{
+}
+
+Fiber::~Fiber()
+{
+	if (handle && !isThreadFiber)
+	{
+		DeleteFiber(handle);
+	}
+}
+
+void WINAPI Fiber::entryPoint(LPVOID parameter)
+{
+	Fiber* fiber = (Fiber*)parameter;
+	fiber->function(fiber->data);
+}
+
+bool Fiber::create(FiberFunction function, void* data, size_t stackSize)
+{
+	this->function = function;
+	this->data = data;
+	handle = CreateFiber(stackSize, entryPoint, this);
+	if (!handle)
+	{
+		printf("ERROR: CreateFiber failed (%lu)\n", GetLastError());
+		return false;
+	}
+	return true;
+}
+
+bool Fiber::convertCurrentThread()
+{
+	isThreadFiber = true;
+	handle = ConvertThreadToFiber(NULL);
+	if (!handle)
+	{
+		printf("ERROR: ConvertThreadToFiber failed (%lu)\n", GetLastError());
+		return false;
+	}
+	return true;
+}
+
+void Fiber::revertCurrentThread()
+{
+	ConvertFiberToThread();
+	handle = NULL;
+}
+
+void Fiber::switchTo(Fiber& from, Fiber& to)
+{
+	SwitchToFiber(to.handle);
+}
+
+#elif KNOX_FIBER_ASM
+
+// knoxSwitchFiber(from, to): pushes the callee-saved registers of the System V ABI plus the SSE and x87
+// control words on the current stack, saves the stack pointer to *from, then does the same in reverse
+// from to. The return at the end lands wherever to last called knoxSwitchFiber, or in
+// knoxStartFiber for a new fiber, which calls the entry point stored in r13 with r12 as the argument
+extern "C" void knoxSwitchFiber(void** from, void* to);
+extern "C" void knoxStartFiber();
+
+asm(R"(
+	.text
+	.globl knoxSwitchFiber
+	.type knoxSwitchFiber, @function
+knoxSwitchFiber:
+	pushq %rbp
+	pushq %rbx
+	pushq %r12
+	pushq %r13
+	pushq %r14
+	pushq %r15
+	subq $8, %rsp
+	stmxcsr (%rsp)
+	fnstcw 4(%rsp)
+	movq %rsp, (%rdi)
+	movq %rsi, %rsp
+	ldmxcsr (%rsp)
+	fldcw 4(%rsp)
+	addq $8, %rsp
+	popq %r15
+	popq %r14
+	popq %r13
+	popq %r12
+	popq %rbx
+	popq %rbp
+	ret
+	.size knoxSwitchFiber, .-knoxSwitchFiber
+
+	.globl knoxStartFiber
+	.type knoxStartFiber, @function
+knoxStartFiber:
+	movq %r12, %rdi
+	callq *%r13
+	ud2
+	.size knoxStartFiber, .-knoxStartFiber
+)");
+
+Fiber::Fiber() : stackPointer(NULL), stack(NULL), function(NULL), data(NULL), isThreadFiber(false)
+{
+}
+
+Fiber::~Fiber()
+{
+	delete[] stack;
+}
+
+void Fiber::entryPoint(Fiber* fiber)
+{
+	fiber->function(fiber->data);
+}
+
+bool Fiber::create(FiberFunction function, void* data, size_t stackSize)
+{
+	this->function = function;
+	this->data = data;
+
+	stack = new char[stackSize];
+
+	// The frame knoxSwitchFiber pops the first time it switches here: control words, r15 to rbp and
+	// the return address. NOTE knoxStartFiber starts with the stack 16 byte aligned, like after a call
+	uintptr_t top = ((uintptr_t)stack + stackSize) & ~(uintptr_t)15;
+	uint64_t* frame = (uint64_t*)(top - 80);
+	frame[0] = 0x1F80 | ((uint64_t)0x037F << 32);	// default MXCSR and x87 control word
+	frame[1] = 0;									// r15
+	frame[2] = 0;									// r14
+	frame[3] = (uint64_t)(uintptr_t)&Fiber::entryPoint;	// r13
+	frame[4] = (uint64_t)(uintptr_t)this;			// r12
+	frame[5] = 0;									// rbx
+	frame[6] = 0;									// rbp
+	frame[7] = (uint64_t)(uintptr_t)&knoxStartFiber;	// return address
+	frame[8] = 0;
+	frame[9] = 0;
+	stackPointer = frame;
+	return true;
+}
+
+bool Fiber::convertCurrentThread()
+{
+	// The stack pointer gets saved the first time this thread switches away
+	isThreadFiber = true;
+	return true;
+}
+
+void Fiber::revertCurrentThread()
+{
+}
+
+void Fiber::switchTo(Fiber& from, Fiber& to)
+{
+	knoxSwitchFiber(&from.stackPointer, to.stackPointer);
+}
+
+#else
+
+Fiber::Fiber() : stack(NULL), function(NULL), data(NULL), isThreadFiber(false)
+{
+}
+
+Fiber::~Fiber()
+{
+	delete[] stack;
+}
+
+// NOTE makecontext only passes int arguments, so the pointer is split in two halves
+void Fiber::entryPoint(unsigned int low, unsigned int high)
+{
+	Fiber* fiber = (Fiber*)(((uintptr_t)high << 32) | (uintptr_t)low);
+	fiber->function(fiber->data);
+}
+
+bool Fiber::create(FiberFunction function, void* data, size_t stackSize)
+{
+	this->function = function;
+	this->data = data;
+
+	if (getcontext(&context) != 0)
+	{
+		printf("ERROR: getcontext failed while creating a fiber\n");
+		return false;
+	}
+
+	stack = new char[stackSize];
+	context.uc_stack.ss_sp = stack;
+	context.uc_stack.ss_size = stackSize;
+	context.uc_link = NULL;
+
+	uintptr_t pointer = (uintptr_t)this;
+	makecontext(&context, (void (*)())entryPoint, 2, (unsigned int)(pointer & 0xFFFFFFFF), (unsigned int)(pointer >> 32));
+	return true;
+}
+
+bool Fiber::convertCurrentThread()
+{
+	// The context gets filled in the first time this thread switches away
+	isThreadFiber = true;
+	return true;
+}
+
+void Fiber::revertCurrentThread()
+{
+}
+
+void Fiber::switchTo(Fiber& from, Fiber& to)
+{
+	swapcontext(&from.context, &to.context);
+}
+
+#endif
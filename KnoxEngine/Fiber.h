@@ -0,0 +1,63 @@
+#pragma once
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__x86_64__) && defined(__ELF__) && !defined(KNOX_FIBER_UCONTEXT)
+#define KNOX_FIBER_ASM 1
+#else
+#include <ucontext.h>
+#endif
+
+#include <cstddef>
+
+typedef void (*FiberFunction)(void* data);
+
+// Thin wrapper over the platform fibers. A fiber is a stack + saved registers, switching between them
+// saves the callee-saved registers of one and restores the other's:
+// - Windows: Win32 fibers, SwitchToFiber stays in user mode
+// - x86-64 Linux and other ELF systems: a hand-written switch (Fiber.cpp), a few pushes and pops with no kernel involved
+// - other CPUs (or with KNOX_FIBER_UCONTEXT): ucontext. NOTE swapcontext also saves and restores the
+//   signal mask, that's a sigprocmask system call on every switch and makes it far slower
+class Fiber
+{
+private:
+#ifdef _WIN32
+	LPVOID handle;
+	static void WINAPI entryPoint(LPVOID parameter);
+#elif KNOX_FIBER_ASM
+	void* stackPointer;		// where the registers were saved, the fiber resumes from there
+	char* stack;
+	static void entryPoint(Fiber* fiber);
+#else
+	ucontext_t context;
+	char* stack;
+	static void entryPoint(unsigned int low, unsigned int high);
+#endif
+	FiberFunction function;
+	void* data;
+	bool isThreadFiber;
+
+public:
+	Fiber();
+	~Fiber();
+
+	Fiber(const Fiber&) = delete;
+	Fiber& operator=(const Fiber&) = delete;
+
+	// Creates a new fiber that will run function(data) the first time it is switched to
+	// NOTE function must never return, it has to switch to another fiber instead
+	bool create(FiberFunction function, void* data, size_t stackSize);
+
+	// Turns the calling thread into a fiber, so it can switch to others and be switched back to
+	bool convertCurrentThread();
+	void revertCurrentThread();
+
+	// Saves the current state into from and continues running to
+	static void switchTo(Fiber& from, Fiber& to);
+};
@@ -0,0 +1,337 @@
+#include "FiberJobSystem.h"
+
+#include <iostream>
+#include <thread>
+
+#ifdef _MSC_VER
+#define KNOX_NOINLINE __declspec(noinline)
+#else
+#define KNOX_NOINLINE __attribute__((noinline))
+#endif
+
+struct FiberThreadState
+{
+	Fiber threadFiber;
+	bool converted;
+
+	// Fiber running a job on this thread, NULL on the thread's own stack
+	void* currentSlot;
+	// Where the running fiber goes back to when its job finishes or waits:
+	// the thread, or the fiber that was running when this one was started
+	Fiber* scheduler;
+	// Set by a fiber going back to the scheduler, the counter it waits on or NULL when its job is done
+	void* parkedCounter;
+};
+
+static thread_local FiberThreadState threadState;
+
+// NOTE A fiber can go to sleep on one thread and wake up on another, the compiler must not
+// keep the address of a thread_local around across a switch, so every access goes through here
+static KNOX_NOINLINE FiberThreadState* getThreadState()
+{
+	return &threadState;
+}
+
+FiberJobSystem::IndexFreeList::IndexFreeList(uint32_t count) : head(0), next(count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		next[i].store(i + 1 < count ? i + 2 : 0, std::memory_order_relaxed);
+	}
+	head.store(count > 0 ? 1 : 0, std::memory_order_release);
+}
+
+bool FiberJobSystem::IndexFreeList::pop(uint32_t& index)
+{
+	uint64_t current = head.load(std::memory_order_acquire);
+	while (true)
+	{
+		uint32_t top = (uint32_t)current;
+		if (top == 0)
+		{
+			return false;
+		}
+
+		// NOTE next may be stale if another thread popped top in the meantime, the tag makes the exchange fail then
+		uint64_t updated = (((current >> 32) + 1) << 32) | next[top - 1].load(std::memory_order_relaxed);
+		if (head.compare_exchange_weak(current, updated, std::memory_order_acquire, std::memory_order_acquire))
+		{
+			index = top - 1;
+			return true;
+		}
+	}
+}
+
+void FiberJobSystem::IndexFreeList::push(uint32_t index)
+{
+	uint64_t current = head.load(std::memory_order_relaxed);
+	uint64_t updated;
+	do
+	{
+		next[index].store((uint32_t)current, std::memory_order_relaxed);
+		updated = (((current >> 32) + 1) << 32) | (index + 1);
+	} while (!head.compare_exchange_weak(current, updated, std::memory_order_release, std::memory_order_relaxed));
+}
+
+FiberJobSystem::FiberJobSystem(JobSystem& jobSystem, int fiberCount, size_t stackSize)
+	: jobSystem(jobSystem), freeFibers(fiberCount > 0 ? fiberCount : 1), records(JobRecordCount), freeRecords(JobRecordCount),
+	outOfFibersReported(false), jobsInFlight(0), jobsExecuted(0), fiberSwitches(0), waitsParked(0), waitsSkipped(0)
+{
+	if (fiberCount < 1)
+	{
+		fiberCount = 1;
+	}
+
+	fibers.resize(fiberCount);
+	for (int i = 0; i < fiberCount; i++)
+	{
+		fibers[i] = new FiberSlot();
+		fibers[i]->system = this;
+		fibers[i]->index = (uint32_t)i;
+		fibers[i]->fiber.create(&FiberJobSystem::fiberMain, fibers[i], stackSize);
+	}
+
+	for (uint32_t i = 0; i < JobRecordCount; i++)
+	{
+		records[i].system = this;
+		records[i].index = i;
+	}
+}
+
+FiberJobSystem::~FiberJobSystem()
+{
+	while (jobsInFlight.load(std::memory_order_acquire) > 0)
+	{
+		if (!jobSystem.runPendingJob())
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	// NOTE Only the calling thread can be turned back, the workers stay fibers until they exit
+	FiberThreadState* state = getThreadState();
+	if (state->converted && !state->currentSlot)
+	{
+		state->threadFiber.revertCurrentThread();
+		state->converted = false;
+	}
+
+	// Idle fibers are suspended at the end of their loop, they are simply dropped
+	for (size_t i = 0; i < fibers.size(); i++)
+	{
+		delete fibers[i];
+	}
+}
+
+void FiberJobSystem::run(JobFunction function, void* data, Counter* counter)
+{
+	if (counter)
+	{
+		counter->state.fetch_add(1ull << 32, std::memory_order_relaxed);
+	}
+	jobsInFlight.fetch_add(1, std::memory_order_relaxed);
+
+	uint32_t recordIndex;
+	if (!freeRecords.pop(recordIndex))
+	{
+		// Every record is queued already, like with a full JobSystem queue it's cheaper to do the work right now
+		function(data);
+		finishJob(counter);
+		jobsInFlight.fetch_sub(1, std::memory_order_release);
+		return;
+	}
+
+	JobRecord& record = records[recordIndex];
+	record.function = function;
+	record.data = data;
+	record.counter = counter;
+	jobSystem.run(&FiberJobSystem::startJob, &record, NULL);
+}
+
+void FiberJobSystem::startJob(void* data)
+{
+	JobRecord* record = (JobRecord*)data;
+	FiberJobSystem* system = record->system;
+	JobFunction function = record->function;
+	void* jobData = record->data;
+	Counter* counter = record->counter;
+	system->freeRecords.push(record->index);
+
+	uint32_t fiberIndex;
+	if (!system->freeFibers.pop(fiberIndex))
+	{
+		// Every fiber is running or parked, run the job on this stack. A wait inside it
+		// parks the fiber this stack belongs to, or blocks the worker on its own stack
+		if (!system->outOfFibersReported.exchange(true))
+		{
+			printf("ERROR: FiberJobSystem ran out of fibers, increase fiberCount\n");
+		}
+		function(jobData);
+		system->finishJob(counter);
+		system->jobsInFlight.fetch_sub(1, std::memory_order_release);
+		return;
+	}
+
+	FiberSlot* slot = system->fibers[fiberIndex];
+	slot->function = function;
+	slot->data = jobData;
+	slot->counter = counter;
+	system->runFiber(slot);
+}
+
+void FiberJobSystem::resumeFiber(void* data)
+{
+	FiberSlot* slot = (FiberSlot*)data;
+	slot->system->runFiber(slot);
+}
+
+void FiberJobSystem::fiberMain(void* data)
+{
+	FiberSlot* slot = (FiberSlot*)data;
+	FiberJobSystem* system = slot->system;
+	while (true)
+	{
+		slot->function(slot->data);
+		system->finishJob(slot->counter);
+
+		// The job may have moved to another thread while it was parked, go back to the one it's on now
+		FiberThreadState* state = getThreadState();
+		state->parkedCounter = NULL;
+		Fiber::switchTo(slot->fiber, *state->scheduler);
+	}
+}
+
+// Runs slot on the calling thread until its job finishes or parks, then files it away.
+// Always returns on the thread it was called on
+void FiberJobSystem::runFiber(FiberSlot* slot)
+{
+	FiberThreadState* state = getThreadState();
+	if (!state->converted)
+	{
+		state->converted = state->threadFiber.convertCurrentThread();
+	}
+
+	FiberSlot* outerSlot = (FiberSlot*)state->currentSlot;
+	Fiber* outerScheduler = state->scheduler;
+	Fiber* from = outerSlot ? &outerSlot->fiber : &state->threadFiber;
+
+	while (true)
+	{
+		state->currentSlot = slot;
+		state->scheduler = from;
+		fiberSwitches.fetch_add(1, std::memory_order_relaxed);
+		Fiber::switchTo(*from, slot->fiber);
+
+		state = getThreadState();
+		Counter* parkedCounter = (Counter*)state->parkedCounter;
+		state->currentSlot = outerSlot;
+		state->scheduler = outerScheduler;
+
+		if (!parkedCounter)
+		{
+			// NOTE Last access to the system, the destructor may go ahead right after
+			freeFibers.push(slot->index);
+			jobsInFlight.fetch_sub(1, std::memory_order_release);
+			return;
+		}
+
+		// NOTE The fiber is only put on the counter now that it's switched out, so another worker
+		// can never resume it while it's still running here
+		if (park(slot, parkedCounter))
+		{
+			return;
+		}
+		// The counter finished in the meantime, carry on right away
+	}
+}
+
+bool FiberJobSystem::park(FiberSlot* slot, Counter* counter)
+{
+	uint64_t state = counter->state.load(std::memory_order_acquire);
+	uint64_t updated;
+	do
+	{
+		if ((state >> 32) == 0)
+		{
+			return false;
+		}
+		slot->nextWaiter = (uint32_t)state;
+		updated = (state & 0xFFFFFFFF00000000ull) | (slot->index + 1);
+	} while (!counter->state.compare_exchange_weak(state, updated, std::memory_order_acq_rel, std::memory_order_acquire));
+
+	waitsParked.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+void FiberJobSystem::finishJob(Counter* counter)
+{
+	jobsExecuted.fetch_add(1, std::memory_order_relaxed);
+	if (!counter)
+	{
+		return;
+	}
+
+	// The last job clears the waiters along with the count
+	uint64_t state = counter->state.load(std::memory_order_relaxed);
+	uint64_t updated;
+	do
+	{
+		updated = (state >> 32) == 1 ? 0 : state - (1ull << 32);
+	} while (!counter->state.compare_exchange_weak(state, updated, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+	if ((state >> 32) != 1)
+	{
+		return;
+	}
+
+	// NOTE The counter can be gone from here on, only the waiters taken out of it are used
+	uint32_t waiter = (uint32_t)state;
+	while (waiter != 0)
+	{
+		FiberSlot* slot = fibers[waiter - 1];
+		waiter = slot->nextWaiter;
+		jobSystem.run(&FiberJobSystem::resumeFiber, slot, NULL);
+	}
+}
+
+void FiberJobSystem::wait(Counter* counter)
+{
+	if (counter->isDone())
+	{
+		waitsSkipped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	FiberThreadState* state = getThreadState();
+	FiberSlot* slot = (FiberSlot*)state->currentSlot;
+	if (!slot || slot->system != this)
+	{
+		// Not on one of our fibers, help out like JobSystem::wait
+		while (!counter->isDone())
+		{
+			if (!jobSystem.runPendingJob())
+			{
+				std::this_thread::yield();
+			}
+		}
+		return;
+	}
+
+	// NOTE Loops in case the counter got more jobs between the wake up and now
+	while (!counter->isDone())
+	{
+		state->parkedCounter = counter;
+		Fiber::switchTo(slot->fiber, *state->scheduler);
+		state = getThreadState();
+	}
+}
+
+FiberJobSystem::Stats FiberJobSystem::getStats() const
+{
+	Stats stats;
+	stats.jobsExecuted = jobsExecuted.load(std::memory_order_relaxed);
+	stats.fiberSwitches = fiberSwitches.load(std::memory_order_relaxed);
+	stats.waitsParked = waitsParked.load(std::memory_order_relaxed);
+	stats.waitsSkipped = waitsSkipped.load(std::memory_order_relaxed);
+	return stats;
+}
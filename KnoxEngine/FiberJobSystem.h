@@ -0,0 +1,128 @@
+#pragma once
+
+#include "JobSystem.h"
+#include "Fiber.h"
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+
+// Fiber layer over a JobSystem: jobs go through the JobSystem's work-stealing queues and are run by
+// its workers, but every job runs on a pooled fiber instead of the worker's own stack. When a job waits
+// on a counter that isn't done yet, its fiber is parked and the worker goes back to its queue. The job
+// that brings the counter to zero schedules the parked fibers again, so any worker can resume them.
+// A waiting job never holds a thread hostage, and deep dependency chains don't pile up on a single
+// stack like in JobSystem::wait.
+//
+// Nothing takes a lock: job records and fibers come from lock-free free lists, and the fibers parked
+// on a counter are a list in the counter itself, updated in the same atomic as the job count.
+// NOTE Same rule as JobSystem, jobs can only be scheduled from its worker threads
+class FiberJobSystem
+{
+private:
+	struct FiberSlot;
+
+public:
+	static const int DefaultFiberCount = 128;
+	static const size_t DefaultStackSize = 64 * 1024;
+	static const uint32_t JobRecordCount = 4096;
+
+	// Jobs left in the high 32 bits, first parked fiber + 1 in the low 32 bits (0 for none), so the
+	// last job takes the waiters in the same operation that finishes the counter and never touches it
+	// again: the waiting job may return and free the counter right after
+	struct Counter
+	{
+		std::atomic<uint64_t> state;
+
+		Counter(int jobCount = 0) : state((uint64_t)jobCount << 32) {}
+
+		bool isDone() const { return (state.load(std::memory_order_acquire) >> 32) == 0; }
+	};
+
+	struct Stats
+	{
+		uint64_t jobsExecuted;
+		uint64_t fiberSwitches;
+		uint64_t waitsParked;
+		uint64_t waitsSkipped;
+	};
+
+private:
+	// Lock-free stack of indices into a fixed array, the tag in the high bits of head stops ABA
+	class IndexFreeList
+	{
+	private:
+		std::atomic<uint64_t> head;		// tag << 32 | (index + 1), 0 when empty
+		std::vector<std::atomic<uint32_t>> next;
+
+	public:
+		IndexFreeList(uint32_t count);
+
+		bool pop(uint32_t& index);
+		void push(uint32_t index);
+	};
+
+	struct FiberSlot
+	{
+		Fiber fiber;
+		FiberJobSystem* system;
+		uint32_t index;
+		uint32_t nextWaiter;	// next parked fiber + 1 on the same counter
+
+		JobFunction function;
+		void* data;
+		Counter* counter;
+	};
+
+	// A scheduled job until a worker picks it up and gives it a fiber
+	struct JobRecord
+	{
+		FiberJobSystem* system;
+		uint32_t index;
+		JobFunction function;
+		void* data;
+		Counter* counter;
+	};
+
+	JobSystem& jobSystem;
+
+	std::vector<FiberSlot*> fibers;
+	IndexFreeList freeFibers;
+	std::vector<JobRecord> records;
+	IndexFreeList freeRecords;
+	std::atomic<bool> outOfFibersReported;
+	// Jobs scheduled and not completely done yet, including a fiber still switching back after its job
+	std::atomic<int> jobsInFlight;
+
+	std::atomic<uint64_t> jobsExecuted;
+	std::atomic<uint64_t> fiberSwitches;
+	std::atomic<uint64_t> waitsParked;
+	std::atomic<uint64_t> waitsSkipped;
+
+	static void startJob(void* data);
+	static void resumeFiber(void* data);
+	static void fiberMain(void* data);
+
+	void runFiber(FiberSlot* slot);
+	bool park(FiberSlot* slot, Counter* counter);
+	void finishJob(Counter* counter);
+
+public:
+	// fiberCount bounds how many jobs can be running or waiting at once, the ones over it run on the
+	// worker's stack and block it when they wait
+	FiberJobSystem(JobSystem& jobSystem, int fiberCount = DefaultFiberCount, size_t stackSize = DefaultStackSize);
+	// NOTE Waits for the jobs still in flight, they may be touching the fibers even after their counters are done
+	~FiberJobSystem();
+
+	FiberJobSystem(const FiberJobSystem&) = delete;
+	FiberJobSystem& operator=(const FiberJobSystem&) = delete;
+
+	void run(JobFunction function, void* data, Counter* counter);
+
+	// Inside a job this parks the fiber until the counter reaches zero,
+	// anywhere else it runs other jobs until it does, like JobSystem::wait
+	void wait(Counter* counter);
+
+	int getWorkerCount() const { return jobSystem.getWorkerCount(); }
+	Stats getStats() const;
+};
@@ -0,0 +1,141 @@
+#include "FrameBenchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+FrameBenchmark::FrameBenchmark(const Settings& settings) : settings(settings)
+{
+}
+
+void FrameBenchmark::addCpuFrame(double milliseconds)
+{
+	cpuMilliseconds.push_back(milliseconds);
+}
+
+void FrameBenchmark::setRenderTimings(const std::vector<RenderThread::FrameTiming>& timings)
+{
+	renderMilliseconds.clear();
+	swapMilliseconds.clear();
+	gpuMilliseconds.clear();
+	inputLatencyMilliseconds.clear();
+	for (size_t i = settings.warmupFrames; i < timings.size(); i++)
+	{
+		renderMilliseconds.push_back(timings[i].renderMilliseconds);
+		swapMilliseconds.push_back(timings[i].swapMilliseconds);
+		inputLatencyMilliseconds.push_back(timings[i].inputLatencyMilliseconds);
+		if (timings[i].gpuMilliseconds >= 0.0)
+		{
+			gpuMilliseconds.push_back(timings[i].gpuMilliseconds);
+		}
+	}
+}
+
+FrameBenchmark::Summary FrameBenchmark::summarize(std::vector<double> values)
+{
+	Summary summary = {};
+	summary.count = (uint32_t)values.size();
+	if (values.empty())
+	{
+		return summary;
+	}
+
+	std::sort(values.begin(), values.end());
+	double total = 0.0;
+	for (size_t i = 0; i < values.size(); i++)
+	{
+		total += values[i];
+	}
+
+	// Smallest value with at least percent of the values at or below it
+	size_t count = values.size();
+	auto percentile = [&values, count](double percent)
+	{
+		size_t rank = (size_t)std::ceil(percent / 100.0 * count);
+		return values[std::min(std::max(rank, (size_t)1), count) - 1];
+	};
+
+	summary.min = values.front();
+	summary.average = total / count;
+	summary.p50 = percentile(50.0);
+	summary.p95 = percentile(95.0);
+	summary.p99 = percentile(99.0);
+	summary.max = values.back();
+	return summary;
+}
+
+static void printSummaryLine(const char* name, const FrameBenchmark::Summary& summary)
+{
+	if (summary.count == 0)
+	{
+		printf("  %-8s no samples\n", name);
+		return;
+	}
+	printf("  %-8s min %7.3f  avg %7.3f  p50 %7.3f  p95 %7.3f  p99 %7.3f  max %7.3f ms\n",
+		name, summary.min, summary.average, summary.p50, summary.p95, summary.p99, summary.max);
+}
+
+void FrameBenchmark::printSummary() const
+{
+	printf("Frame benchmark: %s, %u frames after %d warmup, %.4f s timestep, %s, %s\n", settings.scene.c_str(),
+		(uint32_t)cpuMilliseconds.size(), settings.warmupFrames, settings.timestepSeconds,
+		settings.vsync ? "vsync" : "no vsync", settings.renderer.c_str());
+	printSummaryLine("CPU", summarize(cpuMilliseconds));
+	printSummaryLine("Render", summarize(renderMilliseconds));
+	printSummaryLine("Swap", summarize(swapMilliseconds));
+	printSummaryLine("GPU", summarize(gpuMilliseconds));
+	printSummaryLine("Latency", summarize(inputLatencyMilliseconds));
+}
+
+static void writeJsonSummary(FILE* file, const char* name, const FrameBenchmark::Summary& summary, bool last)
+{
+	fprintf(file, "\t\t\"%s\": { \"count\": %u, \"min\": %.4f, \"avg\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+		name, summary.count, summary.min, summary.average, summary.p50, summary.p95, summary.p99, summary.max, last ? "" : ",");
+}
+
+// NOTE Only quotes and backslashes get escaped, the strings are renderer names and scene ids
+static std::string escapeJson(const std::string& text)
+{
+	std::string result;
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		if (text[i] == '"' || text[i] == '\\')
+		{
+			result += '\\';
+		}
+		result += text[i];
+	}
+	return result;
+}
+
+bool FrameBenchmark::writeJson(const char* filePath) const
+{
+	FILE* file = fopen(filePath, "w");
+	if (!file)
+	{
+		printf("ERROR: Failed to open %s for writing\n", filePath);
+		return false;
+	}
+
+	fprintf(file, "{\n");
+	fprintf(file, "\t\"scene\": \"%s\",\n", escapeJson(settings.scene).c_str());
+	fprintf(file, "\t\"renderer\": \"%s\",\n", escapeJson(settings.renderer).c_str());
+	fprintf(file, "\t\"width\": %d,\n", settings.width);
+	fprintf(file, "\t\"height\": %d,\n", settings.height);
+	fprintf(file, "\t\"frames\": %u,\n", (uint32_t)cpuMilliseconds.size());
+	fprintf(file, "\t\"warmupFrames\": %d,\n", settings.warmupFrames);
+	fprintf(file, "\t\"timestepSeconds\": %.6f,\n", settings.timestepSeconds);
+	fprintf(file, "\t\"vsync\": %s,\n", settings.vsync ? "true" : "false");
+	fprintf(file, "\t\"headless\": %s,\n", settings.headless ? "true" : "false");
+	fprintf(file, "\t\"milliseconds\": {\n");
+	writeJsonSummary(file, "cpuFrame", summarize(cpuMilliseconds), false);
+	writeJsonSummary(file, "render", summarize(renderMilliseconds), false);
+	writeJsonSummary(file, "swap", summarize(swapMilliseconds), false);
+	writeJsonSummary(file, "gpu", summarize(gpuMilliseconds), false);
+	writeJsonSummary(file, "inputLatency", summarize(inputLatencyMilliseconds), true);
+	fprintf(file, "\t}\n");
+	fprintf(file, "}\n");
+
+	fclose(file);
+	return true;
+}
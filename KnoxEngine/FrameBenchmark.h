@@ -0,0 +1,59 @@
+#pragma once
+
+#include "RenderThread.h"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Frame times of a benchmark run (--frame-benchmark) and their distribution:
+// the frame period measured on the simulation thread, and the replay, swap and GPU time and the
+// input latency of every frame on the render thread. Written as a JSON report for regression tracking
+class FrameBenchmark
+{
+public:
+	struct Summary
+	{
+		uint32_t count;
+		double min;
+		double average;
+		double p50;
+		double p95;
+		double p99;
+		double max;
+	};
+
+	struct Settings
+	{
+		std::string scene;
+		std::string renderer;	// GL_RENDERER
+		int width;
+		int height;
+		int warmupFrames;
+		double timestepSeconds;
+		bool vsync;
+		bool headless;
+	};
+
+private:
+	Settings settings;
+	std::vector<double> cpuMilliseconds;
+	std::vector<double> renderMilliseconds;
+	std::vector<double> swapMilliseconds;
+	std::vector<double> gpuMilliseconds;
+	std::vector<double> inputLatencyMilliseconds;
+
+public:
+	FrameBenchmark(const Settings& settings);
+
+	void addCpuFrame(double milliseconds);
+
+	// Frames before warmupFrames are left out, like the CPU frames the caller doesn't add
+	void setRenderTimings(const std::vector<RenderThread::FrameTiming>& timings);
+
+	// Nearest rank percentiles, all zero for no values
+	static Summary summarize(std::vector<double> values);
+
+	void printSummary() const;
+	bool writeJson(const char* filePath) const;
+};
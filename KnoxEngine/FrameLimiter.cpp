@@ -0,0 +1,117 @@
+#include "FrameLimiter.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+static const double InitialSpinSeconds = 0.002;
+static const double MinSpinSeconds = 0.0002;
+static const double SpinDecay = 0.98;		// per frame while sleeps wake up on time
+static const double SpinHeadroom = 1.25;	// over the latest oversleep
+
+static double getSeconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+FrameLimiter::FrameLimiter(double framesPerSecond)
+	: periodSeconds(framesPerSecond > 0.0 ? 1.0 / framesPerSecond : 0.0), nextFrameSeconds(0.0),
+	spinSeconds(InitialSpinSeconds), started(false), timer(NULL), stats()
+{
+#ifdef _WIN32
+	// NOTE Sleep rounds up to the timer resolution (15.6 ms by default), the high resolution
+	// timer doesn't but needs Windows 10 1803. Without it the spin just ends up longer
+	if (periodSeconds > 0.0)
+	{
+		timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	}
+#endif
+}
+
+FrameLimiter::~FrameLimiter()
+{
+#ifdef _WIN32
+	if (timer)
+	{
+		CloseHandle((HANDLE)timer);
+	}
+#endif
+}
+
+void FrameLimiter::sleep(double seconds)
+{
+#ifdef _WIN32
+	if (timer)
+	{
+		LARGE_INTEGER dueTime;
+		dueTime.QuadPart = -(LONGLONG)(seconds * 1e7);	// relative, in 100 ns units
+		if (SetWaitableTimer((HANDLE)timer, &dueTime, 0, NULL, NULL, FALSE))
+		{
+			WaitForSingleObject((HANDLE)timer, INFINITE);
+			return;
+		}
+	}
+#endif
+	std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+}
+
+void FrameLimiter::wait()
+{
+	if (periodSeconds <= 0.0)
+	{
+		return;
+	}
+
+	double now = getSeconds();
+	stats.frames++;
+	if (!started || now >= nextFrameSeconds)
+	{
+		if (started)
+		{
+			stats.lateFrames++;
+		}
+		started = true;
+		nextFrameSeconds = now + periodSeconds;
+		return;
+	}
+
+	double remaining = nextFrameSeconds - now;
+	if (remaining > spinSeconds)
+	{
+		double requested = remaining - spinSeconds;
+		sleep(requested);
+		double woken = getSeconds();
+		stats.sleepMilliseconds += (woken - now) * 1000.0;
+
+		double oversleep = (woken - now) - requested;
+		spinSeconds = std::max(std::max(oversleep * SpinHeadroom, spinSeconds * SpinDecay), MinSpinSeconds);
+		spinSeconds = std::min(spinSeconds, periodSeconds);
+		now = woken;
+	}
+
+	// NOTE Yielding instead of pausing, so a spinning main thread doesn't hold up the render thread
+	// on machines with few cores
+	double spinStart = now;
+	while (now < nextFrameSeconds)
+	{
+		std::this_thread::yield();
+		now = getSeconds();
+	}
+	stats.spinMilliseconds += (now - spinStart) * 1000.0;
+	stats.maxOvershootMilliseconds = std::max(stats.maxOvershootMilliseconds, (now - nextFrameSeconds) * 1000.0);
+
+	nextFrameSeconds += periodSeconds;
+}
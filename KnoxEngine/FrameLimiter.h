@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+
+// Paces a loop to a target frame rate. Waiting sleeps for most of the time left in the frame and
+// spins (yielding) for the rest, since a sleep can wake up late by up to a scheduler tick.
+// The part left to spin adapts to how late sleeps actually wake up: it jumps up on a late wake-up
+// and shrinks slowly while they're on time, so the CPU spins only as long as it has to.
+//
+// Frames start on a fixed schedule. A frame that runs over starts the next one right away and
+// moves the schedule, instead of rushing the following frames to catch up
+class FrameLimiter
+{
+public:
+	struct Stats
+	{
+		uint32_t frames;
+		uint32_t lateFrames;			// ran past their slot, so there was no wait
+		double sleepMilliseconds;
+		double spinMilliseconds;
+		double maxOvershootMilliseconds;	// worst wake-up after the start of a frame
+	};
+
+private:
+	double periodSeconds;	// 0 when not limiting
+	double nextFrameSeconds;
+	double spinSeconds;		// left before the deadline to spin instead of sleep
+	bool started;
+	void* timer;			// high resolution waitable timer on Windows
+	Stats stats;
+
+	void sleep(double seconds);
+
+public:
+	// A frame rate of 0 or less doesn't limit, wait returns right away
+	FrameLimiter(double framesPerSecond);
+	~FrameLimiter();
+
+	FrameLimiter(const FrameLimiter&) = delete;
+	FrameLimiter& operator=(const FrameLimiter&) = delete;
+
+	// Waits for the start of the next frame, call it once at the top of every frame
+	void wait();
+
+	bool isEnabled() const { return periodSeconds > 0.0; }
+	double getFrameRate() const { return periodSeconds > 0.0 ? 1.0 / periodSeconds : 0.0; }
+	double getSpinMilliseconds() const { return spinSeconds * 1000.0; }
+	Stats getStats() const { return stats; }
+};
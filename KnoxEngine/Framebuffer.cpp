@@ -0,0 +1,71 @@
+#include "Framebuffer.h"
+#include "MemoryTracker.h"
+
+#include <cstdio>
+
+Framebuffer::Framebuffer() : Id(0), colorTexture(0), depthBuffer(0), width(0), height(0)
+{
+}
+
+bool Framebuffer::create(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+
+	glGenTextures(1, &colorTexture);
+	glBindTexture(GL_TEXTURE_2D, colorTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &Id);
+	glBindFramebuffer(GL_FRAMEBUFFER, Id);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		printf("ERROR: Framebuffer %dx%d is incomplete (0x%X)\n", width, height, status);
+		return false;
+	}
+	glViewport(0, 0, width, height);
+
+	trackAllocation("GPU", "Framebuffer", (size_t)width * height * 8);
+	return true;
+}
+
+void Framebuffer::destroy()
+{
+	if (Id)
+	{
+		trackFree("GPU", "Framebuffer", (size_t)width * height * 8);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &Id);
+	glDeleteRenderbuffers(1, &depthBuffer);
+	glDeleteTextures(1, &colorTexture);
+	Id = 0;
+	colorTexture = 0;
+	depthBuffer = 0;
+}
+
+void Framebuffer::bind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, Id);
+	glViewport(0, 0, width, height);
+}
+
+void Framebuffer::readPixels(std::vector<unsigned char>& pixels)
+{
+	pixels.resize((size_t)width * height * 4);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, Id);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <vector>
+
+// Offscreen render target: RGBA8 color texture and a 24 bit depth renderbuffer.
+// What a headless context renders into, since it has no default framebuffer
+class Framebuffer
+{
+public:
+	unsigned int Id;
+	unsigned int colorTexture;
+	unsigned int depthBuffer;
+
+private:
+	int width;
+	int height;
+
+public:
+	Framebuffer();
+
+	// Leaves the framebuffer bound, false (with an error printed) if it isn't complete
+	bool create(int width, int height);
+
+	// NOTE Must be called while the OpenGL context is still alive
+	void destroy();
+
+	// Binds it for drawing and reading, with the viewport covering all of it
+	void bind();
+
+	// RGBA8 rows bottom to top like glReadPixels, stalls until rendering is done
+	void readPixels(std::vector<unsigned char>& pixels);
+
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+};
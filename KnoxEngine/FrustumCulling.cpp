@@ -0,0 +1,359 @@
+#include "FrustumCulling.h"
+#include "LinearArena.h"
+
+#include <cstring>
+
+// Objects per job, big enough that scheduling is noise next to the plane tests
+static const uint32_t CullBatchSize = 16 * 1024;
+
+Frustum extractFrustum(const mat4& viewProjection)
+{
+	// Rows of the matrix, clip = M * p so every clip plane is a combination of them
+	vec4 rows[4];
+	for (int row = 0; row < 4; row++)
+	{
+		rows[row] = vec4(viewProjection.at(row, 0), viewProjection.at(row, 1), viewProjection.at(row, 2), viewProjection.at(row, 3));
+	}
+
+	Frustum frustum;
+	frustum.planes[0] = rows[3] + rows[0];
+	frustum.planes[1] = rows[3] - rows[0];
+	frustum.planes[2] = rows[3] + rows[1];
+	frustum.planes[3] = rows[3] - rows[1];
+	frustum.planes[4] = rows[3] + rows[2];
+	frustum.planes[5] = rows[3] - rows[2];
+	for (int i = 0; i < 6; i++)
+	{
+		frustum.planes[i] = frustum.planes[i] * (1.0f / length(frustum.planes[i].xyz()));
+	}
+	return frustum;
+}
+
+// Appends first + lane for every lane set in mask, without branching on the mask:
+// every lane is written and the count only moves past the visible ones
+static inline uint32_t appendVisible(uint32_t* visible, uint32_t count, uint32_t first, int mask, int width)
+{
+	for (int lane = 0; lane < width; lane++)
+	{
+		visible[count] = first + lane;
+		count += (mask >> lane) & 1;
+	}
+	return count;
+}
+
+uint32_t cullBoxesScalar(const Frustum& frustum, const BoxesSoA& boxes, uint32_t begin, uint32_t end, uint32_t* visible)
+{
+	uint32_t count = 0;
+	for (uint32_t i = begin; i < end; i++)
+	{
+		bool inside = true;
+		for (int p = 0; p < 6; p++)
+		{
+			const vec4& plane = frustum.planes[p];
+			float distance = plane.x * boxes.centerX[i] + plane.y * boxes.centerY[i] + plane.z * boxes.centerZ[i] + plane.w;
+			float radius = std::fabs(plane.x) * boxes.extentX[i] + std::fabs(plane.y) * boxes.extentY[i] + std::fabs(plane.z) * boxes.extentZ[i];
+			inside = inside && distance + radius >= 0.0f;
+		}
+		visible[count] = i;
+		count += inside;
+	}
+	return count;
+}
+
+uint32_t cullSpheresScalar(const Frustum& frustum, const SpheresSoA& spheres, uint32_t begin, uint32_t end, uint32_t* visible)
+{
+	uint32_t count = 0;
+	for (uint32_t i = begin; i < end; i++)
+	{
+		bool inside = true;
+		for (int p = 0; p < 6; p++)
+		{
+			const vec4& plane = frustum.planes[p];
+			float distance = plane.x * spheres.centerX[i] + plane.y * spheres.centerY[i] + plane.z * spheres.centerZ[i] + plane.w;
+			inside = inside && distance + spheres.radius[i] >= 0.0f;
+		}
+		visible[count] = i;
+		count += inside;
+	}
+	return count;
+}
+
+#if KNOX_MATH_AVX
+static inline __m256 multiplyAdd8(__m256 a, __m256 b, __m256 c)
+{
+#if KNOX_MATH_FMA
+	return _mm256_fmadd_ps(a, b, c);
+#else
+	return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+#endif
+
+uint32_t cullBoxes(const Frustum& frustum, const BoxesSoA& boxes, uint32_t begin, uint32_t end, uint32_t* visible)
+{
+	uint32_t i = begin;
+	uint32_t count = 0;
+
+#if KNOX_MATH_AVX
+	{
+		// Box radius along a plane normal is dot(|normal|, extents)
+		__m256 normalX[6], normalY[6], normalZ[6], planeW[6], absX[6], absY[6], absZ[6];
+		for (int p = 0; p < 6; p++)
+		{
+			const vec4& plane = frustum.planes[p];
+			normalX[p] = _mm256_set1_ps(plane.x);
+			normalY[p] = _mm256_set1_ps(plane.y);
+			normalZ[p] = _mm256_set1_ps(plane.z);
+			planeW[p] = _mm256_set1_ps(plane.w);
+			absX[p] = _mm256_set1_ps(std::fabs(plane.x));
+			absY[p] = _mm256_set1_ps(std::fabs(plane.y));
+			absZ[p] = _mm256_set1_ps(std::fabs(plane.z));
+		}
+
+		for (; i + 8 <= end; i += 8)
+		{
+			__m256 x = _mm256_loadu_ps(boxes.centerX + i);
+			__m256 y = _mm256_loadu_ps(boxes.centerY + i);
+			__m256 z = _mm256_loadu_ps(boxes.centerZ + i);
+			__m256 extentX = _mm256_loadu_ps(boxes.extentX + i);
+			__m256 extentY = _mm256_loadu_ps(boxes.extentY + i);
+			__m256 extentZ = _mm256_loadu_ps(boxes.extentZ + i);
+
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int p = 0; p < 6; p++)
+			{
+				__m256 distance = multiplyAdd8(normalX[p], x, multiplyAdd8(normalY[p], y, multiplyAdd8(normalZ[p], z, planeW[p])));
+				__m256 reach = multiplyAdd8(absX[p], extentX, multiplyAdd8(absY[p], extentY, multiplyAdd8(absZ[p], extentZ, distance)));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(reach, _mm256_setzero_ps(), _CMP_GE_OQ));
+			}
+			count = appendVisible(visible, count, i, _mm256_movemask_ps(inside), 8);
+		}
+	}
+#endif
+
+#if KNOX_MATH_SSE
+	{
+		__m128 normalX[6], normalY[6], normalZ[6], planeW[6], absX[6], absY[6], absZ[6];
+		for (int p = 0; p < 6; p++)
+		{
+			const vec4& plane = frustum.planes[p];
+			normalX[p] = _mm_set1_ps(plane.x);
+			normalY[p] = _mm_set1_ps(plane.y);
+			normalZ[p] = _mm_set1_ps(plane.z);
+			planeW[p] = _mm_set1_ps(plane.w);
+			absX[p] = _mm_set1_ps(std::fabs(plane.x));
+			absY[p] = _mm_set1_ps(std::fabs(plane.y));
+			absZ[p] = _mm_set1_ps(std::fabs(plane.z));
+		}
+
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(boxes.centerX + i);
+			__m128 y = _mm_loadu_ps(boxes.centerY + i);
+			__m128 z = _mm_loadu_ps(boxes.centerZ + i);
+			__m128 extentX = _mm_loadu_ps(boxes.extentX + i);
+			__m128 extentY = _mm_loadu_ps(boxes.extentY + i);
+			__m128 extentZ = _mm_loadu_ps(boxes.extentZ + i);
+
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < 6; p++)
+			{
+				__m128 distance = multiplyAdd(normalX[p], x, multiplyAdd(normalY[p], y, multiplyAdd(normalZ[p], z, planeW[p])));
+				__m128 reach = multiplyAdd(absX[p], extentX, multiplyAdd(absY[p], extentY, multiplyAdd(absZ[p], extentZ, distance)));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(reach, _mm_setzero_ps()));
+			}
+			count = appendVisible(visible, count, i, _mm_movemask_ps(inside), 4);
+		}
+	}
+#elif KNOX_MATH_NEON
+	{
+		for (; i + 4 <= end; i += 4)
+		{
+			float32x4_t x = vld1q_f32(boxes.centerX + i);
+			float32x4_t y = vld1q_f32(boxes.centerY + i);
+			float32x4_t z = vld1q_f32(boxes.centerZ + i);
+			float32x4_t extentX = vld1q_f32(boxes.extentX + i);
+			float32x4_t extentY = vld1q_f32(boxes.extentY + i);
+			float32x4_t extentZ = vld1q_f32(boxes.extentZ + i);
+
+			uint32x4_t inside = vdupq_n_u32(0xFFFFFFFF);
+			for (int p = 0; p < 6; p++)
+			{
+				const vec4& plane = frustum.planes[p];
+				float32x4_t distance = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(plane.w), z, plane.z), y, plane.y), x, plane.x);
+				float32x4_t reach = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(distance, extentZ, std::fabs(plane.z)), extentY, std::fabs(plane.y)), extentX, std::fabs(plane.x));
+				inside = vandq_u32(inside, vcgeq_f32(reach, vdupq_n_f32(0.0f)));
+			}
+			int mask = (vgetq_lane_u32(inside, 0) & 1) | (vgetq_lane_u32(inside, 1) & 2) | (vgetq_lane_u32(inside, 2) & 4) | (vgetq_lane_u32(inside, 3) & 8);
+			count = appendVisible(visible, count, i, mask, 4);
+		}
+	}
+#endif
+
+	if (i < end)
+	{
+		count += cullBoxesScalar(frustum, boxes, i, end, visible + count);
+	}
+	return count;
+}
+
+uint32_t cullSpheres(const Frustum& frustum, const SpheresSoA& spheres, uint32_t begin, uint32_t end, uint32_t* visible)
+{
+	uint32_t i = begin;
+	uint32_t count = 0;
+
+#if KNOX_MATH_AVX
+	{
+		__m256 normalX[6], normalY[6], normalZ[6], planeW[6];
+		for (int p = 0; p < 6; p++)
+		{
+			const vec4& plane = frustum.planes[p];
+			normalX[p] = _mm256_set1_ps(plane.x);
+			normalY[p] = _mm256_set1_ps(plane.y);
+			normalZ[p] = _mm256_set1_ps(plane.z);
+			planeW[p] = _mm256_set1_ps(plane.w);
+		}
+
+		for (; i + 8 <= end; i += 8)
+		{
+			__m256 x = _mm256_loadu_ps(spheres.centerX + i);
+			__m256 y = _mm256_loadu_ps(spheres.centerY + i);
+			__m256 z = _mm256_loadu_ps(spheres.centerZ + i);
+			__m256 radius = _mm256_loadu_ps(spheres.radius + i);
+
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int p = 0; p < 6; p++)
+			{
+				__m256 reach = multiplyAdd8(normalX[p], x, multiplyAdd8(normalY[p], y, multiplyAdd8(normalZ[p], z, _mm256_add_ps(planeW[p], radius))));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(reach, _mm256_setzero_ps(), _CMP_GE_OQ));
+			}
+			count = appendVisible(visible, count, i, _mm256_movemask_ps(inside), 8);
+		}
+	}
+#endif
+
+#if KNOX_MATH_SSE
+	{
+		__m128 normalX[6], normalY[6], normalZ[6], planeW[6];
+		for (int p = 0; p < 6; p++)
+		{
+			const vec4& plane = frustum.planes[p];
+			normalX[p] = _mm_set1_ps(plane.x);
+			normalY[p] = _mm_set1_ps(plane.y);
+			normalZ[p] = _mm_set1_ps(plane.z);
+			planeW[p] = _mm_set1_ps(plane.w);
+		}
+
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(spheres.centerX + i);
+			__m128 y = _mm_loadu_ps(spheres.centerY + i);
+			__m128 z = _mm_loadu_ps(spheres.centerZ + i);
+			__m128 radius = _mm_loadu_ps(spheres.radius + i);
+
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < 6; p++)
+			{
+				__m128 reach = multiplyAdd(normalX[p], x, multiplyAdd(normalY[p], y, multiplyAdd(normalZ[p], z, _mm_add_ps(planeW[p], radius))));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(reach, _mm_setzero_ps()));
+			}
+			count = appendVisible(visible, count, i, _mm_movemask_ps(inside), 4);
+		}
+	}
+#elif KNOX_MATH_NEON
+	{
+		for (; i + 4 <= end; i += 4)
+		{
+			float32x4_t x = vld1q_f32(spheres.centerX + i);
+			float32x4_t y = vld1q_f32(spheres.centerY + i);
+			float32x4_t z = vld1q_f32(spheres.centerZ + i);
+			float32x4_t radius = vld1q_f32(spheres.radius + i);
+
+			uint32x4_t inside = vdupq_n_u32(0xFFFFFFFF);
+			for (int p = 0; p < 6; p++)
+			{
+				const vec4& plane = frustum.planes[p];
+				float32x4_t reach = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vaddq_f32(vdupq_n_f32(plane.w), radius), z, plane.z), y, plane.y), x, plane.x);
+				inside = vandq_u32(inside, vcgeq_f32(reach, vdupq_n_f32(0.0f)));
+			}
+			int mask = (vgetq_lane_u32(inside, 0) & 1) | (vgetq_lane_u32(inside, 1) & 2) | (vgetq_lane_u32(inside, 2) & 4) | (vgetq_lane_u32(inside, 3) & 8);
+			count = appendVisible(visible, count, i, mask, 4);
+		}
+	}
+#endif
+
+	if (i < end)
+	{
+		count += cullSpheresScalar(frustum, spheres, i, end, visible + count);
+	}
+	return count;
+}
+
+// Every batch culls into its own part of visible, then the parts are packed together in order
+template<typename Cull>
+static uint32_t cullParallel(JobSystem& jobSystem, uint32_t count, uint32_t* visible, const Cull& cull)
+{
+	if (count <= CullBatchSize)
+	{
+		return cull(0, count, visible);
+	}
+
+	ScratchScope scratch;
+	uint32_t batchCount = (count + CullBatchSize - 1) / CullBatchSize;
+	uint32_t* batchVisibleCounts = scratch.getArena().allocateArray<uint32_t>(batchCount);
+
+	jobSystem.parallelFor(count, CullBatchSize, [visible, batchVisibleCounts, &cull](uint32_t begin, uint32_t end)
+	{
+		batchVisibleCounts[begin / CullBatchSize] = cull(begin, end, visible + begin);
+	});
+
+	uint32_t visibleCount = batchVisibleCounts[0];
+	for (uint32_t batch = 1; batch < batchCount; batch++)
+	{
+		memmove(visible + visibleCount, visible + batch * CullBatchSize, batchVisibleCounts[batch] * sizeof(uint32_t));
+		visibleCount += batchVisibleCounts[batch];
+	}
+	return visibleCount;
+}
+
+uint32_t cullBoxesParallel(JobSystem& jobSystem, const Frustum& frustum, const BoxesSoA& boxes, uint32_t count, uint32_t* visible)
+{
+	return cullParallel(jobSystem, count, visible, [&frustum, &boxes](uint32_t begin, uint32_t end, uint32_t* batchVisible)
+	{
+		return cullBoxes(frustum, boxes, begin, end, batchVisible);
+	});
+}
+
+uint32_t cullSpheresParallel(JobSystem& jobSystem, const Frustum& frustum, const SpheresSoA& spheres, uint32_t count, uint32_t* visible)
+{
+	return cullParallel(jobSystem, count, visible, [&frustum, &spheres](uint32_t begin, uint32_t end, uint32_t* batchVisible)
+	{
+		return cullSpheres(frustum, spheres, begin, end, batchVisible);
+	});
+}
+
+void BoxBuffer::clear()
+{
+	centerX.clear();
+	centerY.clear();
+	centerZ.clear();
+	extentX.clear();
+	extentY.clear();
+	extentZ.clear();
+}
+
+void BoxBuffer::add(const vec3& center, const vec3& extents)
+{
+	centerX.push_back(center.x);
+	centerY.push_back(center.y);
+	centerZ.push_back(center.z);
+	extentX.push_back(extents.x);
+	extentY.push_back(extents.y);
+	extentZ.push_back(extents.z);
+}
+
+BoxesSoA BoxBuffer::getBoxes() const
+{
+	BoxesSoA boxes = { centerX.data(), centerY.data(), centerZ.data(), extentX.data(), extentY.data(), extentZ.data() };
+	return boxes;
+}
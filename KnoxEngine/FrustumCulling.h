@@ -0,0 +1,68 @@
+#pragma once
+
+#include "MathTypes.h"
+#include "JobSystem.h"
+
+#include <vector>
+#include <cstdint>
+
+// The six planes of a view frustum: left, right, bottom, top, near, far.
+// Normals point inside and are normalized, a point p is inside a plane when dot(normal, p) + w >= 0
+struct Frustum
+{
+	vec4 planes[6];
+};
+
+// Planes of the clip volume of an OpenGL view projection matrix (Gribb/Hartmann).
+// With the identity matrix that's the [-1, 1] clip cube
+Frustum extractFrustum(const mat4& viewProjection);
+
+// Axis aligned boxes as center and half extents, structure of arrays
+struct BoxesSoA
+{
+	const float* centerX;
+	const float* centerY;
+	const float* centerZ;
+	const float* extentX;
+	const float* extentY;
+	const float* extentZ;
+};
+
+struct SpheresSoA
+{
+	const float* centerX;
+	const float* centerY;
+	const float* centerZ;
+	const float* radius;
+};
+
+// Writes the indices of the objects in [begin, end) that intersect the frustum to visible
+// (in order, packed at the front) and returns how many there are.
+// Conservative like any plane test: objects near a frustum corner can pass without being visible.
+// One plane test covers 8 (AVX) or 4 (SSE/NEON) objects, the remainder runs through the scalar code
+// NOTE visible needs room for end - begin indices, all of them can be written to
+uint32_t cullBoxes(const Frustum& frustum, const BoxesSoA& boxes, uint32_t begin, uint32_t end, uint32_t* visible);
+uint32_t cullSpheres(const Frustum& frustum, const SpheresSoA& spheres, uint32_t begin, uint32_t end, uint32_t* visible);
+
+uint32_t cullBoxesScalar(const Frustum& frustum, const BoxesSoA& boxes, uint32_t begin, uint32_t end, uint32_t* visible);
+uint32_t cullSpheresScalar(const Frustum& frustum, const SpheresSoA& spheres, uint32_t begin, uint32_t end, uint32_t* visible);
+
+// Same over [0, count), split across the job system. The visible list is the same as the
+// single threaded one, in the same order
+uint32_t cullBoxesParallel(JobSystem& jobSystem, const Frustum& frustum, const BoxesSoA& boxes, uint32_t count, uint32_t* visible);
+uint32_t cullSpheresParallel(JobSystem& jobSystem, const Frustum& frustum, const SpheresSoA& spheres, uint32_t count, uint32_t* visible);
+
+// Boxes collected into structure of arrays storage, to build the culling input of a frame
+class BoxBuffer
+{
+private:
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+
+public:
+	void clear();
+	void add(const vec3& center, const vec3& extents);
+
+	uint32_t size() const { return (uint32_t)centerX.size(); }
+	BoxesSoA getBoxes() const;
+};
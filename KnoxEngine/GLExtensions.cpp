@@ -0,0 +1,52 @@
+#include "GLExtensions.h"
+
+#include <iostream>
+#include <cstring>
+
+PFNGLBUFFERSTORAGEPROC knox_glBufferStorage = NULL;
+PFNGLMULTIDRAWELEMENTSINDIRECTPROC knox_glMultiDrawElementsIndirect = NULL;
+
+GLExtensionSupport GLExtensions = {};
+
+bool isGLExtensionSupported(const char* extensionName)
+{
+	GLint extensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for (GLint i = 0; i < extensionCount; i++)
+	{
+		const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (extension && strcmp(extension, extensionName) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool isGLVersionAtLeast(int major, int minor)
+{
+	GLint contextMajor = 0, contextMinor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &contextMajor);
+	glGetIntegerv(GL_MINOR_VERSION, &contextMinor);
+	return contextMajor > major || (contextMajor == major && contextMinor >= minor);
+}
+
+void loadGLExtensions(GLADloadproc load)
+{
+	// NOTE Some drivers return non-NULL pointers for anything, so the extension string is checked too
+	if (isGLVersionAtLeast(4, 4) || isGLExtensionSupported("GL_ARB_buffer_storage"))
+	{
+		knox_glBufferStorage = (PFNGLBUFFERSTORAGEPROC)load("glBufferStorage");
+	}
+	GLExtensions.bufferStorage = knox_glBufferStorage != NULL;
+
+	if (isGLVersionAtLeast(4, 3) ||
+		(isGLExtensionSupported("GL_ARB_multi_draw_indirect") && isGLExtensionSupported("GL_ARB_base_instance")))
+	{
+		knox_glMultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
+	}
+	GLExtensions.multiDrawIndirect = knox_glMultiDrawElementsIndirect != NULL;
+
+	printf("GL_ARB_buffer_storage: %s\n", GLExtensions.bufferStorage ? "supported" : "not supported");
+	printf("GL_ARB_multi_draw_indirect: %s\n", GLExtensions.multiDrawIndirect ? "supported" : "not supported");
+}
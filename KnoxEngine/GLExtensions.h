@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// glad was generated for the OpenGL 3.3 core profile with no extensions,
+// entry points from newer versions/extensions are loaded here by hand
+
+#ifndef GL_ARB_buffer_storage
+#define GL_ARB_buffer_storage 1
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+#endif
+
+#ifndef GL_ARB_draw_indirect
+#define GL_ARB_draw_indirect 1
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#define GL_DRAW_INDIRECT_BUFFER_BINDING 0x8F43
+#endif
+
+#ifndef GL_ARB_multi_draw_indirect
+#define GL_ARB_multi_draw_indirect 1
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+#endif
+
+extern PFNGLBUFFERSTORAGEPROC knox_glBufferStorage;
+#define glBufferStorage knox_glBufferStorage
+extern PFNGLMULTIDRAWELEMENTSINDIRECTPROC knox_glMultiDrawElementsIndirect;
+#define glMultiDrawElementsIndirect knox_glMultiDrawElementsIndirect
+
+struct GLExtensionSupport
+{
+	bool bufferStorage;
+	// NOTE Also implies base instance support (GL 4.2), which indirect commands need for per-draw data
+	bool multiDrawIndirect;
+};
+
+extern GLExtensionSupport GLExtensions;
+
+// NOTE Must be called after gladLoadGLLoader, with the same loader function
+void loadGLExtensions(GLADloadproc load);
+bool isGLExtensionSupported(const char* extensionName);
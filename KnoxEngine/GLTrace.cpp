@@ -0,0 +1,1853 @@
+#include "GLTrace.h"
+#include "GLExtensions.h"
+
+#include <unordered_map>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+// The calls the engine makes, every one has a wrapper and a replay case below.
+// NOTE Calls are written by their position in this list, append new ones at the end and bump TraceVersion
+#define TRACED_GL_FUNCTIONS(X) \
+	X(ActiveTexture) X(AttachShader) X(BeginQuery) X(BindBuffer) X(BindFramebuffer) X(BindRenderbuffer) \
+	X(BindTexture) X(BindVertexArray) X(BlendFunc) X(BufferData) X(BufferSubData) X(CheckFramebufferStatus) \
+	X(Clear) X(ClearColor) X(ClientWaitSync) X(CompileShader) X(CopyBufferSubData) X(CreateProgram) \
+	X(CreateShader) X(DeleteBuffers) X(DeleteFramebuffers) X(DeleteProgram) X(DeleteQueries) \
+	X(DeleteRenderbuffers) X(DeleteShader) X(DeleteSync) X(DeleteTextures) X(DeleteVertexArrays) X(DepthMask) \
+	X(Disable) X(DisableVertexAttribArray) X(DrawArrays) X(DrawElementsBaseVertex) \
+	X(DrawElementsInstancedBaseVertex) X(Enable) X(EnableVertexAttribArray) X(EndQuery) X(FenceSync) X(Finish) \
+	X(Flush) X(FlushMappedBufferRange) X(FramebufferRenderbuffer) X(FramebufferTexture2D) X(GenBuffers) \
+	X(GenFramebuffers) X(GenQueries) X(GenRenderbuffers) X(GenTextures) X(GenVertexArrays) X(GenerateMipmap) \
+	X(GetIntegerv) X(GetProgramInfoLog) X(GetProgramiv) X(GetQueryObjectiv) X(GetQueryObjectui64v) \
+	X(GetShaderInfoLog) X(GetShaderiv) X(GetString) X(GetStringi) X(GetUniformLocation) X(LinkProgram) \
+	X(MapBufferRange) X(PixelStorei) X(PolygonMode) X(QueryCounter) X(ReadPixels) X(RenderbufferStorage) \
+	X(ShaderSource) X(TexImage2D) X(TexParameteri) X(Uniform1f) X(Uniform1i) X(Uniform2f) X(Uniform4f) \
+	X(UnmapBuffer) X(UseProgram) X(VertexAttrib4f) X(VertexAttrib4fv) X(VertexAttribDivisor) \
+	X(VertexAttribPointer) X(Viewport)
+
+enum TraceCall
+{
+#define TRACE_CALL_ID(name) Call##name,
+	TRACED_GL_FUNCTIONS(TRACE_CALL_ID)
+#undef TRACE_CALL_ID
+	CallFrameMarker
+};
+
+static const char TraceMagic[8] = { 'K', 'N', 'O', 'X', 'G', 'L', 'T', 'R' };
+static const uint32_t TraceVersion = 1;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double millisecondsBetween(Clock::time_point start, Clock::time_point end)
+{
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Bytes glTexImage2D reads or glReadPixels writes, with the pixel store alignment
+static size_t getImageSize(GLsizei width, GLsizei height, GLenum format, GLenum type, GLint alignment)
+{
+	if (width <= 0 || height <= 0)
+	{
+		return 0;
+	}
+
+	size_t channels = 4;
+	switch (format)
+	{
+	case GL_RED:
+	case GL_DEPTH_COMPONENT:
+	case GL_STENCIL_INDEX:
+		channels = 1;
+		break;
+	case GL_RG:
+		channels = 2;
+		break;
+	case GL_RGB:
+	case GL_BGR:
+		channels = 3;
+		break;
+	}
+
+	size_t channelBytes = 1;
+	switch (type)
+	{
+	case GL_SHORT:
+	case GL_UNSIGNED_SHORT:
+	case GL_HALF_FLOAT:
+		channelBytes = 2;
+		break;
+	case GL_INT:
+	case GL_UNSIGNED_INT:
+	case GL_FLOAT:
+		channelBytes = 4;
+		break;
+	case GL_UNSIGNED_INT_24_8:
+		channels = 1;
+		channelBytes = 4;
+		break;
+	}
+
+	// NOTE The last row isn't padded, GL doesn't read past its last pixel
+	size_t pixelBytes = channels * channelBytes;
+	size_t rowBytes = ((size_t)width * pixelBytes + alignment - 1) / alignment * alignment;
+	return rowBytes * (height - 1) + (size_t)width * pixelBytes;
+}
+
+static GLenum getBufferBinding(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER:
+		return GL_ARRAY_BUFFER_BINDING;
+	case GL_ELEMENT_ARRAY_BUFFER:
+		return GL_ELEMENT_ARRAY_BUFFER_BINDING;
+	case GL_PIXEL_PACK_BUFFER:
+		return GL_PIXEL_PACK_BUFFER_BINDING;
+	case GL_PIXEL_UNPACK_BUFFER:
+		return GL_PIXEL_UNPACK_BUFFER_BINDING;
+	case GL_UNIFORM_BUFFER:
+		return GL_UNIFORM_BUFFER_BINDING;
+	case GL_DRAW_INDIRECT_BUFFER:
+		return GL_DRAW_INDIRECT_BUFFER_BINDING;
+	default:
+		// GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER and GL_TEXTURE_BUFFER are their own binding
+		return target;
+	}
+}
+
+
+////////////////////////////////////
+//
+// Capture
+//
+#define TRACE_REAL_POINTER(name) static decltype(glad_gl##name) real_gl##name;
+TRACED_GL_FUNCTIONS(TRACE_REAL_POINTER)
+#undef TRACE_REAL_POINTER
+
+static const size_t TraceFlushSize = 1024 * 1024;
+
+// NOTE No lock: the context is current on one thread at a time, so the calls come one after the other
+static bool capturing;
+static FILE* traceFile;
+static std::vector<unsigned char> traceBuffer;
+static GLCaptureStats captureStats;
+static GLExtensionSupport capturedExtensions;
+static GLuint capturedDefaultFramebuffer;
+
+// State the size of the memory a call reads depends on
+static GLint unpackAlignment = 4;
+static GLint packAlignment = 4;
+
+// Ranges mapped for writing, by buffer
+struct MappedRange
+{
+	GLuint buffer;
+	const unsigned char* pointer;
+	GLsizeiptr length;
+	GLbitfield access;
+};
+static std::vector<MappedRange> mappedRanges;
+
+static void flushTrace()
+{
+	if (!traceBuffer.empty())
+	{
+		fwrite(traceBuffer.data(), 1, traceBuffer.size(), traceFile);
+		captureStats.bytes += traceBuffer.size();
+		traceBuffer.clear();
+	}
+}
+
+static void write(const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	traceBuffer.insert(traceBuffer.end(), bytes, bytes + size);
+	if (traceBuffer.size() >= TraceFlushSize)
+	{
+		flushTrace();
+	}
+}
+
+template <typename T>
+static void write(T value)
+{
+	write(&value, sizeof(T));
+}
+
+static void writeCall(TraceCall call)
+{
+	write((uint16_t)call);
+	captureStats.calls++;
+}
+
+// A size of 0 stands for a NULL pointer
+static void writeBlob(const void* data, uint64_t size)
+{
+	write(size);
+	if (size > 0)
+	{
+		write(data, (size_t)size);
+	}
+}
+
+static void writeNames(GLsizei count, const GLuint* names)
+{
+	write(count);
+	write(names, count * sizeof(GLuint));
+}
+
+static GLuint getBoundBuffer(GLenum target)
+{
+	GLint buffer = 0;
+	real_glGetIntegerv(getBufferBinding(target), &buffer);
+	return (GLuint)buffer;
+}
+
+static MappedRange* findMappedRange(GLuint buffer)
+{
+	for (size_t i = 0; i < mappedRanges.size(); i++)
+	{
+		if (mappedRanges[i].buffer == buffer)
+		{
+			return &mappedRanges[i];
+		}
+	}
+	return NULL;
+}
+
+static void APIENTRY trace_glActiveTexture(GLenum texture)
+{
+	writeCall(CallActiveTexture);
+	write(texture);
+	real_glActiveTexture(texture);
+}
+
+static void APIENTRY trace_glAttachShader(GLuint program, GLuint shader)
+{
+	writeCall(CallAttachShader);
+	write(program);
+	write(shader);
+	real_glAttachShader(program, shader);
+}
+
+static void APIENTRY trace_glBeginQuery(GLenum target, GLuint id)
+{
+	writeCall(CallBeginQuery);
+	write(target);
+	write(id);
+	real_glBeginQuery(target, id);
+}
+
+static void APIENTRY trace_glBindBuffer(GLenum target, GLuint buffer)
+{
+	writeCall(CallBindBuffer);
+	write(target);
+	write(buffer);
+	real_glBindBuffer(target, buffer);
+}
+
+static void APIENTRY trace_glBindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	writeCall(CallBindFramebuffer);
+	write(target);
+	write(framebuffer == capturedDefaultFramebuffer ? 0 : framebuffer);
+	real_glBindFramebuffer(target, framebuffer);
+}
+
+static void APIENTRY trace_glBindRenderbuffer(GLenum target, GLuint renderbuffer)
+{
+	writeCall(CallBindRenderbuffer);
+	write(target);
+	write(renderbuffer);
+	real_glBindRenderbuffer(target, renderbuffer);
+}
+
+static void APIENTRY trace_glBindTexture(GLenum target, GLuint texture)
+{
+	writeCall(CallBindTexture);
+	write(target);
+	write(texture);
+	real_glBindTexture(target, texture);
+}
+
+static void APIENTRY trace_glBindVertexArray(GLuint array)
+{
+	writeCall(CallBindVertexArray);
+	write(array);
+	real_glBindVertexArray(array);
+}
+
+static void APIENTRY trace_glBlendFunc(GLenum sfactor, GLenum dfactor)
+{
+	writeCall(CallBlendFunc);
+	write(sfactor);
+	write(dfactor);
+	real_glBlendFunc(sfactor, dfactor);
+}
+
+static void APIENTRY trace_glBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+	writeCall(CallBufferData);
+	write(target);
+	write((int64_t)size);
+	writeBlob(data, data ? size : 0);
+	write(usage);
+	real_glBufferData(target, size, data, usage);
+}
+
+static void APIENTRY trace_glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+{
+	writeCall(CallBufferSubData);
+	write(target);
+	write((int64_t)offset);
+	writeBlob(data, size);
+	real_glBufferSubData(target, offset, size, data);
+}
+
+static GLenum APIENTRY trace_glCheckFramebufferStatus(GLenum target)
+{
+	writeCall(CallCheckFramebufferStatus);
+	write(target);
+	return real_glCheckFramebufferStatus(target);
+}
+
+static void APIENTRY trace_glClear(GLbitfield mask)
+{
+	writeCall(CallClear);
+	write(mask);
+	real_glClear(mask);
+}
+
+static void APIENTRY trace_glClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+{
+	writeCall(CallClearColor);
+	write(red);
+	write(green);
+	write(blue);
+	write(alpha);
+	real_glClearColor(red, green, blue, alpha);
+}
+
+static GLenum APIENTRY trace_glClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout)
+{
+	writeCall(CallClientWaitSync);
+	write((uint64_t)(uintptr_t)sync);
+	write(flags);
+	write(timeout);
+	return real_glClientWaitSync(sync, flags, timeout);
+}
+
+static void APIENTRY trace_glCompileShader(GLuint shader)
+{
+	writeCall(CallCompileShader);
+	write(shader);
+	real_glCompileShader(shader);
+}
+
+static void APIENTRY trace_glCopyBufferSubData(GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size)
+{
+	writeCall(CallCopyBufferSubData);
+	write(readTarget);
+	write(writeTarget);
+	write((int64_t)readOffset);
+	write((int64_t)writeOffset);
+	write((int64_t)size);
+	real_glCopyBufferSubData(readTarget, writeTarget, readOffset, writeOffset, size);
+}
+
+static GLuint APIENTRY trace_glCreateProgram()
+{
+	GLuint program = real_glCreateProgram();
+	writeCall(CallCreateProgram);
+	write(program);
+	return program;
+}
+
+static GLuint APIENTRY trace_glCreateShader(GLenum type)
+{
+	GLuint shader = real_glCreateShader(type);
+	writeCall(CallCreateShader);
+	write(type);
+	write(shader);
+	return shader;
+}
+
+static void APIENTRY trace_glDeleteBuffers(GLsizei n, const GLuint* buffers)
+{
+	writeCall(CallDeleteBuffers);
+	writeNames(n, buffers);
+	real_glDeleteBuffers(n, buffers);
+}
+
+static void APIENTRY trace_glDeleteFramebuffers(GLsizei n, const GLuint* framebuffers)
+{
+	writeCall(CallDeleteFramebuffers);
+	writeNames(n, framebuffers);
+	real_glDeleteFramebuffers(n, framebuffers);
+}
+
+static void APIENTRY trace_glDeleteProgram(GLuint program)
+{
+	writeCall(CallDeleteProgram);
+	write(program);
+	real_glDeleteProgram(program);
+}
+
+static void APIENTRY trace_glDeleteQueries(GLsizei n, const GLuint* ids)
+{
+	writeCall(CallDeleteQueries);
+	writeNames(n, ids);
+	real_glDeleteQueries(n, ids);
+}
+
+static void APIENTRY trace_glDeleteRenderbuffers(GLsizei n, const GLuint* renderbuffers)
+{
+	writeCall(CallDeleteRenderbuffers);
+	writeNames(n, renderbuffers);
+	real_glDeleteRenderbuffers(n, renderbuffers);
+}
+
+static void APIENTRY trace_glDeleteShader(GLuint shader)
+{
+	writeCall(CallDeleteShader);
+	write(shader);
+	real_glDeleteShader(shader);
+}
+
+static void APIENTRY trace_glDeleteSync(GLsync sync)
+{
+	writeCall(CallDeleteSync);
+	write((uint64_t)(uintptr_t)sync);
+	real_glDeleteSync(sync);
+}
+
+static void APIENTRY trace_glDeleteTextures(GLsizei n, const GLuint* textures)
+{
+	writeCall(CallDeleteTextures);
+	writeNames(n, textures);
+	real_glDeleteTextures(n, textures);
+}
+
+static void APIENTRY trace_glDeleteVertexArrays(GLsizei n, const GLuint* arrays)
+{
+	writeCall(CallDeleteVertexArrays);
+	writeNames(n, arrays);
+	real_glDeleteVertexArrays(n, arrays);
+}
+
+static void APIENTRY trace_glDepthMask(GLboolean flag)
+{
+	writeCall(CallDepthMask);
+	write(flag);
+	real_glDepthMask(flag);
+}
+
+static void APIENTRY trace_glDisable(GLenum cap)
+{
+	writeCall(CallDisable);
+	write(cap);
+	real_glDisable(cap);
+}
+
+static void APIENTRY trace_glDisableVertexAttribArray(GLuint index)
+{
+	writeCall(CallDisableVertexAttribArray);
+	write(index);
+	real_glDisableVertexAttribArray(index);
+}
+
+static void APIENTRY trace_glDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+	writeCall(CallDrawArrays);
+	write(mode);
+	write(first);
+	write(count);
+	real_glDrawArrays(mode, first, count);
+}
+
+// NOTE Indices always come from the element buffer, the pointer is an offset into it
+static void APIENTRY trace_glDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices, GLint basevertex)
+{
+	writeCall(CallDrawElementsBaseVertex);
+	write(mode);
+	write(count);
+	write(type);
+	write((uint64_t)(uintptr_t)indices);
+	write(basevertex);
+	real_glDrawElementsBaseVertex(mode, count, type, indices, basevertex);
+}
+
+static void APIENTRY trace_glDrawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount, GLint basevertex)
+{
+	writeCall(CallDrawElementsInstancedBaseVertex);
+	write(mode);
+	write(count);
+	write(type);
+	write((uint64_t)(uintptr_t)indices);
+	write(instancecount);
+	write(basevertex);
+	real_glDrawElementsInstancedBaseVertex(mode, count, type, indices, instancecount, basevertex);
+}
+
+static void APIENTRY trace_glEnable(GLenum cap)
+{
+	writeCall(CallEnable);
+	write(cap);
+	real_glEnable(cap);
+}
+
+static void APIENTRY trace_glEnableVertexAttribArray(GLuint index)
+{
+	writeCall(CallEnableVertexAttribArray);
+	write(index);
+	real_glEnableVertexAttribArray(index);
+}
+
+static void APIENTRY trace_glEndQuery(GLenum target)
+{
+	writeCall(CallEndQuery);
+	write(target);
+	real_glEndQuery(target);
+}
+
+static GLsync APIENTRY trace_glFenceSync(GLenum condition, GLbitfield flags)
+{
+	GLsync sync = real_glFenceSync(condition, flags);
+	writeCall(CallFenceSync);
+	write(condition);
+	write(flags);
+	write((uint64_t)(uintptr_t)sync);
+	return sync;
+}
+
+static void APIENTRY trace_glFinish()
+{
+	writeCall(CallFinish);
+	real_glFinish();
+}
+
+static void APIENTRY trace_glFlush()
+{
+	writeCall(CallFlush);
+	real_glFlush();
+}
+
+// The written part of the range goes into the trace, offset is relative to the start of the mapping
+static void APIENTRY trace_glFlushMappedBufferRange(GLenum target, GLintptr offset, GLsizeiptr length)
+{
+	MappedRange* range = findMappedRange(getBoundBuffer(target));
+	writeCall(CallFlushMappedBufferRange);
+	write(target);
+	write((int64_t)offset);
+	writeBlob(range ? range->pointer + offset : NULL, range ? length : 0);
+	real_glFlushMappedBufferRange(target, offset, length);
+}
+
+static void APIENTRY trace_glFramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer)
+{
+	writeCall(CallFramebufferRenderbuffer);
+	write(target);
+	write(attachment);
+	write(renderbuffertarget);
+	write(renderbuffer);
+	real_glFramebufferRenderbuffer(target, attachment, renderbuffertarget, renderbuffer);
+}
+
+static void APIENTRY trace_glFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level)
+{
+	writeCall(CallFramebufferTexture2D);
+	write(target);
+	write(attachment);
+	write(textarget);
+	write(texture);
+	write(level);
+	real_glFramebufferTexture2D(target, attachment, textarget, texture, level);
+}
+
+static void APIENTRY trace_glGenBuffers(GLsizei n, GLuint* buffers)
+{
+	real_glGenBuffers(n, buffers);
+	writeCall(CallGenBuffers);
+	writeNames(n, buffers);
+}
+
+static void APIENTRY trace_glGenFramebuffers(GLsizei n, GLuint* framebuffers)
+{
+	real_glGenFramebuffers(n, framebuffers);
+	writeCall(CallGenFramebuffers);
+	writeNames(n, framebuffers);
+}
+
+static void APIENTRY trace_glGenQueries(GLsizei n, GLuint* ids)
+{
+	real_glGenQueries(n, ids);
+	writeCall(CallGenQueries);
+	writeNames(n, ids);
+}
+
+static void APIENTRY trace_glGenRenderbuffers(GLsizei n, GLuint* renderbuffers)
+{
+	real_glGenRenderbuffers(n, renderbuffers);
+	writeCall(CallGenRenderbuffers);
+	writeNames(n, renderbuffers);
+}
+
+static void APIENTRY trace_glGenTextures(GLsizei n, GLuint* textures)
+{
+	real_glGenTextures(n, textures);
+	writeCall(CallGenTextures);
+	writeNames(n, textures);
+}
+
+static void APIENTRY trace_glGenVertexArrays(GLsizei n, GLuint* arrays)
+{
+	real_glGenVertexArrays(n, arrays);
+	writeCall(CallGenVertexArrays);
+	writeNames(n, arrays);
+}
+
+static void APIENTRY trace_glGenerateMipmap(GLenum target)
+{
+	writeCall(CallGenerateMipmap);
+	write(target);
+	real_glGenerateMipmap(target);
+}
+
+// NOTE Queries are replayed for their cost (some of them wait for the GPU), their results aren't kept
+static void APIENTRY trace_glGetIntegerv(GLenum pname, GLint* data)
+{
+	writeCall(CallGetIntegerv);
+	write(pname);
+	real_glGetIntegerv(pname, data);
+}
+
+static void APIENTRY trace_glGetProgramInfoLog(GLuint program, GLsizei bufSize, GLsizei* length, GLchar* infoLog)
+{
+	writeCall(CallGetProgramInfoLog);
+	write(program);
+	write(bufSize);
+	real_glGetProgramInfoLog(program, bufSize, length, infoLog);
+}
+
+static void APIENTRY trace_glGetProgramiv(GLuint program, GLenum pname, GLint* params)
+{
+	writeCall(CallGetProgramiv);
+	write(program);
+	write(pname);
+	real_glGetProgramiv(program, pname, params);
+}
+
+static void APIENTRY trace_glGetQueryObjectiv(GLuint id, GLenum pname, GLint* params)
+{
+	writeCall(CallGetQueryObjectiv);
+	write(id);
+	write(pname);
+	real_glGetQueryObjectiv(id, pname, params);
+}
+
+static void APIENTRY trace_glGetQueryObjectui64v(GLuint id, GLenum pname, GLuint64* params)
+{
+	writeCall(CallGetQueryObjectui64v);
+	write(id);
+	write(pname);
+	real_glGetQueryObjectui64v(id, pname, params);
+}
+
+static void APIENTRY trace_glGetShaderInfoLog(GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* infoLog)
+{
+	writeCall(CallGetShaderInfoLog);
+	write(shader);
+	write(bufSize);
+	real_glGetShaderInfoLog(shader, bufSize, length, infoLog);
+}
+
+static void APIENTRY trace_glGetShaderiv(GLuint shader, GLenum pname, GLint* params)
+{
+	writeCall(CallGetShaderiv);
+	write(shader);
+	write(pname);
+	real_glGetShaderiv(shader, pname, params);
+}
+
+static const GLubyte* APIENTRY trace_glGetString(GLenum name)
+{
+	writeCall(CallGetString);
+	write(name);
+	return real_glGetString(name);
+}
+
+static const GLubyte* APIENTRY trace_glGetStringi(GLenum name, GLuint index)
+{
+	writeCall(CallGetStringi);
+	write(name);
+	write(index);
+	return real_glGetStringi(name, index);
+}
+
+static GLint APIENTRY trace_glGetUniformLocation(GLuint program, const GLchar* name)
+{
+	GLint location = real_glGetUniformLocation(program, name);
+	writeCall(CallGetUniformLocation);
+	write(program);
+	writeBlob(name, strlen(name) + 1);
+	write(location);
+	return location;
+}
+
+static void APIENTRY trace_glLinkProgram(GLuint program)
+{
+	writeCall(CallLinkProgram);
+	write(program);
+	real_glLinkProgram(program);
+}
+
+static void* APIENTRY trace_glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+{
+	void* pointer = real_glMapBufferRange(target, offset, length, access);
+	writeCall(CallMapBufferRange);
+	write(target);
+	write((int64_t)offset);
+	write((int64_t)length);
+	write(access);
+
+	if (pointer && (access & GL_MAP_WRITE_BIT))
+	{
+		MappedRange range = { getBoundBuffer(target), (const unsigned char*)pointer, length, access };
+		mappedRanges.push_back(range);
+	}
+	return pointer;
+}
+
+static void APIENTRY trace_glPixelStorei(GLenum pname, GLint param)
+{
+	writeCall(CallPixelStorei);
+	write(pname);
+	write(param);
+	if (pname == GL_UNPACK_ALIGNMENT)
+	{
+		unpackAlignment = param;
+	}
+	else if (pname == GL_PACK_ALIGNMENT)
+	{
+		packAlignment = param;
+	}
+	real_glPixelStorei(pname, param);
+}
+
+static void APIENTRY trace_glPolygonMode(GLenum face, GLenum mode)
+{
+	writeCall(CallPolygonMode);
+	write(face);
+	write(mode);
+	real_glPolygonMode(face, mode);
+}
+
+static void APIENTRY trace_glQueryCounter(GLuint id, GLenum target)
+{
+	writeCall(CallQueryCounter);
+	write(id);
+	write(target);
+	real_glQueryCounter(id, target);
+}
+
+// Into a pixel pack buffer the pointer is an offset, into client memory the replay reads into a scratch buffer
+static void APIENTRY trace_glReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels)
+{
+	writeCall(CallReadPixels);
+	write(x);
+	write(y);
+	write(width);
+	write(height);
+	write(format);
+	write(type);
+	write((uint8_t)(getBoundBuffer(GL_PIXEL_PACK_BUFFER) != 0));
+	write((uint64_t)(uintptr_t)pixels);
+	real_glReadPixels(x, y, width, height, format, type, pixels);
+}
+
+static void APIENTRY trace_glRenderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height)
+{
+	writeCall(CallRenderbufferStorage);
+	write(target);
+	write(internalformat);
+	write(width);
+	write(height);
+	real_glRenderbufferStorage(target, internalformat, width, height);
+}
+
+static void APIENTRY trace_glShaderSource(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length)
+{
+	writeCall(CallShaderSource);
+	write(shader);
+	write(count);
+	for (GLsizei i = 0; i < count; i++)
+	{
+		size_t size = length && length[i] >= 0 ? (size_t)length[i] : strlen(string[i]);
+		writeBlob(string[i], size);
+	}
+	real_glShaderSource(shader, count, string, length);
+}
+
+// Pixels from a pixel unpack buffer stay an offset, pixels from client memory go into the trace
+static void APIENTRY trace_glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels)
+{
+	writeCall(CallTexImage2D);
+	write(target);
+	write(level);
+	write(internalformat);
+	write(width);
+	write(height);
+	write(border);
+	write(format);
+	write(type);
+	bool fromBuffer = getBoundBuffer(GL_PIXEL_UNPACK_BUFFER) != 0;
+	write((uint8_t)fromBuffer);
+	if (fromBuffer)
+	{
+		write((uint64_t)(uintptr_t)pixels);
+	}
+	else
+	{
+		writeBlob(pixels, pixels ? getImageSize(width, height, format, type, unpackAlignment) : 0);
+	}
+	real_glTexImage2D(target, level, internalformat, width, height, border, format, type, pixels);
+}
+
+static void APIENTRY trace_glTexParameteri(GLenum target, GLenum pname, GLint param)
+{
+	writeCall(CallTexParameteri);
+	write(target);
+	write(pname);
+	write(param);
+	real_glTexParameteri(target, pname, param);
+}
+
+static void APIENTRY trace_glUniform1f(GLint location, GLfloat v0)
+{
+	writeCall(CallUniform1f);
+	write(location);
+	write(v0);
+	real_glUniform1f(location, v0);
+}
+
+static void APIENTRY trace_glUniform1i(GLint location, GLint v0)
+{
+	writeCall(CallUniform1i);
+	write(location);
+	write(v0);
+	real_glUniform1i(location, v0);
+}
+
+static void APIENTRY trace_glUniform2f(GLint location, GLfloat v0, GLfloat v1)
+{
+	writeCall(CallUniform2f);
+	write(location);
+	write(v0);
+	write(v1);
+	real_glUniform2f(location, v0, v1);
+}
+
+static void APIENTRY trace_glUniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3)
+{
+	writeCall(CallUniform4f);
+	write(location);
+	write(v0);
+	write(v1);
+	write(v2);
+	write(v3);
+	real_glUniform4f(location, v0, v1, v2, v3);
+}
+
+// Writes that weren't flushed explicitly go into the trace here, the whole mapped range
+static GLboolean APIENTRY trace_glUnmapBuffer(GLenum target)
+{
+	GLuint buffer = getBoundBuffer(target);
+	MappedRange* range = findMappedRange(buffer);
+	writeCall(CallUnmapBuffer);
+	write(target);
+	if (range && !(range->access & GL_MAP_FLUSH_EXPLICIT_BIT))
+	{
+		writeBlob(range->pointer, range->length);
+	}
+	else
+	{
+		writeBlob(NULL, 0);
+	}
+	if (range)
+	{
+		mappedRanges.erase(mappedRanges.begin() + (range - mappedRanges.data()));
+	}
+	return real_glUnmapBuffer(target);
+}
+
+static void APIENTRY trace_glUseProgram(GLuint program)
+{
+	writeCall(CallUseProgram);
+	write(program);
+	real_glUseProgram(program);
+}
+
+static void APIENTRY trace_glVertexAttrib4f(GLuint index, GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+{
+	writeCall(CallVertexAttrib4f);
+	write(index);
+	write(x);
+	write(y);
+	write(z);
+	write(w);
+	real_glVertexAttrib4f(index, x, y, z, w);
+}
+
+static void APIENTRY trace_glVertexAttrib4fv(GLuint index, const GLfloat* v)
+{
+	writeCall(CallVertexAttrib4fv);
+	write(index);
+	write(v, 4 * sizeof(GLfloat));
+	real_glVertexAttrib4fv(index, v);
+}
+
+static void APIENTRY trace_glVertexAttribDivisor(GLuint index, GLuint divisor)
+{
+	writeCall(CallVertexAttribDivisor);
+	write(index);
+	write(divisor);
+	real_glVertexAttribDivisor(index, divisor);
+}
+
+// NOTE Attributes always come from the array buffer, the pointer is an offset into it
+static void APIENTRY trace_glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer)
+{
+	writeCall(CallVertexAttribPointer);
+	write(index);
+	write(size);
+	write(type);
+	write(normalized);
+	write(stride);
+	write((uint64_t)(uintptr_t)pointer);
+	real_glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+}
+
+static void APIENTRY trace_glViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	writeCall(CallViewport);
+	write(x);
+	write(y);
+	write(width);
+	write(height);
+	real_glViewport(x, y, width, height);
+}
+
+bool beginGLCapture(const char* filePath, int width, int height, GLuint defaultFramebuffer)
+{
+	if (capturing)
+	{
+		printf("ERROR: A GL capture is already running\n");
+		return false;
+	}
+
+	traceFile = fopen(filePath, "wb");
+	if (!traceFile)
+	{
+		printf("ERROR: Failed to open %s for writing\n", filePath);
+		return false;
+	}
+
+	captureStats = GLCaptureStats();
+	traceBuffer.reserve(TraceFlushSize + 64 * 1024);
+	write(TraceMagic, sizeof(TraceMagic));
+	write(TraceVersion);
+	write((int32_t)width);
+	write((int32_t)height);
+
+	unpackAlignment = 4;
+	packAlignment = 4;
+	mappedRanges.clear();
+	capturedDefaultFramebuffer = defaultFramebuffer;
+
+	capturedExtensions = GLExtensions;
+	GLExtensions.bufferStorage = false;
+	GLExtensions.multiDrawIndirect = false;
+
+#define TRACE_INSTALL(name) real_gl##name = glad_gl##name; glad_gl##name = trace_gl##name;
+	TRACED_GL_FUNCTIONS(TRACE_INSTALL)
+#undef TRACE_INSTALL
+
+	capturing = true;
+	return true;
+}
+
+void markGLCaptureFrame()
+{
+	if (capturing)
+	{
+		write((uint16_t)CallFrameMarker);
+		captureStats.frames++;
+	}
+}
+
+void endGLCapture()
+{
+	if (!capturing)
+	{
+		return;
+	}
+
+#define TRACE_RESTORE(name) glad_gl##name = real_gl##name;
+	TRACED_GL_FUNCTIONS(TRACE_RESTORE)
+#undef TRACE_RESTORE
+
+	GLExtensions = capturedExtensions;
+	flushTrace();
+	fclose(traceFile);
+	traceFile = NULL;
+	capturing = false;
+}
+
+bool isGLCaptureActive()
+{
+	return capturing;
+}
+
+GLCaptureStats getGLCaptureStats()
+{
+	GLCaptureStats stats = captureStats;
+	stats.bytes += traceBuffer.size();
+	return stats;
+}
+
+
+////////////////////////////////////
+//
+// Replay
+//
+typedef std::unordered_map<GLuint, GLuint> NameMap;
+
+struct TraceReader
+{
+	const unsigned char* data;
+	size_t size;
+	size_t offset;
+	bool failed;
+
+	const unsigned char* getBytes(size_t count)
+	{
+		if (failed || size - offset < count)
+		{
+			failed = true;
+			return NULL;
+		}
+		const unsigned char* bytes = data + offset;
+		offset += count;
+		return bytes;
+	}
+
+	template <typename T>
+	T get()
+	{
+		T value = T();
+		const unsigned char* bytes = getBytes(sizeof(T));
+		if (bytes)
+		{
+			memcpy(&value, bytes, sizeof(T));
+		}
+		return value;
+	}
+
+	// NULL for an empty blob
+	const void* getBlob(uint64_t& blobSize)
+	{
+		blobSize = get<uint64_t>();
+		return blobSize > 0 ? getBytes((size_t)blobSize) : NULL;
+	}
+};
+
+// Objects the trace didn't create (made before the capture started) keep their names
+static GLuint mapName(const NameMap& names, GLuint recorded)
+{
+	NameMap::const_iterator found = names.find(recorded);
+	return found != names.end() ? found->second : recorded;
+}
+
+template <typename GenerateFunction>
+static void replayGenerate(TraceReader& reader, NameMap& names, GenerateFunction generate)
+{
+	GLsizei count = reader.get<GLsizei>();
+	const unsigned char* recorded = reader.getBytes(count * sizeof(GLuint));
+	if (!recorded)
+	{
+		return;
+	}
+
+	std::vector<GLuint> created(count);
+	generate(count, created.data());
+	for (GLsizei i = 0; i < count; i++)
+	{
+		GLuint name;
+		memcpy(&name, recorded + i * sizeof(GLuint), sizeof(GLuint));
+		names[name] = created[i];
+	}
+}
+
+template <typename DeleteFunction>
+static void replayDelete(TraceReader& reader, NameMap& names, DeleteFunction destroy)
+{
+	GLsizei count = reader.get<GLsizei>();
+	const unsigned char* recorded = reader.getBytes(count * sizeof(GLuint));
+	if (!recorded)
+	{
+		return;
+	}
+
+	std::vector<GLuint> mapped(count);
+	for (GLsizei i = 0; i < count; i++)
+	{
+		GLuint name;
+		memcpy(&name, recorded + i * sizeof(GLuint), sizeof(GLuint));
+		mapped[i] = mapName(names, name);
+		names.erase(name);
+	}
+	destroy(count, mapped.data());
+}
+
+bool replayGLTrace(const char* filePath, Framebuffer& target, GLReplayStats& stats)
+{
+	stats = GLReplayStats();
+	if (capturing)
+	{
+		printf("ERROR: Can't replay a GL trace while capturing one\n");
+		return false;
+	}
+
+	// NOTE Read all of it up front, so the replay doesn't wait on the disk
+	FILE* file = fopen(filePath, "rb");
+	if (!file)
+	{
+		printf("ERROR: Failed to open GL trace %s\n", filePath);
+		return false;
+	}
+	std::vector<unsigned char> trace;
+	unsigned char chunk[64 * 1024];
+	size_t chunkSize;
+	while ((chunkSize = fread(chunk, 1, sizeof(chunk), file)) > 0)
+	{
+		trace.insert(trace.end(), chunk, chunk + chunkSize);
+	}
+	fclose(file);
+
+	TraceReader reader = { trace.data(), trace.size(), 0, false };
+	const unsigned char* magic = reader.getBytes(sizeof(TraceMagic));
+	uint32_t version = reader.get<uint32_t>();
+	int32_t width = reader.get<int32_t>();
+	int32_t height = reader.get<int32_t>();
+	if (!magic || memcmp(magic, TraceMagic, sizeof(TraceMagic)) != 0 || version != TraceVersion)
+	{
+		printf("ERROR: %s isn't a GL trace of version %u\n", filePath, TraceVersion);
+		return false;
+	}
+
+	// The default framebuffer of the capture
+	if (!target.create(width, height))
+	{
+		return false;
+	}
+
+	NameMap buffers, textures, vertexArrays, framebuffers, renderbuffers, queries, programs;
+	framebuffers[0] = target.Id;
+	std::unordered_map<uint64_t, GLsync> syncs;
+	std::unordered_map<uint64_t, GLint> uniformLocations;	// recorded program << 32 | recorded location
+	std::unordered_map<GLuint, unsigned char*> mappedPointers;	// by replay buffer name
+	GLuint currentProgram = 0;	// recorded name
+	GLint packAlignment = 4;
+	std::vector<unsigned char> scratch;
+
+	auto mapLocation = [&uniformLocations, &currentProgram](GLint location)
+	{
+		if (location < 0)
+		{
+			return location;
+		}
+		auto found = uniformLocations.find(((uint64_t)currentProgram << 32) | (uint32_t)location);
+		return found != uniformLocations.end() ? found->second : location;
+	};
+	auto getBoundReplayBuffer = [](GLenum bufferTarget)
+	{
+		GLint buffer = 0;
+		glGetIntegerv(getBufferBinding(bufferTarget), &buffer);
+		return (GLuint)buffer;
+	};
+
+	Clock::time_point start = Clock::now();
+	Clock::time_point frameStart = start;
+	bool inSetup = true;
+	while (reader.offset < reader.size && !reader.failed)
+	{
+		uint16_t call = reader.get<uint16_t>();
+		stats.calls++;
+		switch (call)
+		{
+		case CallActiveTexture:
+		{
+			GLenum texture = reader.get<GLenum>();
+			glActiveTexture(texture);
+			break;
+		}
+		case CallAttachShader:
+		{
+			GLuint program = reader.get<GLuint>();
+			GLuint shader = reader.get<GLuint>();
+			glAttachShader(mapName(programs, program), mapName(programs, shader));
+			break;
+		}
+		case CallBeginQuery:
+		{
+			GLenum queryTarget = reader.get<GLenum>();
+			GLuint id = reader.get<GLuint>();
+			glBeginQuery(queryTarget, mapName(queries, id));
+			break;
+		}
+		case CallBindBuffer:
+		{
+			GLenum bufferTarget = reader.get<GLenum>();
+			GLuint buffer = reader.get<GLuint>();
+			glBindBuffer(bufferTarget, mapName(buffers, buffer));
+			break;
+		}
+		case CallBindFramebuffer:
+		{
+			GLenum framebufferTarget = reader.get<GLenum>();
+			GLuint framebuffer = reader.get<GLuint>();
+			glBindFramebuffer(framebufferTarget, mapName(framebuffers, framebuffer));
+			break;
+		}
+		case CallBindRenderbuffer:
+		{
+			GLenum renderbufferTarget = reader.get<GLenum>();
+			GLuint renderbuffer = reader.get<GLuint>();
+			glBindRenderbuffer(renderbufferTarget, mapName(renderbuffers, renderbuffer));
+			break;
+		}
+		case CallBindTexture:
+		{
+			GLenum textureTarget = reader.get<GLenum>();
+			GLuint texture = reader.get<GLuint>();
+			glBindTexture(textureTarget, mapName(textures, texture));
+			break;
+		}
+		case CallBindVertexArray:
+		{
+			GLuint array = reader.get<GLuint>();
+			glBindVertexArray(mapName(vertexArrays, array));
+			break;
+		}
+		case CallBlendFunc:
+		{
+			GLenum sourceFactor = reader.get<GLenum>();
+			GLenum destinationFactor = reader.get<GLenum>();
+			glBlendFunc(sourceFactor, destinationFactor);
+			break;
+		}
+		case CallBufferData:
+		{
+			GLenum bufferTarget = reader.get<GLenum>();
+			int64_t size = reader.get<int64_t>();
+			uint64_t dataSize;
+			const void* data = reader.getBlob(dataSize);
+			GLenum usage = reader.get<GLenum>();
+			glBufferData(bufferTarget, (GLsizeiptr)size, data, usage);
+			break;
+		}
+		case CallBufferSubData:
+		{
+			GLenum bufferTarget = reader.get<GLenum>();
+			int64_t offset = reader.get<int64_t>();
+			uint64_t dataSize;
+			const void* data = reader.getBlob(dataSize);
+			glBufferSubData(bufferTarget, (GLintptr)offset, (GLsizeiptr)dataSize, data);
+			break;
+		}
+		case CallCheckFramebufferStatus:
+		{
+			GLenum framebufferTarget = reader.get<GLenum>();
+			glCheckFramebufferStatus(framebufferTarget);
+			break;
+		}
+		case CallClear:
+		{
+			GLbitfield mask = reader.get<GLbitfield>();
+			glClear(mask);
+			break;
+		}
+		case CallClearColor:
+		{
+			GLfloat red = reader.get<GLfloat>();
+			GLfloat green = reader.get<GLfloat>();
+			GLfloat blue = reader.get<GLfloat>();
+			GLfloat alpha = reader.get<GLfloat>();
+			glClearColor(red, green, blue, alpha);
+			break;
+		}
+		case CallClientWaitSync:
+		{
+			uint64_t sync = reader.get<uint64_t>();
+			GLbitfield flags = reader.get<GLbitfield>();
+			GLuint64 timeout = reader.get<GLuint64>();
+			auto found = syncs.find(sync);
+			if (found != syncs.end())
+			{
+				glClientWaitSync(found->second, flags, timeout);
+			}
+			break;
+		}
+		case CallCompileShader:
+		{
+			GLuint shader = reader.get<GLuint>();
+			glCompileShader(mapName(programs, shader));
+			break;
+		}
+		case CallCopyBufferSubData:
+		{
+			GLenum readTarget = reader.get<GLenum>();
+			GLenum writeTarget = reader.get<GLenum>();
+			int64_t readOffset = reader.get<int64_t>();
+			int64_t writeOffset = reader.get<int64_t>();
+			int64_t size = reader.get<int64_t>();
+			glCopyBufferSubData(readTarget, writeTarget, (GLintptr)readOffset, (GLintptr)writeOffset, (GLsizeiptr)size);
+			break;
+		}
+		case CallCreateProgram:
+		{
+			GLuint program = reader.get<GLuint>();
+			programs[program] = glCreateProgram();
+			break;
+		}
+		case CallCreateShader:
+		{
+			GLenum type = reader.get<GLenum>();
+			GLuint shader = reader.get<GLuint>();
+			programs[shader] = glCreateShader(type);
+			break;
+		}
+		case CallDeleteBuffers:
+			replayDelete(reader, buffers, [](GLsizei count, const GLuint* names) { glDeleteBuffers(count, names); });
+			break;
+		case CallDeleteFramebuffers:
+			replayDelete(reader, framebuffers, [](GLsizei count, const GLuint* names) { glDeleteFramebuffers(count, names); });
+			break;
+		case CallDeleteProgram:
+		{
+			GLuint program = reader.get<GLuint>();
+			glDeleteProgram(mapName(programs, program));
+			programs.erase(program);
+			break;
+		}
+		case CallDeleteQueries:
+			replayDelete(reader, queries, [](GLsizei count, const GLuint* names) { glDeleteQueries(count, names); });
+			break;
+		case CallDeleteRenderbuffers:
+			replayDelete(reader, renderbuffers, [](GLsizei count, const GLuint* names) { glDeleteRenderbuffers(count, names); });
+			break;
+		case CallDeleteShader:
+		{
+			GLuint shader = reader.get<GLuint>();
+			glDeleteShader(mapName(programs, shader));
+			programs.erase(shader);
+			break;
+		}
+		case CallDeleteSync:
+		{
+			uint64_t sync = reader.get<uint64_t>();
+			auto found = syncs.find(sync);
+			if (found != syncs.end())
+			{
+				glDeleteSync(found->second);
+				syncs.erase(found);
+			}
+			break;
+		}
+		case CallDeleteTextures:
+			replayDelete(reader, textures, [](GLsizei count, const GLuint* names) { glDeleteTextures(count, names); });
+			break;
+		case CallDeleteVertexArrays:
+			replayDelete(reader, vertexArrays, [](GLsizei count, const GLuint* names) { glDeleteVertexArrays(count, names); });
+			break;
+		case CallDepthMask:
+		{
+			GLboolean flag = reader.get<GLboolean>();
+			glDepthMask(flag);
+			break;
+		}
+		case CallDisable:
+		{
+			GLenum capability = reader.get<GLenum>();
+			glDisable(capability);
+			break;
+		}
+		case CallDisableVertexAttribArray:
+		{
+			GLuint index = reader.get<GLuint>();
+			glDisableVertexAttribArray(index);
+			break;
+		}
+		case CallDrawArrays:
+		{
+			GLenum mode = reader.get<GLenum>();
+			GLint first = reader.get<GLint>();
+			GLsizei count = reader.get<GLsizei>();
+			glDrawArrays(mode, first, count);
+			break;
+		}
+		case CallDrawElementsBaseVertex:
+		{
+			GLenum mode = reader.get<GLenum>();
+			GLsizei count = reader.get<GLsizei>();
+			GLenum type = reader.get<GLenum>();
+			uint64_t indices = reader.get<uint64_t>();
+			GLint baseVertex = reader.get<GLint>();
+			glDrawElementsBaseVertex(mode, count, type, (const void*)(uintptr_t)indices, baseVertex);
+			break;
+		}
+		case CallDrawElementsInstancedBaseVertex:
+		{
+			GLenum mode = reader.get<GLenum>();
+			GLsizei count = reader.get<GLsizei>();
+			GLenum type = reader.get<GLenum>();
+			uint64_t indices = reader.get<uint64_t>();
+			GLsizei instanceCount = reader.get<GLsizei>();
+			GLint baseVertex = reader.get<GLint>();
+			glDrawElementsInstancedBaseVertex(mode, count, type, (const void*)(uintptr_t)indices, instanceCount, baseVertex);
+			break;
+		}
+		case CallEnable:
+		{
+			GLenum capability = reader.get<GLenum>();
+			glEnable(capability);
+			break;
+		}
+		case CallEnableVertexAttribArray:
+		{
+			GLuint index = reader.get<GLuint>();
+			glEnableVertexAttribArray(index);
+			break;
+		}
+		case CallEndQuery:
+		{
+			GLenum queryTarget = reader.get<GLenum>();
+			glEndQuery(queryTarget);
+			break;
+		}
+		case CallFenceSync:
+		{
+			GLenum condition = reader.get<GLenum>();
+			GLbitfield flags = reader.get<GLbitfield>();
+			uint64_t sync = reader.get<uint64_t>();
+			syncs[sync] = glFenceSync(condition, flags);
+			break;
+		}
+		case CallFinish:
+			glFinish();
+			break;
+		case CallFlush:
+			glFlush();
+			break;
+		case CallFlushMappedBufferRange:
+		{
+			GLenum bufferTarget = reader.get<GLenum>();
+			int64_t offset = reader.get<int64_t>();
+			uint64_t dataSize;
+			const void* data = reader.getBlob(dataSize);
+			auto mapped = mappedPointers.find(getBoundReplayBuffer(bufferTarget));
+			if (mapped != mappedPointers.end() && data)
+			{
+				memcpy(mapped->second + offset, data, (size_t)dataSize);
+			}
+			glFlushMappedBufferRange(bufferTarget, (GLintptr)offset, (GLsizeiptr)dataSize);
+			break;
+		}
+		case CallFramebufferRenderbuffer:
+		{
+			GLenum framebufferTarget = reader.get<GLenum>();
+			GLenum attachment = reader.get<GLenum>();
+			GLenum renderbufferTarget = reader.get<GLenum>();
+			GLuint renderbuffer = reader.get<GLuint>();
+			glFramebufferRenderbuffer(framebufferTarget, attachment, renderbufferTarget, mapName(renderbuffers, renderbuffer));
+			break;
+		}
+		case CallFramebufferTexture2D:
+		{
+			GLenum framebufferTarget = reader.get<GLenum>();
+			GLenum attachment = reader.get<GLenum>();
+			GLenum textureTarget = reader.get<GLenum>();
+			GLuint texture = reader.get<GLuint>();
+			GLint level = reader.get<GLint>();
+			glFramebufferTexture2D(framebufferTarget, attachment, textureTarget, mapName(textures, texture), level);
+			break;
+		}
+		case CallGenBuffers:
+			replayGenerate(reader, buffers, [](GLsizei count, GLuint* names) { glGenBuffers(count, names); });
+			break;
+		case CallGenFramebuffers:
+			replayGenerate(reader, framebuffers, [](GLsizei count, GLuint* names) { glGenFramebuffers(count, names); });
+			break;
+		case CallGenQueries:
+			replayGenerate(reader, queries, [](GLsizei count, GLuint* names) { glGenQueries(count, names); });
+			break;
+		case CallGenRenderbuffers:
+			replayGenerate(reader, renderbuffers, [](GLsizei count, GLuint* names) { glGenRenderbuffers(count, names); });
+			break;
+		case CallGenTextures:
+			replayGenerate(reader, textures, [](GLsizei count, GLuint* names) { glGenTextures(count, names); });
+			break;
+		case CallGenVertexArrays:
+			replayGenerate(reader, vertexArrays, [](GLsizei count, GLuint* names) { glGenVertexArrays(count, names); });
+			break;
+		case CallGenerateMipmap:
+		{
+			GLenum textureTarget = reader.get<GLenum>();
+			glGenerateMipmap(textureTarget);
+			break;
+		}
+		case CallGetIntegerv:
+		{
+			GLenum name = reader.get<GLenum>();
+			GLint values[256];
+			glGetIntegerv(name, values);
+			break;
+		}
+		case CallGetProgramInfoLog:
+		case CallGetShaderInfoLog:
+		{
+			GLuint object = reader.get<GLuint>();
+			GLsizei bufferSize = reader.get<GLsizei>();
+			scratch.resize(bufferSize > 0 ? bufferSize : 1);
+			if (call == CallGetProgramInfoLog)
+			{
+				glGetProgramInfoLog(mapName(programs, object), bufferSize, NULL, (GLchar*)scratch.data());
+			}
+			else
+			{
+				glGetShaderInfoLog(mapName(programs, object), bufferSize, NULL, (GLchar*)scratch.data());
+			}
+			break;
+		}
+		case CallGetProgramiv:
+		case CallGetShaderiv:
+		{
+			GLuint object = reader.get<GLuint>();
+			GLenum name = reader.get<GLenum>();
+			GLint values[4];
+			if (call == CallGetProgramiv)
+			{
+				glGetProgramiv(mapName(programs, object), name, values);
+			}
+			else
+			{
+				glGetShaderiv(mapName(programs, object), name, values);
+			}
+			break;
+		}
+		case CallGetQueryObjectiv:
+		{
+			GLuint id = reader.get<GLuint>();
+			GLenum name = reader.get<GLenum>();
+			GLint value;
+			glGetQueryObjectiv(mapName(queries, id), name, &value);
+			break;
+		}
+		case CallGetQueryObjectui64v:
+		{
+			GLuint id = reader.get<GLuint>();
+			GLenum name = reader.get<GLenum>();
+			GLuint64 value;
+			glGetQueryObjectui64v(mapName(queries, id), name, &value);
+			break;
+		}
+		case CallGetString:
+		{
+			GLenum name = reader.get<GLenum>();
+			glGetString(name);
+			break;
+		}
+		case CallGetStringi:
+		{
+			GLenum name = reader.get<GLenum>();
+			GLuint index = reader.get<GLuint>();
+			glGetStringi(name, index);
+			break;
+		}
+		case CallGetUniformLocation:
+		{
+			GLuint program = reader.get<GLuint>();
+			uint64_t nameSize;
+			const GLchar* name = (const GLchar*)reader.getBlob(nameSize);
+			GLint location = reader.get<GLint>();
+			if (name && location >= 0)
+			{
+				uniformLocations[((uint64_t)program << 32) | (uint32_t)location] = glGetUniformLocation(mapName(programs, program), name);
+			}
+			break;
+		}
+		case CallLinkProgram:
+		{
+			GLuint program = reader.get<GLuint>();
+			glLinkProgram(mapName(programs, program));
+			break;
+		}
+		case CallMapBufferRange:
+		{
+			GLenum bufferTarget = reader.get<GLenum>();
+			int64_t offset = reader.get<int64_t>();
+			int64_t length = reader.get<int64_t>();
+			GLbitfield access = reader.get<GLbitfield>();
+			void* pointer = glMapBufferRange(bufferTarget, (GLintptr)offset, (GLsizeiptr)length, access);
+			if (pointer)
+			{
+				mappedPointers[getBoundReplayBuffer(bufferTarget)] = (unsigned char*)pointer;
+			}
+			break;
+		}
+		case CallPixelStorei:
+		{
+			GLenum name = reader.get<GLenum>();
+			GLint value = reader.get<GLint>();
+			if (name == GL_PACK_ALIGNMENT)
+			{
+				packAlignment = value;
+			}
+			glPixelStorei(name, value);
+			break;
+		}
+		case CallPolygonMode:
+		{
+			GLenum face = reader.get<GLenum>();
+			GLenum mode = reader.get<GLenum>();
+			glPolygonMode(face, mode);
+			break;
+		}
+		case CallQueryCounter:
+		{
+			GLuint id = reader.get<GLuint>();
+			GLenum queryTarget = reader.get<GLenum>();
+			glQueryCounter(mapName(queries, id), queryTarget);
+			break;
+		}
+		case CallReadPixels:
+		{
+			GLint x = reader.get<GLint>();
+			GLint y = reader.get<GLint>();
+			GLsizei readWidth = reader.get<GLsizei>();
+			GLsizei readHeight = reader.get<GLsizei>();
+			GLenum format = reader.get<GLenum>();
+			GLenum type = reader.get<GLenum>();
+			uint8_t intoBuffer = reader.get<uint8_t>();
+			uint64_t pointer = reader.get<uint64_t>();
+			if (intoBuffer)
+			{
+				glReadPixels(x, y, readWidth, readHeight, format, type, (void*)(uintptr_t)pointer);
+			}
+			else
+			{
+				scratch.resize(getImageSize(readWidth, readHeight, format, type, packAlignment) + 1);
+				glReadPixels(x, y, readWidth, readHeight, format, type, scratch.data());
+			}
+			break;
+		}
+		case CallRenderbufferStorage:
+		{
+			GLenum renderbufferTarget = reader.get<GLenum>();
+			GLenum internalFormat = reader.get<GLenum>();
+			GLsizei storageWidth = reader.get<GLsizei>();
+			GLsizei storageHeight = reader.get<GLsizei>();
+			glRenderbufferStorage(renderbufferTarget, internalFormat, storageWidth, storageHeight);
+			break;
+		}
+		case CallShaderSource:
+		{
+			GLuint shader = reader.get<GLuint>();
+			GLsizei count = reader.get<GLsizei>();
+			std::vector<const GLchar*> strings(count);
+			std::vector<GLint> lengths(count);
+			for (GLsizei i = 0; i < count; i++)
+			{
+				uint64_t size;
+				strings[i] = (const GLchar*)reader.getBlob(size);
+				lengths[i] = (GLint)size;
+				if (!strings[i])
+				{
+					strings[i] = "";
+				}
+			}
+			glShaderSource(mapName(programs, shader), count, strings.data(), lengths.data());
+			break;
+		}
+		case CallTexImage2D:
+		{
+			GLenum textureTarget = reader.get<GLenum>();
+			GLint level = reader.get<GLint>();
+			GLint internalFormat = reader.get<GLint>();
+			GLsizei imageWidth = reader.get<GLsizei>();
+			GLsizei imageHeight = reader.get<GLsizei>();
+			GLint border = reader.get<GLint>();
+			GLenum format = reader.get<GLenum>();
+			GLenum type = reader.get<GLenum>();
+			uint8_t fromBuffer = reader.get<uint8_t>();
+			const void* pixels;
+			if (fromBuffer)
+			{
+				pixels = (const void*)(uintptr_t)reader.get<uint64_t>();
+			}
+			else
+			{
+				uint64_t size;
+				pixels = reader.getBlob(size);
+			}
+			glTexImage2D(textureTarget, level, internalFormat, imageWidth, imageHeight, border, format, type, pixels);
+			break;
+		}
+		case CallTexParameteri:
+		{
+			GLenum textureTarget = reader.get<GLenum>();
+			GLenum name = reader.get<GLenum>();
+			GLint value = reader.get<GLint>();
+			glTexParameteri(textureTarget, name, value);
+			break;
+		}
+		case CallUniform1f:
+		{
+			GLint location = reader.get<GLint>();
+			GLfloat v0 = reader.get<GLfloat>();
+			glUniform1f(mapLocation(location), v0);
+			break;
+		}
+		case CallUniform1i:
+		{
+			GLint location = reader.get<GLint>();
+			GLint v0 = reader.get<GLint>();
+			glUniform1i(mapLocation(location), v0);
+			break;
+		}
+		case CallUniform2f:
+		{
+			GLint location = reader.get<GLint>();
+			GLfloat v0 = reader.get<GLfloat>();
+			GLfloat v1 = reader.get<GLfloat>();
+			glUniform2f(mapLocation(location), v0, v1);
+			break;
+		}
+		case CallUniform4f:
+		{
+			GLint location = reader.get<GLint>();
+			GLfloat v0 = reader.get<GLfloat>();
+			GLfloat v1 = reader.get<GLfloat>();
+			GLfloat v2 = reader.get<GLfloat>();
+			GLfloat v3 = reader.get<GLfloat>();
+			glUniform4f(mapLocation(location), v0, v1, v2, v3);
+			break;
+		}
+		case CallUnmapBuffer:
+		{
+			GLenum bufferTarget = reader.get<GLenum>();
+			uint64_t dataSize;
+			const void* data = reader.getBlob(dataSize);
+			auto mapped = mappedPointers.find(getBoundReplayBuffer(bufferTarget));
+			if (mapped != mappedPointers.end())
+			{
+				if (data)
+				{
+					memcpy(mapped->second, data, (size_t)dataSize);
+				}
+				mappedPointers.erase(mapped);
+			}
+			glUnmapBuffer(bufferTarget);
+			break;
+		}
+		case CallUseProgram:
+		{
+			currentProgram = reader.get<GLuint>();
+			glUseProgram(mapName(programs, currentProgram));
+			break;
+		}
+		case CallVertexAttrib4f:
+		{
+			GLuint index = reader.get<GLuint>();
+			GLfloat x = reader.get<GLfloat>();
+			GLfloat y = reader.get<GLfloat>();
+			GLfloat z = reader.get<GLfloat>();
+			GLfloat w = reader.get<GLfloat>();
+			glVertexAttrib4f(index, x, y, z, w);
+			break;
+		}
+		case CallVertexAttrib4fv:
+		{
+			GLuint index = reader.get<GLuint>();
+			GLfloat values[4];
+			for (int i = 0; i < 4; i++)
+			{
+				values[i] = reader.get<GLfloat>();
+			}
+			glVertexAttrib4fv(index, values);
+			break;
+		}
+		case CallVertexAttribDivisor:
+		{
+			GLuint index = reader.get<GLuint>();
+			GLuint divisor = reader.get<GLuint>();
+			glVertexAttribDivisor(index, divisor);
+			break;
+		}
+		case CallVertexAttribPointer:
+		{
+			GLuint index = reader.get<GLuint>();
+			GLint size = reader.get<GLint>();
+			GLenum type = reader.get<GLenum>();
+			GLboolean normalized = reader.get<GLboolean>();
+			GLsizei stride = reader.get<GLsizei>();
+			uint64_t pointer = reader.get<uint64_t>();
+			glVertexAttribPointer(index, size, type, normalized, stride, (const void*)(uintptr_t)pointer);
+			break;
+		}
+		case CallViewport:
+		{
+			GLint x = reader.get<GLint>();
+			GLint y = reader.get<GLint>();
+			GLsizei viewportWidth = reader.get<GLsizei>();
+			GLsizei viewportHeight = reader.get<GLsizei>();
+			glViewport(x, y, viewportWidth, viewportHeight);
+			break;
+		}
+		case CallFrameMarker:
+		{
+			// Stands in for the swap, like a headless context
+			stats.calls--;
+			Clock::time_point submitEnd = Clock::now();
+			glFinish();
+			Clock::time_point frameEnd = Clock::now();
+			if (inSetup)
+			{
+				stats.setupMilliseconds = millisecondsBetween(start, frameEnd);
+				inSetup = false;
+			}
+			else
+			{
+				stats.submitMilliseconds.push_back(millisecondsBetween(frameStart, submitEnd));
+				stats.frameMilliseconds.push_back(millisecondsBetween(frameStart, frameEnd));
+			}
+			stats.frames++;
+			frameStart = frameEnd;
+			break;
+		}
+		default:
+			printf("ERROR: Unknown call %u in GL trace %s at byte %zu\n", call, filePath, reader.offset - sizeof(uint16_t));
+			reader.failed = true;
+			break;
+		}
+	}
+
+	glFinish();
+	glBindFramebuffer(GL_FRAMEBUFFER, target.Id);
+	if (reader.failed)
+	{
+		printf("ERROR: GL trace %s is truncated or corrupt, replay stopped after %llu calls\n", filePath, (unsigned long long)stats.calls);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "Framebuffer.h"
+
+#include <vector>
+#include <cstdint>
+
+// Capture of the OpenGL calls of a run into a binary trace, and replay of the trace on any
+// context, for measuring driver overhead and submission cost offline and deterministically.
+//
+// Capturing swaps the glad function pointers of the calls the engine makes for wrappers that
+// write the call and its arguments before calling through. Memory a call reads goes into the
+// trace with it: buffer and texture data, shader sources, and the writes made through mapped
+// buffer ranges (taken when the range is flushed or unmapped).
+// Object names, uniform locations and syncs are remapped on replay, and the default framebuffer
+// of the capture becomes a framebuffer object of the same size.
+//
+// The trace is a header and then one record per call: a 16 bit call id followed by the arguments
+// as they are in memory (little endian), blobs and strings prefixed by their 64 bit size.
+// NOTE While capturing, persistent mapping and multi-draw indirect are reported as unsupported:
+// writes to persistently mapped memory can't be seen, so those paths fall back to core 3.3
+struct GLCaptureStats
+{
+	uint32_t frames;
+	uint64_t calls;
+	uint64_t bytes;	// size of the trace
+};
+
+struct GLReplayStats
+{
+	uint32_t frames;
+	uint64_t calls;
+	double setupMilliseconds;	// everything before the first frame marker
+	std::vector<double> submitMilliseconds;	// per frame, issuing the calls
+	std::vector<double> frameMilliseconds;	// per frame, including the glFinish at its marker
+};
+
+// Starts recording, after gladLoadGLLoader and loadGLExtensions.
+// width and height are the size of the default framebuffer, for the replay.
+// defaultFramebuffer is recorded as framebuffer 0, for a headless context rendering into an FBO
+bool beginGLCapture(const char* filePath, int width, int height, GLuint defaultFramebuffer = 0);
+
+// Ends a frame in the trace, at the buffer swap. Does nothing when not capturing
+void markGLCaptureFrame();
+
+// Puts the glad function pointers back and closes the trace
+void endGLCapture();
+
+bool isGLCaptureActive();
+GLCaptureStats getGLCaptureStats();
+
+// Runs every call of a trace as fast as it can on the current context, with a glFinish at
+// every frame marker like a headless swap. Can't run while capturing.
+// target is created to stand in for the default framebuffer, the last frame can be read from it
+bool replayGLTrace(const char* filePath, Framebuffer& target, GLReplayStats& stats);
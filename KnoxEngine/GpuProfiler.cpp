@@ -0,0 +1,264 @@
+#include "GpuProfiler.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <map>
+
+GpuProfiler::GpuProfiler(size_t historyLimit)
+	: currentSlot(-1), frameIndex(0), openZoneCount(0), created(false), hasFirstTimestamp(false), firstTimestamp(0), historyLimit(historyLimit)
+{
+	memset(pendingFrames, 0, sizeof(pendingFrames));
+	stats = Stats();
+}
+
+void GpuProfiler::create()
+{
+	for (int i = 0; i < FrameLatency; i++)
+	{
+		glGenQueries(MaxZones * 2, pendingFrames[i].queries);
+		pendingFrames[i].zoneCount = 0;
+		pendingFrames[i].used = false;
+	}
+	currentSlot = -1;
+	openZoneCount = 0;
+	created = true;
+}
+
+void GpuProfiler::destroy()
+{
+	if (!created)
+	{
+		return;
+	}
+
+	// Oldest first, so the history stays in order
+	for (int i = 1; i <= FrameLatency; i++)
+	{
+		PendingFrame& frame = pendingFrames[(currentSlot + i + FrameLatency) % FrameLatency];
+		if (frame.used)
+		{
+			readBack(frame);
+		}
+	}
+
+	for (int i = 0; i < FrameLatency; i++)
+	{
+		glDeleteQueries(MaxZones * 2, pendingFrames[i].queries);
+	}
+	created = false;
+}
+
+void GpuProfiler::readBack(PendingFrame& frame)
+{
+	frame.used = false;
+	if (frame.zoneCount == 0)
+	{
+		return;
+	}
+
+	// The end of the root zone is the last query of the frame to complete
+	GLint available = 0;
+	glGetQueryObjectiv(frame.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+
+	GLuint64 timestamps[MaxZones * 2];
+	for (int i = 0; i < frame.zoneCount * 2; i++)
+	{
+		glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &timestamps[i]);
+	}
+
+	if (!hasFirstTimestamp)
+	{
+		firstTimestamp = timestamps[0];
+		hasFirstTimestamp = true;
+	}
+
+	Frame result;
+	result.index = frame.index;
+	result.startMilliseconds = (double)(int64_t)(timestamps[0] - firstTimestamp) / 1e6;
+	result.milliseconds = (double)(int64_t)(timestamps[1] - timestamps[0]) / 1e6;
+	result.zones.resize(frame.zoneCount);
+	for (int i = 0; i < frame.zoneCount; i++)
+	{
+		Zone& zone = result.zones[i];
+		zone.name = frame.names[i];
+		zone.depth = frame.depths[i];
+		zone.startMilliseconds = (double)(int64_t)(timestamps[i * 2] - timestamps[0]) / 1e6;
+		zone.milliseconds = (double)(int64_t)(timestamps[i * 2 + 1] - timestamps[i * 2]) / 1e6;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	stats.framesRead++;
+	if (!available)
+	{
+		stats.stalls++;
+	}
+	if (history.size() >= historyLimit && !history.empty())
+	{
+		history.pop_front();
+	}
+	history.push_back(result);
+}
+
+void GpuProfiler::beginFrame()
+{
+	currentSlot = (int)(frameIndex % FrameLatency);
+	PendingFrame& frame = pendingFrames[currentSlot];
+	if (frame.used)
+	{
+		readBack(frame);
+	}
+
+	frame.zoneCount = 0;
+	frame.index = frameIndex;
+	frame.used = true;
+	openZoneCount = 0;
+	beginZone("Frame");
+}
+
+void GpuProfiler::endFrame()
+{
+	while (openZoneCount > 0)
+	{
+		endZone();
+	}
+	frameIndex++;
+}
+
+void GpuProfiler::beginZone(const char* name)
+{
+	PendingFrame& frame = pendingFrames[currentSlot];
+	if (frame.zoneCount == MaxZones || openZoneCount == MaxZones)
+	{
+		// NOTE Still pushed so the matching endZone pops it
+		if (openZoneCount < MaxZones)
+		{
+			openZones[openZoneCount++] = -1;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.droppedZones++;
+		return;
+	}
+
+	int zone = frame.zoneCount++;
+	frame.names[zone] = name;
+	frame.depths[zone] = openZoneCount;
+	glQueryCounter(frame.queries[zone * 2], GL_TIMESTAMP);
+	openZones[openZoneCount++] = zone;
+}
+
+void GpuProfiler::endZone()
+{
+	if (openZoneCount == 0)
+	{
+		printf("ERROR: GPU profiler zone ended without beginning\n");
+		return;
+	}
+
+	int zone = openZones[--openZoneCount];
+	if (zone >= 0)
+	{
+		glQueryCounter(pendingFrames[currentSlot].queries[zone * 2 + 1], GL_TIMESTAMP);
+	}
+}
+
+bool GpuProfiler::getLatestFrame(Frame& frame)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (history.empty())
+	{
+		return false;
+	}
+	frame = history.back();
+	return true;
+}
+
+std::vector<GpuProfiler::Frame> GpuProfiler::getHistory()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return std::vector<Frame>(history.begin(), history.end());
+}
+
+GpuProfiler::Stats GpuProfiler::getStats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats;
+}
+
+void GpuProfiler::printSummary()
+{
+	std::vector<Frame> frames = getHistory();
+	Stats currentStats = getStats();
+	printf("GPU profile: %u frames, %u stalled read backs, %u dropped zones\n",
+		(uint32_t)frames.size(), (uint32_t)currentStats.stalls, (uint32_t)currentStats.droppedZones);
+	if (frames.empty())
+	{
+		return;
+	}
+
+	// Zones are told apart by depth and name, in the order they first appeared
+	typedef std::pair<int, std::string> Key;
+	struct Total
+	{
+		double milliseconds;
+		uint32_t count;
+	};
+	std::vector<Key> order;
+	std::map<Key, Total> totals;
+	for (size_t i = 0; i < frames.size(); i++)
+	{
+		for (size_t j = 0; j < frames[i].zones.size(); j++)
+		{
+			const Zone& zone = frames[i].zones[j];
+			Key key(zone.depth, zone.name);
+			auto found = totals.find(key);
+			if (found == totals.end())
+			{
+				order.push_back(key);
+				Total total = { 0.0, 0 };
+				found = totals.insert(std::make_pair(key, total)).first;
+			}
+			found->second.milliseconds += zone.milliseconds;
+			found->second.count++;
+		}
+	}
+
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		const Total& total = totals[order[i]];
+		int indent = order[i].first * 2;
+		printf("  %*s%-*s avg %8.4f ms  (%.2f per frame)\n", indent, "", 20 - indent, order[i].second.c_str(),
+			total.milliseconds / total.count, (double)total.count / frames.size());
+	}
+}
+
+bool GpuProfiler::writeChromeTrace(const char* filePath)
+{
+	FILE* file = fopen(filePath, "w");
+	if (!file)
+	{
+		printf("ERROR: Failed to open %s for writing\n", filePath);
+		return false;
+	}
+
+	std::vector<Frame> frames = getHistory();
+
+	// NOTE Zone names are string literals from the engine, they aren't escaped
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"GPU\"}}");
+	for (size_t i = 0; i < frames.size(); i++)
+	{
+		const Frame& frame = frames[i];
+		for (size_t j = 0; j < frame.zones.size(); j++)
+		{
+			const Zone& zone = frame.zones[j];
+			// Microseconds
+			fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu}}",
+				zone.name, (frame.startMilliseconds + zone.startMilliseconds) * 1000.0, zone.milliseconds * 1000.0, (unsigned long long)frame.index);
+		}
+	}
+	fprintf(file, "\n]}\n");
+
+	fclose(file);
+	return true;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+// GPU time of the passes of a frame, from glQueryCounter(GL_TIMESTAMP) queries around every zone.
+// Each frame gets its own set of queries out of a ring FrameLatency frames deep, and a set is
+// only read back when its slot comes around again. By then the GPU is long done with it, so
+// reading the results doesn't wait for the GPU (stats.stalls counts the times it had to).
+//
+// Zones nest, every frame has a root zone covering all of it. The results are kept as a
+// timeline of the last frames: readable from other threads while rendering, and exportable
+// as a Chrome trace (chrome://tracing, Perfetto).
+// NOTE Everything except the result getters has to run on the thread that owns the context
+class GpuProfiler
+{
+public:
+	static const int FrameLatency = 4;
+	static const int MaxZones = 64;	// per frame, including the root
+
+	struct Zone
+	{
+		const char* name;
+		int depth;
+		double startMilliseconds;	// from the start of the frame
+		double milliseconds;
+	};
+
+	struct Frame
+	{
+		uint64_t index;
+		double startMilliseconds;	// GPU time since the first profiled frame
+		double milliseconds;
+		std::vector<Zone> zones;	// in the order they began, zones[0] is the root
+	};
+
+	struct Stats
+	{
+		uint64_t framesRead;
+		uint64_t stalls;	// read backs that found the results not ready yet
+		uint64_t droppedZones;	// over MaxZones in a frame
+	};
+
+private:
+	struct PendingFrame
+	{
+		unsigned int queries[MaxZones * 2];	// begin and end timestamp of every zone
+		const char* names[MaxZones];
+		int depths[MaxZones];
+		int zoneCount;
+		uint64_t index;
+		bool used;
+	};
+
+	PendingFrame pendingFrames[FrameLatency];
+	int currentSlot;
+	uint64_t frameIndex;
+	int openZones[MaxZones];	// stack of the zones that began and haven't ended, -1 for dropped ones
+	int openZoneCount;
+	bool created;
+	bool hasFirstTimestamp;
+	GLuint64 firstTimestamp;
+
+	// NOTE Guards what other threads can read
+	std::mutex mutex;
+	std::deque<Frame> history;
+	size_t historyLimit;
+	Stats stats;
+
+	void readBack(PendingFrame& frame);
+
+public:
+	// Keeps the results of the last historyLimit frames
+	GpuProfiler(size_t historyLimit = 3600);
+
+	void create();
+	// Reads back the frames still in flight, waiting for them
+	void destroy();
+
+	// Opens the root zone of the frame, endFrame closes it along with any zone left open
+	void beginFrame();
+	void endFrame();
+
+	// name has to outlive the profiler, string literals are what's meant to be used
+	void beginZone(const char* name);
+	void endZone();
+
+	bool isCreated() const { return created; }
+
+	// Most recent frame that was read back, false if there's none yet
+	bool getLatestFrame(Frame& frame);
+	std::vector<Frame> getHistory();
+	Stats getStats();
+
+	// Average GPU milliseconds of every zone name over the history
+	void printSummary();
+
+	// Chrome trace event JSON, one complete event per zone on a "GPU" track
+	bool writeChromeTrace(const char* filePath);
+};
+
+// Zone for a scope, does nothing with a NULL profiler
+class GpuZone
+{
+private:
+	GpuProfiler* profiler;
+
+public:
+	GpuZone(GpuProfiler* profiler, const char* name) : profiler(profiler)
+	{
+		if (profiler)
+		{
+			profiler->beginZone(name);
+		}
+	}
+
+	~GpuZone()
+	{
+		if (profiler)
+		{
+			profiler->endZone();
+		}
+	}
+
+	GpuZone(const GpuZone&) = delete;
+	GpuZone& operator=(const GpuZone&) = delete;
+};
@@ -0,0 +1,317 @@
+#include <glad/glad.h>
+
+#include "HeadlessContext.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+// NOTE The few EGL and OSMesa declarations needed, so their headers don't have to be around at build time
+#ifdef _WIN32
+#define KNOX_EGLAPIENTRY __stdcall
+#else
+#define KNOX_EGLAPIENTRY
+#endif
+
+typedef int32_t EGLint;
+typedef unsigned int EGLBoolean;
+typedef unsigned int EGLenum;
+
+static const EGLint EGL_NONE_VALUE = 0x3038;
+static const EGLint EGL_EXTENSIONS_VALUE = 0x3055;
+static const EGLint EGL_RENDERABLE_TYPE_VALUE = 0x3040;
+static const EGLint EGL_OPENGL_BIT_VALUE = 0x0008;
+static const EGLint EGL_CONTEXT_MAJOR_VERSION_VALUE = 0x3098;
+static const EGLint EGL_CONTEXT_MINOR_VERSION_VALUE = 0x30FB;
+static const EGLint EGL_CONTEXT_OPENGL_PROFILE_MASK_VALUE = 0x30FD;
+static const EGLint EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_VALUE = 0x0001;
+static const EGLenum EGL_OPENGL_API_VALUE = 0x30A2;
+static const EGLenum EGL_PLATFORM_SURFACELESS_MESA_VALUE = 0x31DD;
+
+typedef void* (KNOX_EGLAPIENTRY *EglGetProcAddress)(const char* name);
+typedef void* (KNOX_EGLAPIENTRY *EglGetDisplay)(void* nativeDisplay);
+typedef void* (KNOX_EGLAPIENTRY *EglGetPlatformDisplayExt)(EGLenum platform, void* nativeDisplay, const EGLint* attributes);
+typedef EGLBoolean (KNOX_EGLAPIENTRY *EglInitialize)(void* display, EGLint* major, EGLint* minor);
+typedef EGLBoolean (KNOX_EGLAPIENTRY *EglTerminate)(void* display);
+typedef const char* (KNOX_EGLAPIENTRY *EglQueryString)(void* display, EGLint name);
+typedef EGLBoolean (KNOX_EGLAPIENTRY *EglBindApi)(EGLenum api);
+typedef EGLBoolean (KNOX_EGLAPIENTRY *EglChooseConfig)(void* display, const EGLint* attributes, void** configs, EGLint configSize, EGLint* configCount);
+typedef void* (KNOX_EGLAPIENTRY *EglCreateContext)(void* display, void* config, void* shareContext, const EGLint* attributes);
+typedef EGLBoolean (KNOX_EGLAPIENTRY *EglDestroyContext)(void* display, void* context);
+typedef EGLBoolean (KNOX_EGLAPIENTRY *EglMakeCurrent)(void* display, void* draw, void* read, void* context);
+typedef EGLint (KNOX_EGLAPIENTRY *EglGetError)();
+
+static const int OSMESA_FORMAT_VALUE = 0x22;
+static const int OSMESA_DEPTH_BITS_VALUE = 0x30;
+static const int OSMESA_PROFILE_VALUE = 0x33;
+static const int OSMESA_CORE_PROFILE_VALUE = 0x34;
+static const int OSMESA_CONTEXT_MAJOR_VERSION_VALUE = 0x36;
+static const int OSMESA_CONTEXT_MINOR_VERSION_VALUE = 0x37;
+
+typedef void* (*OsMesaCreateContextAttribs)(const int* attributes, void* shareContext);
+typedef unsigned char (*OsMesaMakeCurrent)(void* context, void* buffer, unsigned int type, int width, int height);
+typedef void (*OsMesaDestroyContext)(void* context);
+typedef void* (*OsMesaGetProcAddress)(const char* name);
+
+// The entry points of the backend in use, the context is one per process anyway
+static struct
+{
+	EglGetProcAddress getProcAddress;
+	EglTerminate terminate;
+	EglDestroyContext destroyContext;
+	EglMakeCurrent makeCurrent;
+} egl;
+
+static struct
+{
+	OsMesaMakeCurrent makeCurrent;
+	OsMesaDestroyContext destroyContext;
+	OsMesaGetProcAddress getProcAddress;
+} osMesa;
+
+static HeadlessContext::Backend loadedBackend = HeadlessContext::BackendNone;
+
+static void* openLibrary(const char* const* names)
+{
+	for (int i = 0; names[i]; i++)
+	{
+#ifdef _WIN32
+		void* library = (void*)LoadLibraryA(names[i]);
+#else
+		void* library = dlopen(names[i], RTLD_NOW | RTLD_LOCAL);
+#endif
+		if (library)
+		{
+			return library;
+		}
+	}
+	return NULL;
+}
+
+static void closeLibrary(void* library)
+{
+#ifdef _WIN32
+	FreeLibrary((HMODULE)library);
+#else
+	dlclose(library);
+#endif
+}
+
+static void* findSymbol(void* library, const char* name)
+{
+#ifdef _WIN32
+	return (void*)GetProcAddress((HMODULE)library, name);
+#else
+	return dlsym(library, name);
+#endif
+}
+
+HeadlessContext::HeadlessContext() : backend(BackendNone), library(NULL), display(NULL), context(NULL)
+{
+	memset(osMesaBuffer, 0, sizeof(osMesaBuffer));
+}
+
+bool HeadlessContext::create(int majorVersion, int minorVersion)
+{
+	////////////////////////////////////
+	//
+	// EGL
+	//
+	static const char* const eglNames[] = { "libEGL.so.1", "libEGL.so", "libEGL.dll", NULL };
+	library = openLibrary(eglNames);
+	if (library)
+	{
+		egl.getProcAddress = (EglGetProcAddress)findSymbol(library, "eglGetProcAddress");
+		egl.terminate = (EglTerminate)findSymbol(library, "eglTerminate");
+		egl.destroyContext = (EglDestroyContext)findSymbol(library, "eglDestroyContext");
+		egl.makeCurrent = (EglMakeCurrent)findSymbol(library, "eglMakeCurrent");
+		EglGetDisplay getDisplay = (EglGetDisplay)findSymbol(library, "eglGetDisplay");
+		EglInitialize initialize = (EglInitialize)findSymbol(library, "eglInitialize");
+		EglQueryString queryString = (EglQueryString)findSymbol(library, "eglQueryString");
+		EglBindApi bindApi = (EglBindApi)findSymbol(library, "eglBindAPI");
+		EglChooseConfig chooseConfig = (EglChooseConfig)findSymbol(library, "eglChooseConfig");
+		EglCreateContext createContext = (EglCreateContext)findSymbol(library, "eglCreateContext");
+		EglGetError getError = (EglGetError)findSymbol(library, "eglGetError");
+
+		if (egl.getProcAddress && egl.terminate && egl.destroyContext && egl.makeCurrent && getDisplay && initialize &&
+			queryString && bindApi && chooseConfig && createContext && getError)
+		{
+			// NOTE Surfaceless needs no X11/Wayland connection, the default display is the fallback for other drivers
+			const char* clientExtensions = queryString(NULL, EGL_EXTENSIONS_VALUE);
+			EglGetPlatformDisplayExt getPlatformDisplay = (EglGetPlatformDisplayExt)egl.getProcAddress("eglGetPlatformDisplayEXT");
+			if (clientExtensions && strstr(clientExtensions, "EGL_MESA_platform_surfaceless") && getPlatformDisplay)
+			{
+				display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA_VALUE, NULL, NULL);
+			}
+			if (!display)
+			{
+				display = getDisplay(NULL);
+			}
+
+			EGLint major, minor;
+			if (display && initialize(display, &major, &minor) && bindApi(EGL_OPENGL_API_VALUE))
+			{
+				EGLint contextAttributes[] = {
+					EGL_CONTEXT_MAJOR_VERSION_VALUE, majorVersion,
+					EGL_CONTEXT_MINOR_VERSION_VALUE, minorVersion,
+					EGL_CONTEXT_OPENGL_PROFILE_MASK_VALUE, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_VALUE,
+					EGL_NONE_VALUE
+				};
+
+				// No surface is ever made, so any config will do, or none at all with EGL_KHR_no_config_context
+				void* config = NULL;
+				const char* displayExtensions = queryString(display, EGL_EXTENSIONS_VALUE);
+				if (!displayExtensions || !strstr(displayExtensions, "EGL_KHR_no_config_context"))
+				{
+					EGLint configAttributes[] = { EGL_RENDERABLE_TYPE_VALUE, EGL_OPENGL_BIT_VALUE, EGL_NONE_VALUE };
+					EGLint configCount = 0;
+					chooseConfig(display, configAttributes, &config, 1, &configCount);
+				}
+
+				context = createContext(display, config, NULL, contextAttributes);
+				if (context)
+				{
+					backend = BackendEgl;
+					loadedBackend = backend;
+					return true;
+				}
+				printf("ERROR: eglCreateContext failed for OpenGL %d.%d core (0x%X)\n", majorVersion, minorVersion, getError());
+				egl.terminate(display);
+			}
+			display = NULL;
+		}
+		closeLibrary(library);
+		library = NULL;
+	}
+
+	////////////////////////////////////
+	//
+	// OSMesa
+	//
+	static const char* const osMesaNames[] = { "libOSMesa.so.8", "libOSMesa.so.6", "libOSMesa.so", "osmesa.dll", NULL };
+	library = openLibrary(osMesaNames);
+	if (library)
+	{
+		OsMesaCreateContextAttribs createContext = (OsMesaCreateContextAttribs)findSymbol(library, "OSMesaCreateContextAttribs");
+		osMesa.makeCurrent = (OsMesaMakeCurrent)findSymbol(library, "OSMesaMakeCurrent");
+		osMesa.destroyContext = (OsMesaDestroyContext)findSymbol(library, "OSMesaDestroyContext");
+		osMesa.getProcAddress = (OsMesaGetProcAddress)findSymbol(library, "OSMesaGetProcAddress");
+
+		if (createContext && osMesa.makeCurrent && osMesa.destroyContext && osMesa.getProcAddress)
+		{
+			int attributes[] = {
+				OSMESA_FORMAT_VALUE, GL_RGBA,
+				OSMESA_DEPTH_BITS_VALUE, 24,
+				OSMESA_PROFILE_VALUE, OSMESA_CORE_PROFILE_VALUE,
+				OSMESA_CONTEXT_MAJOR_VERSION_VALUE, majorVersion,
+				OSMESA_CONTEXT_MINOR_VERSION_VALUE, minorVersion,
+				0
+			};
+			context = createContext(attributes, NULL);
+			if (context)
+			{
+				backend = BackendOsMesa;
+				loadedBackend = backend;
+				return true;
+			}
+			printf("ERROR: OSMesaCreateContextAttribs failed for OpenGL %d.%d core\n", majorVersion, minorVersion);
+		}
+		closeLibrary(library);
+		library = NULL;
+	}
+
+	printf("ERROR: No headless OpenGL context, needs libEGL (surfaceless) or libOSMesa\n");
+	return false;
+}
+
+void HeadlessContext::destroy()
+{
+	if (backend == BackendEgl)
+	{
+		egl.makeCurrent(display, NULL, NULL, NULL);
+		egl.destroyContext(display, context);
+		egl.terminate(display);
+	}
+	else if (backend == BackendOsMesa)
+	{
+		osMesa.makeCurrent(NULL, NULL, 0, 0, 0);
+		osMesa.destroyContext(context);
+	}
+
+	if (library)
+	{
+		closeLibrary(library);
+	}
+	backend = BackendNone;
+	loadedBackend = BackendNone;
+	library = NULL;
+	display = NULL;
+	context = NULL;
+}
+
+void HeadlessContext::makeCurrent()
+{
+	if (backend == BackendEgl)
+	{
+		egl.makeCurrent(display, NULL, NULL, context);
+	}
+	else if (backend == BackendOsMesa)
+	{
+		osMesa.makeCurrent(context, osMesaBuffer, GL_UNSIGNED_BYTE, 1, 1);
+	}
+}
+
+void HeadlessContext::releaseCurrent()
+{
+	if (backend == BackendEgl)
+	{
+		egl.makeCurrent(display, NULL, NULL, NULL);
+	}
+	else if (backend == BackendOsMesa)
+	{
+		osMesa.makeCurrent(NULL, NULL, 0, 0, 0);
+	}
+}
+
+void HeadlessContext::swapBuffers()
+{
+	glFinish();
+}
+
+const char* HeadlessContext::getBackendName() const
+{
+	switch (backend)
+	{
+	case BackendEgl:
+		return "EGL";
+	case BackendOsMesa:
+		return "OSMesa";
+	default:
+		return "none";
+	}
+}
+
+void* HeadlessContext::getProcAddress(const char* name)
+{
+	if (loadedBackend == BackendEgl)
+	{
+		return egl.getProcAddress(name);
+	}
+	if (loadedBackend == BackendOsMesa)
+	{
+		return osMesa.getProcAddress(name);
+	}
+	return NULL;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+// OpenGL context without a window, for servers and CI machines without a display.
+// Tries a surfaceless EGL display first (Mesa, including llvmpipe on machines without a GPU,
+// and the EGL of the GPU drivers), then OSMesa. Both libraries are loaded at runtime,
+// so there's no build dependency on them and create just fails where they aren't installed.
+//
+// There's no default framebuffer: everything has to be rendered into a framebuffer object.
+// Like a GLFW context it can be current on one thread at a time
+class HeadlessContext
+{
+public:
+	enum Backend
+	{
+		BackendNone,
+		BackendEgl,
+		BackendOsMesa
+	};
+
+private:
+	Backend backend;
+	void* library;
+	void* display;
+	void* context;
+	unsigned char osMesaBuffer[4];	// OSMesa needs something to make current with, 1x1 RGBA
+
+public:
+	HeadlessContext();
+
+	// Core profile of the given version, false (with an error printed) if no backend could create one
+	bool create(int majorVersion = 3, int minorVersion = 3);
+	void destroy();
+
+	void makeCurrent();
+	void releaseCurrent();
+
+	// Stands in for the buffer swap: waits for the frame to finish rendering, so frames
+	// don't queue up in the driver and frame times include the GPU work
+	void swapBuffers();
+
+	Backend getBackend() const { return backend; }
+	const char* getBackendName() const;
+
+	// Loader for GLAD, valid after create
+	static void* getProcAddress(const char* name);
+};
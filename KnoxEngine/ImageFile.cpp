@@ -0,0 +1,74 @@
+#include "ImageFile.h"
+
+#include <cstdio>
+#include <vector>
+
+bool writePpm(const char* filePath, const unsigned char* rgba, int width, int height, bool bottomUp)
+{
+	FILE* file = fopen(filePath, "wb");
+	if (!file)
+	{
+		printf("ERROR: Failed to open %s for writing\n", filePath);
+		return false;
+	}
+
+	fprintf(file, "P6\n%d %d\n255\n", width, height);
+	std::vector<unsigned char> row((size_t)width * 3);
+	for (int y = 0; y < height; y++)
+	{
+		const unsigned char* source = rgba + (size_t)(bottomUp ? height - 1 - y : y) * width * 4;
+		for (int x = 0; x < width; x++)
+		{
+			row[x * 3 + 0] = source[x * 4 + 0];
+			row[x * 3 + 1] = source[x * 4 + 1];
+			row[x * 3 + 2] = source[x * 4 + 2];
+		}
+		fwrite(row.data(), 1, row.size(), file);
+	}
+	fclose(file);
+	return true;
+}
+
+bool readPpm(const char* filePath, std::vector<unsigned char>& rgba, int& width, int& height, bool bottomUp)
+{
+	FILE* file = fopen(filePath, "rb");
+	if (!file)
+	{
+		printf("ERROR: Failed to open %s\n", filePath);
+		return false;
+	}
+
+	// NOTE The header is whitespace separated and the single whitespace after the maximum value ends it,
+	// writePpm doesn't write comments so they aren't handled
+	int maxValue = 0;
+	if (fscanf(file, "P6 %d %d %d", &width, &height, &maxValue) != 3 || maxValue != 255 || width <= 0 || height <= 0)
+	{
+		printf("ERROR: %s isn't a binary PPM with 8 bit channels\n", filePath);
+		fclose(file);
+		return false;
+	}
+	fgetc(file);
+
+	rgba.resize((size_t)width * height * 4);
+	std::vector<unsigned char> row((size_t)width * 3);
+	for (int y = 0; y < height; y++)
+	{
+		if (fread(row.data(), 1, row.size(), file) != row.size())
+		{
+			printf("ERROR: %s is truncated\n", filePath);
+			fclose(file);
+			return false;
+		}
+
+		unsigned char* destination = &rgba[(size_t)(bottomUp ? height - 1 - y : y) * width * 4];
+		for (int x = 0; x < width; x++)
+		{
+			destination[x * 4 + 0] = row[x * 3 + 0];
+			destination[x * 4 + 1] = row[x * 3 + 1];
+			destination[x * 4 + 2] = row[x * 3 + 2];
+			destination[x * 4 + 3] = 255;
+		}
+	}
+	fclose(file);
+	return true;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <vector>
+
+// Binary PPM (P6) of RGBA8 pixels, alpha is dropped. bottomUp is for pixels read back
+// with glReadPixels, whose first row is the bottom of the image
+bool writePpm(const char* filePath, const unsigned char* rgba, int width, int height, bool bottomUp);
+
+// Reads a binary PPM with 8 bit channels back into RGBA8 with an alpha of 255,
+// bottomUp puts the last row first like glReadPixels
+bool readPpm(const char* filePath, std::vector<unsigned char>& rgba, int& width, int& height, bool bottomUp);
@@ -0,0 +1,701 @@
+#include <glad/glad.h>
+
+#include "ImageRegression.h"
+#include "Framebuffer.h"
+#include "ImageFile.h"
+#include "FrameBenchmark.h"
+#include "BufferArena.h"
+#include "InstanceBatcher.h"
+#include "StatsOverlay.h"
+#include "Shader.h"
+#include "MathTypes.h"
+#include "resources/utils/stb_image.h"
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static const int SceneSize = 256;
+static const int WarmupFrames = 3;
+static const int TimedFrames = 20;
+
+static const uint32_t PixelThreshold = 16;				// channel difference a pixel counts as different from
+static const double MaxDifferentPixels = 0.001;			// fraction of the image
+static const double MinSsim = 0.99;
+static const double MaxSlowdown = 1.25;					// median frame against the baseline
+static const double SlowdownSlackMilliseconds = 0.1;	// so scenes this small don't fail on timer noise
+
+static double millisecondsBetween(Clock::time_point start, Clock::time_point end)
+{
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+////////////////////////////////////
+//
+// Comparison
+//
+// Mean of the SSIM of 8x8 windows of the luminance, a window every 4 pixels
+static double computeSsim(const unsigned char* a, const unsigned char* b, int width, int height)
+{
+	const int WindowSize = 8;
+	const int WindowStride = 4;
+	if (width < WindowSize || height < WindowSize)
+	{
+		return memcmp(a, b, (size_t)width * height * 4) == 0 ? 1.0 : 0.0;
+	}
+
+	// NOTE Padded to a multiple of 4 floats, so rows can be loaded 4 at a time
+	size_t pixelCount = (size_t)width * height;
+	std::vector<float> luminanceA(pixelCount + 4), luminanceB(pixelCount + 4);
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		luminanceA[i] = 0.299f * a[i * 4 + 0] + 0.587f * a[i * 4 + 1] + 0.114f * a[i * 4 + 2];
+		luminanceB[i] = 0.299f * b[i * 4 + 0] + 0.587f * b[i * 4 + 1] + 0.114f * b[i * 4 + 2];
+	}
+
+	const double C1 = (0.01 * 255.0) * (0.01 * 255.0);
+	const double C2 = (0.03 * 255.0) * (0.03 * 255.0);
+	const double n = WindowSize * WindowSize;
+
+	double ssimSum = 0.0;
+	int windowCount = 0;
+	for (int y = 0; y + WindowSize <= height; y += WindowStride)
+	{
+		for (int x = 0; x + WindowSize <= width; x += WindowStride)
+		{
+			float sumA, sumB, sumAA, sumBB, sumAB;
+#if KNOX_MATH_SSE
+			__m128 vectorA = _mm_setzero_ps(), vectorB = _mm_setzero_ps();
+			__m128 vectorAA = _mm_setzero_ps(), vectorBB = _mm_setzero_ps(), vectorAB = _mm_setzero_ps();
+			for (int row = 0; row < WindowSize; row++)
+			{
+				const float* rowA = &luminanceA[(size_t)(y + row) * width + x];
+				const float* rowB = &luminanceB[(size_t)(y + row) * width + x];
+				for (int column = 0; column < WindowSize; column += 4)
+				{
+					__m128 valuesA = _mm_loadu_ps(rowA + column);
+					__m128 valuesB = _mm_loadu_ps(rowB + column);
+					vectorA = _mm_add_ps(vectorA, valuesA);
+					vectorB = _mm_add_ps(vectorB, valuesB);
+					vectorAA = multiplyAdd(valuesA, valuesA, vectorAA);
+					vectorBB = multiplyAdd(valuesB, valuesB, vectorBB);
+					vectorAB = multiplyAdd(valuesA, valuesB, vectorAB);
+				}
+			}
+
+			alignas(16) float sums[5][4];
+			_mm_store_ps(sums[0], vectorA);
+			_mm_store_ps(sums[1], vectorB);
+			_mm_store_ps(sums[2], vectorAA);
+			_mm_store_ps(sums[3], vectorBB);
+			_mm_store_ps(sums[4], vectorAB);
+			sumA = sums[0][0] + sums[0][1] + sums[0][2] + sums[0][3];
+			sumB = sums[1][0] + sums[1][1] + sums[1][2] + sums[1][3];
+			sumAA = sums[2][0] + sums[2][1] + sums[2][2] + sums[2][3];
+			sumBB = sums[3][0] + sums[3][1] + sums[3][2] + sums[3][3];
+			sumAB = sums[4][0] + sums[4][1] + sums[4][2] + sums[4][3];
+#else
+			sumA = sumB = sumAA = sumBB = sumAB = 0.0f;
+			for (int row = 0; row < WindowSize; row++)
+			{
+				const float* rowA = &luminanceA[(size_t)(y + row) * width + x];
+				const float* rowB = &luminanceB[(size_t)(y + row) * width + x];
+				for (int column = 0; column < WindowSize; column++)
+				{
+					sumA += rowA[column];
+					sumB += rowB[column];
+					sumAA += rowA[column] * rowA[column];
+					sumBB += rowB[column] * rowB[column];
+					sumAB += rowA[column] * rowB[column];
+				}
+			}
+#endif
+
+			double meanA = sumA / n;
+			double meanB = sumB / n;
+			double varianceA = sumAA / n - meanA * meanA;
+			double varianceB = sumBB / n - meanB * meanB;
+			double covariance = sumAB / n - meanA * meanB;
+			ssimSum += ((2.0 * meanA * meanB + C1) * (2.0 * covariance + C2)) /
+				((meanA * meanA + meanB * meanB + C1) * (varianceA + varianceB + C2));
+			windowCount++;
+		}
+	}
+	return ssimSum / windowCount;
+}
+
+ImageDifference compareImages(const unsigned char* a, const unsigned char* b, int width, int height, uint32_t threshold)
+{
+	ImageDifference difference = {};
+	size_t pixelCount = (size_t)width * height;
+	uint64_t differenceSum = 0;
+	size_t i = 0;
+
+#if KNOX_MATH_SSE
+	// 4 pixels at a time: absolute byte differences with the alpha masked out, summed with SAD,
+	// and the largest channel of every pixel shifted down into its low byte
+	const __m128i rgbMask = _mm_set1_epi32(0x00FFFFFF);
+	const __m128i lowByteMask = _mm_set1_epi32(0xFF);
+	const __m128i thresholdVector = _mm_set1_epi32((int)threshold);
+	const __m128i zero = _mm_setzero_si128();
+	__m128i sums = _mm_setzero_si128();
+	__m128i maxima = _mm_setzero_si128();
+	for (; i + 4 <= pixelCount; i += 4)
+	{
+		__m128i pixelsA = _mm_loadu_si128((const __m128i*)(a + i * 4));
+		__m128i pixelsB = _mm_loadu_si128((const __m128i*)(b + i * 4));
+		__m128i channelDifference = _mm_and_si128(_mm_or_si128(_mm_subs_epu8(pixelsA, pixelsB), _mm_subs_epu8(pixelsB, pixelsA)), rgbMask);
+		sums = _mm_add_epi64(sums, _mm_sad_epu8(channelDifference, zero));
+
+		__m128i pixelMaximum = _mm_max_epu8(channelDifference, _mm_srli_epi32(channelDifference, 8));
+		pixelMaximum = _mm_and_si128(_mm_max_epu8(pixelMaximum, _mm_srli_epi32(channelDifference, 16)), lowByteMask);
+		maxima = _mm_max_epu8(maxima, pixelMaximum);
+
+		int overThreshold = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(pixelMaximum, thresholdVector)));
+		difference.differentPixels += (overThreshold & 1) + ((overThreshold >> 1) & 1) + ((overThreshold >> 2) & 1) + (overThreshold >> 3);
+	}
+
+	alignas(16) uint64_t sumLanes[2];
+	alignas(16) uint32_t maximumLanes[4];
+	_mm_store_si128((__m128i*)sumLanes, sums);
+	_mm_store_si128((__m128i*)maximumLanes, maxima);
+	differenceSum = sumLanes[0] + sumLanes[1];
+	for (int lane = 0; lane < 4; lane++)
+	{
+		if (maximumLanes[lane] > difference.maxDifference)
+		{
+			difference.maxDifference = maximumLanes[lane];
+		}
+	}
+#endif
+
+	for (; i < pixelCount; i++)
+	{
+		uint32_t pixelMaximum = 0;
+		for (int channel = 0; channel < 3; channel++)
+		{
+			int channelDifference = (int)a[i * 4 + channel] - (int)b[i * 4 + channel];
+			uint32_t absoluteDifference = (uint32_t)(channelDifference < 0 ? -channelDifference : channelDifference);
+			differenceSum += absoluteDifference;
+			if (absoluteDifference > pixelMaximum)
+			{
+				pixelMaximum = absoluteDifference;
+			}
+		}
+		if (pixelMaximum > threshold)
+		{
+			difference.differentPixels++;
+		}
+		if (pixelMaximum > difference.maxDifference)
+		{
+			difference.maxDifference = pixelMaximum;
+		}
+	}
+
+	difference.meanDifference = pixelCount > 0 ? (double)differenceSum / (pixelCount * 3) : 0.0;
+	difference.ssim = computeSsim(a, b, width, height);
+	return difference;
+}
+
+
+////////////////////////////////////
+//
+// Scenes
+//
+struct RegressionResources
+{
+	Shader* shader;
+	unsigned int woodTexture;
+	unsigned int faceTexture;
+	BufferArena* bufferArena;
+	MeshRange quad;
+	InstanceBatcher* batcher;
+	StatsOverlay overlay;
+};
+
+struct RegressionScene
+{
+	const char* name;
+	void (*draw)(RegressionResources& resources);
+};
+
+// RGBA whatever the file has, with mipmaps, so the scenes can pick their filtering
+static unsigned int loadTexture(const char* filePath)
+{
+	int width, height, channels;
+	unsigned char* data = stbi_load(filePath, &width, &height, &channels, 4);
+	if (!data)
+	{
+		printf("ERROR: Failed to load texture from %s\n", filePath);
+		return 0;
+	}
+
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	stbi_image_free(data);
+	return texture;
+}
+
+static void setMinFilter(unsigned int texture, GLint filter)
+{
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+}
+
+static void clearScene()
+{
+	glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+static void bindQuad(RegressionResources& resources, unsigned int texture1, unsigned int texture2, float mixValue)
+{
+	glUseProgram(resources.shader->Id);
+	resources.shader->setFloat("mixValue", mixValue);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture1);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, texture2);
+	glBindVertexArray(resources.bufferArena->VAO);
+}
+
+// One glDrawElements, the transform goes through the generic attribute values
+static void drawQuad(const RegressionResources& resources, const mat4& transform)
+{
+	for (GLuint column = 0; column < 4; column++)
+	{
+		glVertexAttrib4fv(InstanceBatcher::TransformLocation + column, &transform.m[column * 4]);
+	}
+	glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)resources.quad.indexCount, GL_UNSIGNED_INT,
+		(void *)((size_t)resources.quad.firstIndex() * sizeof(unsigned int)), resources.quad.baseVertex());
+}
+
+// Magnified and rotated, bilinear
+static void drawTexturedQuad(RegressionResources& resources)
+{
+	clearScene();
+	setMinFilter(resources.woodTexture, GL_LINEAR);
+	setMinFilter(resources.faceTexture, GL_LINEAR);
+	bindQuad(resources, resources.woodTexture, resources.faceTexture, 0.2f);
+	drawQuad(resources, composeTransform(vec3(0.0f, 0.0f, 0.0f), quatFromAxisAngle(vec3(0.0f, 0.0f, 1.0f), 0.5f), vec3(1.4f, 1.4f, 1.0f)));
+}
+
+// Heavily minified, trilinear, through the instanced path
+static void drawMipmappedGrid(RegressionResources& resources)
+{
+	const int side = 32;
+	clearScene();
+	setMinFilter(resources.woodTexture, GL_LINEAR_MIPMAP_LINEAR);
+	setMinFilter(resources.faceTexture, GL_LINEAR_MIPMAP_LINEAR);
+	bindQuad(resources, resources.woodTexture, resources.faceTexture, 0.5f);
+
+	DrawItem item;
+	item.program = resources.shader->Id;
+	item.materialId = 0;
+	item.textures[0] = resources.woodTexture;
+	item.textures[1] = resources.faceTexture;
+	item.vertexArray = resources.bufferArena->VAO;
+	item.indexCount = resources.quad.indexCount;
+	item.firstIndex = resources.quad.firstIndex();
+	item.baseVertex = resources.quad.baseVertex();
+
+	float cellSize = 2.0f / side;
+	for (int i = 0; i < side * side; i++)
+	{
+		vec3 position(-1.0f + cellSize * (i % side + 0.5f), -1.0f + cellSize * (i / side + 0.5f), 0.0f);
+		quat orientation = quatFromAxisAngle(vec3(0.0f, 0.0f, 1.0f), 0.05f * i);
+		mat4 transform = composeTransform(position, orientation, vec3(cellSize, cellSize, 1.0f));
+		resources.batcher->submit(item, transform.m);
+	}
+	resources.batcher->flush();
+	InstanceBatcher::setDefaultTransform();
+}
+
+// Alpha of the face texture blended over the wood, overlapping
+static void drawBlendedQuads(RegressionResources& resources)
+{
+	clearScene();
+	setMinFilter(resources.woodTexture, GL_LINEAR);
+	setMinFilter(resources.faceTexture, GL_LINEAR);
+	bindQuad(resources, resources.woodTexture, resources.woodTexture, 0.0f);
+	drawQuad(resources, scaling(vec3(2.0f, 2.0f, 1.0f)));
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	bindQuad(resources, resources.faceTexture, resources.faceTexture, 0.0f);
+	for (int i = 0; i < 5; i++)
+	{
+		float angle = 1.2566f * i;
+		vec3 position(0.35f * std::cos(angle), 0.35f * std::sin(angle), 0.0f);
+		drawQuad(resources, composeTransform(position, quatFromAxisAngle(vec3(0.0f, 0.0f, 1.0f), angle), vec3(0.9f, 0.9f, 1.0f)));
+	}
+	glDisable(GL_BLEND);
+}
+
+// The overlay's glyph atlas and text shader over the main scene
+static void drawOverlayText(RegressionResources& resources)
+{
+	clearScene();
+	setMinFilter(resources.woodTexture, GL_LINEAR);
+	setMinFilter(resources.faceTexture, GL_LINEAR);
+	bindQuad(resources, resources.woodTexture, resources.faceTexture, 0.5f);
+	drawQuad(resources, scaling(vec3(2.0f, 2.0f, 1.0f)));
+
+	resources.overlay.clear();
+	resources.overlay.addLine("Knox image regression");
+	resources.overlay.addLine("%dx%d", SceneSize, SceneSize);
+	resources.overlay.addLine("0123456789 +-.:%%");
+	resources.overlay.draw();
+}
+
+static const RegressionScene Scenes[] = {
+	{ "textured-quad", drawTexturedQuad },
+	{ "mipmapped-grid", drawMipmappedGrid },
+	{ "blended-quads", drawBlendedQuads },
+	{ "overlay-text", drawOverlayText }
+};
+static const int SceneCount = sizeof(Scenes) / sizeof(Scenes[0]);
+
+static bool createResources(RegressionResources& resources)
+{
+	resources.woodTexture = loadTexture("resources/textures/wood-container.jpg");
+	resources.faceTexture = loadTexture("resources/textures/awesomeface.png");
+
+	float vertices[] = {
+		 0.5f,  0.5f, 0.0f,		1.0f, 0.0f, 0.0f,		1.0f, 0.0f,
+		 0.5f, -0.5f, 0.0f,		0.0f, 1.0f, 0.0f,		1.0f, 1.0f,
+		-0.5f, -0.5f, 0.0f,		0.0f, 0.0f, 1.0f,		0.0f, 1.0f,
+		-0.5f,  0.5f, 0.0f,		1.0f, 1.0f, 1.0f,		0.0f, 0.0f
+	};
+	unsigned int indices[] = { 0, 1, 3, 1, 2, 3 };
+	resources.bufferArena = new BufferArena(1024, 1024);
+	resources.bufferArena->allocate(4, 6, resources.quad);
+	resources.bufferArena->upload(resources.quad, vertices, indices);
+
+	resources.shader = new Shader("resources/shaders/VertexShader.txt", "resources/shaders/FragmentShader.txt");
+	glUseProgram(resources.shader->Id);
+	resources.shader->setInt("texture1", 0);
+	resources.shader->setInt("texture2", 1);
+
+	resources.batcher = new InstanceBatcher(4096);
+	resources.overlay.create();
+	InstanceBatcher::setDefaultTransform();
+	return resources.woodTexture != 0 && resources.faceTexture != 0;
+}
+
+static void destroyResources(RegressionResources& resources)
+{
+	resources.overlay.destroy();
+	resources.batcher->destroy();
+	delete resources.batcher;
+
+	glDeleteProgram(resources.shader->Id);
+	delete resources.shader;
+
+	resources.bufferArena->free(resources.quad);
+	resources.bufferArena->destroy();
+	delete resources.bufferArena;
+
+	glDeleteTextures(1, &resources.woodTexture);
+	glDeleteTextures(1, &resources.faceTexture);
+}
+
+
+////////////////////////////////////
+//
+// Run
+//
+struct SceneRun
+{
+	Framebuffer framebuffer;
+	unsigned int pixelBuffer;
+	GLsync readbackFence;
+	std::vector<double> submitMilliseconds;
+	std::vector<double> frameMilliseconds;
+	double readbackMilliseconds;	// what the CPU waited for the pixels after all the scenes were rendered
+	std::vector<unsigned char> pixels;	// RGBA8, bottom row first
+
+	ImageDifference difference;
+	double baselineMilliseconds;	// 0 without a baseline
+	bool imagePassed;
+	bool timingPassed;
+};
+
+// glReadPixels into a pixel pack buffer only queues the copy, the next scenes render while it runs
+static void startReadback(SceneRun& run)
+{
+	size_t size = (size_t)SceneSize * SceneSize * 4;
+	glGenBuffers(1, &run.pixelBuffer);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, run.pixelBuffer);
+	glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, SceneSize, SceneSize, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	run.readbackFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+static void finishReadback(SceneRun& run)
+{
+	Clock::time_point start = Clock::now();
+	GLenum waitResult;
+	do
+	{
+		waitResult = glClientWaitSync(run.readbackFence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+	} while (waitResult == GL_TIMEOUT_EXPIRED);
+	glDeleteSync(run.readbackFence);
+
+	size_t size = (size_t)SceneSize * SceneSize * 4;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, run.pixelBuffer);
+	const unsigned char* mapped = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+	if (mapped)
+	{
+		run.pixels.assign(mapped, mapped + size);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	else
+	{
+		printf("ERROR: Failed to map the pixel pack buffer\n");
+		run.pixels.assign(size, 0);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glDeleteBuffers(1, &run.pixelBuffer);
+	run.readbackMilliseconds = millisecondsBetween(start, Clock::now());
+}
+
+static std::string getScenePath(const char* directory, const char* scene, const char* suffix)
+{
+	return std::string(directory) + "/" + scene + suffix;
+}
+
+static double readBaseline(const char* directory, const char* scene)
+{
+	FILE* file = fopen(getScenePath(directory, "timings", ".txt").c_str(), "r");
+	if (!file)
+	{
+		return 0.0;
+	}
+
+	char name[128];
+	double milliseconds;
+	double baseline = 0.0;
+	while (fscanf(file, "%127s %lf", name, &milliseconds) == 2)
+	{
+		if (strcmp(name, scene) == 0)
+		{
+			baseline = milliseconds;
+		}
+	}
+	fclose(file);
+	return baseline;
+}
+
+// Differences times 8, so small ones show up
+static void writeDifferenceImage(const char* filePath, const unsigned char* a, const unsigned char* b)
+{
+	std::vector<unsigned char> image((size_t)SceneSize * SceneSize * 4);
+	for (size_t i = 0; i < image.size(); i++)
+	{
+		int difference = ((int)a[i] - (int)b[i]) * 8;
+		difference = difference < 0 ? -difference : difference;
+		image[i] = (unsigned char)(difference > 255 ? 255 : difference);
+	}
+	writePpm(filePath, image.data(), SceneSize, SceneSize, true);
+}
+
+static void writeJsonReport(const char* filePath, const std::vector<SceneRun>& runs)
+{
+	FILE* file = fopen(filePath, "w");
+	if (!file)
+	{
+		printf("ERROR: Failed to open %s for writing\n", filePath);
+		return;
+	}
+
+	fprintf(file, "{\n");
+	fprintf(file, "\t\"width\": %d,\n", SceneSize);
+	fprintf(file, "\t\"height\": %d,\n", SceneSize);
+	fprintf(file, "\t\"frames\": %d,\n", TimedFrames);
+	fprintf(file, "\t\"scenes\": [\n");
+	for (int i = 0; i < SceneCount; i++)
+	{
+		const SceneRun& run = runs[i];
+		FrameBenchmark::Summary submit = FrameBenchmark::summarize(run.submitMilliseconds);
+		FrameBenchmark::Summary frame = FrameBenchmark::summarize(run.frameMilliseconds);
+		fprintf(file, "\t\t{\n");
+		fprintf(file, "\t\t\t\"name\": \"%s\",\n", Scenes[i].name);
+		fprintf(file, "\t\t\t\"passed\": %s,\n", run.imagePassed && run.timingPassed ? "true" : "false");
+		fprintf(file, "\t\t\t\"ssim\": %.6f,\n", run.difference.ssim);
+		fprintf(file, "\t\t\t\"maxDifference\": %u,\n", run.difference.maxDifference);
+		fprintf(file, "\t\t\t\"differentPixels\": %llu,\n", (unsigned long long)run.difference.differentPixels);
+		fprintf(file, "\t\t\t\"meanDifference\": %.4f,\n", run.difference.meanDifference);
+		fprintf(file, "\t\t\t\"submitMilliseconds\": { \"average\": %.4f, \"p50\": %.4f, \"max\": %.4f },\n", submit.average, submit.p50, submit.max);
+		fprintf(file, "\t\t\t\"frameMilliseconds\": { \"average\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"max\": %.4f },\n", frame.average, frame.p50, frame.p95, frame.max);
+		fprintf(file, "\t\t\t\"baselineMilliseconds\": %.4f,\n", run.baselineMilliseconds);
+		fprintf(file, "\t\t\t\"readbackMilliseconds\": %.4f\n", run.readbackMilliseconds);
+		fprintf(file, "\t\t}%s\n", i + 1 < SceneCount ? "," : "");
+	}
+	fprintf(file, "\t]\n");
+	fprintf(file, "}\n");
+	fclose(file);
+}
+
+bool runImageRegression(const char* goldenDirectory, bool updateGolden, const char* reportPath)
+{
+	RegressionResources resources;
+	if (!createResources(resources))
+	{
+		destroyResources(resources);
+		return false;
+	}
+
+	printf("Image regression on %s, %d scenes at %dx%d, %d frames each\n", (const char*)glGetString(GL_RENDERER),
+		SceneCount, SceneSize, SceneSize, TimedFrames);
+
+	// NOTE Every scene keeps its framebuffer until its readback is done, the readbacks are only waited on
+	// once all the scenes are rendered
+	std::vector<SceneRun> runs(SceneCount);
+	for (int i = 0; i < SceneCount; i++)
+	{
+		SceneRun& run = runs[i];
+		if (!run.framebuffer.create(SceneSize, SceneSize))
+		{
+			for (int j = 0; j < i; j++)
+			{
+				finishReadback(runs[j]);
+				runs[j].framebuffer.destroy();
+			}
+			destroyResources(resources);
+			return false;
+		}
+
+		for (int frame = 0; frame < WarmupFrames; frame++)
+		{
+			Scenes[i].draw(resources);
+			glFinish();
+		}
+		for (int frame = 0; frame < TimedFrames; frame++)
+		{
+			Clock::time_point start = Clock::now();
+			Scenes[i].draw(resources);
+			Clock::time_point submitted = Clock::now();
+			glFinish();
+			Clock::time_point end = Clock::now();
+			run.submitMilliseconds.push_back(millisecondsBetween(start, submitted));
+			run.frameMilliseconds.push_back(millisecondsBetween(start, end));
+		}
+		startReadback(run);
+	}
+
+	bool passed = true;
+	FILE* timingsFile = NULL;
+	if (updateGolden)
+	{
+		timingsFile = fopen(getScenePath(goldenDirectory, "timings", ".txt").c_str(), "w");
+		if (!timingsFile)
+		{
+			printf("ERROR: Failed to open %s for writing\n", getScenePath(goldenDirectory, "timings", ".txt").c_str());
+			passed = false;
+		}
+	}
+
+	for (int i = 0; i < SceneCount; i++)
+	{
+		SceneRun& run = runs[i];
+		finishReadback(run);
+		run.framebuffer.destroy();
+
+		const char* name = Scenes[i].name;
+		std::string goldenPath = getScenePath(goldenDirectory, name, ".ppm");
+		FrameBenchmark::Summary submit = FrameBenchmark::summarize(run.submitMilliseconds);
+		FrameBenchmark::Summary frame = FrameBenchmark::summarize(run.frameMilliseconds);
+		run.difference = ImageDifference();
+		run.baselineMilliseconds = 0.0;
+		run.imagePassed = true;
+		run.timingPassed = true;
+
+		if (updateGolden)
+		{
+			passed = writePpm(goldenPath.c_str(), run.pixels.data(), SceneSize, SceneSize, true) && passed;
+			if (timingsFile)
+			{
+				fprintf(timingsFile, "%s %.4f\n", name, frame.p50);
+			}
+			printf("  %-16s written, %.3f ms submit, %.3f ms frame (p50)\n", name, submit.p50, frame.p50);
+			continue;
+		}
+
+		std::vector<unsigned char> golden;
+		int goldenWidth = 0, goldenHeight = 0;
+		if (!readPpm(goldenPath.c_str(), golden, goldenWidth, goldenHeight, true) || goldenWidth != SceneSize || goldenHeight != SceneSize)
+		{
+			printf("  %-16s FAIL no %dx%d golden at %s\n", name, SceneSize, SceneSize, goldenPath.c_str());
+			run.imagePassed = false;
+			passed = false;
+			continue;
+		}
+
+		run.difference = compareImages(run.pixels.data(), golden.data(), SceneSize, SceneSize, PixelThreshold);
+		run.imagePassed = run.difference.ssim >= MinSsim &&
+			run.difference.differentPixels <= (uint64_t)(MaxDifferentPixels * SceneSize * SceneSize);
+		run.baselineMilliseconds = readBaseline(goldenDirectory, name);
+		run.timingPassed = run.baselineMilliseconds <= 0.0 ||
+			frame.p50 <= run.baselineMilliseconds * MaxSlowdown + SlowdownSlackMilliseconds;
+
+		const char* result = !run.imagePassed ? "FAIL" : !run.timingPassed ? "SLOW" : "PASS";
+		printf("  %-16s %s ssim %.5f, max difference %u, %llu pixels over %u, %.3f ms submit, %.3f ms frame (p50)",
+			name, result, run.difference.ssim, run.difference.maxDifference, (unsigned long long)run.difference.differentPixels,
+			PixelThreshold, submit.p50, frame.p50);
+		if (run.baselineMilliseconds > 0.0)
+		{
+			printf(", baseline %.3f ms", run.baselineMilliseconds);
+		}
+		printf("\n");
+
+		if (!run.imagePassed)
+		{
+			writePpm(getScenePath(goldenDirectory, name, ".actual.ppm").c_str(), run.pixels.data(), SceneSize, SceneSize, true);
+			writeDifferenceImage(getScenePath(goldenDirectory, name, ".difference.ppm").c_str(), run.pixels.data(), golden.data());
+		}
+		passed = passed && run.imagePassed && run.timingPassed;
+	}
+
+	if (timingsFile)
+	{
+		fclose(timingsFile);
+	}
+
+	double readbackMilliseconds = 0.0;
+	for (int i = 0; i < SceneCount; i++)
+	{
+		readbackMilliseconds += runs[i].readbackMilliseconds;
+	}
+	printf("Readback: %.3f ms waited for %d scenes\n", readbackMilliseconds, SceneCount);
+	if (updateGolden)
+	{
+		printf("Goldens written to %s\n", goldenDirectory);
+	}
+	else
+	{
+		printf("Image regression %s\n", passed ? "passed" : "FAILED");
+	}
+
+	if (reportPath)
+	{
+		writeJsonReport(reportPath, runs);
+	}
+
+	destroyResources(resources);
+	return passed;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+
+// Image regression run (--image-regression <directory>): renders reference scenes of the texture
+// and shader path into framebuffer objects, reads them back asynchronously through pixel pack
+// buffers and compares them with the golden images of the directory, one <scene>.ppm each.
+// Every scene is also rendered a number of times and timed, against the baseline in timings.txt of
+// the same directory when there is one, so a run catches slowdowns as well as visual changes.
+//
+// A scene fails when its SSIM falls under a minimum, too many pixels differ by more than a
+// threshold, or its median frame is much slower than the baseline. The rendered image and an
+// amplified difference are written next to the golden of a failed scene, to have a look at.
+// NOTE Goldens depend on how the driver rasterizes and filters, they only compare well on
+// the driver that wrote them. updateGolden writes the goldens and the baseline instead
+
+struct ImageDifference
+{
+	uint32_t maxDifference;		// largest RGB channel difference
+	uint64_t differentPixels;	// pixels with a channel difference over the threshold
+	double meanDifference;		// per RGB channel
+	double ssim;				// mean structural similarity of the luminance, 1 for identical images
+};
+
+// Both RGBA8 and of the same size, alpha is ignored
+ImageDifference compareImages(const unsigned char* a, const unsigned char* b, int width, int height, uint32_t threshold);
+
+// Needs a current OpenGL context. reportPath (optional) gets the results of every scene as JSON.
+// Returns true when every scene passed, or when the goldens were written
+bool runImageRegression(const char* goldenDirectory, bool updateGolden, const char* reportPath);
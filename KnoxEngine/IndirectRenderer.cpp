@@ -0,0 +1,135 @@
+#include "IndirectRenderer.h"
+#include "GLExtensions.h"
+#include "InstanceBatcher.h"
+#include "Counters.h"
+
+#include <iostream>
+
+static const GLsizei TransformStride = sizeof(float) * 16;
+
+IndirectRenderer::IndirectRenderer(BufferArena& bufferArena, uint32_t maxDrawsPerFrame)
+	: bufferArena(bufferArena),
+	commandBuffer((size_t)maxDrawsPerFrame * sizeof(DrawElementsIndirectCommand)),
+	transformBuffer((size_t)maxDrawsPerFrame * TransformStride),
+	maxDraws(maxDrawsPerFrame)
+{
+	stats = Stats();
+	commands.reserve(maxDrawsPerFrame);
+	transforms.reserve((size_t)maxDrawsPerFrame * 16);
+}
+
+void IndirectRenderer::destroy()
+{
+	commandBuffer.destroy();
+	transformBuffer.destroy();
+}
+
+void IndirectRenderer::submit(const MeshRange& mesh, const float* transform)
+{
+	if (commands.size() >= maxDraws)
+	{
+		return;
+	}
+
+	DrawElementsIndirectCommand command;
+	command.count = mesh.indexCount;
+	command.instanceCount = 1;
+	command.firstIndex = mesh.firstIndex();
+	command.baseVertex = mesh.baseVertex();
+	command.baseInstance = (GLuint)commands.size();
+	commands.push_back(command);
+
+	transforms.insert(transforms.end(), transform, transform + 16);
+}
+
+void IndirectRenderer::setTransformPointer(size_t offset)
+{
+	for (GLuint column = 0; column < 4; column++)
+	{
+		GLuint location = InstanceBatcher::TransformLocation + column;
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, TransformStride, (void *)(offset + column * 4 * sizeof(float)));
+		glVertexAttribDivisor(location, 1);
+	}
+}
+
+void IndirectRenderer::flush(unsigned int program, const unsigned int* textures, int textureCount)
+{
+	stats = Stats();
+	if (commands.empty())
+	{
+		return;
+	}
+
+	size_t commandOffset = 0, transformOffset = 0;
+	commandBuffer.beginFrame();
+	transformBuffer.beginFrame();
+	commandBuffer.write(commands.data(), commands.size() * sizeof(DrawElementsIndirectCommand), sizeof(DrawElementsIndirectCommand), commandOffset);
+	transformBuffer.write(transforms.data(), transforms.size() * sizeof(float), TransformStride, transformOffset);
+	commandBuffer.finishWrites();
+	transformBuffer.finishWrites();
+
+	glUseProgram(program);
+	for (int unit = 0; unit < textureCount; unit++)
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(GL_TEXTURE_2D, textures[unit]);
+	}
+
+	bufferArena.bind();
+	glBindBuffer(GL_ARRAY_BUFFER, transformBuffer.Id);
+
+	if (GLExtensions.multiDrawIndirect)
+	{
+		setTransformPointer(transformOffset);
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer.Id);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)commandOffset, (GLsizei)commands.size(), 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+		stats.apiCalls = 1;
+	}
+	else
+	{
+		// NOTE GL 3.3 has no baseInstance, so the transform pointer is moved for every command instead
+		for (size_t i = 0; i < commands.size(); i++)
+		{
+			const DrawElementsIndirectCommand& command = commands[i];
+			setTransformPointer(transformOffset + (size_t)command.baseInstance * TransformStride);
+			glDrawElementsInstancedBaseVertex(
+				GL_TRIANGLES,
+				(GLsizei)command.count,
+				GL_UNSIGNED_INT,
+				(void *)((size_t)command.firstIndex * sizeof(unsigned int)),
+				(GLsizei)command.instanceCount,
+				command.baseVertex
+			);
+		}
+
+		stats.apiCalls = (uint32_t)commands.size();
+	}
+	stats.drawCount = (uint32_t)commands.size();
+
+	uint64_t triangles = 0;
+	for (size_t i = 0; i < commands.size(); i++)
+	{
+		triangles += (uint64_t)(commands[i].count / 3) * commands[i].instanceCount;
+	}
+	countEvent(CounterDrawCalls, stats.apiCalls);
+	countEvent(CounterTriangles, triangles);
+	countEvent(CounterStateChanges, 2 + textureCount);	// program, vertex array and textures
+	countEvent(CounterTextureBinds, textureCount);
+
+	for (GLuint column = 0; column < 4; column++)
+	{
+		glDisableVertexAttribArray(InstanceBatcher::TransformLocation + column);
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	commandBuffer.endFrame();
+	transformBuffer.endFrame();
+
+	commands.clear();
+	transforms.clear();
+}
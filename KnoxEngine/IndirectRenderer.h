@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "BufferArena.h"
+#include "StreamBuffer.h"
+
+#include <cstdint>
+#include <vector>
+
+// Layout expected by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// Draws a whole pass of meshes living in one BufferArena with a single glMultiDrawElementsIndirect.
+// Commands are built on the CPU and streamed every frame together with the per-draw transforms,
+// baseInstance is used as the index of each draw's transform.
+//
+// Without ARB_multi_draw_indirect the same command list is replayed with one
+// glDrawElementsInstancedBaseVertex per command
+class IndirectRenderer
+{
+public:
+	struct Stats
+	{
+		uint32_t drawCount;
+		uint32_t apiCalls;
+	};
+
+private:
+	BufferArena& bufferArena;
+
+	StreamBuffer commandBuffer;
+	StreamBuffer transformBuffer;
+
+	std::vector<DrawElementsIndirectCommand> commands;
+	std::vector<float> transforms;
+
+	uint32_t maxDraws;
+	Stats stats;
+
+	void setTransformPointer(size_t offset);
+
+public:
+	IndirectRenderer(BufferArena& bufferArena, uint32_t maxDrawsPerFrame);
+
+	// NOTE Must be called while the OpenGL context is still alive
+	void destroy();
+
+	// transform is a column-major 4x4 matrix
+	void submit(const MeshRange& mesh, const float* transform);
+
+	// Draws everything submitted this frame with the given program and textures
+	void flush(unsigned int program, const unsigned int* textures, int textureCount);
+
+	Stats getStats() const { return stats; }
+};
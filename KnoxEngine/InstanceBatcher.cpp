@@ -0,0 +1,266 @@
+#include "InstanceBatcher.h"
+#include "Counters.h"
+
+#include <iostream>
+#include <cstring>
+
+static const GLsizei TransformStride = sizeof(float) * 16;
+
+size_t InstanceBatcher::BatchKeyHash::operator()(const DrawItem& item) const
+{
+	// FNV-1a over the fields that identify the mesh and material
+	uint64_t hash = 14695981039346656037ull;
+	uint32_t fields[] = {
+		item.program, item.materialId, item.textures[0], item.textures[1],
+		item.vertexArray, item.indexCount, item.firstIndex, (uint32_t)item.baseVertex
+	};
+	for (int i = 0; i < 8; i++)
+	{
+		hash = (hash ^ fields[i]) * 1099511628211ull;
+	}
+	return (size_t)hash;
+}
+
+bool InstanceBatcher::BatchKeyEqual::operator()(const DrawItem& a, const DrawItem& b) const
+{
+	return canBatch(a, b);
+}
+
+bool InstanceBatcher::canBatch(const DrawItem& a, const DrawItem& b)
+{
+	return a.program == b.program && a.materialId == b.materialId &&
+		a.textures[0] == b.textures[0] && a.textures[1] == b.textures[1] &&
+		a.vertexArray == b.vertexArray && a.indexCount == b.indexCount &&
+		a.firstIndex == b.firstIndex && a.baseVertex == b.baseVertex;
+}
+
+InstanceBatcher::InstanceBatcher(uint32_t maxInstancesPerFrame)
+	: instanceBuffer((size_t)maxInstancesPerFrame * TransformStride)
+{
+	stats = Stats();
+}
+
+void InstanceBatcher::destroy()
+{
+	instanceBuffer.destroy();
+}
+
+void InstanceBatcher::setDefaultTransform()
+{
+	// NOTE Generic vertex attribute values are context state, so this only has to be done once
+	glVertexAttrib4f(TransformLocation + 0, 1.0f, 0.0f, 0.0f, 0.0f);
+	glVertexAttrib4f(TransformLocation + 1, 0.0f, 1.0f, 0.0f, 0.0f);
+	glVertexAttrib4f(TransformLocation + 2, 0.0f, 0.0f, 1.0f, 0.0f);
+	glVertexAttrib4f(TransformLocation + 3, 0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+void InstanceBatcher::submit(const DrawItem& item, const float* transform)
+{
+	uint32_t batchIndex;
+	std::unordered_map<DrawItem, uint32_t, BatchKeyHash, BatchKeyEqual>::iterator it = batchIndices.find(item);
+	if (it != batchIndices.end())
+	{
+		batchIndex = it->second;
+	}
+	else
+	{
+		batchIndex = (uint32_t)batches.size();
+		batchIndices[item] = batchIndex;
+		batches.push_back(Batch());
+		batches.back().item = item;
+	}
+
+	std::vector<float>& transforms = batches[batchIndex].transforms;
+	transforms.insert(transforms.end(), transform, transform + 16);
+}
+
+void InstanceBatcher::flush()
+{
+	stats = Stats();
+
+	instanceBuffer.beginFrame();
+
+	// Upload every batch first, the fallback StreamBuffer path can't be written while drawing
+	batchOffsets.assign(batches.size(), 0);
+	batchInstanceCounts.assign(batches.size(), 0);
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		std::vector<float>& transforms = batches[i].transforms;
+		uint32_t instanceCount = (uint32_t)(transforms.size() / 16);
+		if (instanceCount == 0)
+		{
+			continue;
+		}
+
+		if (instanceBuffer.write(transforms.data(), instanceCount * TransformStride, TransformStride, batchOffsets[i]))
+		{
+			batchInstanceCounts[i] = instanceCount;
+		}
+		else
+		{
+			stats.droppedInstances += instanceCount;
+		}
+		transforms.clear();
+	}
+	instanceBuffer.finishWrites();
+
+	if (stats.droppedInstances > 0)
+	{
+		printf("ERROR: InstanceBatcher ran out of instance buffer space, %u instances dropped\n", stats.droppedInstances);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer.Id);
+
+	uint64_t triangles = 0, stateChanges = 0, textureBinds = 0;
+	const DrawItem* previous = NULL;
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		if (batchInstanceCounts[i] == 0)
+		{
+			continue;
+		}
+
+		const DrawItem& item = batches[i].item;
+		if (!previous || previous->program != item.program)
+		{
+			glUseProgram(item.program);
+			stateChanges++;
+		}
+		for (int unit = 0; unit < DrawItem::MaxTextures; unit++)
+		{
+			if (!previous || previous->textures[unit] != item.textures[unit])
+			{
+				glActiveTexture(GL_TEXTURE0 + unit);
+				glBindTexture(GL_TEXTURE_2D, item.textures[unit]);
+				textureBinds++;
+			}
+		}
+		if (!previous || previous->vertexArray != item.vertexArray)
+		{
+			glBindVertexArray(item.vertexArray);
+			stateChanges++;
+		}
+
+		// A mat4 attribute takes 4 consecutive locations, one per column
+		for (GLuint column = 0; column < 4; column++)
+		{
+			glEnableVertexAttribArray(TransformLocation + column);
+			glVertexAttribPointer(TransformLocation + column, 4, GL_FLOAT, GL_FALSE, TransformStride, (void *)(batchOffsets[i] + column * 4 * sizeof(float)));
+			glVertexAttribDivisor(TransformLocation + column, 1);
+		}
+
+		glDrawElementsInstancedBaseVertex(
+			GL_TRIANGLES,
+			(GLsizei)item.indexCount,
+			GL_UNSIGNED_INT,
+			(void *)((size_t)item.firstIndex * sizeof(unsigned int)),
+			(GLsizei)batchInstanceCounts[i],
+			item.baseVertex
+		);
+
+		stats.drawCalls++;
+		stats.instances += batchInstanceCounts[i];
+		triangles += (uint64_t)(item.indexCount / 3) * batchInstanceCounts[i];
+		previous = &item;
+	}
+
+	countEvent(CounterDrawCalls, stats.drawCalls);
+	countEvent(CounterTriangles, triangles);
+	countEvent(CounterStateChanges, stateChanges + textureBinds);
+	countEvent(CounterTextureBinds, textureBinds);
+
+	// NOTE Leave the VAOs as we found them, so regular draws fall back to the default transform
+	previous = NULL;
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		if (batchInstanceCounts[i] == 0 || (previous && previous->vertexArray == batches[i].item.vertexArray))
+		{
+			continue;
+		}
+
+		glBindVertexArray(batches[i].item.vertexArray);
+		for (GLuint column = 0; column < 4; column++)
+		{
+			glDisableVertexAttribArray(TransformLocation + column);
+		}
+		previous = &batches[i].item;
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	instanceBuffer.endFrame();
+}
+
+float* InstanceBatcher::addRun(const DrawItem& item, uint32_t instanceCount)
+{
+	Run run;
+	run.item = item;
+	run.instanceCount = instanceCount;
+	run.firstFloat = runTransforms.size();
+	run.offset = 0;
+	run.uploaded = false;
+	runs.push_back(run);
+
+	runTransforms.resize(runTransforms.size() + (size_t)instanceCount * 16);
+	return &runTransforms[run.firstFloat];
+}
+
+void InstanceBatcher::uploadRuns()
+{
+	stats = Stats();
+
+	// Like flush, everything is written before the first draw
+	instanceBuffer.beginFrame();
+	for (size_t i = 0; i < runs.size(); i++)
+	{
+		Run& run = runs[i];
+		run.uploaded = instanceBuffer.write(&runTransforms[run.firstFloat], run.instanceCount * TransformStride, TransformStride, run.offset);
+	}
+	instanceBuffer.finishWrites();
+}
+
+bool InstanceBatcher::drawRun(uint32_t index)
+{
+	const Run& run = runs[index];
+	if (!run.uploaded)
+	{
+		return false;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer.Id);
+	for (GLuint column = 0; column < 4; column++)
+	{
+		glEnableVertexAttribArray(TransformLocation + column);
+		glVertexAttribPointer(TransformLocation + column, 4, GL_FLOAT, GL_FALSE, TransformStride, (void *)(run.offset + column * 4 * sizeof(float)));
+		glVertexAttribDivisor(TransformLocation + column, 1);
+	}
+
+	glDrawElementsInstancedBaseVertex(
+		GL_TRIANGLES,
+		(GLsizei)run.item.indexCount,
+		GL_UNSIGNED_INT,
+		(void *)((size_t)run.item.firstIndex * sizeof(unsigned int)),
+		(GLsizei)run.instanceCount,
+		run.item.baseVertex
+	);
+
+	// NOTE Single draws of the same VAO may follow, they need the default transform back
+	for (GLuint column = 0; column < 4; column++)
+	{
+		glDisableVertexAttribArray(TransformLocation + column);
+	}
+
+	stats.drawCalls++;
+	stats.instances += run.instanceCount;
+	return true;
+}
+
+void InstanceBatcher::endRuns()
+{
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	instanceBuffer.endFrame();
+
+	runs.clear();
+	runTransforms.clear();
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "RenderQueue.h"
+#include "StreamBuffer.h"
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+// Groups the submitted draws that share mesh and material and issues a single
+// glDrawElementsInstancedBaseVertex per group. Per-instance transforms are streamed
+// into a StreamBuffer every frame and read by the vertex shader at locations 3 to 6 (mat4).
+//
+// submit/flush merges draws in any order. A caller that binds the state and keeps its own draw
+// order (RenderQueue) adds runs of identical draws instead, and draws each run where it belongs.
+class InstanceBatcher
+{
+public:
+	// Location of the first column of the per-instance mat4 in the vertex shader
+	static const GLuint TransformLocation = 3;
+
+	struct Stats
+	{
+		uint32_t drawCalls;
+		uint32_t instances;
+		uint32_t droppedInstances;
+	};
+
+private:
+	struct Batch
+	{
+		DrawItem item;
+		std::vector<float> transforms;
+	};
+
+	struct BatchKeyHash
+	{
+		size_t operator()(const DrawItem& item) const;
+	};
+
+	struct BatchKeyEqual
+	{
+		bool operator()(const DrawItem& a, const DrawItem& b) const;
+	};
+
+	struct Run
+	{
+		DrawItem item;
+		uint32_t instanceCount;
+		size_t firstFloat;	// in runTransforms
+		size_t offset;		// in the instance buffer
+		bool uploaded;
+	};
+
+	StreamBuffer instanceBuffer;
+
+	// NOTE Batches are kept between frames so their transform arrays don't reallocate
+	std::vector<Batch> batches;
+	std::unordered_map<DrawItem, uint32_t, BatchKeyHash, BatchKeyEqual> batchIndices;
+	std::vector<size_t> batchOffsets;
+	std::vector<uint32_t> batchInstanceCounts;
+
+	std::vector<Run> runs;
+	std::vector<float> runTransforms;
+
+	Stats stats;
+
+public:
+	InstanceBatcher(uint32_t maxInstancesPerFrame);
+
+	// NOTE Must be called while the OpenGL context is still alive
+	void destroy();
+
+	// transform is a column-major 4x4 matrix
+	void submit(const DrawItem& item, const float* transform);
+	void flush();
+
+	// Per flush of the caller: addRun for every run -> uploadRuns -> drawRun with the run's program,
+	// textures and VAO bound -> endRuns. NOTE Uses a frame of the instance buffer per flush with runs
+	// Returns where to write the instanceCount transforms of the run, valid until the next addRun
+	float* addRun(const DrawItem& item, uint32_t instanceCount);
+	void uploadRuns();
+	// Returns false when the run didn't fit in the instance buffer, the caller draws it one by one then
+	bool drawRun(uint32_t run);
+	void endRuns();
+	uint32_t getRunCount() const { return (uint32_t)runs.size(); }
+
+	Stats getStats() const { return stats; }
+
+	// Sets the per-instance transform to identity for VAOs that don't have an instance buffer,
+	// so shaders with the instanced transform attribute still work with regular glDrawElements
+	static void setDefaultTransform();
+
+	// Same mesh and material, so the two draws can be instances of one draw
+	static bool canBatch(const DrawItem& a, const DrawItem& b);
+};
@@ -0,0 +1,275 @@
+#include "JobSystem.h"
+
+#include <iostream>
+#include <chrono>
+
+static thread_local JobSystem* currentJobSystem = NULL;
+static thread_local int currentWorkerIndex = -1;
+
+WorkStealingQueue::WorkStealingQueue() : top(0), bottom(0)
+{
+}
+
+bool WorkStealingQueue::push(const Job& job)
+{
+	int64_t b = bottom.load(std::memory_order_relaxed);
+	int64_t t = top.load(std::memory_order_acquire);
+	if (b - t >= Capacity)
+	{
+		return false;
+	}
+
+	jobs[b & Mask] = job;
+	bottom.store(b + 1, std::memory_order_release);
+	return true;
+}
+
+bool WorkStealingQueue::pop(Job& job)
+{
+	int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = top.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{
+		// Queue was already empty
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return false;
+	}
+
+	job = jobs[b & Mask];
+	if (t == b)
+	{
+		// NOTE Last job in the queue, a thief might be trying to take it at the same time
+		bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return won;
+	}
+	return true;
+}
+
+bool WorkStealingQueue::steal(Job& job)
+{
+	int64_t t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t b = bottom.load(std::memory_order_acquire);
+
+	if (t >= b)
+	{
+		return false;
+	}
+
+	job = jobs[t & Mask];
+
+	// Lost the race against the owner or another thief if top moved
+	return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+bool WorkStealingQueue::isEmpty() const
+{
+	return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+}
+
+JobSystem::JobSystem(int workerThreadCount) : running(true), sleepingWorkers(0)
+{
+	if (workerThreadCount < 0)
+	{
+		int cores = (int)std::thread::hardware_concurrency();
+		workerThreadCount = cores > 1 ? cores - 1 : 0;
+	}
+
+	workers.resize(workerThreadCount + 1);
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i] = new Worker();
+		workers[i]->randomState = (uint32_t)(i * 2654435761u + 1);
+		workers[i]->jobsExecuted.store(0);
+		workers[i]->jobsStolen.store(0);
+	}
+
+	currentJobSystem = this;
+	currentWorkerIndex = 0;
+
+	for (int i = 1; i <= workerThreadCount; i++)
+	{
+		threads.push_back(std::thread(&JobSystem::workerLoop, this, i));
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	running.store(false);
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		sleepCondition.notify_all();
+	}
+
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		threads[i].join();
+	}
+
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		delete workers[i];
+	}
+
+	if (currentJobSystem == this)
+	{
+		currentJobSystem = NULL;
+		currentWorkerIndex = -1;
+	}
+}
+
+int JobSystem::getCurrentWorkerIndex()
+{
+	return currentWorkerIndex;
+}
+
+void JobSystem::workerLoop(int workerIndex)
+{
+	currentJobSystem = this;
+	currentWorkerIndex = workerIndex;
+
+	int idleSpins = 0;
+	while (running.load(std::memory_order_relaxed))
+	{
+		Job job;
+		if (getJob(workerIndex, job))
+		{
+			execute(job);
+			idleSpins = 0;
+			continue;
+		}
+
+		// Spin a little before going to sleep, jobs usually come in bursts
+		if (++idleSpins < 64)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepingWorkers.fetch_add(1);
+		// NOTE The timeout covers the race between checking the queues and going to sleep
+		sleepCondition.wait_for(lock, std::chrono::milliseconds(1));
+		sleepingWorkers.fetch_sub(1);
+		idleSpins = 0;
+	}
+}
+
+bool JobSystem::getJob(int workerIndex, Job& job)
+{
+	Worker* worker = workers[workerIndex];
+	if (worker->queue.pop(job))
+	{
+		return true;
+	}
+
+	// Steal from the others, starting at a random worker so thieves don't all hit the same queue
+	uint32_t workerCount = (uint32_t)workers.size();
+	worker->randomState ^= worker->randomState << 13;
+	worker->randomState ^= worker->randomState >> 17;
+	worker->randomState ^= worker->randomState << 5;
+	uint32_t start = worker->randomState % workerCount;
+
+	for (uint32_t i = 0; i < workerCount; i++)
+	{
+		uint32_t victim = (start + i) % workerCount;
+		if ((int)victim == workerIndex)
+		{
+			continue;
+		}
+
+		if (workers[victim]->queue.steal(job))
+		{
+			worker->jobsStolen.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::execute(const Job& job)
+{
+	job.function(job.data);
+	if (job.counter)
+	{
+		job.counter->fetch_sub(1, std::memory_order_release);
+	}
+	workers[currentWorkerIndex]->jobsExecuted.fetch_add(1, std::memory_order_relaxed);
+}
+
+void JobSystem::run(JobFunction function, void* data, Counter* counter)
+{
+	if (currentJobSystem != this)
+	{
+		printf("ERROR: Jobs can only be scheduled from a worker thread, running it inline\n");
+		function(data);
+		return;
+	}
+
+	if (counter)
+	{
+		counter->fetch_add(1, std::memory_order_relaxed);
+	}
+
+	Job job;
+	job.function = function;
+	job.data = data;
+	job.counter = counter;
+
+	if (!workers[currentWorkerIndex]->queue.push(job))
+	{
+		// Queue is full, it's cheaper to just do the work right now
+		execute(job);
+		return;
+	}
+
+	if (sleepingWorkers.load(std::memory_order_relaxed) > 0)
+	{
+		sleepCondition.notify_one();
+	}
+}
+
+void JobSystem::wait(Counter* counter)
+{
+	int workerIndex = currentJobSystem == this ? currentWorkerIndex : -1;
+
+	while (counter->load(std::memory_order_acquire) > 0)
+	{
+		// Help out instead of blocking, the jobs we are waiting on are probably in our own queue
+		Job job;
+		if (workerIndex >= 0 && getJob(workerIndex, job))
+		{
+			execute(job);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+bool JobSystem::runPendingJob()
+{
+	Job job;
+	if (currentJobSystem != this || !getJob(currentWorkerIndex, job))
+	{
+		return false;
+	}
+	execute(job);
+	return true;
+}
+
+JobSystem::Stats JobSystem::getStats() const
+{
+	Stats stats = Stats();
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		stats.jobsExecuted += workers[i]->jobsExecuted.load(std::memory_order_relaxed);
+		stats.jobsStolen += workers[i]->jobsStolen.load(std::memory_order_relaxed);
+	}
+	return stats;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <cstdint>
+
+typedef void (*JobFunction)(void* data);
+
+struct Job
+{
+	JobFunction function;
+	void* data;
+	std::atomic<int>* counter;
+};
+
+// Chase-Lev deque: the owner pushes and pops at the bottom (LIFO, cache friendly),
+// other workers steal from the top (FIFO, takes the biggest pieces of work first).
+// Jobs are stored by value, a slot is never rewritten before top moves past it,
+// so there's no job pool to manage
+class WorkStealingQueue
+{
+public:
+	static const int64_t Capacity = 4096;
+
+private:
+	static const int64_t Mask = Capacity - 1;
+
+	alignas(64) std::atomic<int64_t> top;
+	alignas(64) std::atomic<int64_t> bottom;
+	Job jobs[Capacity];
+
+public:
+	WorkStealingQueue();
+
+	// NOTE push and pop can only be called by the thread that owns the queue
+	bool push(const Job& job);
+	bool pop(Job& job);
+	bool steal(Job& job);
+
+	bool isEmpty() const;
+};
+
+// Pool of worker threads that run jobs out of per-worker work-stealing queues.
+// The thread that creates the JobSystem is worker 0: it can schedule jobs and helps
+// running them while it waits on a counter.
+//
+// Dependencies are expressed with counters: every job scheduled with a counter
+// increments it and decrements it when done, wait() runs other jobs until it reaches zero.
+// NOTE Jobs can only be scheduled from worker threads (including the creating thread)
+class JobSystem
+{
+public:
+	typedef std::atomic<int> Counter;
+
+	struct Stats
+	{
+		uint64_t jobsExecuted;
+		uint64_t jobsStolen;
+	};
+
+private:
+	struct alignas(64) Worker
+	{
+		WorkStealingQueue queue;
+		uint32_t randomState;
+		std::atomic<uint64_t> jobsExecuted;
+		std::atomic<uint64_t> jobsStolen;
+	};
+
+	std::vector<Worker*> workers;
+	std::vector<std::thread> threads;
+
+	std::atomic<bool> running;
+	std::atomic<int> sleepingWorkers;
+	std::mutex sleepMutex;
+	std::condition_variable sleepCondition;
+
+	void workerLoop(int workerIndex);
+	bool getJob(int workerIndex, Job& job);
+	void execute(const Job& job);
+
+public:
+	// workerThreadCount doesn't include the calling thread, -1 uses one thread per remaining core
+	JobSystem(int workerThreadCount = -1);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	void run(JobFunction function, void* data, Counter* counter);
+	void wait(Counter* counter);
+
+	// Runs one job from the calling worker's queue or stolen from another, for waits that can't use wait().
+	// Returns false when there was none or the calling thread isn't a worker
+	bool runPendingJob();
+
+	// Calls function(begin, end) over [0, count) in batches of batchSize elements, returns when all are done
+	template<typename Function>
+	void parallelFor(uint32_t count, uint32_t batchSize, const Function& function);
+
+	int getWorkerCount() const { return (int)workers.size(); }
+	Stats getStats() const;
+
+	// Index of the calling thread in the JobSystem it belongs to, -1 if it isn't a worker
+	static int getCurrentWorkerIndex();
+};
+
+template<typename Function>
+void JobSystem::parallelFor(uint32_t count, uint32_t batchSize, const Function& function)
+{
+	struct Batch
+	{
+		const Function* function;
+		uint32_t begin;
+		uint32_t end;
+
+		static void execute(void* data)
+		{
+			Batch* batch = (Batch*)data;
+			(*batch->function)(batch->begin, batch->end);
+		}
+	};
+
+	if (count == 0)
+	{
+		return;
+	}
+	if (batchSize == 0)
+	{
+		batchSize = 1;
+	}
+
+	uint32_t batchCount = (count + batchSize - 1) / batchSize;
+	std::vector<Batch> batches(batchCount);
+
+	Counter counter(0);
+	for (uint32_t i = 0; i < batchCount; i++)
+	{
+		batches[i].function = &function;
+		batches[i].begin = i * batchSize;
+		batches[i].end = (i + 1) * batchSize < count ? (i + 1) * batchSize : count;
+		run(&Batch::execute, &batches[i], &counter);
+	}
+
+	wait(&counter);
+}
@@ -0,0 +1,98 @@
+#include "LinearArena.h"
+#include "MemoryTracker.h"
+#include "Counters.h"
+
+static const size_t ScratchArenaSize = 1024 * 1024;
+
+LinearArena::LinearArena(size_t capacity, const char* tag) : capacity(capacity), offset(0), tag(tag)
+{
+	memory = (char*)std::pmr::new_delete_resource()->allocate(capacity, 64);
+	stats = Stats();
+	trackAllocation("Arenas", tag, capacity);
+}
+
+LinearArena::~LinearArena()
+{
+	freeOverflowBlocks(0);
+	std::pmr::new_delete_resource()->deallocate(memory, capacity, 64);
+	trackFree("Arenas", tag, capacity);
+}
+
+void* LinearArena::do_allocate(size_t size, size_t alignment)
+{
+	size_t alignedOffset = (offset + alignment - 1) & ~(alignment - 1);
+	if (alignedOffset + size <= capacity)
+	{
+		stats.bytesAllocated += alignedOffset + size - offset;
+		stats.allocationCount++;
+		offset = alignedOffset + size;
+		return memory + alignedOffset;
+	}
+
+	OverflowBlock block;
+	block.memory = std::pmr::new_delete_resource()->allocate(size, alignment);
+	block.size = size;
+	block.alignment = alignment;
+	overflowBlocks.push_back(block);
+
+	stats.overflowBytes += size;
+	stats.overflowAllocations++;
+	countEvent(CounterAllocations);
+	return block.memory;
+}
+
+void LinearArena::do_deallocate(void*, size_t, size_t)
+{
+	// NOTE Nothing to do, memory only comes back with reset or rewind
+}
+
+bool LinearArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+	return this == &other;
+}
+
+void LinearArena::freeOverflowBlocks(size_t keepCount)
+{
+	for (size_t i = keepCount; i < overflowBlocks.size(); i++)
+	{
+		std::pmr::new_delete_resource()->deallocate(overflowBlocks[i].memory, overflowBlocks[i].size, overflowBlocks[i].alignment);
+	}
+	overflowBlocks.resize(keepCount);
+}
+
+void LinearArena::reset()
+{
+	freeOverflowBlocks(0);
+	offset = 0;
+	stats = Stats();
+}
+
+LinearArena::Marker LinearArena::getMarker() const
+{
+	Marker marker;
+	marker.offset = offset;
+	marker.overflowBlockCount = overflowBlocks.size();
+	return marker;
+}
+
+void LinearArena::rewind(Marker marker)
+{
+	freeOverflowBlocks(marker.overflowBlockCount);
+	offset = marker.offset;
+}
+
+LinearArena& getScratchArena()
+{
+	static thread_local LinearArena scratchArena(ScratchArenaSize, "Scratch");
+	return scratchArena;
+}
+
+ScratchScope::ScratchScope() : arena(getScratchArena())
+{
+	marker = arena.getMarker();
+}
+
+ScratchScope::~ScratchScope()
+{
+	arena.rewind(marker);
+}
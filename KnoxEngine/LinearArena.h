@@ -0,0 +1,97 @@
+#pragma once
+
+#include <memory_resource>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Bump allocator: allocating is moving an offset forward, individual frees do nothing and
+// everything is released at once with reset() (or back to a marker with rewind()).
+// It is a std::pmr::memory_resource, so STL containers can use it directly:
+//     std::pmr::vector<int> values(&arena);
+//
+// When the block runs out, allocations fall back to the heap until the next reset and are
+// counted in the stats, so a too small arena shows up instead of failing
+class LinearArena : public std::pmr::memory_resource
+{
+public:
+	struct Marker
+	{
+		size_t offset;
+		size_t overflowBlockCount;
+	};
+
+	struct Stats
+	{
+		size_t bytesAllocated;	// including alignment padding
+		uint32_t allocationCount;	// served by the arena
+		size_t overflowBytes;
+		uint32_t overflowAllocations;	// heap calls that happened anyway because the arena was full
+	};
+
+private:
+	struct OverflowBlock
+	{
+		void* memory;
+		size_t size;
+		size_t alignment;
+	};
+
+	char* memory;
+	size_t capacity;
+	size_t offset;
+	std::vector<OverflowBlock> overflowBlocks;
+	Stats stats;
+	const char* tag;
+
+	void freeOverflowBlocks(size_t keepCount);
+
+protected:
+	void* do_allocate(size_t size, size_t alignment) override;
+	void do_deallocate(void* pointer, size_t size, size_t alignment) override;
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+public:
+	// tag names the arena in the memory report, must be a string literal
+	LinearArena(size_t capacity, const char* tag);
+	~LinearArena();
+
+	LinearArena(const LinearArena&) = delete;
+	LinearArena& operator=(const LinearArena&) = delete;
+
+	template<typename T>
+	T* allocateArray(size_t count) { return (T*)allocate(count * sizeof(T), alignof(T)); }
+
+	// Releases everything and clears the stats
+	void reset();
+
+	// Releases everything allocated after the marker was taken
+	Marker getMarker() const;
+	void rewind(Marker marker);
+
+	size_t getUsed() const { return offset; }
+	size_t getCapacity() const { return capacity; }
+	Stats getStats() const { return stats; }
+};
+
+// Arena owned by the calling thread for short lived allocations, created on first use
+LinearArena& getScratchArena();
+
+// Scoped use of the thread's scratch arena, everything allocated from it during
+// the lifetime of the scope is released when the scope ends
+class ScratchScope
+{
+private:
+	LinearArena& arena;
+	LinearArena::Marker marker;
+
+public:
+	ScratchScope();
+	~ScratchScope();
+
+	ScratchScope(const ScratchScope&) = delete;
+	ScratchScope& operator=(const ScratchScope&) = delete;
+
+	LinearArena& getArena() { return arena; }
+	operator LinearArena*() { return &arena; }
+};
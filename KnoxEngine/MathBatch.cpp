@@ -0,0 +1,161 @@
+#include "MathBatch.h"
+
+void transformPointsSoAScalar(const mat4& m, const PointsSoA& input, PointsSoA& output, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		float x = input.x[i], y = input.y[i], z = input.z[i];
+		output.x[i] = m.m[0] * x + m.m[4] * y + m.m[8] * z + m.m[12];
+		output.y[i] = m.m[1] * x + m.m[5] * y + m.m[9] * z + m.m[13];
+		output.z[i] = m.m[2] * x + m.m[6] * y + m.m[10] * z + m.m[14];
+	}
+}
+
+void transformPointsSoA(const mat4& m, const PointsSoA& input, PointsSoA& output, size_t count)
+{
+	size_t i = 0;
+
+#if KNOX_MATH_AVX
+	{
+		// Every matrix element broadcast once, the loop is then 9 multiply-adds per 8 points
+		__m256 m0 = _mm256_set1_ps(m.m[0]), m1 = _mm256_set1_ps(m.m[1]), m2 = _mm256_set1_ps(m.m[2]);
+		__m256 m4 = _mm256_set1_ps(m.m[4]), m5 = _mm256_set1_ps(m.m[5]), m6 = _mm256_set1_ps(m.m[6]);
+		__m256 m8 = _mm256_set1_ps(m.m[8]), m9 = _mm256_set1_ps(m.m[9]), m10 = _mm256_set1_ps(m.m[10]);
+		__m256 m12 = _mm256_set1_ps(m.m[12]), m13 = _mm256_set1_ps(m.m[13]), m14 = _mm256_set1_ps(m.m[14]);
+
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 x = _mm256_loadu_ps(input.x + i);
+			__m256 y = _mm256_loadu_ps(input.y + i);
+			__m256 z = _mm256_loadu_ps(input.z + i);
+#if KNOX_MATH_FMA
+			__m256 outX = _mm256_fmadd_ps(m0, x, _mm256_fmadd_ps(m4, y, _mm256_fmadd_ps(m8, z, m12)));
+			__m256 outY = _mm256_fmadd_ps(m1, x, _mm256_fmadd_ps(m5, y, _mm256_fmadd_ps(m9, z, m13)));
+			__m256 outZ = _mm256_fmadd_ps(m2, x, _mm256_fmadd_ps(m6, y, _mm256_fmadd_ps(m10, z, m14)));
+#else
+			__m256 outX = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m0, x), _mm256_mul_ps(m4, y)), _mm256_add_ps(_mm256_mul_ps(m8, z), m12));
+			__m256 outY = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m1, x), _mm256_mul_ps(m5, y)), _mm256_add_ps(_mm256_mul_ps(m9, z), m13));
+			__m256 outZ = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m2, x), _mm256_mul_ps(m6, y)), _mm256_add_ps(_mm256_mul_ps(m10, z), m14));
+#endif
+			_mm256_storeu_ps(output.x + i, outX);
+			_mm256_storeu_ps(output.y + i, outY);
+			_mm256_storeu_ps(output.z + i, outZ);
+		}
+	}
+#endif
+
+#if KNOX_MATH_SSE
+	{
+		__m128 m0 = _mm_set1_ps(m.m[0]), m1 = _mm_set1_ps(m.m[1]), m2 = _mm_set1_ps(m.m[2]);
+		__m128 m4 = _mm_set1_ps(m.m[4]), m5 = _mm_set1_ps(m.m[5]), m6 = _mm_set1_ps(m.m[6]);
+		__m128 m8 = _mm_set1_ps(m.m[8]), m9 = _mm_set1_ps(m.m[9]), m10 = _mm_set1_ps(m.m[10]);
+		__m128 m12 = _mm_set1_ps(m.m[12]), m13 = _mm_set1_ps(m.m[13]), m14 = _mm_set1_ps(m.m[14]);
+
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(input.x + i);
+			__m128 y = _mm_loadu_ps(input.y + i);
+			__m128 z = _mm_loadu_ps(input.z + i);
+			_mm_storeu_ps(output.x + i, multiplyAdd(m0, x, multiplyAdd(m4, y, multiplyAdd(m8, z, m12))));
+			_mm_storeu_ps(output.y + i, multiplyAdd(m1, x, multiplyAdd(m5, y, multiplyAdd(m9, z, m13))));
+			_mm_storeu_ps(output.z + i, multiplyAdd(m2, x, multiplyAdd(m6, y, multiplyAdd(m10, z, m14))));
+		}
+	}
+#elif KNOX_MATH_NEON
+	{
+		float32x4_t m0 = vdupq_n_f32(m.m[0]), m1 = vdupq_n_f32(m.m[1]), m2 = vdupq_n_f32(m.m[2]);
+		float32x4_t m4 = vdupq_n_f32(m.m[4]), m5 = vdupq_n_f32(m.m[5]), m6 = vdupq_n_f32(m.m[6]);
+		float32x4_t m8 = vdupq_n_f32(m.m[8]), m9 = vdupq_n_f32(m.m[9]), m10 = vdupq_n_f32(m.m[10]);
+		float32x4_t m12 = vdupq_n_f32(m.m[12]), m13 = vdupq_n_f32(m.m[13]), m14 = vdupq_n_f32(m.m[14]);
+
+		for (; i + 4 <= count; i += 4)
+		{
+			float32x4_t x = vld1q_f32(input.x + i);
+			float32x4_t y = vld1q_f32(input.y + i);
+			float32x4_t z = vld1q_f32(input.z + i);
+			vst1q_f32(output.x + i, vmlaq_f32(vmlaq_f32(vmlaq_f32(m12, m8, z), m4, y), m0, x));
+			vst1q_f32(output.y + i, vmlaq_f32(vmlaq_f32(vmlaq_f32(m13, m9, z), m5, y), m1, x));
+			vst1q_f32(output.z + i, vmlaq_f32(vmlaq_f32(vmlaq_f32(m14, m10, z), m6, y), m2, x));
+		}
+	}
+#endif
+
+	if (i < count)
+	{
+		PointsSoA inputTail = { input.x + i, input.y + i, input.z + i };
+		PointsSoA outputTail = { output.x + i, output.y + i, output.z + i };
+		transformPointsSoAScalar(m, inputTail, outputTail, count - i);
+	}
+}
+
+void transformPoints(const mat4& m, const vec3* input, vec3* output, size_t count)
+{
+#if KNOX_MATH_SSE
+	__m128 c0 = _mm_load_ps(&m.m[0]);
+	__m128 c1 = _mm_load_ps(&m.m[4]);
+	__m128 c2 = _mm_load_ps(&m.m[8]);
+	__m128 c3 = _mm_load_ps(&m.m[12]);
+	for (size_t i = 0; i < count; i++)
+	{
+		__m128 result = multiplyAdd(c0, _mm_set1_ps(input[i].x), multiplyAdd(c1, _mm_set1_ps(input[i].y), multiplyAdd(c2, _mm_set1_ps(input[i].z), c3)));
+		alignas(16) float stored[4];
+		_mm_store_ps(stored, result);
+		output[i] = vec3(stored[0], stored[1], stored[2]);
+	}
+#else
+	for (size_t i = 0; i < count; i++)
+	{
+		output[i] = transformPoint(m, input[i]);
+	}
+#endif
+}
+
+void multiplyMatrices(const mat4* a, const mat4* b, mat4* output, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		output[i] = multiply(a[i], b[i]);
+	}
+}
+
+void multiplyMatrices(const mat4& parent, const mat4* local, mat4* output, size_t count)
+{
+#if KNOX_MATH_SSE
+	// NOTE The parent columns stay in registers for the whole array
+	__m128 c0 = _mm_load_ps(&parent.m[0]);
+	__m128 c1 = _mm_load_ps(&parent.m[4]);
+	__m128 c2 = _mm_load_ps(&parent.m[8]);
+	__m128 c3 = _mm_load_ps(&parent.m[12]);
+	for (size_t i = 0; i < count; i++)
+	{
+		const float* source = local[i].m;
+		float* destination = output[i].m;
+		_mm_store_ps(destination + 0, transformColumn(c0, c1, c2, c3, _mm_load_ps(source + 0)));
+		_mm_store_ps(destination + 4, transformColumn(c0, c1, c2, c3, _mm_load_ps(source + 4)));
+		_mm_store_ps(destination + 8, transformColumn(c0, c1, c2, c3, _mm_load_ps(source + 8)));
+		_mm_store_ps(destination + 12, transformColumn(c0, c1, c2, c3, _mm_load_ps(source + 12)));
+	}
+#else
+	for (size_t i = 0; i < count; i++)
+	{
+		output[i] = multiply(parent, local[i]);
+	}
+#endif
+}
+
+const char* getMathInstructionSet()
+{
+#if KNOX_MATH_AVX && KNOX_MATH_FMA
+	return "AVX + FMA";
+#elif KNOX_MATH_AVX
+	return "AVX";
+#elif KNOX_MATH_SSE && KNOX_MATH_FMA
+	return "SSE + FMA";
+#elif KNOX_MATH_SSE
+	return "SSE";
+#elif KNOX_MATH_NEON
+	return "NEON";
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "MathTypes.h"
+
+#include <cstddef>
+
+// Kernels that run the same operation over whole arrays.
+//
+// Points are stored structure-of-arrays (all x, then all y, then all z), so one register
+// holds the same component of 4 (SSE/NEON) or 8 (AVX) points and no shuffling is needed.
+// Arrays don't have to be aligned and count doesn't have to be a multiple of the width,
+// the remainder runs through the scalar code
+struct PointsSoA
+{
+	float* x;
+	float* y;
+	float* z;
+};
+
+void transformPointsSoA(const mat4& m, const PointsSoA& input, PointsSoA& output, size_t count);
+void transformPointsSoAScalar(const mat4& m, const PointsSoA& input, PointsSoA& output, size_t count);
+
+// Same transform for array-of-structures points, one point per SIMD operation
+void transformPoints(const mat4& m, const vec3* input, vec3* output, size_t count);
+
+// output[i] = a[i] * b[i]
+void multiplyMatrices(const mat4* a, const mat4* b, mat4* output, size_t count);
+
+// output[i] = parent * local[i]
+void multiplyMatrices(const mat4& parent, const mat4* local, mat4* output, size_t count);
+
+// Name of the instruction set the kernels were compiled for
+const char* getMathInstructionSet();
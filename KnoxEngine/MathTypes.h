@@ -0,0 +1,586 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+// Vector, matrix and quaternion types for the engine.
+//
+// Matrices are column-major like OpenGL expects, so a mat4 can be passed straight to
+// glUniformMatrix4fv / an instance buffer, and vectors are transformed as m * v.
+//
+// The hot operations (mat4 multiply, inverse, transforms, quat multiply) use SSE on x86
+// (with FMA and AVX when the compiler is allowed to use them) and NEON on ARM.
+// Every one of them also has a ...Scalar version: plain constexpr C++ that works at compile
+// time, serves as the reference for the SIMD code and is what runs when KNOX_MATH_SCALAR
+// is defined or there's no SIMD instruction set available
+#if !defined(KNOX_MATH_SCALAR)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define KNOX_MATH_SSE 1
+#include <immintrin.h>
+#if defined(__AVX__)
+#define KNOX_MATH_AVX 1
+#endif
+#if defined(__FMA__) || defined(__AVX2__)
+#define KNOX_MATH_FMA 1
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define KNOX_MATH_NEON 1
+#include <arm_neon.h>
+#endif
+#endif
+
+struct vec3
+{
+	float x, y, z;
+
+	constexpr vec3() : x(0.0f), y(0.0f), z(0.0f) {}
+	constexpr explicit vec3(float value) : x(value), y(value), z(value) {}
+	constexpr vec3(float x, float y, float z) : x(x), y(y), z(z) {}
+};
+
+struct alignas(16) vec4
+{
+	float x, y, z, w;
+
+	constexpr vec4() : x(0.0f), y(0.0f), z(0.0f), w(0.0f) {}
+	constexpr explicit vec4(float value) : x(value), y(value), z(value), w(value) {}
+	constexpr vec4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+	constexpr vec4(const vec3& v, float w) : x(v.x), y(v.y), z(v.z), w(w) {}
+
+	constexpr vec3 xyz() const { return vec3(x, y, z); }
+};
+
+// Column-major 4x4 matrix, m[column * 4 + row]
+struct alignas(16) mat4
+{
+	float m[16];
+
+	constexpr mat4() : m{ 0.0f } {}
+	constexpr mat4(const vec4& c0, const vec4& c1, const vec4& c2, const vec4& c3)
+		: m{ c0.x, c0.y, c0.z, c0.w, c1.x, c1.y, c1.z, c1.w, c2.x, c2.y, c2.z, c2.w, c3.x, c3.y, c3.z, c3.w } {}
+
+	static constexpr mat4 identity()
+	{
+		return mat4(vec4(1.0f, 0.0f, 0.0f, 0.0f), vec4(0.0f, 1.0f, 0.0f, 0.0f), vec4(0.0f, 0.0f, 1.0f, 0.0f), vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	}
+
+	constexpr vec4 column(int index) const { return vec4(m[index * 4], m[index * 4 + 1], m[index * 4 + 2], m[index * 4 + 3]); }
+	constexpr float at(int row, int column) const { return m[column * 4 + row]; }
+	const float* data() const { return m; }
+};
+
+// Rotation quaternion, w is the scalar part
+struct alignas(16) quat
+{
+	float x, y, z, w;
+
+	constexpr quat() : x(0.0f), y(0.0f), z(0.0f), w(1.0f) {}
+	constexpr quat(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+};
+
+////////////////////////////////////
+//
+// VECTORS
+//
+// NOTE Plain scalar code on purpose, it stays constexpr and compilers vectorize it just fine
+constexpr vec3 operator+(const vec3& a, const vec3& b) { return vec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+constexpr vec3 operator-(const vec3& a, const vec3& b) { return vec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+constexpr vec3 operator*(const vec3& a, const vec3& b) { return vec3(a.x * b.x, a.y * b.y, a.z * b.z); }
+constexpr vec3 operator*(const vec3& a, float s) { return vec3(a.x * s, a.y * s, a.z * s); }
+constexpr vec3 operator*(float s, const vec3& a) { return vec3(a.x * s, a.y * s, a.z * s); }
+constexpr vec3 operator/(const vec3& a, float s) { return vec3(a.x / s, a.y / s, a.z / s); }
+constexpr vec3 operator-(const vec3& a) { return vec3(-a.x, -a.y, -a.z); }
+
+constexpr float dot(const vec3& a, const vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+constexpr vec3 cross(const vec3& a, const vec3& b) { return vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+inline float length(const vec3& v) { return std::sqrt(dot(v, v)); }
+inline vec3 normalize(const vec3& v) { return v * (1.0f / length(v)); }
+
+constexpr vec4 operator+(const vec4& a, const vec4& b) { return vec4(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w); }
+constexpr vec4 operator-(const vec4& a, const vec4& b) { return vec4(a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w); }
+constexpr vec4 operator*(const vec4& a, const vec4& b) { return vec4(a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w); }
+constexpr vec4 operator*(const vec4& a, float s) { return vec4(a.x * s, a.y * s, a.z * s, a.w * s); }
+constexpr vec4 operator*(float s, const vec4& a) { return vec4(a.x * s, a.y * s, a.z * s, a.w * s); }
+constexpr vec4 operator-(const vec4& a) { return vec4(-a.x, -a.y, -a.z, -a.w); }
+
+constexpr float dot(const vec4& a, const vec4& b) { return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w; }
+inline float length(const vec4& v) { return std::sqrt(dot(v, v)); }
+inline vec4 normalize(const vec4& v) { return v * (1.0f / length(v)); }
+
+////////////////////////////////////
+//
+// SCALAR REFERENCE
+//
+constexpr mat4 multiplyScalar(const mat4& a, const mat4& b)
+{
+	mat4 result;
+	for (int column = 0; column < 4; column++)
+	{
+		for (int row = 0; row < 4; row++)
+		{
+			float sum = 0.0f;
+			for (int k = 0; k < 4; k++)
+			{
+				sum += a.m[k * 4 + row] * b.m[column * 4 + k];
+			}
+			result.m[column * 4 + row] = sum;
+		}
+	}
+	return result;
+}
+
+constexpr vec4 transformScalar(const mat4& m, const vec4& v)
+{
+	return vec4(
+		m.m[0] * v.x + m.m[4] * v.y + m.m[8] * v.z + m.m[12] * v.w,
+		m.m[1] * v.x + m.m[5] * v.y + m.m[9] * v.z + m.m[13] * v.w,
+		m.m[2] * v.x + m.m[6] * v.y + m.m[10] * v.z + m.m[14] * v.w,
+		m.m[3] * v.x + m.m[7] * v.y + m.m[11] * v.z + m.m[15] * v.w);
+}
+
+// Treats p as a point (w = 1) and drops w, so no perspective divide
+constexpr vec3 transformPointScalar(const mat4& m, const vec3& p)
+{
+	return vec3(
+		m.m[0] * p.x + m.m[4] * p.y + m.m[8] * p.z + m.m[12],
+		m.m[1] * p.x + m.m[5] * p.y + m.m[9] * p.z + m.m[13],
+		m.m[2] * p.x + m.m[6] * p.y + m.m[10] * p.z + m.m[14]);
+}
+
+constexpr mat4 transpose(const mat4& m)
+{
+	mat4 result;
+	for (int column = 0; column < 4; column++)
+	{
+		for (int row = 0; row < 4; row++)
+		{
+			result.m[row * 4 + column] = m.m[column * 4 + row];
+		}
+	}
+	return result;
+}
+
+// General inverse by cofactors. A singular matrix gives infinities/NaNs, like glm
+// NOTE The formula is layout agnostic: inverse(transpose(M)) == transpose(inverse(M))
+constexpr mat4 inverseScalar(const mat4& matrix)
+{
+	const float* m = matrix.m;
+	mat4 result;
+	float* r = result.m;
+
+	r[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+	r[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+	r[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+	r[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+	r[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+	r[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+	r[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+	r[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+	r[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+	r[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+	r[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+	r[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+	r[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+	r[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+	r[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+	r[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+	float determinant = m[0] * r[0] + m[1] * r[4] + m[2] * r[8] + m[3] * r[12];
+	float inverseDeterminant = 1.0f / determinant;
+	for (int i = 0; i < 16; i++)
+	{
+		r[i] *= inverseDeterminant;
+	}
+	return result;
+}
+
+constexpr quat multiplyScalar(const quat& a, const quat& b)
+{
+	return quat(
+		a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+		a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+		a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+		a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z);
+}
+
+////////////////////////////////////
+//
+// SIMD
+//
+#if KNOX_MATH_SSE
+inline __m128 multiplyAdd(__m128 a, __m128 b, __m128 c)
+{
+#if KNOX_MATH_FMA
+	return _mm_fmadd_ps(a, b, c);
+#else
+	return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+}
+
+// m * column, with the matrix columns already in registers
+inline __m128 transformColumn(__m128 c0, __m128 c1, __m128 c2, __m128 c3, __m128 v)
+{
+	__m128 result = _mm_mul_ps(c0, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+	result = multiplyAdd(c1, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)), result);
+	result = multiplyAdd(c2, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)), result);
+	return multiplyAdd(c3, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)), result);
+}
+#endif
+
+#if KNOX_MATH_NEON
+inline float32x4_t transformColumn(float32x4_t c0, float32x4_t c1, float32x4_t c2, float32x4_t c3, float32x4_t v)
+{
+	float32x2_t low = vget_low_f32(v);
+	float32x2_t high = vget_high_f32(v);
+	float32x4_t result = vmulq_lane_f32(c0, low, 0);
+	result = vmlaq_lane_f32(result, c1, low, 1);
+	result = vmlaq_lane_f32(result, c2, high, 0);
+	return vmlaq_lane_f32(result, c3, high, 1);
+}
+#endif
+
+inline mat4 multiply(const mat4& a, const mat4& b)
+{
+#if KNOX_MATH_AVX
+	// Two result columns per iteration: every 128 bit lane holds one column of b
+	mat4 result;
+	__m256 a0 = _mm256_broadcast_ps((const __m128*)&a.m[0]);
+	__m256 a1 = _mm256_broadcast_ps((const __m128*)&a.m[4]);
+	__m256 a2 = _mm256_broadcast_ps((const __m128*)&a.m[8]);
+	__m256 a3 = _mm256_broadcast_ps((const __m128*)&a.m[12]);
+	for (int column = 0; column < 4; column += 2)
+	{
+		__m256 b01 = _mm256_loadu_ps(&b.m[column * 4]);
+		__m256 r = _mm256_mul_ps(a0, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(0, 0, 0, 0)));
+#if KNOX_MATH_FMA
+		r = _mm256_fmadd_ps(a1, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(1, 1, 1, 1)), r);
+		r = _mm256_fmadd_ps(a2, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(2, 2, 2, 2)), r);
+		r = _mm256_fmadd_ps(a3, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(3, 3, 3, 3)), r);
+#else
+		r = _mm256_add_ps(r, _mm256_mul_ps(a1, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(1, 1, 1, 1))));
+		r = _mm256_add_ps(r, _mm256_mul_ps(a2, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(2, 2, 2, 2))));
+		r = _mm256_add_ps(r, _mm256_mul_ps(a3, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(3, 3, 3, 3))));
+#endif
+		_mm256_storeu_ps(&result.m[column * 4], r);
+	}
+	return result;
+#elif KNOX_MATH_SSE
+	mat4 result;
+	__m128 c0 = _mm_load_ps(&a.m[0]);
+	__m128 c1 = _mm_load_ps(&a.m[4]);
+	__m128 c2 = _mm_load_ps(&a.m[8]);
+	__m128 c3 = _mm_load_ps(&a.m[12]);
+	_mm_store_ps(&result.m[0], transformColumn(c0, c1, c2, c3, _mm_load_ps(&b.m[0])));
+	_mm_store_ps(&result.m[4], transformColumn(c0, c1, c2, c3, _mm_load_ps(&b.m[4])));
+	_mm_store_ps(&result.m[8], transformColumn(c0, c1, c2, c3, _mm_load_ps(&b.m[8])));
+	_mm_store_ps(&result.m[12], transformColumn(c0, c1, c2, c3, _mm_load_ps(&b.m[12])));
+	return result;
+#elif KNOX_MATH_NEON
+	mat4 result;
+	float32x4_t c0 = vld1q_f32(&a.m[0]);
+	float32x4_t c1 = vld1q_f32(&a.m[4]);
+	float32x4_t c2 = vld1q_f32(&a.m[8]);
+	float32x4_t c3 = vld1q_f32(&a.m[12]);
+	vst1q_f32(&result.m[0], transformColumn(c0, c1, c2, c3, vld1q_f32(&b.m[0])));
+	vst1q_f32(&result.m[4], transformColumn(c0, c1, c2, c3, vld1q_f32(&b.m[4])));
+	vst1q_f32(&result.m[8], transformColumn(c0, c1, c2, c3, vld1q_f32(&b.m[8])));
+	vst1q_f32(&result.m[12], transformColumn(c0, c1, c2, c3, vld1q_f32(&b.m[12])));
+	return result;
+#else
+	return multiplyScalar(a, b);
+#endif
+}
+
+inline vec4 transform(const mat4& m, const vec4& v)
+{
+#if KNOX_MATH_SSE
+	vec4 result;
+	_mm_store_ps(&result.x, transformColumn(_mm_load_ps(&m.m[0]), _mm_load_ps(&m.m[4]), _mm_load_ps(&m.m[8]), _mm_load_ps(&m.m[12]), _mm_load_ps(&v.x)));
+	return result;
+#elif KNOX_MATH_NEON
+	vec4 result;
+	vst1q_f32(&result.x, transformColumn(vld1q_f32(&m.m[0]), vld1q_f32(&m.m[4]), vld1q_f32(&m.m[8]), vld1q_f32(&m.m[12]), vld1q_f32(&v.x)));
+	return result;
+#else
+	return transformScalar(m, v);
+#endif
+}
+
+inline vec3 transformPoint(const mat4& m, const vec3& p)
+{
+	vec4 result = transform(m, vec4(p, 1.0f));
+	return vec3(result.x, result.y, result.z);
+}
+
+inline vec3 transformVector(const mat4& m, const vec3& v)
+{
+	vec4 result = transform(m, vec4(v, 0.0f));
+	return vec3(result.x, result.y, result.z);
+}
+
+inline mat4 operator*(const mat4& a, const mat4& b) { return multiply(a, b); }
+inline vec4 operator*(const mat4& m, const vec4& v) { return transform(m, v); }
+
+#if KNOX_MATH_SSE
+// 2x2 blocks are stored as (m00, m01, m10, m11)
+inline __m128 mat2Multiply(__m128 a, __m128 b)
+{
+	return _mm_add_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 3, 0))),
+		_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
+}
+
+// adjugate(a) * b
+inline __m128 mat2AdjugateMultiply(__m128 a, __m128 b)
+{
+	return _mm_sub_ps(_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 3, 3)), b),
+		_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 1, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2))));
+}
+
+// a * adjugate(b)
+inline __m128 mat2MultiplyAdjugate(__m128 a, __m128 b)
+{
+	return _mm_sub_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 3, 0, 3))),
+		_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
+}
+#endif
+
+// General inverse, singular matrices give infinities/NaNs like inverseScalar
+inline mat4 inverse(const mat4& matrix)
+{
+#if KNOX_MATH_SSE
+	// Block-wise inverse: the matrix is split in four 2x2 blocks A B / C D and the inverse
+	// is built from their adjugates and determinants, which maps well onto 4 wide registers
+	__m128 c0 = _mm_load_ps(&matrix.m[0]);
+	__m128 c1 = _mm_load_ps(&matrix.m[4]);
+	__m128 c2 = _mm_load_ps(&matrix.m[8]);
+	__m128 c3 = _mm_load_ps(&matrix.m[12]);
+
+	__m128 a = _mm_movelh_ps(c0, c1);
+	__m128 b = _mm_movehl_ps(c1, c0);
+	__m128 c = _mm_movelh_ps(c2, c3);
+	__m128 d = _mm_movehl_ps(c3, c2);
+
+	// Determinants of the four blocks as (|A|, |B|, |C|, |D|)
+	__m128 blockDeterminants = _mm_sub_ps(
+		_mm_mul_ps(_mm_shuffle_ps(c0, c2, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(c1, c3, _MM_SHUFFLE(3, 1, 3, 1))),
+		_mm_mul_ps(_mm_shuffle_ps(c0, c2, _MM_SHUFFLE(3, 1, 3, 1)), _mm_shuffle_ps(c1, c3, _MM_SHUFFLE(2, 0, 2, 0))));
+	__m128 determinantA = _mm_shuffle_ps(blockDeterminants, blockDeterminants, _MM_SHUFFLE(0, 0, 0, 0));
+	__m128 determinantB = _mm_shuffle_ps(blockDeterminants, blockDeterminants, _MM_SHUFFLE(1, 1, 1, 1));
+	__m128 determinantC = _mm_shuffle_ps(blockDeterminants, blockDeterminants, _MM_SHUFFLE(2, 2, 2, 2));
+	__m128 determinantD = _mm_shuffle_ps(blockDeterminants, blockDeterminants, _MM_SHUFFLE(3, 3, 3, 3));
+
+	__m128 adjugateDTimesC = mat2AdjugateMultiply(d, c);
+	__m128 adjugateATimesB = mat2AdjugateMultiply(a, b);
+
+	__m128 x = _mm_sub_ps(_mm_mul_ps(determinantD, a), mat2Multiply(b, adjugateDTimesC));
+	__m128 w = _mm_sub_ps(_mm_mul_ps(determinantA, d), mat2Multiply(c, adjugateATimesB));
+	__m128 y = _mm_sub_ps(_mm_mul_ps(determinantB, c), mat2MultiplyAdjugate(d, adjugateATimesB));
+	__m128 z = _mm_sub_ps(_mm_mul_ps(determinantC, b), mat2MultiplyAdjugate(a, adjugateDTimesC));
+
+	// |M| = |A||D| + |B||C| - trace(adj(A)B adj(D)C)
+	__m128 trace = _mm_mul_ps(adjugateATimesB, _mm_shuffle_ps(adjugateDTimesC, adjugateDTimesC, _MM_SHUFFLE(3, 1, 2, 0)));
+	trace = _mm_add_ps(trace, _mm_shuffle_ps(trace, trace, _MM_SHUFFLE(2, 3, 0, 1)));
+	trace = _mm_add_ps(trace, _mm_shuffle_ps(trace, trace, _MM_SHUFFLE(1, 0, 3, 2)));
+	__m128 determinant = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(determinantA, determinantD), _mm_mul_ps(determinantB, determinantC)), trace);
+
+	__m128 inverseDeterminant = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), determinant);
+	x = _mm_mul_ps(x, inverseDeterminant);
+	y = _mm_mul_ps(y, inverseDeterminant);
+	z = _mm_mul_ps(z, inverseDeterminant);
+	w = _mm_mul_ps(w, inverseDeterminant);
+
+	// Adjugate of every block, shuffled straight back into columns
+	mat4 result;
+	_mm_store_ps(&result.m[0], _mm_shuffle_ps(x, y, _MM_SHUFFLE(1, 3, 1, 3)));
+	_mm_store_ps(&result.m[4], _mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 2, 0, 2)));
+	_mm_store_ps(&result.m[8], _mm_shuffle_ps(z, w, _MM_SHUFFLE(1, 3, 1, 3)));
+	_mm_store_ps(&result.m[12], _mm_shuffle_ps(z, w, _MM_SHUFFLE(0, 2, 0, 2)));
+	return result;
+#else
+	return inverseScalar(matrix);
+#endif
+}
+
+// Inverse of a rotation + translation matrix (no scale), much cheaper than the general one
+inline mat4 inverseRigid(const mat4& m)
+{
+	mat4 result = transpose(m);
+	result.m[3] = 0.0f;
+	result.m[7] = 0.0f;
+	result.m[11] = 0.0f;
+	vec3 translation(m.m[12], m.m[13], m.m[14]);
+	result.m[12] = -(m.m[0] * translation.x + m.m[1] * translation.y + m.m[2] * translation.z);
+	result.m[13] = -(m.m[4] * translation.x + m.m[5] * translation.y + m.m[6] * translation.z);
+	result.m[14] = -(m.m[8] * translation.x + m.m[9] * translation.y + m.m[10] * translation.z);
+	result.m[15] = 1.0f;
+	return result;
+}
+
+////////////////////////////////////
+//
+// QUATERNIONS
+//
+inline quat multiply(const quat& a, const quat& b)
+{
+#if KNOX_MATH_SSE
+	__m128 qa = _mm_load_ps(&a.x);
+	__m128 qb = _mm_load_ps(&b.x);
+
+	// Every term of multiplyScalar as a column, the signs are applied with an xor
+	__m128 aw = _mm_shuffle_ps(qa, qa, _MM_SHUFFLE(3, 3, 3, 3));
+	__m128 result = _mm_mul_ps(aw, qb);
+
+	__m128 ax = _mm_shuffle_ps(qa, qa, _MM_SHUFFLE(0, 0, 0, 0));
+	__m128 bwzyx = _mm_shuffle_ps(qb, qb, _MM_SHUFFLE(0, 1, 2, 3));
+	__m128 sign = _mm_castsi128_ps(_mm_setr_epi32(0, (int)0x80000000, 0, (int)0x80000000));
+	result = _mm_add_ps(result, _mm_xor_ps(_mm_mul_ps(ax, bwzyx), sign));
+
+	__m128 ay = _mm_shuffle_ps(qa, qa, _MM_SHUFFLE(1, 1, 1, 1));
+	__m128 bzwxy = _mm_shuffle_ps(qb, qb, _MM_SHUFFLE(1, 0, 3, 2));
+	sign = _mm_castsi128_ps(_mm_setr_epi32(0, 0, (int)0x80000000, (int)0x80000000));
+	result = _mm_add_ps(result, _mm_xor_ps(_mm_mul_ps(ay, bzwxy), sign));
+
+	__m128 az = _mm_shuffle_ps(qa, qa, _MM_SHUFFLE(2, 2, 2, 2));
+	__m128 byxwz = _mm_shuffle_ps(qb, qb, _MM_SHUFFLE(2, 3, 0, 1));
+	sign = _mm_castsi128_ps(_mm_setr_epi32((int)0x80000000, 0, 0, (int)0x80000000));
+	result = _mm_add_ps(result, _mm_xor_ps(_mm_mul_ps(az, byxwz), sign));
+
+	quat q;
+	_mm_store_ps(&q.x, result);
+	return q;
+#else
+	return multiplyScalar(a, b);
+#endif
+}
+
+inline quat operator*(const quat& a, const quat& b) { return multiply(a, b); }
+
+constexpr quat conjugate(const quat& q) { return quat(-q.x, -q.y, -q.z, q.w); }
+constexpr float dot(const quat& a, const quat& b) { return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w; }
+
+inline quat normalize(const quat& q)
+{
+	float inverseLength = 1.0f / std::sqrt(dot(q, q));
+	return quat(q.x * inverseLength, q.y * inverseLength, q.z * inverseLength, q.w * inverseLength);
+}
+
+// axis has to be normalized, angle is in radians
+inline quat quatFromAxisAngle(const vec3& axis, float angle)
+{
+	float s = std::sin(angle * 0.5f);
+	return quat(axis.x * s, axis.y * s, axis.z * s, std::cos(angle * 0.5f));
+}
+
+// Rotates v by a unit quaternion: v + 2w(q x v) + 2q x (q x v)
+constexpr vec3 rotate(const quat& q, const vec3& v)
+{
+	vec3 axis(q.x, q.y, q.z);
+	vec3 t = cross(axis, v) * 2.0f;
+	return v + t * q.w + cross(axis, t);
+}
+
+// Shortest path interpolation, renormalized, good enough for small steps like animation frames
+inline quat nlerp(const quat& a, const quat& b, float t)
+{
+	float sign = dot(a, b) < 0.0f ? -1.0f : 1.0f;
+	return normalize(quat(
+		a.x + (b.x * sign - a.x) * t,
+		a.y + (b.y * sign - a.y) * t,
+		a.z + (b.z * sign - a.z) * t,
+		a.w + (b.w * sign - a.w) * t));
+}
+
+inline quat slerp(const quat& a, const quat& b, float t)
+{
+	float cosine = dot(a, b);
+	float sign = 1.0f;
+	if (cosine < 0.0f)
+	{
+		cosine = -cosine;
+		sign = -1.0f;
+	}
+
+	// NOTE Almost parallel, sin(angle) goes to zero and nlerp is just as accurate
+	if (cosine > 0.9995f)
+	{
+		return nlerp(a, b, t);
+	}
+
+	float angle = std::acos(cosine);
+	float inverseSine = 1.0f / std::sin(angle);
+	float weightA = std::sin((1.0f - t) * angle) * inverseSine;
+	float weightB = std::sin(t * angle) * inverseSine * sign;
+	return quat(
+		a.x * weightA + b.x * weightB,
+		a.y * weightA + b.y * weightB,
+		a.z * weightA + b.z * weightB,
+		a.w * weightA + b.w * weightB);
+}
+
+////////////////////////////////////
+//
+// BUILDERS
+//
+constexpr mat4 translation(const vec3& offset)
+{
+	return mat4(vec4(1.0f, 0.0f, 0.0f, 0.0f), vec4(0.0f, 1.0f, 0.0f, 0.0f), vec4(0.0f, 0.0f, 1.0f, 0.0f), vec4(offset, 1.0f));
+}
+
+constexpr mat4 scaling(const vec3& scale)
+{
+	return mat4(vec4(scale.x, 0.0f, 0.0f, 0.0f), vec4(0.0f, scale.y, 0.0f, 0.0f), vec4(0.0f, 0.0f, scale.z, 0.0f), vec4(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+// q has to be normalized
+constexpr mat4 rotation(const quat& q)
+{
+	float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+	return mat4(
+		vec4(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f),
+		vec4(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f),
+		vec4(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f),
+		vec4(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+// translation * rotation * scale in one go
+constexpr mat4 composeTransform(const vec3& position, const quat& orientation, const vec3& scale)
+{
+	mat4 result = rotation(orientation);
+	for (int i = 0; i < 4; i++)
+	{
+		result.m[i] *= scale.x;
+		result.m[4 + i] *= scale.y;
+		result.m[8 + i] *= scale.z;
+	}
+	result.m[12] = position.x;
+	result.m[13] = position.y;
+	result.m[14] = position.z;
+	return result;
+}
+
+// OpenGL clip space (z from -1 to 1), fovY in radians
+inline mat4 perspective(float fovY, float aspect, float nearPlane, float farPlane)
+{
+	float f = 1.0f / std::tan(fovY * 0.5f);
+	mat4 result;
+	result.m[0] = f / aspect;
+	result.m[5] = f;
+	result.m[10] = (farPlane + nearPlane) / (nearPlane - farPlane);
+	result.m[11] = -1.0f;
+	result.m[14] = 2.0f * farPlane * nearPlane / (nearPlane - farPlane);
+	return result;
+}
+
+inline mat4 lookAt(const vec3& eye, const vec3& target, const vec3& up)
+{
+	vec3 forward = normalize(target - eye);
+	vec3 side = normalize(cross(forward, up));
+	vec3 cameraUp = cross(side, forward);
+	return mat4(
+		vec4(side.x, cameraUp.x, -forward.x, 0.0f),
+		vec4(side.y, cameraUp.y, -forward.y, 0.0f),
+		vec4(side.z, cameraUp.z, -forward.z, 0.0f),
+		vec4(-dot(side, eye), -dot(cameraUp, eye), dot(forward, eye), 1.0f));
+}
@@ -0,0 +1,122 @@
+#include "MemoryTracker.h"
+#include "Counters.h"
+
+#include <iostream>
+#include <mutex>
+#include <vector>
+#include <cstring>
+
+// NOTE Function statics, so tracking works from other globals' constructors too
+static std::mutex& getTrackerMutex()
+{
+	static std::mutex mutex;
+	return mutex;
+}
+
+static std::vector<MemoryTrackerEntry>& getTrackerEntries()
+{
+	static std::vector<MemoryTrackerEntry> entries;
+	return entries;
+}
+
+// There are only a few dozen entries, a linear search is fine
+static MemoryTrackerEntry& findEntry(const char* subsystem, const char* tag)
+{
+	std::vector<MemoryTrackerEntry>& entries = getTrackerEntries();
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		if (strcmp(entries[i].subsystem, subsystem) == 0 && strcmp(entries[i].tag, tag) == 0)
+		{
+			return entries[i];
+		}
+	}
+
+	MemoryTrackerEntry entry = MemoryTrackerEntry();
+	entry.subsystem = subsystem;
+	entry.tag = tag;
+	entries.push_back(entry);
+	return entries.back();
+}
+
+void trackAllocation(const char* subsystem, const char* tag, size_t bytes)
+{
+	countEvent(CounterAllocations);
+	std::lock_guard<std::mutex> lock(getTrackerMutex());
+	MemoryTrackerEntry& entry = findEntry(subsystem, tag);
+	entry.currentBytes += bytes;
+	entry.allocationCount++;
+	if (entry.currentBytes > entry.peakBytes)
+	{
+		entry.peakBytes = entry.currentBytes;
+	}
+}
+
+void trackFree(const char* subsystem, const char* tag, size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(getTrackerMutex());
+	MemoryTrackerEntry& entry = findEntry(subsystem, tag);
+	if (entry.currentBytes < bytes || entry.allocationCount == 0)
+	{
+		printf("ERROR: Freeing more memory than was tracked for %s/%s\n", subsystem, tag);
+		entry.currentBytes = 0;
+		entry.allocationCount = 0;
+		return;
+	}
+	entry.currentBytes -= bytes;
+	entry.allocationCount--;
+}
+
+size_t getTrackedBytes(const char* subsystem, const char* tag)
+{
+	std::lock_guard<std::mutex> lock(getTrackerMutex());
+	std::vector<MemoryTrackerEntry>& entries = getTrackerEntries();
+
+	size_t bytes = 0;
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		if (strcmp(entries[i].subsystem, subsystem) == 0 && (!tag || strcmp(entries[i].tag, tag) == 0))
+		{
+			bytes += entries[i].currentBytes;
+		}
+	}
+	return bytes;
+}
+
+void printMemoryReport()
+{
+	std::lock_guard<std::mutex> lock(getTrackerMutex());
+	std::vector<MemoryTrackerEntry>& entries = getTrackerEntries();
+
+	printf("Memory report:\n");
+	std::vector<bool> printed(entries.size(), false);
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		if (printed[i])
+		{
+			continue;
+		}
+
+		// Subsystem total first, then every tag that belongs to it
+		size_t subsystemBytes = 0;
+		size_t subsystemPeak = 0;
+		for (size_t j = i; j < entries.size(); j++)
+		{
+			if (strcmp(entries[j].subsystem, entries[i].subsystem) == 0)
+			{
+				subsystemBytes += entries[j].currentBytes;
+				subsystemPeak += entries[j].peakBytes;
+			}
+		}
+		printf("  %-12s %10.1f KB (tag peaks add up to %.1f KB)\n", entries[i].subsystem, subsystemBytes / 1024.0, subsystemPeak / 1024.0);
+
+		for (size_t j = i; j < entries.size(); j++)
+		{
+			if (strcmp(entries[j].subsystem, entries[i].subsystem) == 0)
+			{
+				printf("    %-28s %10.1f KB, peak %10.1f KB, %u blocks\n",
+					entries[j].tag, entries[j].currentBytes / 1024.0, entries[j].peakBytes / 1024.0, entries[j].allocationCount);
+				printed[j] = true;
+			}
+		}
+	}
+}
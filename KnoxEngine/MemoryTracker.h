@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Global bookkeeping of the memory held by the engine, grouped by subsystem ("Resources", "GPU", ...)
+// and by a tag naming what it's for inside of it ("Shader", "StreamBuffer", ...).
+// Meant for the big long lived blocks (pools, arenas, buffers), not for every small allocation.
+// NOTE subsystem and tag are stored by pointer, pass string literals
+struct MemoryTrackerEntry
+{
+	const char* subsystem;
+	const char* tag;
+	size_t currentBytes;
+	size_t peakBytes;
+	uint32_t allocationCount;	// currently alive
+};
+
+void trackAllocation(const char* subsystem, const char* tag, size_t bytes);
+void trackFree(const char* subsystem, const char* tag, size_t bytes);
+
+// Current bytes of a whole subsystem, or of a single tag in it
+size_t getTrackedBytes(const char* subsystem, const char* tag = NULL);
+
+void printMemoryReport();
@@ -0,0 +1,273 @@
+#include "OcclusionCuller.h"
+
+#include <chrono>
+#include <algorithm>
+
+// Triangles with a vertex closer than this (clip w) are skipped rather than clipped
+static const float NearW = 1e-3f;
+
+static double millisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+OcclusionCuller::OcclusionCuller(int width, int height) : width((width + 3) & ~3), height(height)
+{
+	// Halve down to 1x1, odd sizes round up so every texel of a level is covered by the next one
+	int levelWidth = this->width;
+	int levelHeight = height;
+	while (true)
+	{
+		Level level;
+		level.width = levelWidth;
+		level.height = levelHeight;
+		level.depths.assign((size_t)levelWidth * levelHeight, 1.0f);
+		levels.push_back(level);
+
+		if (levelWidth == 1 && levelHeight == 1)
+		{
+			break;
+		}
+		levelWidth = (levelWidth + 1) / 2;
+		levelHeight = (levelHeight + 1) / 2;
+	}
+
+	viewProjection = mat4::identity();
+	stats = Stats();
+}
+
+void OcclusionCuller::beginFrame(const mat4& viewProjection)
+{
+	this->viewProjection = viewProjection;
+	std::fill(levels[0].depths.begin(), levels[0].depths.end(), 1.0f);
+	stats = Stats();
+}
+
+void OcclusionCuller::drawOccluder(const mat4& model, const float* vertices, uint32_t stride, const uint32_t* indices, uint32_t indexCount)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	mat4 modelViewProjection = multiply(viewProjection, model);
+
+	for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		vec4 clip[3];
+		bool crossesNear = false;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			const float* position = vertices + (size_t)indices[i + corner] * stride;
+			clip[corner] = transform(modelViewProjection, vec4(position[0], position[1], position[2], 1.0f));
+			crossesNear = crossesNear || clip[corner].w < NearW;
+		}
+		if (crossesNear)
+		{
+			continue;
+		}
+
+		rasterizeTriangle(clip[0], clip[1], clip[2]);
+		stats.occluderTriangles++;
+	}
+
+	stats.rasterMilliseconds += millisecondsSince(start);
+}
+
+void OcclusionCuller::rasterizeTriangle(const vec4& a, const vec4& b, const vec4& c)
+{
+	// Screen space, depth in [0, 1]
+	float x0 = (a.x / a.w * 0.5f + 0.5f) * width, y0 = (a.y / a.w * 0.5f + 0.5f) * height, z0 = a.z / a.w * 0.5f + 0.5f;
+	float x1 = (b.x / b.w * 0.5f + 0.5f) * width, y1 = (b.y / b.w * 0.5f + 0.5f) * height, z1 = b.z / b.w * 0.5f + 0.5f;
+	float x2 = (c.x / c.w * 0.5f + 0.5f) * width, y2 = (c.y / c.w * 0.5f + 0.5f) * height, z2 = c.z / c.w * 0.5f + 0.5f;
+
+	// Both windings are drawn, counter clockwise makes the edge functions positive inside
+	float area = (x1 - x0) * (y2 - y0) - (y1 - y0) * (x2 - x0);
+	if (area == 0.0f)
+	{
+		return;
+	}
+	if (area < 0.0f)
+	{
+		std::swap(x1, x2);
+		std::swap(y1, y2);
+		std::swap(z1, z2);
+		area = -area;
+	}
+
+	int minX = std::max(0, (int)std::floor(std::min(x0, std::min(x1, x2))));
+	int maxX = std::min(width - 1, (int)std::ceil(std::max(x0, std::max(x1, x2))));
+	int minY = std::max(0, (int)std::floor(std::min(y0, std::min(y1, y2))));
+	int maxY = std::min(height - 1, (int)std::ceil(std::max(y0, std::max(y1, y2))));
+	if (minX > maxX || minY > maxY)
+	{
+		return;
+	}
+
+	// Edge functions as a*x + b*y + c, each one is the weight of the opposite vertex times area
+	float a12 = y1 - y2, b12 = x2 - x1, c12 = x1 * y2 - x2 * y1;
+	float a20 = y2 - y0, b20 = x0 - x2, c20 = x2 * y0 - x0 * y2;
+	float a01 = y0 - y1, b01 = x1 - x0, c01 = x0 * y1 - x1 * y0;
+
+	// Depth is linear in screen space
+	float inverseArea = 1.0f / area;
+	float zA = (a12 * z0 + a20 * z1 + a01 * z2) * inverseArea;
+	float zB = (b12 * z0 + b20 * z1 + b01 * z2) * inverseArea;
+	float zC = (c12 * z0 + c20 * z1 + c01 * z2) * inverseArea;
+
+	float* depths = levels[0].depths.data();
+	minX &= ~3;
+
+	for (int y = minY; y <= maxY; y++)
+	{
+		float pixelY = y + 0.5f;
+		float* row = depths + (size_t)y * width;
+		int x = minX;
+
+#if KNOX_MATH_SSE
+		__m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		__m128 edge12Step = _mm_set1_ps(a12 * 4.0f), edge20Step = _mm_set1_ps(a20 * 4.0f), edge01Step = _mm_set1_ps(a01 * 4.0f);
+		__m128 depthStep = _mm_set1_ps(zA * 4.0f);
+
+		__m128 pixelX = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+		__m128 edge12 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a12), pixelX), _mm_set1_ps(b12 * pixelY + c12));
+		__m128 edge20 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a20), pixelX), _mm_set1_ps(b20 * pixelY + c20));
+		__m128 edge01 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a01), pixelX), _mm_set1_ps(b01 * pixelY + c01));
+		__m128 depth = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(zA), pixelX), _mm_set1_ps(zB * pixelY + zC));
+		__m128 zero = _mm_setzero_ps();
+
+		for (; x <= maxX; x += 4)
+		{
+			__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge12, zero), _mm_cmpge_ps(edge20, zero)), _mm_cmpge_ps(edge01, zero));
+			__m128 current = _mm_loadu_ps(row + x);
+			__m128 nearest = _mm_min_ps(current, depth);
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+
+			edge12 = _mm_add_ps(edge12, edge12Step);
+			edge20 = _mm_add_ps(edge20, edge20Step);
+			edge01 = _mm_add_ps(edge01, edge01Step);
+			depth = _mm_add_ps(depth, depthStep);
+		}
+#else
+		for (; x <= maxX; x++)
+		{
+			float pixelX = x + 0.5f;
+			float edge12 = a12 * pixelX + b12 * pixelY + c12;
+			float edge20 = a20 * pixelX + b20 * pixelY + c20;
+			float edge01 = a01 * pixelX + b01 * pixelY + c01;
+			if (edge12 >= 0.0f && edge20 >= 0.0f && edge01 >= 0.0f)
+			{
+				row[x] = std::min(row[x], zA * pixelX + zB * pixelY + zC);
+			}
+		}
+#endif
+	}
+}
+
+void OcclusionCuller::buildHierarchy()
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	for (size_t i = 1; i < levels.size(); i++)
+	{
+		const Level& source = levels[i - 1];
+		Level& level = levels[i];
+		for (int y = 0; y < level.height; y++)
+		{
+			int sourceY0 = y * 2;
+			int sourceY1 = std::min(sourceY0 + 1, source.height - 1);
+			const float* row0 = source.depths.data() + (size_t)sourceY0 * source.width;
+			const float* row1 = source.depths.data() + (size_t)sourceY1 * source.width;
+			float* destination = level.depths.data() + (size_t)y * level.width;
+			for (int x = 0; x < level.width; x++)
+			{
+				int sourceX0 = x * 2;
+				int sourceX1 = std::min(sourceX0 + 1, source.width - 1);
+				destination[x] = std::max(std::max(row0[sourceX0], row0[sourceX1]), std::max(row1[sourceX0], row1[sourceX1]));
+			}
+		}
+	}
+
+	stats.hierarchyMilliseconds += millisecondsSince(start);
+}
+
+bool OcclusionCuller::isVisible(const vec3& center, const vec3& extents)
+{
+	// Screen rectangle and nearest depth of the 8 corners
+	float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+	float nearestDepth = INFINITY;
+
+	// NOTE The corners are the projected center plus or minus the projected extents along every axis
+	vec4 projectedCenter = transform(viewProjection, vec4(center, 1.0f));
+	vec4 axisX = viewProjection.column(0) * extents.x;
+	vec4 axisY = viewProjection.column(1) * extents.y;
+	vec4 axisZ = viewProjection.column(2) * extents.z;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		vec4 clip = projectedCenter + (corner & 1 ? axisX : -axisX) + (corner & 2 ? axisY : -axisY) + (corner & 4 ? axisZ : -axisZ);
+		if (clip.w < NearW)
+		{
+			return true;
+		}
+
+		float inverseW = 1.0f / clip.w;
+		float x = (clip.x * inverseW * 0.5f + 0.5f) * width;
+		float y = (clip.y * inverseW * 0.5f + 0.5f) * height;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearestDepth = std::min(nearestDepth, clip.z * inverseW * 0.5f + 0.5f);
+	}
+
+	if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height || nearestDepth > 1.0f)
+	{
+		return false;
+	}
+
+	int x0 = std::max(0, (int)minX);
+	int y0 = std::max(0, (int)minY);
+	int x1 = std::min(width - 1, (int)maxX);
+	int y1 = std::min(height - 1, (int)maxY);
+
+	// Level where the rectangle spans at most 2 or 3 texels each way
+	int size = std::max(x1 - x0, y1 - y0);
+	size_t levelIndex = 0;
+	while ((size >> levelIndex) > 1 && levelIndex + 1 < levels.size())
+	{
+		levelIndex++;
+	}
+
+	const Level& level = levels[levelIndex];
+	x0 >>= levelIndex;
+	y0 >>= levelIndex;
+	x1 >>= levelIndex;
+	y1 >>= levelIndex;
+	for (int y = y0; y <= y1; y++)
+	{
+		for (int x = x0; x <= x1; x++)
+		{
+			if (nearestDepth <= level.depths[(size_t)y * level.width + x] + DepthBias)
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+uint32_t OcclusionCuller::filterVisible(const BoxesSoA& boxes, uint32_t* indices, uint32_t count)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	uint32_t visibleCount = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t index = indices[i];
+		vec3 center(boxes.centerX[index], boxes.centerY[index], boxes.centerZ[index]);
+		vec3 extents(boxes.extentX[index], boxes.extentY[index], boxes.extentZ[index]);
+		indices[visibleCount] = index;
+		visibleCount += isVisible(center, extents);
+	}
+
+	stats.testedObjects += count;
+	stats.occludedObjects += count - visibleCount;
+	stats.testMilliseconds += millisecondsSince(start);
+	return visibleCount;
+}
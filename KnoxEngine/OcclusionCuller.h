@@ -0,0 +1,74 @@
+#pragma once
+
+#include "MathTypes.h"
+#include "FrustumCulling.h"
+
+#include <vector>
+#include <cstdint>
+
+// Occlusion culling on the CPU: the designated occluder meshes are rasterized into a small
+// depth buffer, which is reduced into a hierarchical-Z pyramid (every texel keeps the farthest
+// depth of the 2x2 texels under it). An object is hidden when the nearest point of its bounds
+// is behind the farthest depth over the screen rectangle it covers, which takes a handful of
+// texel reads at the right level of the pyramid.
+//
+// Everything is conservative: occluder triangles crossing the near plane are skipped and objects
+// crossing it are always visible, so a wrong answer can only be a hidden object that gets drawn.
+// Depth follows OpenGL: NDC z mapped to [0, 1], 1 is the far plane and the cleared value
+class OcclusionCuller
+{
+public:
+	struct Stats
+	{
+		uint32_t occluderTriangles;	// rasterized, after skipping the ones crossing the near plane
+		uint32_t testedObjects;
+		uint32_t occludedObjects;
+		double rasterMilliseconds;
+		double hierarchyMilliseconds;
+		double testMilliseconds;
+	};
+
+private:
+	// Objects at the same depth as an occluder (like the occluder itself) stay visible
+	static constexpr float DepthBias = 1e-4f;
+
+	struct Level
+	{
+		int width;
+		int height;
+		std::vector<float> depths;
+	};
+
+	int width;
+	int height;
+	std::vector<Level> levels;	// levels[0] is the depth buffer
+	mat4 viewProjection;
+	Stats stats;
+
+	void rasterizeTriangle(const vec4& a, const vec4& b, const vec4& c);
+
+public:
+	// The width is rounded up to a multiple of 4 so rows can be rasterized 4 pixels at a time (SSE)
+	OcclusionCuller(int width, int height);
+
+	// Clears the depth buffer and the stats
+	void beginFrame(const mat4& viewProjection);
+
+	// Indexed triangles, positions are the first 3 floats of every vertex, stride is in floats
+	void drawOccluder(const mat4& model, const float* vertices, uint32_t stride, const uint32_t* indices, uint32_t indexCount);
+
+	// Has to be called after the last occluder and before testing
+	void buildHierarchy();
+
+	// Box given as center and half extents, like the culling boxes
+	bool isVisible(const vec3& center, const vec3& extents);
+
+	// Keeps the indices of the boxes that aren't occluded, in order, returns how many are left.
+	// Meant to run on the visible list of the frustum culling
+	uint32_t filterVisible(const BoxesSoA& boxes, uint32_t* indices, uint32_t count);
+
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	const float* getDepthBuffer() const { return levels[0].depths.data(); }
+	Stats getStats() const { return stats; }
+};
@@ -0,0 +1,320 @@
+#include "OffsetAllocator.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include <cstring>
+
+static uint32_t findMostSignificantBit(uint32_t value)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse(&index, value);
+	return (uint32_t)index;
+#else
+	return 31 - (uint32_t)__builtin_clz(value);
+#endif
+}
+
+static uint32_t findLeastSignificantBit(uint32_t value)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, value);
+	return (uint32_t)index;
+#else
+	return (uint32_t)__builtin_ctz(value);
+#endif
+}
+
+float OffsetAllocator::Stats::fragmentation() const
+{
+	if (freeSize == 0)
+	{
+		return 0.0f;
+	}
+	return 1.0f - (float)largestFreeBlock / (float)freeSize;
+}
+
+float OffsetAllocator::Stats::utilization() const
+{
+	if (totalSize == 0)
+	{
+		return 0.0f;
+	}
+	return (float)usedSize / (float)totalSize;
+}
+
+OffsetAllocator::OffsetAllocator(uint32_t size) : size(size)
+{
+	reset();
+}
+
+void OffsetAllocator::reset()
+{
+	usedSize = 0;
+	allocationCount = 0;
+	firstLevelBitmap = 0;
+	memset(secondLevelBitmap, 0, sizeof(secondLevelBitmap));
+	for (uint32_t i = 0; i < BinCount; i++)
+	{
+		binHeads[i] = NoSpace;
+	}
+
+	nodes.clear();
+	unusedNodes.clear();
+
+	if (size > 0)
+	{
+		insertFreeNode(createNode(0, size));
+	}
+}
+
+// Small blocks (< SecondLevelCount) are stored linearly in the first row,
+// bigger ones are split by their most significant bit and the next SecondLevelBits bits
+void OffsetAllocator::mapping(uint32_t blockSize, uint32_t& firstLevel, uint32_t& secondLevel)
+{
+	if (blockSize < SecondLevelCount)
+	{
+		firstLevel = 0;
+		secondLevel = blockSize;
+		return;
+	}
+
+	uint32_t msb = findMostSignificantBit(blockSize);
+	firstLevel = msb - SecondLevelBits + 1;
+	secondLevel = (blockSize >> (msb - SecondLevelBits)) - SecondLevelCount;
+}
+
+bool OffsetAllocator::findSuitableBin(uint32_t blockSize, uint32_t& firstLevel, uint32_t& secondLevel) const
+{
+	// NOTE Round the request up to the next bin, so ANY block in the found bin is big enough
+	uint64_t roundedSize = blockSize;
+	if (blockSize >= SecondLevelCount)
+	{
+		roundedSize += (1u << (findMostSignificantBit(blockSize) - SecondLevelBits)) - 1;
+	}
+	if (roundedSize > 0xFFFFFFFFull)
+	{
+		return false;
+	}
+	mapping((uint32_t)roundedSize, firstLevel, secondLevel);
+
+	uint32_t secondLevelMask = (uint32_t)secondLevelBitmap[firstLevel] & (~0u << secondLevel);
+	if (secondLevelMask == 0)
+	{
+		uint32_t firstLevelMask = firstLevel + 1 < 32 ? firstLevelBitmap & (~0u << (firstLevel + 1)) : 0;
+		if (firstLevelMask == 0)
+		{
+			return false;
+		}
+
+		firstLevel = findLeastSignificantBit(firstLevelMask);
+		secondLevelMask = secondLevelBitmap[firstLevel];
+	}
+
+	secondLevel = findLeastSignificantBit(secondLevelMask);
+	return true;
+}
+
+uint32_t OffsetAllocator::createNode(uint32_t offset, uint32_t blockSize)
+{
+	uint32_t nodeIndex;
+	if (!unusedNodes.empty())
+	{
+		nodeIndex = unusedNodes.back();
+		unusedNodes.pop_back();
+	}
+	else
+	{
+		nodeIndex = (uint32_t)nodes.size();
+		nodes.push_back(Node());
+	}
+
+	Node& node = nodes[nodeIndex];
+	node.offset = offset;
+	node.size = blockSize;
+	node.prevPhysical = NoSpace;
+	node.nextPhysical = NoSpace;
+	node.prevFree = NoSpace;
+	node.nextFree = NoSpace;
+	node.used = false;
+	return nodeIndex;
+}
+
+void OffsetAllocator::insertFreeNode(uint32_t nodeIndex)
+{
+	Node& node = nodes[nodeIndex];
+	uint32_t firstLevel, secondLevel;
+	mapping(node.size, firstLevel, secondLevel);
+
+	uint32_t bin = firstLevel * SecondLevelCount + secondLevel;
+	node.used = false;
+	node.prevFree = NoSpace;
+	node.nextFree = binHeads[bin];
+	if (binHeads[bin] != NoSpace)
+	{
+		nodes[binHeads[bin]].prevFree = nodeIndex;
+	}
+	binHeads[bin] = nodeIndex;
+
+	firstLevelBitmap |= 1u << firstLevel;
+	secondLevelBitmap[firstLevel] |= (uint8_t)(1u << secondLevel);
+}
+
+void OffsetAllocator::removeFreeNode(uint32_t nodeIndex)
+{
+	Node& node = nodes[nodeIndex];
+	if (node.prevFree != NoSpace)
+	{
+		nodes[node.prevFree].nextFree = node.nextFree;
+	}
+	if (node.nextFree != NoSpace)
+	{
+		nodes[node.nextFree].prevFree = node.prevFree;
+	}
+
+	uint32_t firstLevel, secondLevel;
+	mapping(node.size, firstLevel, secondLevel);
+	uint32_t bin = firstLevel * SecondLevelCount + secondLevel;
+
+	if (binHeads[bin] == nodeIndex)
+	{
+		binHeads[bin] = node.nextFree;
+		if (binHeads[bin] == NoSpace)
+		{
+			secondLevelBitmap[firstLevel] &= (uint8_t)~(1u << secondLevel);
+			if (secondLevelBitmap[firstLevel] == 0)
+			{
+				firstLevelBitmap &= ~(1u << firstLevel);
+			}
+		}
+	}
+
+	node.prevFree = NoSpace;
+	node.nextFree = NoSpace;
+}
+
+OffsetAllocator::Allocation OffsetAllocator::allocate(uint32_t blockSize)
+{
+	Allocation allocation;
+	if (blockSize == 0)
+	{
+		return allocation;
+	}
+
+	uint32_t firstLevel, secondLevel;
+	if (!findSuitableBin(blockSize, firstLevel, secondLevel))
+	{
+		return allocation;
+	}
+
+	uint32_t nodeIndex = binHeads[firstLevel * SecondLevelCount + secondLevel];
+	removeFreeNode(nodeIndex);
+
+	// Split the remaining space off into a new free block
+	uint32_t remainder = nodes[nodeIndex].size - blockSize;
+	if (remainder > 0)
+	{
+		uint32_t splitIndex = createNode(nodes[nodeIndex].offset + blockSize, remainder);
+		Node& node = nodes[nodeIndex];
+		Node& split = nodes[splitIndex];
+
+		split.prevPhysical = nodeIndex;
+		split.nextPhysical = node.nextPhysical;
+		if (node.nextPhysical != NoSpace)
+		{
+			nodes[node.nextPhysical].prevPhysical = splitIndex;
+		}
+		node.nextPhysical = splitIndex;
+		node.size = blockSize;
+
+		insertFreeNode(splitIndex);
+	}
+
+	nodes[nodeIndex].used = true;
+	usedSize += blockSize;
+	allocationCount++;
+
+	allocation.offset = nodes[nodeIndex].offset;
+	allocation.node = nodeIndex;
+	return allocation;
+}
+
+void OffsetAllocator::free(Allocation allocation)
+{
+	if (allocation.node == NoSpace || allocation.node >= nodes.size() || !nodes[allocation.node].used)
+	{
+		return;
+	}
+
+	uint32_t nodeIndex = allocation.node;
+	usedSize -= nodes[nodeIndex].size;
+	allocationCount--;
+
+	// Merge with the physical neighbours so free space doesn't keep getting chopped up
+	uint32_t prev = nodes[nodeIndex].prevPhysical;
+	if (prev != NoSpace && !nodes[prev].used)
+	{
+		removeFreeNode(prev);
+		nodes[prev].size += nodes[nodeIndex].size;
+		nodes[prev].nextPhysical = nodes[nodeIndex].nextPhysical;
+		if (nodes[nodeIndex].nextPhysical != NoSpace)
+		{
+			nodes[nodes[nodeIndex].nextPhysical].prevPhysical = prev;
+		}
+		nodes[nodeIndex].used = false;
+		unusedNodes.push_back(nodeIndex);
+		nodeIndex = prev;
+	}
+
+	uint32_t next = nodes[nodeIndex].nextPhysical;
+	if (next != NoSpace && !nodes[next].used)
+	{
+		removeFreeNode(next);
+		nodes[nodeIndex].size += nodes[next].size;
+		nodes[nodeIndex].nextPhysical = nodes[next].nextPhysical;
+		if (nodes[next].nextPhysical != NoSpace)
+		{
+			nodes[nodes[next].nextPhysical].prevPhysical = nodeIndex;
+		}
+		unusedNodes.push_back(next);
+	}
+
+	insertFreeNode(nodeIndex);
+}
+
+uint32_t OffsetAllocator::allocationSize(Allocation allocation) const
+{
+	if (allocation.node == NoSpace || allocation.node >= nodes.size())
+	{
+		return 0;
+	}
+	return nodes[allocation.node].size;
+}
+
+OffsetAllocator::Stats OffsetAllocator::getStats() const
+{
+	Stats stats;
+	stats.totalSize = size;
+	stats.usedSize = usedSize;
+	stats.freeSize = size - usedSize;
+	stats.largestFreeBlock = 0;
+	stats.freeBlockCount = 0;
+	stats.allocationCount = allocationCount;
+
+	for (uint32_t bin = 0; bin < BinCount; bin++)
+	{
+		for (uint32_t nodeIndex = binHeads[bin]; nodeIndex != NoSpace; nodeIndex = nodes[nodeIndex].nextFree)
+		{
+			stats.freeBlockCount++;
+			if (nodes[nodeIndex].size > stats.largestFreeBlock)
+			{
+				stats.largestFreeBlock = nodes[nodeIndex].size;
+			}
+		}
+	}
+
+	return stats;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Two-level segregated fit (TLSF) allocator that hands out ranges inside a
+// linear space of "units" (vertices, indices, bytes...). It never touches
+// memory itself, so it can manage GPU buffers that live on the driver side.
+class OffsetAllocator
+{
+public:
+	static const uint32_t NoSpace = 0xFFFFFFFF;
+
+	struct Allocation
+	{
+		uint32_t offset = NoSpace;
+		uint32_t node = NoSpace;
+	};
+
+	struct Stats
+	{
+		uint32_t totalSize;
+		uint32_t usedSize;
+		uint32_t freeSize;
+		uint32_t largestFreeBlock;
+		uint32_t freeBlockCount;
+		uint32_t allocationCount;
+
+		// 0 when all the free space is a single block, close to 1 when it is scattered in small pieces
+		float fragmentation() const;
+		float utilization() const;
+	};
+
+private:
+	static const uint32_t SecondLevelBits = 3;
+	static const uint32_t SecondLevelCount = 1 << SecondLevelBits;
+	static const uint32_t FirstLevelCount = 32;
+	static const uint32_t BinCount = FirstLevelCount * SecondLevelCount;
+
+	struct Node
+	{
+		uint32_t offset;
+		uint32_t size;
+		uint32_t prevPhysical;
+		uint32_t nextPhysical;
+		uint32_t prevFree;
+		uint32_t nextFree;
+		bool used;
+	};
+
+	uint32_t size;
+	uint32_t usedSize;
+	uint32_t allocationCount;
+
+	uint32_t firstLevelBitmap;
+	uint8_t secondLevelBitmap[FirstLevelCount];
+	uint32_t binHeads[BinCount];
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> unusedNodes;
+
+	static void mapping(uint32_t blockSize, uint32_t& firstLevel, uint32_t& secondLevel);
+	bool findSuitableBin(uint32_t blockSize, uint32_t& firstLevel, uint32_t& secondLevel) const;
+
+	uint32_t createNode(uint32_t offset, uint32_t blockSize);
+	void insertFreeNode(uint32_t nodeIndex);
+	void removeFreeNode(uint32_t nodeIndex);
+
+public:
+	OffsetAllocator(uint32_t size);
+
+	Allocation allocate(uint32_t blockSize);
+	void free(Allocation allocation);
+	void reset();
+
+	uint32_t allocationSize(Allocation allocation) const;
+	Stats getStats() const;
+};
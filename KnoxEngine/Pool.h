@@ -0,0 +1,201 @@
+#pragma once
+
+#include "MemoryTracker.h"
+
+#include <iostream>
+#include <new>
+#include <utility>
+#include <cstdint>
+
+// Reference to an object in a Pool<T>. The generation changes every time a slot is reused,
+// so a handle to a destroyed object stays detectably dead instead of pointing at whatever
+// took its place. A zero initialized handle is null
+template<typename T>
+struct Handle
+{
+	uint32_t index;
+	uint32_t generation;
+
+	Handle() : index(0), generation(0) {}
+	Handle(uint32_t index, uint32_t generation) : index(index), generation(generation) {}
+
+	bool isNull() const { return generation == 0; }
+	bool operator==(const Handle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const Handle& other) const { return !(*this == other); }
+};
+
+// Fixed capacity storage for objects of one type, allocated once up front.
+// Objects are kept packed at the front of a single array (destroying one moves the last
+// object into its place), so iterating with begin()/end() walks contiguous memory.
+// Handles go through a slot table to find the object, which makes lookups O(1) and lets
+// objects move without invalidating handles.
+// NOTE Pointers returned by get() are only valid until the next destroy()
+template<typename T>
+class Pool
+{
+private:
+	struct Slot
+	{
+		uint32_t objectIndex;
+		uint32_t generation;
+		uint32_t nextFree;
+	};
+
+	static const uint32_t EndOfFreeList = 0xFFFFFFFF;
+
+	T* objects;
+	uint32_t* objectSlots;	// slot of every packed object, to fix up the slot table when objects move
+	Slot* slots;
+	uint32_t capacity;
+	uint32_t count;
+	uint32_t firstFree;
+	uint32_t staleAccesses;
+
+	const char* subsystem;
+	const char* tag;
+
+	size_t storageBytes() const { return (size_t)capacity * (sizeof(T) + sizeof(uint32_t) + sizeof(Slot)); }
+
+public:
+	Pool(uint32_t capacity, const char* subsystem, const char* tag);
+	~Pool();
+
+	Pool(const Pool&) = delete;
+	Pool& operator=(const Pool&) = delete;
+
+	// Constructs a T from the arguments, returns a null handle if the pool is full
+	template<typename... Arguments>
+	Handle<T> create(Arguments&&... arguments);
+
+	// Returns false and counts a stale access if the handle was already destroyed
+	bool destroy(Handle<T> handle);
+
+	// NULL for null handles and for handles of destroyed objects
+	T* get(Handle<T> handle);
+	bool isAlive(Handle<T> handle) const;
+
+	// Handle of the object at position index of the packed array, to destroy while iterating
+	Handle<T> getHandle(uint32_t index) const { return Handle<T>(objectSlots[index], slots[objectSlots[index]].generation); }
+
+	T* begin() { return objects; }
+	T* end() { return objects + count; }
+
+	uint32_t size() const { return count; }
+	uint32_t getCapacity() const { return capacity; }
+	uint32_t getStaleAccesses() const { return staleAccesses; }
+};
+
+template<typename T>
+Pool<T>::Pool(uint32_t capacity, const char* subsystem, const char* tag)
+	: capacity(capacity), count(0), firstFree(0), staleAccesses(0), subsystem(subsystem), tag(tag)
+{
+	objects = (T*)::operator new(sizeof(T) * capacity, std::align_val_t(alignof(T)));
+	objectSlots = new uint32_t[capacity];
+	slots = new Slot[capacity];
+
+	for (uint32_t i = 0; i < capacity; i++)
+	{
+		slots[i].objectIndex = EndOfFreeList;
+		slots[i].generation = 1;
+		slots[i].nextFree = i + 1 < capacity ? i + 1 : EndOfFreeList;
+	}
+	if (capacity == 0)
+	{
+		firstFree = EndOfFreeList;
+	}
+
+	trackAllocation(subsystem, tag, storageBytes());
+}
+
+template<typename T>
+Pool<T>::~Pool()
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		objects[i].~T();
+	}
+
+	::operator delete(objects, std::align_val_t(alignof(T)));
+	delete[] objectSlots;
+	delete[] slots;
+
+	trackFree(subsystem, tag, storageBytes());
+}
+
+template<typename T>
+template<typename... Arguments>
+Handle<T> Pool<T>::create(Arguments&&... arguments)
+{
+	if (firstFree == EndOfFreeList)
+	{
+		printf("ERROR: Pool %s/%s is full (%u objects)\n", subsystem, tag, capacity);
+		return Handle<T>();
+	}
+
+	uint32_t slotIndex = firstFree;
+	Slot& slot = slots[slotIndex];
+	firstFree = slot.nextFree;
+
+	new (&objects[count]) T(std::forward<Arguments>(arguments)...);
+	objectSlots[count] = slotIndex;
+	slot.objectIndex = count;
+	count++;
+
+	return Handle<T>(slotIndex, slot.generation);
+}
+
+template<typename T>
+bool Pool<T>::destroy(Handle<T> handle)
+{
+	if (!isAlive(handle))
+	{
+		staleAccesses++;
+		return false;
+	}
+
+	Slot& slot = slots[handle.index];
+	uint32_t objectIndex = slot.objectIndex;
+	uint32_t lastIndex = count - 1;
+
+	// Keep the objects packed by moving the last one into the hole
+	if (objectIndex != lastIndex)
+	{
+		objects[objectIndex] = std::move(objects[lastIndex]);
+		objectSlots[objectIndex] = objectSlots[lastIndex];
+		slots[objectSlots[objectIndex]].objectIndex = objectIndex;
+	}
+	objects[lastIndex].~T();
+	count--;
+
+	// NOTE Generation 0 is reserved for null handles
+	slot.generation++;
+	if (slot.generation == 0)
+	{
+		slot.generation = 1;
+	}
+	slot.objectIndex = EndOfFreeList;
+	slot.nextFree = firstFree;
+	firstFree = handle.index;
+	return true;
+}
+
+template<typename T>
+T* Pool<T>::get(Handle<T> handle)
+{
+	if (!isAlive(handle))
+	{
+		if (!handle.isNull())
+		{
+			staleAccesses++;
+		}
+		return NULL;
+	}
+	return &objects[slots[handle.index].objectIndex];
+}
+
+template<typename T>
+bool Pool<T>::isAlive(Handle<T> handle) const
+{
+	return !handle.isNull() && handle.index < capacity && slots[handle.index].generation == handle.generation
+		&& slots[handle.index].objectIndex != EndOfFreeList;
+}
@@ -0,0 +1,301 @@
+#include "RenderQueue.h"
+#include "InstanceBatcher.h"
+#include "Counters.h"
+
+#include <chrono>
+#include <cstring>
+
+static const float IdentityTransform[16] = {
+	1.0f, 0.0f, 0.0f, 0.0f,
+	0.0f, 1.0f, 0.0f, 0.0f,
+	0.0f, 0.0f, 1.0f, 0.0f,
+	0.0f, 0.0f, 0.0f, 1.0f
+};
+
+// Single draws read the transform from the generic attribute value, the instance array is disabled
+static void setTransform(const float* transform)
+{
+	for (GLuint column = 0; column < 4; column++)
+	{
+		glVertexAttrib4fv(InstanceBatcher::TransformLocation + column, transform + column * 4);
+	}
+}
+
+RenderQueue::RenderQueue() : instanceBatcher(NULL)
+{
+	stats = Stats();
+}
+
+uint32_t RenderQueue::getTextureSetId(const unsigned int* textures)
+{
+	uint64_t textureSet = ((uint64_t)textures[0] << 32) | textures[1];
+
+	std::unordered_map<uint64_t, uint32_t>::iterator it = textureSetIds.find(textureSet);
+	if (it != textureSetIds.end())
+	{
+		return it->second;
+	}
+
+	uint32_t id = (uint32_t)textureSetIds.size();
+	textureSetIds[textureSet] = id;
+	return id;
+}
+
+uint64_t RenderQueue::makeKey(const DrawItem& item, uint32_t textureSetId, float depth, bool transparent)
+{
+	uint64_t program = item.program & 0xFF;
+	uint64_t material = item.materialId & 0xFFF;
+	uint64_t textureSet = textureSetId & 0xFFF;
+	uint64_t vertexArray = item.vertexArray & 0x7F;
+
+	if (depth < 0.0f) depth = 0.0f;
+	if (depth > 1.0f) depth = 1.0f;
+	uint64_t quantizedDepth = (uint64_t)(depth * (float)0xFFFFFF);
+
+	if (!transparent)
+	{
+		return (program << 55) | (material << 43) | (textureSet << 31) | (vertexArray << 24) | quantizedDepth;
+	}
+
+	// NOTE Depth is inverted so the farthest transparent draws come first
+	return (1ull << 63) | ((0xFFFFFF - quantizedDepth) << 39) | (program << 31) | (material << 19) | (textureSet << 7) | vertexArray;
+}
+
+void RenderQueue::submit(const DrawItem& item, float depth, bool transparent, const float* transform)
+{
+	keys.push_back(makeKey(item, getTextureSetId(item.textures), depth, transparent));
+	order.push_back((uint32_t)items.size());
+	items.push_back(item);
+
+	if (!transform)
+	{
+		transform = IdentityTransform;
+	}
+	transforms.insert(transforms.end(), transform, transform + 16);
+}
+
+// LSD radix sort, one byte per pass. Passes where every key has the same byte are skipped,
+// which is common because the high bits (program, material) have very few distinct values
+void RenderQueue::radixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values, std::vector<uint64_t>& scratchKeys, std::vector<uint32_t>& scratchValues)
+{
+	size_t count = keys.size();
+	scratchKeys.resize(count);
+	scratchValues.resize(count);
+
+	uint32_t histograms[8][256] = {};
+	for (size_t i = 0; i < count; i++)
+	{
+		uint64_t key = keys[i];
+		for (int pass = 0; pass < 8; pass++)
+		{
+			histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+		}
+	}
+
+	for (int pass = 0; pass < 8; pass++)
+	{
+		uint32_t* histogram = histograms[pass];
+		int shift = pass * 8;
+
+		if (count == 0 || histogram[(keys[0] >> shift) & 0xFF] == count)
+		{
+			continue;
+		}
+
+		uint32_t offset = 0;
+		for (int bucket = 0; bucket < 256; bucket++)
+		{
+			uint32_t bucketSize = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketSize;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			uint32_t destination = histogram[(keys[i] >> shift) & 0xFF]++;
+			scratchKeys[destination] = keys[i];
+			scratchValues[destination] = values[i];
+		}
+
+		keys.swap(scratchKeys);
+		values.swap(scratchValues);
+	}
+}
+
+void RenderQueue::sort()
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	radixSort(keys, order, sortedKeys, sortedOrder);
+	stats.sortMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+RenderQueue::Stats RenderQueue::countStateChanges() const
+{
+	Stats changes = Stats();
+	changes.sortMilliseconds = stats.sortMilliseconds;
+
+	const DrawItem* previous = NULL;
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		const DrawItem& item = items[order[i]];
+
+		if (!previous || previous->program != item.program) changes.programChanges++;
+		if (!previous || previous->materialId != item.materialId) changes.materialChanges++;
+		if (!previous || previous->vertexArray != item.vertexArray) changes.vertexArrayChanges++;
+		for (int unit = 0; unit < DrawItem::MaxTextures; unit++)
+		{
+			if (!previous || previous->textures[unit] != item.textures[unit]) changes.textureChanges++;
+		}
+
+		changes.drawCount++;
+		previous = &item;
+	}
+
+	return changes;
+}
+
+void RenderQueue::flush()
+{
+	sort();
+	double sortMilliseconds = stats.sortMilliseconds;
+	stats = Stats();
+	stats.sortMilliseconds = sortMilliseconds;
+
+	// Split the sorted draws in runs first, the instance transforms all have to be written before the first draw
+	drawRuns.clear();
+	for (uint32_t begin = 0; begin < (uint32_t)order.size(); )
+	{
+		const DrawItem& item = items[order[begin]];
+		uint32_t end = begin + 1;
+		if (instanceBatcher)
+		{
+			while (end < (uint32_t)order.size() && (keys[end] >> 63) == (keys[begin] >> 63) && InstanceBatcher::canBatch(item, items[order[end]]))
+			{
+				end++;
+			}
+		}
+
+		DrawRun run = { begin, end, NoBatchRun };
+		if (end - begin >= MinInstancedRun)
+		{
+			run.batchRun = instanceBatcher->getRunCount();
+			float* runTransforms = instanceBatcher->addRun(item, end - begin);
+			for (uint32_t i = begin; i < end; i++)
+			{
+				memcpy(runTransforms + (size_t)(i - begin) * 16, &transforms[(size_t)order[i] * 16], sizeof(float) * 16);
+			}
+		}
+		drawRuns.push_back(run);
+		begin = end;
+	}
+	bool batching = instanceBatcher && instanceBatcher->getRunCount() > 0;
+	if (batching)
+	{
+		instanceBatcher->uploadRuns();
+	}
+
+	bool blending = false;
+	uint64_t triangles = 0;
+	const DrawItem* previous = NULL;
+	const float* currentTransform = IdentityTransform;
+	for (size_t runIndex = 0; runIndex < drawRuns.size(); runIndex++)
+	{
+		const DrawRun& run = drawRuns[runIndex];
+		const DrawItem& item = items[order[run.begin]];
+
+		// Transparent draws are all at the end of the queue, blending only has to be turned on once
+		if (!blending && (keys[run.begin] >> 63))
+		{
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			glDepthMask(GL_FALSE);
+			blending = true;
+		}
+
+		if (!previous || previous->program != item.program)
+		{
+			glUseProgram(item.program);
+			stats.programChanges++;
+		}
+		if (!previous || previous->materialId != item.materialId)
+		{
+			stats.materialChanges++;
+		}
+		for (int unit = 0; unit < DrawItem::MaxTextures; unit++)
+		{
+			if (!previous || previous->textures[unit] != item.textures[unit])
+			{
+				glActiveTexture(GL_TEXTURE0 + unit);
+				glBindTexture(GL_TEXTURE_2D, item.textures[unit]);
+				stats.textureChanges++;
+			}
+		}
+		if (!previous || previous->vertexArray != item.vertexArray)
+		{
+			glBindVertexArray(item.vertexArray);
+			stats.vertexArrayChanges++;
+		}
+		previous = &item;
+
+		uint32_t runLength = run.end - run.begin;
+		if (run.batchRun != NoBatchRun && instanceBatcher->drawRun(run.batchRun))
+		{
+			stats.drawCount++;
+			stats.instancedDraws++;
+			stats.instances += runLength;
+			triangles += (uint64_t)(item.indexCount / 3) * runLength;
+			continue;
+		}
+
+		// NOTE Also the runs that didn't fit in the instance buffer, they're all the same draw
+		for (uint32_t i = run.begin; i < run.end; i++)
+		{
+			const float* transform = &transforms[(size_t)order[i] * 16];
+			if (memcmp(transform, currentTransform, sizeof(float) * 16) != 0)
+			{
+				setTransform(transform);
+				currentTransform = transform;
+			}
+
+			glDrawElementsBaseVertex(
+				GL_TRIANGLES,
+				(GLsizei)item.indexCount,
+				GL_UNSIGNED_INT,
+				(void *)((size_t)item.firstIndex * sizeof(unsigned int)),
+				item.baseVertex
+			);
+			stats.drawCount++;
+			triangles += item.indexCount / 3;
+		}
+	}
+
+	if (batching)
+	{
+		instanceBatcher->endRuns();
+	}
+	if (currentTransform != IdentityTransform)
+	{
+		InstanceBatcher::setDefaultTransform();
+	}
+
+	if (blending)
+	{
+		glDisable(GL_BLEND);
+		glDepthMask(GL_TRUE);
+	}
+
+	countEvent(CounterDrawCalls, stats.drawCount);
+	countEvent(CounterTriangles, triangles);
+	countEvent(CounterStateChanges, stats.programChanges + stats.textureChanges + stats.vertexArrayChanges + (blending ? 2 : 0));
+	countEvent(CounterTextureBinds, stats.textureChanges);
+
+	clear();
+}
+
+void RenderQueue::clear()
+{
+	items.clear();
+	transforms.clear();
+	keys.clear();
+	order.clear();
+}
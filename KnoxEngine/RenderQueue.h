@@ -0,0 +1,109 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <unordered_map>
+
+struct DrawItem
+{
+	static const int MaxTextures = 2;
+
+	unsigned int program;
+	unsigned int materialId;
+	unsigned int textures[MaxTextures];
+	unsigned int vertexArray;
+
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	GLint baseVertex;
+};
+
+class InstanceBatcher;
+
+// Collects the draws of a frame, sorts them by a 64-bit key and submits them with as few
+// state changes as possible.
+//
+// Opaque key:      | 0 | program (8) | material (12) | texture set (12) | VAO (7) | depth (24) |
+// Transparent key: | 1 | inverted depth (24) | program (8) | material (12) | texture set (12) | VAO (7) |
+//
+// Opaque draws come first, grouped by state and front-to-back inside each group (helps early-z),
+// transparent draws go after, strictly back-to-front so blending is correct.
+// NOTE Ids are truncated to fit the key, that only affects the grouping,
+// state changes are always decided on the real values
+//
+// With an InstanceBatcher, consecutive sorted draws of the same mesh and material become one
+// instanced draw of their transforms. Instances are drawn in order, so the sort order still holds
+class RenderQueue
+{
+public:
+	struct Stats
+	{
+		uint32_t drawCount;
+		uint32_t programChanges;
+		uint32_t materialChanges;
+		uint32_t textureChanges;
+		uint32_t vertexArrayChanges;
+		uint32_t instancedDraws;	// part of drawCount
+		uint32_t instances;			// submitted draws the instanced draws replaced
+		double sortMilliseconds;
+
+		uint32_t stateChanges() const { return programChanges + materialChanges + textureChanges + vertexArrayChanges; }
+	};
+
+private:
+	// A run of sorted draws that can be one instanced draw, when batchRun isn't NoBatchRun
+	struct DrawRun
+	{
+		uint32_t begin;
+		uint32_t end;
+		uint32_t batchRun;
+	};
+	static const uint32_t NoBatchRun = 0xFFFFFFFF;
+	static const uint32_t MinInstancedRun = 2;
+
+	std::vector<DrawItem> items;
+	std::vector<float> transforms;	// 16 per item, column-major
+	std::vector<uint64_t> keys;
+	std::vector<uint32_t> order;
+
+	// Scratch buffers for the radix sort, kept around so sorting doesn't allocate every frame
+	std::vector<uint64_t> sortedKeys;
+	std::vector<uint32_t> sortedOrder;
+
+	// Texture sets get small sequential ids so they fit in the key
+	std::unordered_map<uint64_t, uint32_t> textureSetIds;
+
+	InstanceBatcher* instanceBatcher;
+	std::vector<DrawRun> drawRuns;
+
+	Stats stats;
+
+	uint32_t getTextureSetId(const unsigned int* textures);
+
+public:
+	RenderQueue();
+
+	// depth is the view depth normalized to [0, 1], 0 being the near plane.
+	// transform (column-major 4x4) goes to the instanced transform attribute, identity when NULL
+	void submit(const DrawItem& item, float depth, bool transparent, const float* transform = NULL);
+
+	// NOTE The batcher has to outlive the queue's flushes, NULL issues every draw on its own
+	void setInstanceBatcher(InstanceBatcher* batcher) { instanceBatcher = batcher; }
+
+	void sort();
+	// Issues the sorted draws and clears the queue for the next frame
+	void flush();
+	void clear();
+
+	// Walks the queue in its current order and counts the state changes without touching OpenGL
+	Stats countStateChanges() const;
+
+	Stats getStats() const { return stats; }
+	size_t size() const { return items.size(); }
+
+	static uint64_t makeKey(const DrawItem& item, uint32_t textureSetId, float depth, bool transparent);
+	static void radixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values, std::vector<uint64_t>& scratchKeys, std::vector<uint32_t>& scratchValues);
+};
@@ -0,0 +1,329 @@
+#include "RenderThread.h"
+#include "CpuProfiler.h"
+#include "Counters.h"
+#include "GLTrace.h"
+#include "InstanceBatcher.h"
+
+static double millisecondsBetween(std::chrono::high_resolution_clock::time_point start, std::chrono::high_resolution_clock::time_point end)
+{
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+RenderThread::RenderThread()
+	: window(NULL), headlessContext(NULL), running(false), resources(), recordingList(0), pendingList(-1), replayingList(-1), frameTimingsEnabled(false), gpuProfilerEnabled(false), statsOverlayEnabled(false)
+{
+	frameArenas[0] = new LinearArena(FrameArenaSize, "Frame");
+	frameArenas[1] = new LinearArena(FrameArenaSize, "Frame");
+	resetStats();
+}
+
+RenderThread::~RenderThread()
+{
+	delete frameArenas[0];
+	delete frameArenas[1];
+}
+
+void RenderThread::start(GLFWwindow* window)
+{
+	this->window = window;
+	running = true;
+	inputTime = Clock::now();
+	thread = std::thread(&RenderThread::run, this);
+}
+
+void RenderThread::start(HeadlessContext* context)
+{
+	headlessContext = context;
+	running = true;
+	inputTime = Clock::now();
+	thread = std::thread(&RenderThread::run, this);
+}
+
+void RenderThread::enableFrameTimings()
+{
+	frameTimingsEnabled = true;
+}
+
+void RenderThread::enableGpuProfiler()
+{
+	gpuProfilerEnabled = true;
+}
+
+void RenderThread::enableStatsOverlay()
+{
+	statsOverlayEnabled = true;
+}
+
+void RenderThread::readTimerQuery(int slot)
+{
+	if (timerQueryFrames[slot] < 0)
+	{
+		return;
+	}
+
+	GLuint64 nanoseconds = 0;
+	glGetQueryObjectui64v(timerQueries[slot], GL_QUERY_RESULT, &nanoseconds);
+	frameTimings[timerQueryFrames[slot]].gpuMilliseconds = nanoseconds / 1e6;
+	timerQueryFrames[slot] = -1;
+}
+
+void RenderThread::stop()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		running = false;
+	}
+	condition.notify_all();
+
+	if (thread.joinable())
+	{
+		thread.join();
+	}
+}
+
+CommandList& RenderThread::beginFrame()
+{
+	Clock::time_point waitStart = Clock::now();
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock, [this] { return pendingList != recordingList && replayingList != recordingList; });
+	}
+	recordStart = Clock::now();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	stats.simulationWaitMilliseconds += millisecondsBetween(waitStart, recordStart);
+
+	// The render thread is done with the frame that used this arena, everything in it can go
+	LinearArena& frameArena = *frameArenas[recordingList];
+	frameArena.reset();
+
+	CommandList& commandList = commandLists[recordingList];
+	commandList.reset(frameArena);
+	return commandList;
+}
+
+void RenderThread::submitFrame()
+{
+	Clock::time_point submitTime = Clock::now();
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		stats.simulationMilliseconds += millisecondsBetween(recordStart, submitTime);
+
+		LinearArena::Stats arenaStats = frameArenas[recordingList]->getStats();
+		stats.frameArenaBytes += arenaStats.bytesAllocated;
+		stats.frameArenaAllocations += arenaStats.allocationCount;
+		stats.frameArenaOverflows += arenaStats.overflowAllocations;
+		if (arenaStats.bytesAllocated > stats.maxFrameArenaBytes)
+		{
+			stats.maxFrameArenaBytes = arenaStats.bytesAllocated;
+		}
+
+		// NOTE Only one frame can be queued, if the render thread hasn't picked up the previous
+		// one yet the simulation is running too far ahead and has to wait
+		condition.wait(lock, [this] { return pendingList == -1; });
+		stats.simulationWaitMilliseconds += millisecondsBetween(submitTime, Clock::now());
+
+		submitTimes[recordingList] = submitTime;
+		inputTimes[recordingList] = inputTime;
+		pendingList = recordingList;
+		recordingList = 1 - recordingList;
+	}
+	condition.notify_all();
+}
+
+void RenderThread::markInputSampled()
+{
+	inputTime = Clock::now();
+}
+
+void RenderThread::run()
+{
+	CpuProfiler::setThreadName("Render");
+	if (headlessContext)
+	{
+		headlessContext->makeCurrent();
+	}
+	else
+	{
+		glfwMakeContextCurrent(window);
+	}
+
+	if (frameTimingsEnabled)
+	{
+		glGenQueries(TimerQueryLatency, timerQueries);
+		for (int i = 0; i < TimerQueryLatency; i++)
+		{
+			timerQueryFrames[i] = -1;
+		}
+	}
+
+	if (gpuProfilerEnabled)
+	{
+		gpuProfiler.create();
+	}
+	if (statsOverlayEnabled)
+	{
+		statsOverlay.create();
+	}
+
+	// Counter frames go from swap to swap
+	Clock::time_point previousSwapEnd = Clock::now();
+	double frameMilliseconds = 0.0;
+
+	// Identical draws that end up next to each other after sorting become one instanced draw
+	InstanceBatcher instanceBatcher(MaxInstancesPerFrame);
+	RenderQueue renderQueue;
+	renderQueue.setInstanceBatcher(&instanceBatcher);
+	while (true)
+	{
+		Clock::time_point waitStart = Clock::now();
+		int listIndex;
+		{
+			CpuZone zone("Wait");
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this] { return pendingList != -1 || !running; });
+			if (pendingList == -1)
+			{
+				break;
+			}
+
+			listIndex = pendingList;
+			replayingList = pendingList;
+			pendingList = -1;
+		}
+		condition.notify_all();
+
+		// The slot of this frame held the query of TimerQueryLatency frames ago
+		int frameIndex = (int)frameTimings.size();
+		int querySlot = frameIndex % TimerQueryLatency;
+		if (frameTimingsEnabled)
+		{
+			readTimerQuery(querySlot);
+			glBeginQuery(GL_TIME_ELAPSED, timerQueries[querySlot]);
+		}
+
+		Clock::time_point renderStart = Clock::now();
+		uint32_t staleCommands = 0;
+		{
+			CpuZone zone("Replay");
+			GpuProfiler* profiler = gpuProfilerEnabled ? &gpuProfiler : NULL;
+			if (profiler)
+			{
+				profiler->beginFrame();
+			}
+
+			staleCommands = commandLists[listIndex].execute(renderQueue, resources, profiler);
+
+			if (statsOverlayEnabled)
+			{
+				GpuZone overlayZone(profiler, "Overlay");
+				statsOverlay.clear();
+				statsOverlay.addCounters(getFrameCounters(), frameMilliseconds);
+				statsOverlay.draw();
+			}
+
+			if (profiler)
+			{
+				profiler->endFrame();
+			}
+		}
+
+		if (frameTimingsEnabled)
+		{
+			glEndQuery(GL_TIME_ELAPSED);
+		}
+
+		Clock::time_point swapStart = Clock::now();
+		{
+			CpuZone zone("Swap");
+			if (headlessContext)
+			{
+				headlessContext->swapBuffers();
+			}
+			else
+			{
+				glfwSwapBuffers(window);
+			}
+		}
+		CpuProfiler::markFrame();
+		markGLCaptureFrame();
+		Clock::time_point swapEnd = Clock::now();
+
+		frameMilliseconds = millisecondsBetween(previousSwapEnd, swapEnd);
+		previousSwapEnd = swapEnd;
+		endCounterFrame(frameMilliseconds);
+
+		if (frameTimingsEnabled)
+		{
+			FrameTiming timing = { millisecondsBetween(renderStart, swapStart), millisecondsBetween(swapStart, swapEnd), -1.0,
+				millisecondsBetween(inputTimes[listIndex], swapEnd) };
+			frameTimings.push_back(timing);
+			timerQueryFrames[querySlot] = frameIndex;
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			replayingList = -1;
+
+			double latency = millisecondsBetween(submitTimes[listIndex], swapEnd);
+			double inputLatency = millisecondsBetween(inputTimes[listIndex], swapEnd);
+			stats.frames++;
+			stats.staleCommands += staleCommands;
+			stats.renderWaitMilliseconds += millisecondsBetween(waitStart, renderStart);
+			stats.renderMilliseconds += millisecondsBetween(renderStart, swapStart);
+			stats.swapMilliseconds += millisecondsBetween(swapStart, swapEnd);
+			stats.latencyMilliseconds += latency;
+			if (latency > stats.maxLatencyMilliseconds)
+			{
+				stats.maxLatencyMilliseconds = latency;
+			}
+			stats.inputLatencyMilliseconds += inputLatency;
+			if (inputLatency > stats.maxInputLatencyMilliseconds)
+			{
+				stats.maxInputLatencyMilliseconds = inputLatency;
+			}
+		}
+		condition.notify_all();
+	}
+
+	if (frameTimingsEnabled)
+	{
+		for (int i = 0; i < TimerQueryLatency; i++)
+		{
+			readTimerQuery(i);
+		}
+		glDeleteQueries(TimerQueryLatency, timerQueries);
+	}
+
+	instanceBatcher.destroy();
+	if (gpuProfilerEnabled)
+	{
+		gpuProfiler.destroy();
+	}
+	if (statsOverlayEnabled)
+	{
+		statsOverlay.destroy();
+	}
+
+	// NOTE Release the context so the main thread can take it back for cleanup
+	if (headlessContext)
+	{
+		headlessContext->releaseCurrent();
+	}
+	else
+	{
+		glfwMakeContextCurrent(NULL);
+	}
+}
+
+RenderThread::Stats RenderThread::getStats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats;
+}
+
+void RenderThread::resetStats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	stats = Stats();
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "CommandList.h"
+#include "RenderQueue.h"
+#include "LinearArena.h"
+#include "HeadlessContext.h"
+#include "GpuProfiler.h"
+#include "StatsOverlay.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Owns the OpenGL context and replays the command lists recorded by the simulation thread.
+// There are two lists: while the simulation records frame N the render thread replays
+// frame N - 1, so game logic and GL submission overlap instead of adding up.
+//
+// Each list has its own frame arena for everything the simulation allocates for that frame.
+// An arena is reset when its list gets recorded again, which is only after the render thread
+// swapped the frame that used it, so per-frame data never touches the general heap
+class RenderThread
+{
+public:
+	static const size_t FrameArenaSize = 4 * 1024 * 1024;
+	static const uint32_t MaxInstancesPerFrame = 16384;	// per render queue flush
+
+	struct Stats
+	{
+		int frames;
+		double simulationMilliseconds;	// recording a frame, between beginFrame and submitFrame
+		double simulationWaitMilliseconds;	// simulation blocked because the render thread was behind
+		double renderMilliseconds;	// replaying a command list
+		double swapMilliseconds;	// glfwSwapBuffers, or waiting for the GPU to finish when headless
+		double renderWaitMilliseconds;	// render thread idle waiting for a command list
+		double latencyMilliseconds;	// from submitFrame until that frame was swapped
+		double maxLatencyMilliseconds;
+		double inputLatencyMilliseconds;	// from markInputSampled until the frame recorded with that input was swapped
+		double maxInputLatencyMilliseconds;
+		size_t frameArenaBytes;	// allocated from the frame arenas
+		size_t maxFrameArenaBytes;	// worst single frame
+		uint64_t frameArenaAllocations;	// served by the frame arenas
+		uint64_t frameArenaOverflows;	// heap calls made anyway because an arena was full
+		uint64_t staleCommands;	// skipped because they referred to a destroyed resource
+	};
+
+	// One per replayed frame when frame timings are enabled
+	struct FrameTiming
+	{
+		double renderMilliseconds;
+		double swapMilliseconds;
+		double gpuMilliseconds;	// GL_TIME_ELAPSED over the replay, negative if there's no result
+		double inputLatencyMilliseconds;
+	};
+
+	// GPU results are read this many frames later, by then they're available and reading doesn't stall
+	static const int TimerQueryLatency = 4;
+
+private:
+	typedef std::chrono::high_resolution_clock Clock;
+
+	GLFWwindow* window;
+	HeadlessContext* headlessContext;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool running;
+
+	CommandList commandLists[2];
+	RenderResources resources;
+	LinearArena* frameArenas[2];
+	Clock::time_point submitTimes[2];
+	Clock::time_point inputTimes[2];
+	Clock::time_point inputTime;	// NOTE Simulation thread only, the latest markInputSampled
+	int recordingList;
+	int pendingList;
+	int replayingList;
+
+	Clock::time_point recordStart;
+	Stats stats;
+
+	// NOTE Only touched by the render thread while it runs
+	bool frameTimingsEnabled;
+	std::vector<FrameTiming> frameTimings;
+	unsigned int timerQueries[TimerQueryLatency];
+	int timerQueryFrames[TimerQueryLatency];	// frame waiting on each query, -1 for none
+
+	void readTimerQuery(int slot);
+
+	bool gpuProfilerEnabled;
+	GpuProfiler gpuProfiler;
+
+	bool statsOverlayEnabled;
+	StatsOverlay statsOverlay;
+
+	void run();
+
+public:
+	RenderThread();
+	~RenderThread();
+
+	RenderThread(const RenderThread&) = delete;
+	RenderThread& operator=(const RenderThread&) = delete;
+
+	// NOTE The context of window must not be current on the calling thread
+	void start(GLFWwindow* window);
+	void start(HeadlessContext* context);
+	void stop();
+
+	// Pools the handles in the command lists are resolved through, has to be called before start
+	void setResources(const RenderResources& resources) { this->resources = resources; }
+
+	// Returns the list to record the next frame into, waits if the render thread is still using it
+	CommandList& beginFrame();
+	void submitFrame();
+
+	// Marks when the input the next submitted frame reacts to was sampled (events polled),
+	// the input latency of a frame runs from there to its swap. Frames count from start until it's called
+	void markInputSampled();
+
+	// Arena of the frame being recorded, valid between beginFrame and submitFrame.
+	// Allocations live until the render thread is done with the frame
+	LinearArena& getFrameArena() { return *frameArenas[recordingList]; }
+
+	// Records a FrameTiming for every frame replayed from now on, has to be called before start
+	void enableFrameTimings();
+
+	// Timings of every frame replayed since start, only valid after stop
+	const std::vector<FrameTiming>& getFrameTimings() const { return frameTimings; }
+
+	// Profiles the passes of every frame replayed from now on, has to be called before start.
+	// The results can be read from any thread while rendering, the last frames are only in after stop
+	void enableGpuProfiler();
+	GpuProfiler& getGpuProfiler() { return gpuProfiler; }
+
+	// Draws the counters of the previous frame over every frame, has to be called before start
+	void enableStatsOverlay();
+
+	// Totals since the last resetStats, divide by frames for per-frame averages
+	Stats getStats();
+	void resetStats();
+};
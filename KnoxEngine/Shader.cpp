@@ -1,4 +1,5 @@
 #include "Shader.h"
+#include "Counters.h"
 
 #include <iostream>
 #include <fstream>
@@ -96,16 +97,19 @@ void Shader::setBool(const char* attributeName, bool value)
 {
 	int location = glGetUniformLocation(Id, attributeName);
 	glUniform1i(location, (int)value);
+	countEvent(CounterUniformUploads);
 }
 
 void Shader::setInt(const char* attributeName, int value)
 {
 	int location = glGetUniformLocation(Id, attributeName);
 	glUniform1i(location, value);
+	countEvent(CounterUniformUploads);
 }
 
 void Shader::setFloat(const char* attributeName, float value)
 {
 	int location = glGetUniformLocation(Id, attributeName);
 	glUniform1f(location, value);
+	countEvent(CounterUniformUploads);
 }
\ No newline at end of file
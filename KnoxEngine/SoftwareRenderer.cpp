@@ -0,0 +1,552 @@
+#include "SoftwareRenderer.h"
+#include "ImageFile.h"
+
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+
+static double millisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static uint32_t packColor(float r, float g, float b, float a)
+{
+	// NOTE Channels are in [0, 255] already, +0.5 rounds to the nearest
+	uint32_t red = (uint32_t)std::min(std::max(r + 0.5f, 0.0f), 255.0f);
+	uint32_t green = (uint32_t)std::min(std::max(g + 0.5f, 0.0f), 255.0f);
+	uint32_t blue = (uint32_t)std::min(std::max(b + 0.5f, 0.0f), 255.0f);
+	uint32_t alpha = (uint32_t)std::min(std::max(a + 0.5f, 0.0f), 255.0f);
+	return red | (green << 8) | (blue << 16) | (alpha << 24);
+}
+
+static int wrapCoordinate(int coordinate, int size)
+{
+	if (coordinate >= 0 && coordinate < size)
+	{
+		return coordinate;
+	}
+	coordinate %= size;
+	return coordinate < 0 ? coordinate + size : coordinate;
+}
+
+#if KNOX_MATH_SSE
+static inline __m128 unpackTexel(uint32_t texel)
+{
+	__m128i zero = _mm_setzero_si128();
+	return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)texel), zero), zero));
+}
+#endif
+
+void SoftwareTexture::create(const unsigned char* data, int width, int height, int channels)
+{
+	levels.clear();
+
+	Level base;
+	base.width = width;
+	base.height = height;
+	base.texels.resize((size_t)width * height);
+	for (size_t i = 0; i < base.texels.size(); i++)
+	{
+		const unsigned char* texel = data + i * channels;
+		uint32_t alpha = channels == 4 ? texel[3] : 255;
+		base.texels[i] = texel[0] | (texel[1] << 8) | (texel[2] << 16) | (alpha << 24);
+	}
+	levels.push_back(base);
+
+	// Box filtered down to 1x1 like glGenerateMipmap, odd sizes round down and repeat the last texel
+	while (levels.back().width > 1 || levels.back().height > 1)
+	{
+		const Level& source = levels.back();
+		Level level;
+		level.width = std::max(1, source.width / 2);
+		level.height = std::max(1, source.height / 2);
+		level.texels.resize((size_t)level.width * level.height);
+		for (int y = 0; y < level.height; y++)
+		{
+			int sourceY0 = std::min(y * 2, source.height - 1);
+			int sourceY1 = std::min(y * 2 + 1, source.height - 1);
+			for (int x = 0; x < level.width; x++)
+			{
+				int sourceX0 = std::min(x * 2, source.width - 1);
+				int sourceX1 = std::min(x * 2 + 1, source.width - 1);
+				uint32_t texels[4] = {
+					source.texels[(size_t)sourceY0 * source.width + sourceX0], source.texels[(size_t)sourceY0 * source.width + sourceX1],
+					source.texels[(size_t)sourceY1 * source.width + sourceX0], source.texels[(size_t)sourceY1 * source.width + sourceX1]
+				};
+
+				uint32_t result = 0;
+				for (int shift = 0; shift < 32; shift += 8)
+				{
+					uint32_t sum = ((texels[0] >> shift) & 0xFF) + ((texels[1] >> shift) & 0xFF) + ((texels[2] >> shift) & 0xFF) + ((texels[3] >> shift) & 0xFF);
+					result |= ((sum + 2) / 4) << shift;
+				}
+				level.texels[(size_t)y * level.width + x] = result;
+			}
+		}
+		levels.push_back(level);
+	}
+}
+
+// Channels in [0, 255]
+static void sampleBilinear(const SoftwareTexture::Level& level, float u, float v, float* result)
+{
+	float x = u * level.width - 0.5f;
+	float y = v * level.height - 0.5f;
+	float floorX = std::floor(x);
+	float floorY = std::floor(y);
+	float fractionX = x - floorX;
+	float fractionY = y - floorY;
+
+	int x0 = wrapCoordinate((int)floorX, level.width);
+	int y0 = wrapCoordinate((int)floorY, level.height);
+	int x1 = x0 + 1 < level.width ? x0 + 1 : 0;
+	int y1 = y0 + 1 < level.height ? y0 + 1 : 0;
+
+	uint32_t texel00 = level.texels[(size_t)y0 * level.width + x0];
+	uint32_t texel10 = level.texels[(size_t)y0 * level.width + x1];
+	uint32_t texel01 = level.texels[(size_t)y1 * level.width + x0];
+	uint32_t texel11 = level.texels[(size_t)y1 * level.width + x1];
+
+#if KNOX_MATH_SSE
+	__m128 color00 = unpackTexel(texel00), color10 = unpackTexel(texel10);
+	__m128 color01 = unpackTexel(texel01), color11 = unpackTexel(texel11);
+	__m128 weightX = _mm_set1_ps(fractionX);
+	__m128 top = _mm_add_ps(color00, _mm_mul_ps(_mm_sub_ps(color10, color00), weightX));
+	__m128 bottom = _mm_add_ps(color01, _mm_mul_ps(_mm_sub_ps(color11, color01), weightX));
+	_mm_storeu_ps(result, _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), _mm_set1_ps(fractionY))));
+#else
+	for (int channel = 0; channel < 4; channel++)
+	{
+		int shift = channel * 8;
+		float top = (float)((texel00 >> shift) & 0xFF) + ((float)((texel10 >> shift) & 0xFF) - (float)((texel00 >> shift) & 0xFF)) * fractionX;
+		float bottom = (float)((texel01 >> shift) & 0xFF) + ((float)((texel11 >> shift) & 0xFF) - (float)((texel01 >> shift) & 0xFF)) * fractionX;
+		result[channel] = top + (bottom - top) * fractionY;
+	}
+#endif
+}
+
+// Derivatives of the texture coordinates over the screen pick the level, only used with mipmapping
+static void sampleTexture(const SoftwareTexture& texture, TextureFilter filter, float u, float v, float dudx, float dvdx, float dudy, float dvdy, float* result)
+{
+	int levelIndex = 0;
+	if (filter == TextureFilterBilinearMipmapped)
+	{
+		const SoftwareTexture::Level& base = texture.getLevel(0);
+		float scaleX = dudx * base.width, scaleY = dvdx * base.height;
+		float scaleU = dudy * base.width, scaleV = dvdy * base.height;
+		float rhoSquared = std::max(scaleX * scaleX + scaleY * scaleY, scaleU * scaleU + scaleV * scaleV);
+
+		// Nearest level to log2(rho) = log2(rhoSquared) / 2, 0 when magnified.
+		// NOTE Read off the float exponent, floor(log2(rhoSquared * sqrt(2))) / 2 rounds to the nearest level
+		float scaled = std::max(rhoSquared, 1.0f) * 1.41421356f;
+		uint32_t bits;
+		memcpy(&bits, &scaled, sizeof(bits));
+		int exponent = (int)((bits >> 23) & 0xFF) - 127;
+		levelIndex = std::min(exponent >> 1, texture.getLevelCount() - 1);
+	}
+	sampleBilinear(texture.getLevel(levelIndex), u, v, result);
+}
+
+// FragmentShader: mix(texture(texture1, texCoord), texture(texture2, texCoord), mixValue)
+static uint32_t shadePixel(const SoftwareTexture* const* textures, TextureFilter filter, float mixValue, float u, float v, float dudx, float dvdx, float dudy, float dvdy)
+{
+	float color1[4] = { 0.0f, 0.0f, 0.0f, 255.0f };
+	float color2[4] = { 0.0f, 0.0f, 0.0f, 255.0f };
+	if (textures[0])
+	{
+		sampleTexture(*textures[0], filter, u, v, dudx, dvdx, dudy, dvdy, color1);
+	}
+	if (textures[1])
+	{
+		sampleTexture(*textures[1], filter, u, v, dudx, dvdx, dudy, dvdy, color2);
+	}
+#if KNOX_MATH_SSE
+	__m128 first = _mm_loadu_ps(color1);
+	__m128 mixed = _mm_add_ps(first, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(color2), first), _mm_set1_ps(mixValue)));
+	__m128i channels = _mm_cvtps_epi32(mixed);
+	channels = _mm_packs_epi32(channels, channels);
+	return (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(channels, channels));
+#else
+	return packColor(
+		color1[0] + (color2[0] - color1[0]) * mixValue,
+		color1[1] + (color2[1] - color1[1]) * mixValue,
+		color1[2] + (color2[2] - color1[2]) * mixValue,
+		color1[3] + (color2[3] - color1[3]) * mixValue);
+#endif
+}
+
+SoftwareRenderer::SoftwareRenderer(int width, int height, JobSystem* jobSystem) : width(width), height(height), jobSystem(jobSystem)
+{
+	tilesX = (width + TileSize - 1) / TileSize;
+	tilesY = (height + TileSize - 1) / TileSize;
+	colors.assign((size_t)width * height, 0xFF000000);
+	bins.resize((size_t)tilesX * tilesY);
+	tileShadedPixels.assign(bins.size(), 0);
+
+	currentState.textures[0] = NULL;
+	currentState.textures[1] = NULL;
+	currentState.mixValue = 0.0f;
+	currentState.filter = TextureFilterBilinear;
+	stats = Stats();
+}
+
+void SoftwareRenderer::clear(float r, float g, float b, float a)
+{
+	flush();
+	std::fill(colors.begin(), colors.end(), packColor(r * 255.0f, g * 255.0f, b * 255.0f, a * 255.0f));
+}
+
+void SoftwareRenderer::setTextures(const SoftwareTexture* texture1, const SoftwareTexture* texture2)
+{
+	currentState.textures[0] = texture1 && texture1->isValid() ? texture1 : NULL;
+	currentState.textures[1] = texture2 && texture2->isValid() ? texture2 : NULL;
+}
+
+void SoftwareRenderer::setMixValue(float mixValue)
+{
+	currentState.mixValue = mixValue;
+}
+
+void SoftwareRenderer::setFilter(TextureFilter filter)
+{
+	currentState.filter = filter;
+}
+
+void SoftwareRenderer::draw(const float* vertices, const uint32_t* indices, uint32_t indexCount, const mat4& transform, const VertexLayout& layout)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	states.push_back(currentState);
+
+	for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		ClipVertex corners[3];
+		int outsideMask = 0x3F;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			const float* vertex = vertices + (size_t)indices[i + corner] * layout.stride;
+			const float* position = vertex + layout.positionOffset;
+			const float* texCoord = vertex + layout.texCoordOffset;
+			vec4 clip = ::transform(transform, vec4(position[0], position[1], position[2], 1.0f));
+			corners[corner].position = clip;
+			corners[corner].u = texCoord[0];
+			corners[corner].v = texCoord[1];
+
+			// Bit per clip plane the vertex is outside of, the triangle is gone when all three share one
+			int outside = (clip.x < -clip.w) | (clip.x > clip.w) << 1 | (clip.y < -clip.w) << 2 |
+				(clip.y > clip.w) << 3 | (clip.z < -clip.w) << 4 | (clip.z > clip.w) << 5;
+			outsideMask &= outside;
+		}
+		if (outsideMask)
+		{
+			continue;
+		}
+
+		// Sutherland-Hodgman against the near plane (z >= -w), leaves a triangle or a quad
+		ClipVertex clipped[4];
+		int clippedCount = 0;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			const ClipVertex& current = corners[corner];
+			const ClipVertex& next = corners[corner == 2 ? 0 : corner + 1];
+			float currentDistance = current.position.z + current.position.w;
+			float nextDistance = next.position.z + next.position.w;
+			if (currentDistance >= 0.0f)
+			{
+				clipped[clippedCount++] = current;
+			}
+			if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+			{
+				float t = currentDistance / (currentDistance - nextDistance);
+				ClipVertex& vertex = clipped[clippedCount++];
+				vertex.position = current.position + (next.position - current.position) * t;
+				vertex.u = current.u + (next.u - current.u) * t;
+				vertex.v = current.v + (next.v - current.v) * t;
+			}
+		}
+
+		for (int corner = 2; corner < clippedCount; corner++)
+		{
+			setupTriangle(clipped[0], clipped[corner - 1], clipped[corner]);
+		}
+	}
+
+	stats.setupMilliseconds += millisecondsSince(start);
+}
+
+void SoftwareRenderer::setupTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c)
+{
+	if (a.position.w <= 0.0f || b.position.w <= 0.0f || c.position.w <= 0.0f)
+	{
+		return;
+	}
+
+	// Screen space with y going down, so row 0 is the top of the color buffer
+	float inverseW0 = 1.0f / a.position.w, inverseW1 = 1.0f / b.position.w, inverseW2 = 1.0f / c.position.w;
+	float x0 = (a.position.x * inverseW0 * 0.5f + 0.5f) * width, y0 = (0.5f - a.position.y * inverseW0 * 0.5f) * height;
+	float x1 = (b.position.x * inverseW1 * 0.5f + 0.5f) * width, y1 = (0.5f - b.position.y * inverseW1 * 0.5f) * height;
+	float x2 = (c.position.x * inverseW2 * 0.5f + 0.5f) * width, y2 = (0.5f - c.position.y * inverseW2 * 0.5f) * height;
+	float u0 = a.u * inverseW0, v0 = a.v * inverseW0;
+	float u1 = b.u * inverseW1, v1 = b.v * inverseW1;
+	float u2 = c.u * inverseW2, v2 = c.v * inverseW2;
+
+	// Both windings are drawn, swapping two corners makes the edge functions positive inside
+	float area = (x1 - x0) * (y2 - y0) - (y1 - y0) * (x2 - x0);
+	if (area == 0.0f || !std::isfinite(area))
+	{
+		return;
+	}
+	if (area < 0.0f)
+	{
+		std::swap(x1, x2);
+		std::swap(y1, y2);
+		std::swap(inverseW1, inverseW2);
+		std::swap(u1, u2);
+		std::swap(v1, v2);
+		area = -area;
+	}
+
+	Triangle triangle;
+	triangle.minX = std::max(0, (int)std::floor(std::min(x0, std::min(x1, x2))));
+	triangle.maxX = std::min(width - 1, (int)std::ceil(std::max(x0, std::max(x1, x2))));
+	triangle.minY = std::max(0, (int)std::floor(std::min(y0, std::min(y1, y2))));
+	triangle.maxY = std::min(height - 1, (int)std::ceil(std::max(y0, std::max(y1, y2))));
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+	{
+		return;
+	}
+
+	// Edge functions as a*x + b*y + c, each one is the weight of the opposite vertex times area
+	float a12 = y1 - y2, b12 = x2 - x1, c12 = x1 * y2 - x2 * y1;
+	float a20 = y2 - y0, b20 = x0 - x2, c20 = x2 * y0 - x0 * y2;
+	float a01 = y0 - y1, b01 = x1 - x0, c01 = x0 * y1 - x1 * y0;
+	triangle.edgeA[0] = a12; triangle.edgeB[0] = b12; triangle.edgeC[0] = c12;
+	triangle.edgeA[1] = a20; triangle.edgeB[1] = b20; triangle.edgeC[1] = c20;
+	triangle.edgeA[2] = a01; triangle.edgeB[2] = b01; triangle.edgeC[2] = c01;
+
+	// Pixels exactly on an edge belong to the triangle on its right (left edge) or below it (top edge)
+	for (int edge = 0; edge < 3; edge++)
+	{
+		triangle.topLeft[edge] = triangle.edgeA[edge] > 0.0f || (triangle.edgeA[edge] == 0.0f && triangle.edgeB[edge] > 0.0f);
+	}
+
+	// 1/w, u/w and v/w are linear in screen space, dividing by the interpolated 1/w makes them perspective correct
+	float inverseArea = 1.0f / area;
+	triangle.inverseWA = (a12 * inverseW0 + a20 * inverseW1 + a01 * inverseW2) * inverseArea;
+	triangle.inverseWB = (b12 * inverseW0 + b20 * inverseW1 + b01 * inverseW2) * inverseArea;
+	triangle.inverseWC = (c12 * inverseW0 + c20 * inverseW1 + c01 * inverseW2) * inverseArea;
+	triangle.uA = (a12 * u0 + a20 * u1 + a01 * u2) * inverseArea;
+	triangle.uB = (b12 * u0 + b20 * u1 + b01 * u2) * inverseArea;
+	triangle.uC = (c12 * u0 + c20 * u1 + c01 * u2) * inverseArea;
+	triangle.vA = (a12 * v0 + a20 * v1 + a01 * v2) * inverseArea;
+	triangle.vB = (b12 * v0 + b20 * v1 + b01 * v2) * inverseArea;
+	triangle.vC = (c12 * v0 + c20 * v1 + c01 * v2) * inverseArea;
+	triangle.state = (uint32_t)states.size() - 1;
+
+	uint32_t triangleIndex = (uint32_t)triangles.size();
+	triangles.push_back(triangle);
+	stats.triangles++;
+
+	// NOTE Binned by bounding box, tiles it misses near the corners just find no covered pixels
+	int tileX0 = triangle.minX / TileSize, tileX1 = triangle.maxX / TileSize;
+	int tileY0 = triangle.minY / TileSize, tileY1 = triangle.maxY / TileSize;
+	for (int tileY = tileY0; tileY <= tileY1; tileY++)
+	{
+		for (int tileX = tileX0; tileX <= tileX1; tileX++)
+		{
+			bins[(size_t)tileY * tilesX + tileX].push_back(triangleIndex);
+		}
+	}
+	stats.binnedTriangles += (tileX1 - tileX0 + 1) * (tileY1 - tileY0 + 1);
+}
+
+void SoftwareRenderer::flush()
+{
+	if (triangles.empty())
+	{
+		states.clear();
+		return;
+	}
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	std::vector<uint32_t> busyTiles;
+	for (size_t tile = 0; tile < bins.size(); tile++)
+	{
+		if (!bins[tile].empty())
+		{
+			busyTiles.push_back((uint32_t)tile);
+		}
+	}
+
+	// NOTE One tile per job, a tile is already thousands of pixels and the busy ones vary a lot
+	if (jobSystem)
+	{
+		jobSystem->parallelFor((uint32_t)busyTiles.size(), 1, [this, &busyTiles](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				rasterizeTile(busyTiles[i]);
+			}
+		});
+	}
+	else
+	{
+		for (size_t i = 0; i < busyTiles.size(); i++)
+		{
+			rasterizeTile(busyTiles[i]);
+		}
+	}
+
+	for (size_t i = 0; i < busyTiles.size(); i++)
+	{
+		stats.shadedPixels += tileShadedPixels[busyTiles[i]];
+		tileShadedPixels[busyTiles[i]] = 0;
+		bins[busyTiles[i]].clear();
+	}
+	triangles.clear();
+	states.clear();
+
+	stats.rasterMilliseconds += millisecondsSince(start);
+}
+
+#if KNOX_MATH_SSE
+// Edges owning their pixels (top-left) also take the ones exactly on them
+static inline __m128 insideEdge(__m128 edge, __m128 topLeft)
+{
+	__m128 zero = _mm_setzero_ps();
+	return _mm_or_ps(_mm_and_ps(topLeft, _mm_cmpge_ps(edge, zero)), _mm_andnot_ps(topLeft, _mm_cmpgt_ps(edge, zero)));
+}
+#endif
+
+void SoftwareRenderer::rasterizeTile(int tile)
+{
+	int tileX = tile % tilesX, tileY = tile / tilesX;
+	int tileMinX = tileX * TileSize, tileMaxX = std::min(width, tileMinX + TileSize) - 1;
+	int tileMinY = tileY * TileSize, tileMaxY = std::min(height, tileMinY + TileSize) - 1;
+	const std::vector<uint32_t>& bin = bins[tile];
+	uint64_t shadedPixels = 0;
+
+	for (size_t i = 0; i < bin.size(); i++)
+	{
+		const Triangle& triangle = triangles[bin[i]];
+		const DrawState& state = states[triangle.state];
+		bool mipmapped = state.filter == TextureFilterBilinearMipmapped;
+
+		// NOTE Tiles start at multiples of 4, so aligning down stays inside the tile
+		int minX = std::max(triangle.minX, tileMinX) & ~3;
+		int maxX = std::min(triangle.maxX, tileMaxX);
+		int minY = std::max(triangle.minY, tileMinY);
+		int maxY = std::min(triangle.maxY, tileMaxY);
+
+		for (int y = minY; y <= maxY; y++)
+		{
+			float pixelY = y + 0.5f;
+			uint32_t* row = colors.data() + (size_t)y * width;
+			int x = minX;
+
+#if KNOX_MATH_SSE
+			__m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+			__m128 pixelX = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+			__m128 step = _mm_set1_ps(4.0f);
+			__m128 lastX = _mm_set1_ps((float)maxX + 1.0f);
+
+			__m128 edges[3], edgeSteps[3], topLeft[3];
+			for (int edge = 0; edge < 3; edge++)
+			{
+				edges[edge] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edgeA[edge]), pixelX), _mm_set1_ps(triangle.edgeB[edge] * pixelY + triangle.edgeC[edge]));
+				edgeSteps[edge] = _mm_set1_ps(triangle.edgeA[edge] * 4.0f);
+				topLeft[edge] = _mm_castsi128_ps(_mm_set1_epi32(triangle.topLeft[edge] ? -1 : 0));
+			}
+			__m128 inverseW = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.inverseWA), pixelX), _mm_set1_ps(triangle.inverseWB * pixelY + triangle.inverseWC));
+			__m128 u = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.uA), pixelX), _mm_set1_ps(triangle.uB * pixelY + triangle.uC));
+			__m128 v = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.vA), pixelX), _mm_set1_ps(triangle.vB * pixelY + triangle.vC));
+			__m128 inverseWStep = _mm_set1_ps(triangle.inverseWA * 4.0f);
+			__m128 uStep = _mm_set1_ps(triangle.uA * 4.0f);
+			__m128 vStep = _mm_set1_ps(triangle.vA * 4.0f);
+
+			for (; x <= maxX; x += 4)
+			{
+				__m128 inside = _mm_and_ps(_mm_and_ps(insideEdge(edges[0], topLeft[0]), insideEdge(edges[1], topLeft[1])), insideEdge(edges[2], topLeft[2]));
+				inside = _mm_and_ps(inside, _mm_cmplt_ps(pixelX, lastX));
+				int mask = _mm_movemask_ps(inside);
+
+				if (mask)
+				{
+					__m128 w = _mm_div_ps(_mm_set1_ps(1.0f), inverseW);
+					alignas(16) float pixelU[4], pixelV[4];
+					alignas(16) float dudx[4] = { 0.0f }, dvdx[4] = { 0.0f }, dudy[4] = { 0.0f }, dvdy[4] = { 0.0f };
+					__m128 perspectiveU = _mm_mul_ps(u, w);
+					__m128 perspectiveV = _mm_mul_ps(v, w);
+					_mm_store_ps(pixelU, perspectiveU);
+					_mm_store_ps(pixelV, perspectiveV);
+
+					if (mipmapped)
+					{
+						// d(U/W)/dx = (dU/dx - u * dW/dx) / W with U = u/w and W = 1/w the interpolated planes
+						__m128 inverseWA = _mm_set1_ps(triangle.inverseWA), inverseWB = _mm_set1_ps(triangle.inverseWB);
+						_mm_store_ps(dudx, _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(triangle.uA), _mm_mul_ps(perspectiveU, inverseWA)), w));
+						_mm_store_ps(dvdx, _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(triangle.vA), _mm_mul_ps(perspectiveV, inverseWA)), w));
+						_mm_store_ps(dudy, _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(triangle.uB), _mm_mul_ps(perspectiveU, inverseWB)), w));
+						_mm_store_ps(dvdy, _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(triangle.vB), _mm_mul_ps(perspectiveV, inverseWB)), w));
+					}
+
+					for (int lane = 0; lane < 4; lane++)
+					{
+						if (mask & (1 << lane))
+						{
+							row[x + lane] = shadePixel(state.textures, state.filter, state.mixValue, pixelU[lane], pixelV[lane], dudx[lane], dvdx[lane], dudy[lane], dvdy[lane]);
+							shadedPixels++;
+						}
+					}
+				}
+
+				for (int edge = 0; edge < 3; edge++)
+				{
+					edges[edge] = _mm_add_ps(edges[edge], edgeSteps[edge]);
+				}
+				inverseW = _mm_add_ps(inverseW, inverseWStep);
+				u = _mm_add_ps(u, uStep);
+				v = _mm_add_ps(v, vStep);
+				pixelX = _mm_add_ps(pixelX, step);
+			}
+#else
+			for (; x <= maxX; x++)
+			{
+				float pixelX = x + 0.5f;
+				bool inside = true;
+				for (int edge = 0; edge < 3; edge++)
+				{
+					float value = triangle.edgeA[edge] * pixelX + triangle.edgeB[edge] * pixelY + triangle.edgeC[edge];
+					inside = inside && (value > 0.0f || (value == 0.0f && triangle.topLeft[edge]));
+				}
+				if (!inside)
+				{
+					continue;
+				}
+
+				float w = 1.0f / (triangle.inverseWA * pixelX + triangle.inverseWB * pixelY + triangle.inverseWC);
+				float u = (triangle.uA * pixelX + triangle.uB * pixelY + triangle.uC) * w;
+				float v = (triangle.vA * pixelX + triangle.vB * pixelY + triangle.vC) * w;
+				float dudx = 0.0f, dvdx = 0.0f, dudy = 0.0f, dvdy = 0.0f;
+				if (mipmapped)
+				{
+					dudx = (triangle.uA - u * triangle.inverseWA) * w;
+					dvdx = (triangle.vA - v * triangle.inverseWA) * w;
+					dudy = (triangle.uB - u * triangle.inverseWB) * w;
+					dvdy = (triangle.vB - v * triangle.inverseWB) * w;
+				}
+				row[x] = shadePixel(state.textures, state.filter, state.mixValue, u, v, dudx, dvdx, dudy, dvdy);
+				shadedPixels++;
+			}
+#endif
+		}
+	}
+
+	tileShadedPixels[tile] = shadedPixels;
+}
+
+bool SoftwareRenderer::writePpm(const char* filePath) const
+{
+	return ::writePpm(filePath, (const unsigned char*)colors.data(), width, height, false);
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "MathTypes.h"
+#include "JobSystem.h"
+
+#include <vector>
+#include <cstdint>
+
+enum TextureFilter
+{
+	TextureFilterBilinear,			// GL_LINEAR, what main.cpp sets
+	TextureFilterBilinearMipmapped	// GL_LINEAR_MIPMAP_NEAREST
+};
+
+// RGBA8 texture with its mip chain, texels packed as 0xAABBGGRR like GL_RGBA/GL_UNSIGNED_BYTE in memory.
+// Wraps with GL_REPEAT, row 0 of the data is t = 0 like glTexImage2D
+class SoftwareTexture
+{
+public:
+	struct Level
+	{
+		int width;
+		int height;
+		std::vector<uint32_t> texels;
+	};
+
+private:
+	std::vector<Level> levels;
+
+public:
+	// Data as decoded by stb_image, 3 or 4 channels. RGB gets an alpha of 1
+	void create(const unsigned char* data, int width, int height, int channels);
+
+	bool isValid() const { return !levels.empty(); }
+	int getLevelCount() const { return (int)levels.size(); }
+	const Level& getLevel(int level) const { return levels[level]; }
+};
+
+// Renders the pipeline of the main shaders on the CPU, for machines without a GPU:
+// indexed triangles with the position, color and texture coordinates of the mesh vertices,
+// a transform like aTransform, and two textures mixed by mixValue like FragmentShader.
+//
+// Draws only set up their triangles, flush bins them into screen tiles and rasterizes the tiles
+// in parallel on the job system. Every tile goes through its triangles in draw order and no two
+// jobs touch the same pixels, so the result doesn't depend on the thread count.
+// Coverage follows the top-left rule (shared edges are drawn once), texture coordinates are
+// perspective correct and triangles are clipped against the near plane. There's no depth test
+// or blending, main.cpp doesn't use them either
+class SoftwareRenderer
+{
+public:
+	// In floats, main.cpp's layout is 8 floats: position at 0, color at 3, texture coordinates at 6.
+	// NOTE The color isn't read, FragmentShader doesn't use it
+	struct VertexLayout
+	{
+		uint32_t stride;
+		uint32_t positionOffset;
+		uint32_t texCoordOffset;
+	};
+
+	struct Stats
+	{
+		uint32_t triangles;		// after clipping and dropping the ones off screen or without area
+		uint32_t binnedTriangles;	// triangle and tile pairs
+		uint64_t shadedPixels;
+		double setupMilliseconds;	// vertex transform, clipping, triangle setup and binning
+		double rasterMilliseconds;
+	};
+
+	static const int TileSize = 64;
+
+private:
+	struct DrawState
+	{
+		const SoftwareTexture* textures[2];
+		float mixValue;
+		TextureFilter filter;
+	};
+
+	// Every attribute as a plane a*x + b*y + c over the screen
+	struct Triangle
+	{
+		float edgeA[3], edgeB[3], edgeC[3];
+		bool topLeft[3];
+		float inverseWA, inverseWB, inverseWC;	// 1/w
+		float uA, uB, uC;	// u/w
+		float vA, vB, vC;	// v/w
+		int minX, minY, maxX, maxY;
+		uint32_t state;
+	};
+
+	struct ClipVertex
+	{
+		vec4 position;
+		float u, v;
+	};
+
+	int width;
+	int height;
+	int tilesX;
+	int tilesY;
+	JobSystem* jobSystem;
+
+	std::vector<uint32_t> colors;
+	std::vector<Triangle> triangles;
+	std::vector<DrawState> states;
+	std::vector<std::vector<uint32_t>> bins;
+	std::vector<uint64_t> tileShadedPixels;
+
+	DrawState currentState;
+	Stats stats;
+
+	void setupTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c);
+	void rasterizeTile(int tile);
+
+public:
+	static VertexLayout defaultLayout() { VertexLayout layout = { 8, 0, 6 }; return layout; }
+
+	// Tiles run on the job system when there's one, on the calling thread otherwise
+	SoftwareRenderer(int width, int height, JobSystem* jobSystem = NULL);
+
+	// Draws what's pending first, then fills the color buffer
+	void clear(float r, float g, float b, float a);
+
+	void setTextures(const SoftwareTexture* texture1, const SoftwareTexture* texture2);
+	void setMixValue(float mixValue);
+	void setFilter(TextureFilter filter);
+
+	// Sets up and bins the triangles right away, with the current textures, mixValue and filter
+	void draw(const float* vertices, const uint32_t* indices, uint32_t indexCount, const mat4& transform, const VertexLayout& layout = defaultLayout());
+
+	// Rasterizes everything drawn since the last flush.
+	// NOTE With a job system this has to be called from one of its workers, like any parallelFor
+	void flush();
+
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+
+	// RGBA8, row 0 is the top of the screen (OpenGL reads back bottom row first)
+	const uint32_t* getColorBuffer() const { return colors.data(); }
+
+	// Binary PPM of the color buffer, alpha is dropped
+	bool writePpm(const char* filePath) const;
+
+	Stats getStats() const { return stats; }
+	void resetStats() { stats = Stats(); }
+};
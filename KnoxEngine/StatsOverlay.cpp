@@ -0,0 +1,238 @@
+#include "StatsOverlay.h"
+#include "Shader.h"
+
+#include <cstdio>
+#include <cstdarg>
+#include <cctype>
+#include <cstring>
+#include <cstddef>
+
+// Rows top to bottom, 3 pixels each
+struct Glyph
+{
+	char character;
+	const char* pixels;
+};
+
+static const Glyph Glyphs[] = {
+	{ '#', "111111111111111" },	// solid, the background
+	{ '0', "111101101101111" }, { '1', "010110010010111" }, { '2', "111001111100111" }, { '3', "111001111001111" },
+	{ '4', "101101111001001" }, { '5', "111100111001111" }, { '6', "111100111101111" }, { '7', "111001001001001" },
+	{ '8', "111101111101111" }, { '9', "111101111001111" },
+	{ 'A', "010101111101101" }, { 'B', "110101110101110" }, { 'C', "011100100100011" }, { 'D', "110101101101110" },
+	{ 'E', "111100110100111" }, { 'F', "111100110100100" }, { 'G', "011100101101011" }, { 'H', "101101111101101" },
+	{ 'I', "111010010010111" }, { 'J', "001001001101010" }, { 'K', "101101110101101" }, { 'L', "100100100100111" },
+	{ 'M', "101111111101101" }, { 'N', "110101101101101" }, { 'O', "010101101101010" }, { 'P', "110101110100100" },
+	{ 'Q', "010101101110011" }, { 'R', "110101110101101" }, { 'S', "011100010001110" }, { 'T', "111010010010010" },
+	{ 'U', "101101101101111" }, { 'V', "101101101101010" }, { 'W', "101101111111101" }, { 'X', "101101010101101" },
+	{ 'Y', "101101010010010" }, { 'Z', "111001010100111" },
+	{ '.', "000000000000010" }, { ':', "000010000010000" }, { '/', "001001010100100" }, { '-', "000000111000000" },
+	{ '%', "101001010100101" }, { '(', "010100100100010" }, { ')', "010001001001010" }
+};
+
+static const int GlyphCount = sizeof(Glyphs) / sizeof(Glyphs[0]);
+static const int GlyphWidth = 3;
+static const int GlyphHeight = 5;
+static const int GlyphStride = GlyphWidth + 1;	// a column of space between glyphs in the texture
+static const int LineSpacing = 2;
+static const int Margin = 2;	// font pixels of background around the text
+
+static const float TextColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+static const float BackgroundColor[4] = { 0.0f, 0.0f, 0.0f, 0.6f };
+
+// Index into Glyphs, -1 for a space
+static int findGlyph(char character)
+{
+	character = (char)toupper((unsigned char)character);
+	for (int i = 1; i < GlyphCount; i++)
+	{
+		if (Glyphs[i].character == character)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+StatsOverlay::StatsOverlay()
+	: program(0), glyphTexture(0), VAO(0), VBO(0), viewportSizeLocation(-1), bufferCapacity(0), lineCount(0), longestLine(0)
+{
+	clear();
+}
+
+void StatsOverlay::create()
+{
+	Shader shader("resources/shaders/OverlayVertexShader.txt", "resources/shaders/OverlayFragmentShader.txt");
+	program = shader.Id;
+	viewportSizeLocation = glGetUniformLocation(program, "viewportSize");
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "glyphs"), 0);
+
+	// All glyphs in a row, one byte of coverage per pixel
+	int textureWidth = GlyphCount * GlyphStride;
+	std::vector<unsigned char> pixels((size_t)textureWidth * GlyphHeight, 0);
+	for (int i = 0; i < GlyphCount; i++)
+	{
+		for (int y = 0; y < GlyphHeight; y++)
+		{
+			for (int x = 0; x < GlyphWidth; x++)
+			{
+				if (Glyphs[i].pixels[y * GlyphWidth + x] == '1')
+				{
+					pixels[(size_t)y * textureWidth + i * GlyphStride + x] = 255;
+				}
+			}
+		}
+	}
+
+	glGenTextures(1, &glyphTexture);
+	glBindTexture(GL_TEXTURE_2D, glyphTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	// NOTE Rows of single bytes aren't 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, textureWidth, GlyphHeight, 0, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, x));
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, u));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, r));
+	glEnableVertexAttribArray(2);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void StatsOverlay::destroy()
+{
+	glDeleteBuffers(1, &VBO);
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteTextures(1, &glyphTexture);
+	glDeleteProgram(program);
+	VBO = VAO = glyphTexture = program = 0;
+	bufferCapacity = 0;
+}
+
+void StatsOverlay::clear()
+{
+	// NOTE The first quad is the background, it's only sized in draw once all the lines are in
+	vertices.assign(6, Vertex());
+	lineCount = 0;
+	longestLine = 0;
+}
+
+void StatsOverlay::writeQuad(Vertex* destination, float x, float y, float width, float height, int glyph, const float* color)
+{
+	// Texel edges, nearest filtering of a quad that's a whole number of texels maps them exactly
+	float textureWidth = (float)(GlyphCount * GlyphStride);
+	float u0 = glyph * GlyphStride / textureWidth;
+	float u1 = (glyph * GlyphStride + GlyphWidth) / textureWidth;
+	if (glyph == 0)
+	{
+		// The background is stretched, only sample the middle of the solid glyph
+		u0 = u1 = (GlyphWidth * 0.5f) / textureWidth;
+	}
+
+	Vertex corners[4] = {
+		{ x, y, u0, 0.0f, color[0], color[1], color[2], color[3] },
+		{ x + width, y, u1, 0.0f, color[0], color[1], color[2], color[3] },
+		{ x + width, y + height, u1, 1.0f, color[0], color[1], color[2], color[3] },
+		{ x, y + height, u0, 1.0f, color[0], color[1], color[2], color[3] }
+	};
+	destination[0] = corners[0];
+	destination[1] = corners[1];
+	destination[2] = corners[2];
+	destination[3] = corners[0];
+	destination[4] = corners[2];
+	destination[5] = corners[3];
+}
+
+void StatsOverlay::addLine(const char* format, ...)
+{
+	char text[128];
+	va_list arguments;
+	va_start(arguments, format);
+	vsnprintf(text, sizeof(text), format, arguments);
+	va_end(arguments);
+
+	const float scale = (float)PixelScale;
+	float y = (Margin + lineCount * (GlyphHeight + LineSpacing)) * scale;
+	int length = (int)strlen(text);
+	for (int i = 0; i < length; i++)
+	{
+		int glyph = findGlyph(text[i]);
+		if (glyph < 0)
+		{
+			continue;
+		}
+		float x = (Margin + i * GlyphStride) * scale;
+		vertices.resize(vertices.size() + 6);
+		writeQuad(&vertices[vertices.size() - 6], x, y, GlyphWidth * scale, GlyphHeight * scale, glyph, TextColor);
+	}
+
+	lineCount++;
+	if (length > longestLine)
+	{
+		longestLine = length;
+	}
+}
+
+void StatsOverlay::addCounters(const CounterValues& counters, double frameMilliseconds)
+{
+	const uint64_t* values = counters.values;
+	addLine("Frame     %8.2f ms", frameMilliseconds);
+	addLine("Draws     %8llu", (unsigned long long)values[CounterDrawCalls]);
+	addLine("Triangles %8llu", (unsigned long long)values[CounterTriangles]);
+	addLine("State     %8llu", (unsigned long long)values[CounterStateChanges]);
+	addLine("Uniforms  %8llu", (unsigned long long)values[CounterUniformUploads]);
+	addLine("Textures  %8llu", (unsigned long long)values[CounterTextureBinds]);
+	addLine("Uploaded  %8.1f KB", values[CounterBytesUploaded] / 1024.0);
+	addLine("Allocs    %8llu", (unsigned long long)values[CounterAllocations]);
+}
+
+void StatsOverlay::draw()
+{
+	if (lineCount == 0)
+	{
+		return;
+	}
+
+	// The background is first in the buffer, so it's drawn under the text
+	const float scale = (float)PixelScale;
+	float width = (Margin * 2 + longestLine * GlyphStride - 1) * scale;
+	float height = (Margin * 2 + lineCount * (GlyphHeight + LineSpacing) - LineSpacing) * scale;
+	writeQuad(&vertices[0], 0.0f, 0.0f, width, height, 0, BackgroundColor);
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	if (vertices.size() > bufferCapacity)
+	{
+		bufferCapacity = vertices.size() * 2;
+		glBufferData(GL_ARRAY_BUFFER, bufferCapacity * sizeof(Vertex), NULL, GL_STREAM_DRAW);
+	}
+	glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(Vertex), vertices.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glUseProgram(program);
+	glUniform2f(viewportSizeLocation, (float)viewport[2], (float)viewport[3]);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, glyphTexture);
+	glBindVertexArray(VAO);
+
+	glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertices.size());
+
+	glBindVertexArray(0);
+	glDisable(GL_BLEND);
+}
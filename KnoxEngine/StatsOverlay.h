@@ -0,0 +1,60 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "Counters.h"
+
+#include <vector>
+#include <cstddef>
+
+// Lines of text in the top left corner of the screen, drawn with a built-in 3x5 pixel font
+// over a dark background. All the text of a frame goes into one vertex buffer and one draw call.
+// NOTE The overlay's own draw call and uploads don't go through the counters, so turning it on
+// doesn't change what it shows
+class StatsOverlay
+{
+public:
+	static const int PixelScale = 2;	// screen pixels per font pixel
+
+private:
+	struct Vertex
+	{
+		float x, y;
+		float u, v;
+		float r, g, b, a;
+	};
+
+	unsigned int program;
+	unsigned int glyphTexture;
+	unsigned int VAO;
+	unsigned int VBO;
+	int viewportSizeLocation;
+
+	std::vector<Vertex> vertices;
+	size_t bufferCapacity;	// in vertices
+	int lineCount;
+	int longestLine;
+
+	void writeQuad(Vertex* destination, float x, float y, float width, float height, int glyph, const float* color);
+
+public:
+	StatsOverlay();
+
+	// Loads the overlay shaders from resources/shaders
+	void create();
+
+	// NOTE Must be called while the OpenGL context is still alive
+	void destroy();
+
+	// Starts the text of a new frame
+	void clear();
+
+	// printf formatting, lowercase is drawn as uppercase and characters without a glyph as spaces
+	void addLine(const char* format, ...);
+
+	// The counts of a frame and the time it took, one line each
+	void addCounters(const CounterValues& counters, double frameMilliseconds);
+
+	// Blends the text over whatever is in the current framebuffer
+	void draw();
+};
@@ -0,0 +1,206 @@
+#include "StreamBuffer.h"
+#include "GLExtensions.h"
+#include "MemoryTracker.h"
+#include "Counters.h"
+
+#include <iostream>
+#include <chrono>
+#include <cstring>
+
+StreamBuffer::StreamBuffer(size_t bytesPerFrame)
+	: frameSize(bytesPerFrame), mappedMemory(NULL), writeOffset(0), currentFrame(0)
+{
+	for (int i = 0; i < FrameCount; i++)
+	{
+		fences[i] = 0;
+	}
+	resetStats();
+
+	GLsizeiptr totalSize = (GLsizeiptr)(frameSize * FrameCount);
+
+	// NOTE All the binding is done through GL_COPY_WRITE_BUFFER, so we never touch the
+	// GL_ELEMENT_ARRAY_BUFFER binding of whatever VAO happens to be bound
+	glGenBuffers(1, &Id);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, Id);
+
+	persistent = GLExtensions.bufferStorage;
+	if (persistent)
+	{
+		// NOTE Coherent mapping means we don't need glFlushMappedBufferRange or memory barriers,
+		// the fences are the only synchronization needed
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, totalSize, NULL, flags);
+		mappedMemory = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, totalSize, flags);
+
+		if (!mappedMemory)
+		{
+			printf("ERROR: Failed to persistently map StreamBuffer, falling back to glMapBufferRange\n");
+			glDeleteBuffers(1, &Id);
+			glGenBuffers(1, &Id);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, Id);
+			persistent = false;
+		}
+	}
+
+	if (!persistent)
+	{
+		glBufferData(GL_COPY_WRITE_BUFFER, totalSize, NULL, GL_STREAM_DRAW);
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	trackAllocation("GPU", "StreamBuffer", (size_t)totalSize);
+}
+
+void StreamBuffer::destroy()
+{
+	for (int i = 0; i < FrameCount; i++)
+	{
+		if (fences[i])
+		{
+			glDeleteSync(fences[i]);
+			fences[i] = 0;
+		}
+	}
+
+	if (persistent)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, Id);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	mappedMemory = NULL;
+
+	glDeleteBuffers(1, &Id);
+
+	trackFree("GPU", "StreamBuffer", frameSize * FrameCount);
+}
+
+void StreamBuffer::waitForFence(int frame)
+{
+	if (!fences[frame])
+	{
+		return;
+	}
+
+	// Only count it as a wait if the GPU hasn't already finished with this region
+	GLenum result = glClientWaitSync(fences[frame], 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		do
+		{
+			result = glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		} while (result == GL_TIMEOUT_EXPIRED);
+
+		stats.fenceWaits++;
+		stats.fenceWaitMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	if (result == GL_WAIT_FAILED)
+	{
+		printf("ERROR: glClientWaitSync failed on StreamBuffer fence\n");
+	}
+
+	glDeleteSync(fences[frame]);
+	fences[frame] = 0;
+}
+
+void StreamBuffer::beginFrame()
+{
+	currentFrame = (currentFrame + 1) % FrameCount;
+	writeOffset = 0;
+
+	waitForFence(currentFrame);
+
+	if (!persistent)
+	{
+		// NOTE The fence already told us the GPU is done with this region, so there is no need
+		// for the driver to synchronize the mapping
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT;
+		glBindBuffer(GL_COPY_WRITE_BUFFER, Id);
+		mappedMemory = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, (GLintptr)(currentFrame * frameSize), (GLsizeiptr)frameSize, flags);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		if (!mappedMemory)
+		{
+			printf("ERROR: Failed to map StreamBuffer region %d\n", currentFrame);
+		}
+	}
+}
+
+void StreamBuffer::finishWrites()
+{
+	if (!persistent && mappedMemory)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, Id);
+		if (writeOffset > 0)
+		{
+			glFlushMappedBufferRange(GL_COPY_WRITE_BUFFER, 0, (GLsizeiptr)writeOffset);
+		}
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		mappedMemory = NULL;
+	}
+}
+
+void StreamBuffer::endFrame()
+{
+	finishWrites();
+
+	// NOTE The fence goes in after every draw that reads this region was submitted
+	fences[currentFrame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void* StreamBuffer::allocate(size_t size, size_t alignment, size_t& offset)
+{
+	if (!mappedMemory)
+	{
+		return NULL;
+	}
+
+	size_t alignedOffset = writeOffset;
+	if (alignment > 1)
+	{
+		alignedOffset = (writeOffset + alignment - 1) / alignment * alignment;
+	}
+
+	if (alignedOffset + size > frameSize)
+	{
+		stats.failedAllocations++;
+		return NULL;
+	}
+
+	writeOffset = alignedOffset + size;
+	stats.bytesWritten += size;
+	countEvent(CounterBytesUploaded, size);
+
+	offset = currentFrame * frameSize + alignedOffset;
+
+	// Persistent memory maps the whole buffer, the fallback only maps the current region
+	if (persistent)
+	{
+		return mappedMemory + offset;
+	}
+	return mappedMemory + alignedOffset;
+}
+
+bool StreamBuffer::write(const void* data, size_t size, size_t alignment, size_t& offset)
+{
+	void* destination = allocate(size, alignment, offset);
+	if (!destination)
+	{
+		return false;
+	}
+
+	memcpy(destination, data, size);
+	return true;
+}
+
+void StreamBuffer::resetStats()
+{
+	stats.bytesWritten = 0;
+	stats.failedAllocations = 0;
+	stats.fenceWaits = 0;
+	stats.fenceWaitMilliseconds = 0.0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+// Ring buffer for geometry that changes every frame (debug lines, UI, particles...)
+// The buffer is split in FrameCount regions, the CPU writes into one while the GPU
+// is still reading from the others. A fence per region makes sure we never overwrite
+// data the GPU hasn't consumed yet, so writing is just a memcpy.
+//
+// Uses a persistently mapped buffer when ARB_buffer_storage is available, otherwise the
+// current region is mapped unsynchronized with glMapBufferRange at the start of each frame
+class StreamBuffer
+{
+public:
+	static const int FrameCount = 3;
+
+	struct Stats
+	{
+		size_t bytesWritten;
+		size_t failedAllocations;
+		int fenceWaits;
+		double fenceWaitMilliseconds;
+	};
+
+private:
+	size_t frameSize;
+	bool persistent;
+
+	unsigned char* mappedMemory;
+	size_t writeOffset;
+	int currentFrame;
+	GLsync fences[FrameCount];
+
+	Stats stats;
+
+	void waitForFence(int frame);
+
+public:
+	unsigned int Id;
+
+	StreamBuffer(size_t bytesPerFrame);
+
+	// NOTE Must be called while the OpenGL context is still alive
+	void destroy();
+
+	// Per frame usage: beginFrame -> allocate/write -> finishWrites -> draw calls -> endFrame
+	// NOTE finishWrites is needed because the fallback path can't draw from a mapped buffer
+	void beginFrame();
+	void finishWrites();
+	void endFrame();
+
+	// Reserves size bytes in the current frame region and returns where to write them,
+	// offset receives the position in the buffer to use in glVertexAttribPointer/glDrawElements.
+	// Returns NULL if the frame region is full
+	void* allocate(size_t size, size_t alignment, size_t& offset);
+	bool write(const void* data, size_t size, size_t alignment, size_t& offset);
+
+	bool isPersistent() const { return persistent; }
+	size_t getFrameSize() const { return frameSize; }
+	Stats getStats() const { return stats; }
+	void resetStats();
+};
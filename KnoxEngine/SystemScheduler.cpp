@@ -0,0 +1,124 @@
+#include "SystemScheduler.h"
+
+#include <iostream>
+
+struct SystemJob
+{
+	const SystemScheduler::System* system;
+	EntityWorld* world;
+};
+
+static void runSystemJob(void* data)
+{
+	SystemJob* job = (SystemJob*)data;
+	job->system->function(*job->world, job->system->data);
+}
+
+SystemScheduler::SystemScheduler() : needsBuild(false)
+{
+}
+
+bool SystemScheduler::conflicts(const System& a, const System& b)
+{
+	return (a.writes & (b.reads | b.writes)) || (b.writes & a.reads);
+}
+
+void SystemScheduler::addSystem(const char* name, ComponentMask reads, ComponentMask writes, SystemFunction function, void* data)
+{
+	System system = { name, function, data, reads, writes };
+	systems.push_back(system);
+	needsBuild = true;
+}
+
+void SystemScheduler::build()
+{
+	// Every system goes one stage after the last earlier system it conflicts with
+	uint32_t systemCount = (uint32_t)systems.size();
+	std::vector<uint32_t> stages(systemCount, 0);
+	uint32_t stageCount = 0;
+	for (uint32_t i = 0; i < systemCount; i++)
+	{
+		for (uint32_t earlier = 0; earlier < i; earlier++)
+		{
+			if (conflicts(systems[i], systems[earlier]) && stages[earlier] + 1 > stages[i])
+			{
+				stages[i] = stages[earlier] + 1;
+			}
+		}
+		stageCount = stages[i] + 1 > stageCount ? stages[i] + 1 : stageCount;
+	}
+
+	stageOrder.clear();
+	stageStarts.clear();
+	for (uint32_t stage = 0; stage < stageCount; stage++)
+	{
+		stageStarts.push_back((uint32_t)stageOrder.size());
+		for (uint32_t i = 0; i < systemCount; i++)
+		{
+			if (stages[i] == stage)
+			{
+				stageOrder.push_back(i);
+			}
+		}
+	}
+	stageStarts.push_back((uint32_t)stageOrder.size());
+	needsBuild = false;
+}
+
+void SystemScheduler::run(EntityWorld& world, JobSystem* jobSystem)
+{
+	if (needsBuild)
+	{
+		build();
+	}
+
+	std::vector<SystemJob> jobs(systems.size());
+	for (size_t stage = 0; stage + 1 < stageStarts.size(); stage++)
+	{
+		uint32_t begin = stageStarts[stage];
+		uint32_t end = stageStarts[stage + 1];
+
+		// Lone systems run right here, they can still split their own work across the job system
+		if (!jobSystem || end - begin == 1)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				const System& system = systems[stageOrder[i]];
+				system.function(world, system.data);
+			}
+			continue;
+		}
+
+		JobSystem::Counter counter(0);
+		for (uint32_t i = begin; i < end; i++)
+		{
+			jobs[i].system = &systems[stageOrder[i]];
+			jobs[i].world = &world;
+			jobSystem->run(runSystemJob, &jobs[i], &counter);
+		}
+		jobSystem->wait(&counter);
+	}
+}
+
+uint32_t SystemScheduler::getStageCount()
+{
+	if (needsBuild)
+	{
+		build();
+	}
+	return stageStarts.empty() ? 0 : (uint32_t)stageStarts.size() - 1;
+}
+
+void SystemScheduler::printSchedule()
+{
+	uint32_t stageCount = getStageCount();
+	for (uint32_t stage = 0; stage < stageCount; stage++)
+	{
+		printf("  stage %u:", stage);
+		for (uint32_t i = stageStarts[stage]; i < stageStarts[stage + 1]; i++)
+		{
+			printf(" %s", systems[stageOrder[i]].name);
+		}
+		printf("\n");
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "EntityWorld.h"
+#include "JobSystem.h"
+
+#include <vector>
+
+typedef void (*SystemFunction)(EntityWorld& world, void* data);
+
+// Runs systems over an EntityWorld, in parallel where their component accesses allow it.
+// Every system declares the components it reads and writes. Two systems conflict when one
+// writes something the other reads or writes; a system runs after every earlier system it
+// conflicts with and alongside the ones it doesn't, so the result is the same as running
+// them one by one in the order they were added.
+//
+// Systems are grouped into stages: a stage only holds systems that don't conflict with each
+// other, the stages run one after the other and the systems of a stage run as parallel jobs.
+// NOTE Systems can't make structural changes (create/destroy entities, add/remove components)
+class SystemScheduler
+{
+public:
+	struct System
+	{
+		const char* name;
+		SystemFunction function;
+		void* data;
+		ComponentMask reads;
+		ComponentMask writes;
+	};
+
+private:
+	std::vector<System> systems;
+	std::vector<uint32_t> stageOrder;	// system indices sorted by stage
+	std::vector<uint32_t> stageStarts;	// first entry of every stage in stageOrder, plus one past the end
+	bool needsBuild;
+
+	static bool conflicts(const System& a, const System& b);
+	void build();
+
+public:
+	SystemScheduler();
+
+	// name must be a string literal
+	void addSystem(const char* name, ComponentMask reads, ComponentMask writes, SystemFunction function, void* data);
+
+	// Runs every system once, all on the calling thread without a job system
+	void run(EntityWorld& world, JobSystem* jobSystem);
+
+	uint32_t getStageCount();
+	void printSchedule();
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+// OpenGL texture object and the size it was created with, lives in a Pool<Texture>
+struct Texture
+{
+	unsigned int Id;
+	int width;
+	int height;
+};
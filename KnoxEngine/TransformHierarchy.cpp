@@ -0,0 +1,265 @@
+#include "TransformHierarchy.h"
+
+#include <chrono>
+#include <atomic>
+#include <cstring>
+
+static double millisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+TransformHierarchy::TransformHierarchy(uint32_t expectedCount) : needsSort(false), needsLevels(false)
+{
+	positions.reserve(expectedCount);
+	rotations.reserve(expectedCount);
+	scales.reserve(expectedCount);
+	parents.reserve(expectedCount);
+	depths.reserve(expectedCount);
+	ids.reserve(expectedCount);
+	worldMatrices.reserve(expectedCount);
+	dirty.reserve(expectedCount);
+	changed.reserve(expectedCount);
+	idToIndex.reserve(expectedCount);
+	stats = Stats();
+}
+
+TransformId TransformHierarchy::create(TransformId parent, const vec3& position, const quat& rotation, const vec3& scale)
+{
+	TransformId id = (TransformId)idToIndex.size();
+	uint32_t index = (uint32_t)ids.size();
+	uint32_t parentIndex = parent == NoParent ? NoParent : idToIndex[parent];
+	uint32_t depth = parent == NoParent ? 0 : depths[parentIndex] + 1;
+
+	// NOTE Appending keeps the arrays sorted as long as the new node is at least as deep as the last one
+	if (index > 0 && depth < depths[index - 1])
+	{
+		needsSort = true;
+	}
+	needsLevels = true;
+
+	if (levelDirtyCounts.size() <= depth)
+	{
+		levelDirtyCounts.resize(depth + 1, 0);
+	}
+	levelDirtyCounts[depth]++;
+
+	positions.push_back(position);
+	rotations.push_back(rotation);
+	scales.push_back(scale);
+	parents.push_back(parentIndex);
+	depths.push_back(depth);
+	ids.push_back(id);
+	worldMatrices.push_back(mat4::identity());
+	dirty.push_back(1);
+	changed.push_back(0);
+	idToIndex.push_back(index);
+	return id;
+}
+
+void TransformHierarchy::markDirty(uint32_t index)
+{
+	if (!dirty[index])
+	{
+		dirty[index] = 1;
+		levelDirtyCounts[depths[index]]++;
+	}
+}
+
+void TransformHierarchy::setLocal(TransformId id, const vec3& position, const quat& rotation, const vec3& scale)
+{
+	uint32_t index = idToIndex[id];
+	positions[index] = position;
+	rotations[index] = rotation;
+	scales[index] = scale;
+	markDirty(index);
+}
+
+void TransformHierarchy::setPosition(TransformId id, const vec3& position)
+{
+	uint32_t index = idToIndex[id];
+	positions[index] = position;
+	markDirty(index);
+}
+
+void TransformHierarchy::setRotation(TransformId id, const quat& rotation)
+{
+	uint32_t index = idToIndex[id];
+	rotations[index] = rotation;
+	markDirty(index);
+}
+
+void TransformHierarchy::sort()
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	uint32_t count = (uint32_t)ids.size();
+
+	// Counting sort by depth, stable so siblings keep their order
+	uint32_t levelCount = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		levelCount = depths[i] + 1 > levelCount ? depths[i] + 1 : levelCount;
+	}
+
+	std::vector<uint32_t> levelOffsets(levelCount + 1, 0);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		levelOffsets[depths[i] + 1]++;
+	}
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		levelOffsets[level + 1] += levelOffsets[level];
+	}
+
+	std::vector<uint32_t> newIndices(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		newIndices[i] = levelOffsets[depths[i]]++;
+	}
+
+	// Scatter every array into its new order
+	std::vector<vec3> sortedPositions(count), sortedScales(count);
+	std::vector<quat> sortedRotations(count);
+	std::vector<uint32_t> sortedParents(count), sortedDepths(count);
+	std::vector<TransformId> sortedIds(count);
+	std::vector<mat4> sortedWorldMatrices(count);
+	std::vector<uint8_t> sortedDirty(count), sortedChanged(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t destination = newIndices[i];
+		sortedPositions[destination] = positions[i];
+		sortedRotations[destination] = rotations[i];
+		sortedScales[destination] = scales[i];
+		sortedParents[destination] = parents[i] == NoParent ? NoParent : newIndices[parents[i]];
+		sortedDepths[destination] = depths[i];
+		sortedIds[destination] = ids[i];
+		sortedWorldMatrices[destination] = worldMatrices[i];
+		sortedDirty[destination] = dirty[i];
+		sortedChanged[destination] = changed[i];
+		idToIndex[ids[i]] = destination;
+	}
+
+	positions.swap(sortedPositions);
+	rotations.swap(sortedRotations);
+	scales.swap(sortedScales);
+	parents.swap(sortedParents);
+	depths.swap(sortedDepths);
+	ids.swap(sortedIds);
+	worldMatrices.swap(sortedWorldMatrices);
+	dirty.swap(sortedDirty);
+	changed.swap(sortedChanged);
+
+	needsSort = false;
+	stats.sortMilliseconds = millisecondsSince(start);
+}
+
+uint32_t TransformHierarchy::updateRange(uint32_t begin, uint32_t end)
+{
+	uint32_t updatedCount = 0;
+	for (uint32_t i = begin; i < end; i++)
+	{
+		uint32_t parent = parents[i];
+
+		// NOTE The parent's level is already done, so its changed flag is final
+		bool recompute = dirty[i] || (parent != NoParent && changed[parent]);
+		changed[i] = recompute;
+		if (!recompute)
+		{
+			continue;
+		}
+
+		dirty[i] = 0;
+		mat4 local = composeTransform(positions[i], rotations[i], scales[i]);
+		worldMatrices[i] = parent == NoParent ? local : multiply(worldMatrices[parent], local);
+		updatedCount++;
+	}
+	return updatedCount;
+}
+
+void TransformHierarchy::buildLevels()
+{
+	// The arrays are sorted by depth so this is one linear scan
+	uint32_t count = (uint32_t)ids.size();
+	levelStarts.clear();
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (i == 0 || depths[i] != depths[i - 1])
+		{
+			levelStarts.push_back(i);
+		}
+	}
+	levelStarts.push_back(count);
+
+	levelChangedCounts.assign(levelStarts.size() - 1, 1);
+	needsLevels = false;
+}
+
+void TransformHierarchy::update(JobSystem* jobSystem)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	stats.sortMilliseconds = 0.0;
+
+	// NOTE Without nodes there are no levels, not even the end sentinel
+	if (ids.empty())
+	{
+		stats.updatedCount = 0;
+		stats.levelCount = 0;
+		stats.updateMilliseconds = millisecondsSince(start);
+		return;
+	}
+
+	if (needsSort)
+	{
+		sort();
+	}
+	if (needsLevels)
+	{
+		buildLevels();
+	}
+
+	uint32_t levelCount = (uint32_t)levelStarts.size() - 1;
+	uint32_t updatedCount = 0;
+	bool parentLevelChanged = false;
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		uint32_t begin = levelStarts[level];
+		uint32_t end = levelStarts[level + 1];
+
+		if (!parentLevelChanged && levelDirtyCounts[level] == 0)
+		{
+			// Nothing to recompute, only the flags of the last update have to go
+			if (levelChangedCounts[level] > 0)
+			{
+				memset(&changed[begin], 0, end - begin);
+				levelChangedCounts[level] = 0;
+			}
+			continue;
+		}
+
+		uint32_t levelUpdatedCount = 0;
+
+		// Small levels aren't worth the scheduling
+		if (!jobSystem || end - begin <= UpdateBatchSize)
+		{
+			levelUpdatedCount = updateRange(begin, end);
+		}
+		else
+		{
+			std::atomic<uint32_t> batchUpdatedCount(0);
+			jobSystem->parallelFor(end - begin, UpdateBatchSize, [this, begin, &batchUpdatedCount](uint32_t batchBegin, uint32_t batchEnd)
+			{
+				batchUpdatedCount += updateRange(begin + batchBegin, begin + batchEnd);
+			});
+			levelUpdatedCount = batchUpdatedCount;
+		}
+
+		levelDirtyCounts[level] = 0;
+		levelChangedCounts[level] = levelUpdatedCount;
+		parentLevelChanged = levelUpdatedCount > 0;
+		updatedCount += levelUpdatedCount;
+	}
+
+	stats.updatedCount = updatedCount;
+	stats.levelCount = levelCount;
+	stats.updateMilliseconds = millisecondsSince(start);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "MathTypes.h"
+#include "JobSystem.h"
+
+#include <vector>
+#include <cstdint>
+
+typedef uint32_t TransformId;
+
+// Parent/child transforms stored as parallel arrays (structure of arrays), sorted by depth:
+// all roots first, then all their children, and so on. Every parent comes before its
+// children, so world matrices are computed in one pass, one level at a time, and every
+// node of a level can be processed in parallel since they only read the level above.
+//
+// Only what changed gets recomputed: setLocal marks a node dirty, and during update a node
+// is recomputed if it or any of its ancestors was dirty.
+//
+// NOTE Ids stay the same when the arrays get re-sorted, indices don't
+class TransformHierarchy
+{
+public:
+	static const TransformId NoParent = 0xFFFFFFFF;
+
+	struct Stats
+	{
+		uint32_t updatedCount;	// world matrices recomputed by the last update
+		uint32_t levelCount;
+		double sortMilliseconds;
+		double updateMilliseconds;
+	};
+
+private:
+	static const uint32_t UpdateBatchSize = 2048;
+
+	// Local transform, sorted by depth
+	std::vector<vec3> positions;
+	std::vector<quat> rotations;
+	std::vector<vec3> scales;
+
+	// Hierarchy, sorted by depth
+	std::vector<uint32_t> parents;	// index of the parent, NoParent for roots
+	std::vector<uint32_t> depths;
+	std::vector<TransformId> ids;
+
+	// Results, sorted by depth
+	std::vector<mat4> worldMatrices;
+	std::vector<uint8_t> dirty;	// local transform changed since the last update
+	std::vector<uint8_t> changed;	// world matrix was recomputed by the last update
+
+	std::vector<uint32_t> idToIndex;
+
+	// Per level, so clean levels below clean levels are skipped without touching their nodes
+	std::vector<uint32_t> levelStarts;	// first index of every level, plus one past the end
+	std::vector<uint32_t> levelDirtyCounts;
+	std::vector<uint32_t> levelChangedCounts;	// from the last update
+	bool needsSort;
+	bool needsLevels;
+
+	Stats stats;
+
+	void sort();
+	void buildLevels();
+	void markDirty(uint32_t index);
+	uint32_t updateRange(uint32_t begin, uint32_t end);
+
+public:
+	TransformHierarchy(uint32_t expectedCount = 0);
+
+	// parent has to exist already, NoParent makes a root
+	TransformId create(TransformId parent, const vec3& position, const quat& rotation, const vec3& scale);
+
+	void setLocal(TransformId id, const vec3& position, const quat& rotation, const vec3& scale);
+	void setPosition(TransformId id, const vec3& position);
+	void setRotation(TransformId id, const quat& rotation);
+
+	// Recomputes the world matrices of dirty nodes and their descendants,
+	// levels are split across the job system when one is given
+	void update(JobSystem* jobSystem = NULL);
+
+	// Valid after update
+	const mat4& getWorld(TransformId id) const { return worldMatrices[idToIndex[id]]; }
+	bool hasChanged(TransformId id) const { return changed[idToIndex[id]] != 0; }
+
+	uint32_t size() const { return (uint32_t)ids.size(); }
+	Stats getStats() const { return stats; }
+};
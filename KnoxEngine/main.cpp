@@ -2,105 +2,314 @@
 #include <GLFW/glfw3.h>
 
 #include "Shader.h"
+#include "GLExtensions.h"
+#include "BufferArena.h"
+#include "RenderQueue.h"
+#include "InstanceBatcher.h"
+#include "RenderThread.h"
+#include "JobSystem.h"
+#include "Benchmarks.h"
+#include "Pool.h"
+#include "Texture.h"
+#include "MemoryTracker.h"
+#include "EntityWorld.h"
+#include "Components.h"
+#include "FrustumCulling.h"
+#include "OcclusionCuller.h"
+#include "SoftwareRenderer.h"
+#include "HeadlessContext.h"
+#include "Framebuffer.h"
+#include "ImageFile.h"
+#include "FrameBenchmark.h"
+#include "CpuProfiler.h"
+#include "Counters.h"
+#include "GLTrace.h"
+#include "ImageRegression.h"
+#include "FrameLimiter.h"
 #include "resources/utils/stb_image.h"
 
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <cmath>
+#include <algorithm>
 
 void framebufferSizeCallback(GLFWwindow *window, int width, int height);
 void processInput(GLFWwindow *window);
+const char* getArgumentValue(int argc, char** argv, const char* argumentName);
+bool hasArgument(int argc, char** argv, const char* argumentName);
+double getSeconds();
 
-int main()
+struct TextureDecodeJob
+{
+	const char* filePath;
+	int width, height, nrChannels;
+	unsigned char* data;
+};
+static const int SceneTextureCount = 2;
+void decodeTexture(void* data);
+void decodeSceneTextures(JobSystem& jobSystem, TextureDecodeJob* textureDecodes);
+int renderSoftware(int frameCount, const char* outputPath);
+
+// NOTE Written by the resize callback on the main thread, the viewport itself is set by the render thread
+int framebufferWidth = 800;
+int framebufferHeight = 600;
+bool framebufferResized = false;
+
+// NOTE The scene is shared by the OpenGL and the software renderer
+float triangle_1[] = {
+	// positions		 	// colors				// texture coords
+	 0.5f,  0.5f, 0.0f,		1.0f, 0.0f, 0.0f,		1.0f, 0.0f,  // top right
+	 0.5f, -0.5f, 0.0f,		0.0f, 1.0f, 0.0f,		1.0f, 1.0f,  // bottom right
+	-0.5f, -0.5f, 0.0f,		0.0f, 0.0f, 1.0f,		0.0f, 1.0f,  // bottom left
+	-0.5f,  0.5f, 0.0f,		1.0f, 1.0f, 1.0f,		0.0f, 0.0f   // top left
+};
+
+unsigned int indices[] = {
+	0, 1, 3, // first triangle
+	1, 2, 3  // second triangle
+};
+
+int main(int argc, char** argv)
 {
 	////////////////////////////////////
 	//
-	// GLFW and GLAD setup
+	// Benchmarks that don't need an OpenGL context
 	//
-	glfwInit();
-	
-	// Setup to target the OpenGL version 3.3 core-profile
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3); 
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3); 
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-	GLFWwindow *window = glfwCreateWindow(800, 600, "Knox Engine", NULL, NULL);
-	if (!window)
+	const char* benchmarkName = getArgumentValue(argc, argv, "--bench");
+	if (benchmarkName && runCpuBenchmark(benchmarkName))
 	{
-		printf("Failed to create GLFW windows\n");
-		glfwTerminate();
-		return -1;
+		return 0;
 	}
-	glfwMakeContextCurrent(window);
 
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	const char* widthArgument = getArgumentValue(argc, argv, "--width");
+	const char* heightArgument = getArgumentValue(argc, argv, "--height");
+	if (widthArgument && heightArgument && atoi(widthArgument) > 0 && atoi(heightArgument) > 0)
 	{
-		printf("Failed to initialize GLAD\n");
-		return -1;
+		framebufferWidth = atoi(widthArgument);
+		framebufferHeight = atoi(heightArgument);
 	}
+	const char* outputPath = getArgumentValue(argc, argv, "--output");
 
-	glViewport(0, 0, 800, 600);
-	glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
-
+	////////////////////////////////////
+	//
+	// Same scene rendered on the CPU, for machines without a GPU
+	//
+	const char* softwareFrames = getArgumentValue(argc, argv, "--software");
+	if (softwareFrames)
+	{
+		return renderSoftware(atoi(softwareFrames), outputPath);
+	}
 
 	////////////////////////////////////
 	//
-	// Vertex (and buffers) setup and configuration
+	// GLFW and GLAD setup
 	//
-	float triangle_1[] = {
-		// positions		 	// colors				// texture coords
-		 0.5f,  0.5f, 0.0f,		1.0f, 0.0f, 0.0f,		1.0f, 0.0f,  // top right
-		 0.5f, -0.5f, 0.0f,		0.0f, 1.0f, 0.0f,		1.0f, 1.0f,  // bottom right
-		-0.5f, -0.5f, 0.0f,		0.0f, 0.0f, 1.0f,		0.0f, 1.0f,  // bottom left
-		-0.5f,  0.5f, 0.0f,		1.0f, 1.0f, 1.0f,		0.0f, 0.0f   // top left
-	};
+	// NOTE With --headless <frames> there's no window: the context comes from EGL or OSMesa and the
+	// scene is rendered into a framebuffer object for that many frames, on machines without a display
+	const char* headlessFrames = getArgumentValue(argc, argv, "--headless");
+	HeadlessContext headlessContext;
+	GLFWwindow* window = NULL;
+	GLADloadproc getProcAddress = (GLADloadproc)glfwGetProcAddress;
+
+	if (headlessFrames)
+	{
+		if (!headlessContext.create(3, 3))
+		{
+			return -1;
+		}
+		headlessContext.makeCurrent();
+		getProcAddress = (GLADloadproc)HeadlessContext::getProcAddress;
+	}
+	else
+	{
+		glfwInit();
+
+		// Setup to target the OpenGL version 3.3 core-profile
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+		window = glfwCreateWindow(framebufferWidth, framebufferHeight, "Knox Engine", NULL, NULL);
+		if (!window)
+		{
+			printf("Failed to create GLFW windows\n");
+			glfwTerminate();
+			return -1;
+		}
+		glfwMakeContextCurrent(window);
+	}
 
-    unsigned int indices[] = {  
-        0, 1, 3, // first triangle
-        1, 2, 3  // second triangle
-    };
+	if (!gladLoadGLLoader(getProcAddress))
+	{
+		printf("Failed to initialize GLAD\n");
+		return -1;
+	}
+	loadGLExtensions(getProcAddress);
 
-	unsigned int VAO[1], VBO[1], EBO;
-	glGenVertexArrays(1, VAO);
-	glGenBuffers(1, VBO);
-	glGenBuffers(1, &EBO);
+	if (benchmarkName)
+	{
+		bool benchmarkFound = runGpuBenchmark(benchmarkName);
+		if (!benchmarkFound)
+		{
+			printf("ERROR: Unknown benchmark %s\n", benchmarkName);
+		}
+		if (headlessFrames)
+		{
+			headlessContext.destroy();
+		}
+		else
+		{
+			glfwTerminate();
+		}
+		return benchmarkFound ? 0 : -1;
+	}
 
-	glBindVertexArray(VAO[0]);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO[0]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(triangle_1), triangle_1, GL_STATIC_DRAW);
+	// NOTE --image-regression <directory> renders the reference scenes and compares them with the goldens
+	// of the directory, --update-golden writes them instead. The results go to --report <file> as JSON
+	const char* regressionDirectory = getArgumentValue(argc, argv, "--image-regression");
+	if (regressionDirectory)
+	{
+		bool regressionPassed = runImageRegression(regressionDirectory, hasArgument(argc, argv, "--update-golden"),
+			getArgumentValue(argc, argv, "--report"));
+		if (headlessFrames)
+		{
+			headlessContext.destroy();
+		}
+		else
+		{
+			glfwTerminate();
+		}
+		return regressionPassed ? 0 : -1;
+	}
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+	// NOTE --replay <trace> runs a trace written with --capture and prints its timings, the last frame
+	// goes to --output. Use it with --headless 1 on machines without a display
+	const char* replayPath = getArgumentValue(argc, argv, "--replay");
+	if (replayPath)
+	{
+		Framebuffer replayTarget;
+		GLReplayStats replayStats;
+		bool replayed = replayGLTrace(replayPath, replayTarget, replayStats);
+		if (replayed)
+		{
+			FrameBenchmark::Summary submit = FrameBenchmark::summarize(replayStats.submitMilliseconds);
+			FrameBenchmark::Summary frame = FrameBenchmark::summarize(replayStats.frameMilliseconds);
+			printf("Replayed %s on %s: %u frames, %llu calls, %.1f ms setup\n", replayPath, (const char*)glGetString(GL_RENDERER),
+				replayStats.frames, (unsigned long long)replayStats.calls, replayStats.setupMilliseconds);
+			printf("Submit: %.3f ms average, %.3f ms p50, %.3f ms p95, %.3f ms max\n", submit.average, submit.p50, submit.p95, submit.max);
+			printf("Frame: %.3f ms average, %.3f ms p50, %.3f ms p95, %.3f ms max\n", frame.average, frame.p50, frame.p95, frame.max);
+
+			if (outputPath)
+			{
+				std::vector<unsigned char> pixels;
+				replayTarget.readPixels(pixels);
+				writePpm(outputPath, pixels.data(), replayTarget.getWidth(), replayTarget.getHeight(), true);
+			}
+		}
+		replayTarget.destroy();
+		if (headlessFrames)
+		{
+			headlessContext.destroy();
+		}
+		else
+		{
+			glfwTerminate();
+		}
+		return replayed ? 0 : -1;
+	}
 
-	// 3 floats for position + 3 floats for colors + 2 floats for texture coords
-	GLsizei vertexStride = sizeof(float) * 8; 
-	
-	// NOTE Vertex attribute al (location = 0) => vertex position
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, vertexStride, (void *)0);
-	glEnableVertexAttribArray(0);
+	// NOTE With --frame-benchmark <frames> the scene runs scripted with a fixed timestep and no vsync,
+	// the frame times go to a summary and to a JSON report with --report <file>
+	const char* benchmarkFrames = getArgumentValue(argc, argv, "--frame-benchmark");
+	const char* reportPath = getArgumentValue(argc, argv, "--report");
+	const int benchmarkWarmupFrames = 10;
+	const double benchmarkTimestep = 1.0 / 60.0;
+	const int benchmarkExtraQuads = 15;
+	std::string rendererName = (const char*)glGetString(GL_RENDERER);
+
+	// NOTE With --gpu-profile <file> the passes of every frame are timed on the GPU, the averages are
+	// printed at the end and the timeline is written as a Chrome trace
+	const char* gpuProfilePath = getArgumentValue(argc, argv, "--gpu-profile");
+
+	// NOTE With --cpu-profile <file> the zones of the main and render threads are captured
+	// and written as a Chrome trace, with a frame marker at every swap
+	const char* cpuProfilePath = getArgumentValue(argc, argv, "--cpu-profile");
+
+	// NOTE --overlay draws the per-frame counters on screen, --counters <file> streams them as CSV
+	bool statsOverlay = hasArgument(argc, argv, "--overlay");
+	const char* countersPath = getArgumentValue(argc, argv, "--counters");
+
+	// NOTE --fps <rate> paces the main loop. --late-input polls events right before the input-dependent
+	// part of a frame is recorded, instead of at the end of the previous frame, and --input-latency
+	// prints the distribution of the time from polling to the swap of the frame that used the input
+	const char* frameRateArgument = getArgumentValue(argc, argv, "--fps");
+	bool lateInput = hasArgument(argc, argv, "--late-input");
+	bool inputLatencyReport = hasArgument(argc, argv, "--input-latency");
+
+	if (benchmarkFrames && window)
+	{
+		glfwSwapInterval(0);
+	}
 
-	// NOTE Vertex attribute al (location = 1) => vertex color
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, vertexStride, (void *)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
+	Framebuffer headlessFramebuffer;
+	if (headlessFrames)
+	{
+		if (!headlessFramebuffer.create(framebufferWidth, framebufferHeight))
+		{
+			headlessContext.destroy();
+			return -1;
+		}
+		printf("Headless %s context: %s, %dx%d\n", headlessContext.getBackendName(), rendererName.c_str(), framebufferWidth, framebufferHeight);
+	}
+	else
+	{
+		glViewport(0, 0, framebufferWidth, framebufferHeight);
+		glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
+	}
 
-	// NOTE Vertex attribute al (location = 2) => texture coords
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, vertexStride, (void *)(6 * sizeof(float)));
-	glEnableVertexAttribArray(2);
+	// NOTE With --capture <trace> every OpenGL call from here on goes into a trace for --replay
+	const char* capturePath = getArgumentValue(argc, argv, "--capture");
+	if (capturePath && !beginGLCapture(capturePath, framebufferWidth, framebufferHeight, headlessFrames ? headlessFramebuffer.Id : 0))
+	{
+		capturePath = NULL;
+	}
 
-	
-	// Unbinding VBO, the call to glVertexAttribPointer register the VBO as 
-	// the vertex attribute's bound vertex buffer object
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	
-	// We DON'T unbind the EBO while the VAO is active because the EBO is stored in the VAO
-	//glBindVertexArray(GL_ELEMENT_ARRAY_BUFFER, 0);
 
-	// We can unbind the VBO so other calls don't accidentally modify it
-	glBindVertexArray(0);
+	////////////////////////////////////
+	//
+	// Vertex (and buffers) setup and configuration
+	//
+	// NOTE All meshes share the VBO/EBO/VAO of the arena, each mesh just owns a range inside of them
+	BufferArena bufferArena(1024 * 1024, 4 * 1024 * 1024);
+
+	// NOTE Resources are referenced by handles into their pools instead of pointers or raw GL ids,
+	// a handle to something that was destroyed just fails to resolve
+	Pool<MeshRange> meshes(1024, "Resources", "Mesh");
+	Pool<Texture> textures(64, "Resources", "Texture");
+	Pool<Shader> shaders(16, "Resources", "Shader");
+
+	MeshRange quad;
+	if (bufferArena.allocate(4, 6, quad))
+	{
+		bufferArena.upload(quad, triangle_1, indices);
+	}
+	Handle<MeshRange> quadMesh = meshes.create(quad);
 
 
 	////////////////////////////////////
 	//
 	// LOAD TEXTURE
 	//
+	JobSystem jobSystem;
+
+	// NOTE Decoding runs on the job system, only the upload to OpenGL has to happen on this thread
+	TextureDecodeJob textureDecodes[SceneTextureCount];
+	decodeSceneTextures(jobSystem, textureDecodes);
+
 	unsigned int texture1, texture2;
 	glGenTextures(1, &texture1);
 	glBindTexture(GL_TEXTURE_2D, texture1);
@@ -110,9 +319,9 @@ int main()
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);	// Linear mipmap interpolation at texture downscale
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);	// Linear mipmap interpolation at texture upscale
 
-	int width, height, nrChannels;
-	const char *textureFilePath = "resources/textures/wood-container.jpg";
-	unsigned char *textureData = stbi_load(textureFilePath, &width, &height, &nrChannels, 0);
+	int width = textureDecodes[0].width, height = textureDecodes[0].height;
+	const char *textureFilePath = textureDecodes[0].filePath;
+	unsigned char *textureData = textureDecodes[0].data;
 
 	if (textureData)
 	{
@@ -136,6 +345,9 @@ int main()
 	// NOTE Texture is already loaded to OpenGL, so we can free this memory
 	stbi_image_free(textureData);
 
+	Texture woodTexture = { texture1, width, height };
+	Handle<Texture> woodTextureHandle = textures.create(woodTexture);
+
 
 	glGenTextures(1, &texture2);
 	glBindTexture(GL_TEXTURE_2D, texture2);
@@ -145,8 +357,10 @@ int main()
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);	// Linear mipmap interpolation at texture downscale
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);	// Linear mipmap interpolation at texture upscale
 
-	textureFilePath = "resources/textures/awesomeface.png";
-	textureData = stbi_load(textureFilePath, &width, &height, &nrChannels, 0);
+	width = textureDecodes[1].width;
+	height = textureDecodes[1].height;
+	textureFilePath = textureDecodes[1].filePath;
+	textureData = textureDecodes[1].data;
 
 	if (textureData)
 	{
@@ -170,73 +384,385 @@ int main()
 	// NOTE Texture is already loaded to OpenGL, so we can free this memory
 	stbi_image_free(textureData);
 
+	Texture faceTexture = { texture2, width, height };
+	Handle<Texture> faceTextureHandle = textures.create(faceTexture);
+
 
 
 	////////////////////////////////////////
 	//
 	// RENDER LOOP
 	//
-	Shader shader("resources/shaders/VertexShader.txt", "resources/shaders/FragmentShader.txt");
+	Handle<Shader> shaderHandle = shaders.create("resources/shaders/VertexShader.txt", "resources/shaders/FragmentShader.txt");
+	Shader& shader = *shaders.get(shaderHandle);
 
 	// NOTE We have to activate the shader before setting uniforms
 	glUseProgram(shader.Id);
 	shader.setInt("texture1", 0);
 	shader.setInt("texture2", 1);
+	InstanceBatcher::setDefaultTransform();
+
+	// NOTE Draws keep the handles, the render thread resolves them when it replays the frame
+	DrawRequest quadDraw;
+	quadDraw.shader = shaderHandle;
+	quadDraw.textures[0] = woodTextureHandle;
+	quadDraw.textures[1] = faceTextureHandle;
+	quadDraw.mesh = quadMesh;
+	quadDraw.materialId = 0;
+
+	// NOTE The scene is a set of entities, the render loop draws whatever has a Renderable
+	EntityWorld world(1024);
+	Entity quadEntity = world.createEntity();
+	Renderable quadRenderable = { quadDraw, 0.5f, false };
+	world.addComponent(quadEntity, quadRenderable);
+	Bounds quadBounds = { vec3(0.0f), vec3(0.5f, 0.5f, 0.0f) };
+	world.addComponent(quadEntity, quadBounds);
+	Occluder quadOccluder = { triangle_1, 8, indices, 6 };
+	world.addComponent(quadEntity, quadOccluder);
+	if (benchmarkFrames)
+	{
+		// More of the same quad, at different depths so the render queue has something to sort
+		for (int i = 0; i < benchmarkExtraQuads; i++)
+		{
+			Entity entity = world.createEntity();
+			Renderable renderable = { quadDraw, (float)i / benchmarkExtraQuads, false };
+			world.addComponent(entity, renderable);
+			world.addComponent(entity, quadBounds);
+		}
+	}
+	Query renderables(componentMask<Renderable, Bounds>());
+	Query occluders(componentMask<Occluder>());
+
+	// NOTE There's no camera yet, vertex positions are already clip space so the view is the clip cube
+	mat4 viewProjection = mat4::identity();
+	Frustum viewFrustum = extractFrustum(viewProjection);
+	OcclusionCuller occlusionCuller(256, 128);
+	BoxBuffer cullingBoxes;
+	std::vector<const Renderable*> cullingItems;
+	std::vector<uint32_t> visibleIndices;
 
 	// Uncomment to draw wireframes
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-	double currentTime = glfwGetTime();
+	// From here on the render thread owns the OpenGL context, the main thread only
+	// handles input and simulation and records what to draw into a CommandList
+	RenderThread renderThread;
+	RenderResources renderResources = { &shaders, &textures, &meshes, &bufferArena };
+	renderThread.setResources(renderResources);
+	if (benchmarkFrames || inputLatencyReport)
+	{
+		renderThread.enableFrameTimings();
+	}
+	if (gpuProfilePath)
+	{
+		renderThread.enableGpuProfiler();
+	}
+	if (statsOverlay)
+	{
+		renderThread.enableStatsOverlay();
+	}
+	if (countersPath)
+	{
+		openCounterCsv(countersPath);
+	}
+	if (headlessFrames)
+	{
+		headlessContext.releaseCurrent();
+		renderThread.start(&headlessContext);
+	}
+	else
+	{
+		glfwMakeContextCurrent(NULL);
+		renderThread.start(window);
+	}
+
+	// Headless and benchmark runs stop after a number of frames, a window runs until it's closed
+	int lastFrame = headlessFrames ? std::max(atoi(headlessFrames), 1) : 0;
+	if (benchmarkFrames)
+	{
+		lastFrame = benchmarkWarmupFrames + atoi(benchmarkFrames);
+	}
+
+	FrameBenchmark::Settings benchmarkSettings = { "quad", rendererName, framebufferWidth, framebufferHeight,
+		benchmarkWarmupFrames, benchmarkTimestep, false, headlessFrames != NULL };
+	FrameBenchmark frameBenchmark(benchmarkSettings);
+
+	CpuProfiler::setThreadName("Main");
+	if (cpuProfilePath)
+	{
+		CpuProfiler::start();
+	}
+
+	FrameLimiter frameLimiter(frameRateArgument ? atof(frameRateArgument) : 0.0);
+
+	double startTime = getSeconds();
+	double currentTime = startTime;
 	double deltaTime = 0.0f;
+	double simulationTime = 0.0;
 	double counter = 0.0f;
 	int frameCount = 1;
-	while (!glfwWindowShouldClose(window))
+	while ((lastFrame == 0 || frameCount <= lastFrame) && (!window || !glfwWindowShouldClose(window)))
 	{
-		deltaTime = glfwGetTime() - currentTime;
-		currentTime = glfwGetTime();
-		processInput(window);
+		if (frameLimiter.isEnabled())
+		{
+			CpuZone zone("Frame limiter");
+			frameLimiter.wait();
+		}
+
+		double frameStart = getSeconds();
+		deltaTime = benchmarkFrames ? benchmarkTimestep : frameStart - currentTime;
+		currentTime = frameStart;
+		simulationTime += deltaTime;
+		if (window && !lateInput)
+		{
+			CpuZone zone("Input");
+			processInput(window);
+		}
+
+		CommandList& commandList = renderThread.beginFrame();
+		CpuZone recordZone("Record");
+
+		if (framebufferResized)
+		{
+			commandList.setViewport(0, 0, framebufferWidth, framebufferHeight);
+			framebufferResized = false;
+		}
 
 		// Render
-		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
+		commandList.clear(0.2f, 0.3f, 0.3f, 1.0f, GL_COLOR_BUFFER_BIT);
 
 		
 		//float colorValue = ((std::sin(counter += deltaTime * 10.0f) / 4.0f)) + 0.5f;
 		//int colorLocation = glGetUniformLocation(shaderProgram, "color");
 		//glUniform4f(colorLocation, 0.0f, colorValue, 0.0f, 1.0f);
-		
-		shader.setInt("frameCount", frameCount);
-		shader.setFloat("mixValue", 0.5f);
-		glUseProgram(shader.Id);
 
-		// NOTE GL_TEXTURE0 is activated by default, 
-		// so if there is only ONE texture, there is no need to actiavte it manually
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, texture1);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, texture2);
+		// Only the renderables that intersect the view get a draw
+		CpuZone cullingZone("Culling");
+		cullingBoxes.clear();
+		cullingItems.clear();
+		world.forEachChunk(renderables, [&cullingBoxes, &cullingItems](const ChunkView& chunk)
+		{
+			const Renderable* items = chunk.get<Renderable>();
+			const Bounds* bounds = chunk.get<Bounds>();
+			for (uint32_t i = 0; i < chunk.count; i++)
+			{
+				cullingBoxes.add(bounds[i].center, bounds[i].extents);
+				cullingItems.push_back(&items[i]);
+			}
+		});
+		visibleIndices.resize(cullingBoxes.size());
+		uint32_t visibleCount = cullBoxesParallel(jobSystem, viewFrustum, cullingBoxes.getBoxes(), cullingBoxes.size(), visibleIndices.data());
+
+		cullingZone.end();
+
+		// Then the ones hidden behind occluders, tested against a depth buffer rasterized on the CPU
+		CpuZone occlusionZone("Occlusion");
+		occlusionCuller.beginFrame(viewProjection);
+		world.forEachChunk(occluders, [&occlusionCuller](const ChunkView& chunk)
+		{
+			const Occluder* items = chunk.get<Occluder>();
+			for (uint32_t i = 0; i < chunk.count; i++)
+			{
+				occlusionCuller.drawOccluder(mat4::identity(), items[i].vertices, items[i].stride, items[i].indices, items[i].indexCount);
+			}
+		});
+		occlusionCuller.buildHierarchy();
+		visibleCount = occlusionCuller.filterVisible(cullingBoxes.getBoxes(), visibleIndices.data(), visibleCount);
+		occlusionZone.end();
+
+		// NOTE With late input sampling the events are polled here, after the work that doesn't depend on
+		// input and right before the state that does is recorded and submitted
+		if (lateInput)
+		{
+			CpuZone zone("Input");
+			if (window)
+			{
+				glfwPollEvents();
+				processInput(window);
+			}
+			renderThread.markInputSampled();
+		}
+
+		CpuZone uniformsZone("Uniforms");
+		commandList.setInt(shaderHandle, "frameCount", frameCount);
+		// NOTE The benchmark script only depends on the simulation time, so every run draws the same frames
+		float mixValue = benchmarkFrames ? 0.5f + 0.5f * (float)std::sin(simulationTime) : 0.5f;
+		commandList.setFloat(shaderHandle, "mixValue", mixValue);
+		uniformsZone.end();
+
+		// NOTE The render queue binds the program, textures and VAO only when they change between draws
+		CpuZone drawsZone("Draws");
+		commandList.beginGpuZone("Scene");
+		for (uint32_t i = 0; i < visibleCount; i++)
+		{
+			const Renderable& renderable = *cullingItems[visibleIndices[i]];
+			commandList.draw(renderable.request, renderable.depth, renderable.transparent);
+		}
+		commandList.endGpuZone();
+		drawsZone.end();
+		recordZone.end();
+
+		{
+			CpuZone zone("Submit");
+			renderThread.submitFrame();
+		}
+		if (!lateInput)
+		{
+			if (window)
+			{
+				CpuZone zone("Poll events");
+				glfwPollEvents();
+			}
+			renderThread.markInputSampled();
+		}
+
+		if (benchmarkFrames && frameCount > benchmarkWarmupFrames)
+		{
+			frameBenchmark.addCpuFrame((getSeconds() - frameStart) * 1000.0);
+		}
 
-		glBindVertexArray(VAO[0]);
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+		frameCount++;
+	}
 
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+	renderThread.stop();
+	if (cpuProfilePath)
+	{
+		CpuProfiler::stop();
+	}
+	if (countersPath)
+	{
+		closeCounterCsv();
+	}
+	double runMilliseconds = (getSeconds() - startTime) * 1000.0;
+	if (headlessFrames)
+	{
+		headlessContext.makeCurrent();
+		printf("Headless: %d frames in %.1f ms, %.1f frames/s\n", frameCount - 1, runMilliseconds, (frameCount - 1) * 1000.0 / runMilliseconds);
+
+		if (outputPath)
+		{
+			std::vector<unsigned char> pixels;
+			headlessFramebuffer.readPixels(pixels);
+			writePpm(outputPath, pixels.data(), headlessFramebuffer.getWidth(), headlessFramebuffer.getHeight(), true);
+		}
+	}
+	else
+	{
+		glfwMakeContextCurrent(window);
+	}
 
-		frameCount++;
+	if (benchmarkFrames)
+	{
+		frameBenchmark.setRenderTimings(renderThread.getFrameTimings());
+		frameBenchmark.printSummary();
+		if (reportPath)
+		{
+			frameBenchmark.writeJson(reportPath);
+		}
 	}
 
-	glDeleteVertexArrays(1, VAO);
-	glDeleteBuffers(1, VBO);
-	//glDeleteBuffers(1, &EBO);
-	glDeleteProgram(shader.Id);
+	if (inputLatencyReport)
+	{
+		std::vector<double> inputLatencies;
+		const std::vector<RenderThread::FrameTiming>& timings = renderThread.getFrameTimings();
+		for (size_t i = 0; i < timings.size(); i++)
+		{
+			inputLatencies.push_back(timings[i].inputLatencyMilliseconds);
+		}
+		FrameBenchmark::Summary latency = FrameBenchmark::summarize(inputLatencies);
+		printf("Input latency, %s input sampling, %u frames: min %.3f avg %.3f p50 %.3f p95 %.3f p99 %.3f max %.3f ms\n",
+			lateInput ? "late" : "end of frame", latency.count, latency.min, latency.average, latency.p50, latency.p95, latency.p99, latency.max);
+	}
+
+	if (frameLimiter.isEnabled())
+	{
+		FrameLimiter::Stats limiterStats = frameLimiter.getStats();
+		uint32_t limitedFrames = std::max(limiterStats.frames, 1u);
+		printf("Frame limiter: %.1f frames/s target, %u frames, %u late, %.3f ms/frame sleeping, %.3f ms/frame spinning, %.3f ms worst overshoot\n",
+			frameLimiter.getFrameRate(), limiterStats.frames, limiterStats.lateFrames, limiterStats.sleepMilliseconds / limitedFrames,
+			limiterStats.spinMilliseconds / limitedFrames, limiterStats.maxOvershootMilliseconds);
+	}
+
+	if (cpuProfilePath && CpuProfiler::writeChromeTrace(cpuProfilePath))
+	{
+		CpuProfiler::Stats stats = CpuProfiler::getStats();
+		printf("CPU timeline written to %s: %u events on %u threads, %u dropped\n", cpuProfilePath,
+			(uint32_t)stats.events, stats.threads, (uint32_t)stats.droppedEvents);
+	}
+
+	if (gpuProfilePath)
+	{
+		renderThread.getGpuProfiler().printSummary();
+		if (renderThread.getGpuProfiler().writeChromeTrace(gpuProfilePath))
+		{
+			printf("GPU timeline written to %s\n", gpuProfilePath);
+		}
+	}
 
-	glfwTerminate();
+	RenderThread::Stats threadStats = renderThread.getStats();
+	if (threadStats.frames > 0)
+	{
+		printf("Frames: %d\n", threadStats.frames);
+		printf("Simulation thread: %.3f ms/frame recording, %.3f ms/frame waiting\n",
+			threadStats.simulationMilliseconds / threadStats.frames, threadStats.simulationWaitMilliseconds / threadStats.frames);
+		printf("Render thread: %.3f ms/frame replaying, %.3f ms/frame swapping, %.3f ms/frame waiting\n",
+			threadStats.renderMilliseconds / threadStats.frames, threadStats.swapMilliseconds / threadStats.frames,
+			threadStats.renderWaitMilliseconds / threadStats.frames);
+		printf("Pipeline latency: %.3f ms average, %.3f ms max\n",
+			threadStats.latencyMilliseconds / threadStats.frames, threadStats.maxLatencyMilliseconds);
+		printf("Input latency: %.3f ms average, %.3f ms max\n",
+			threadStats.inputLatencyMilliseconds / threadStats.frames, threadStats.maxInputLatencyMilliseconds);
+		printf("Frame arena: %.1f bytes/frame (%zu max), %.1f allocations/frame, %llu overflowed to the heap\n",
+			(double)threadStats.frameArenaBytes / threadStats.frames, threadStats.maxFrameArenaBytes,
+			(double)threadStats.frameArenaAllocations / threadStats.frames, (unsigned long long)threadStats.frameArenaOverflows);
+		if (threadStats.staleCommands > 0)
+		{
+			printf("ERROR: %llu commands referred to destroyed resources and were skipped\n", (unsigned long long)threadStats.staleCommands);
+		}
+	}
+
+	bufferArena.printStats();
+	printMemoryReport();
+
+	for (MeshRange* mesh = meshes.begin(); mesh != meshes.end(); mesh++)
+	{
+		bufferArena.free(*mesh);
+	}
+	for (Texture* texture = textures.begin(); texture != textures.end(); texture++)
+	{
+		glDeleteTextures(1, &texture->Id);
+	}
+	for (Shader* program = shaders.begin(); program != shaders.end(); program++)
+	{
+		glDeleteProgram(program->Id);
+	}
+	bufferArena.destroy();
+
+	if (capturePath)
+	{
+		endGLCapture();
+		GLCaptureStats captureStats = getGLCaptureStats();
+		printf("GL trace written to %s: %u frames, %llu calls, %.1f MB\n", capturePath, captureStats.frames,
+			(unsigned long long)captureStats.calls, captureStats.bytes / (1024.0 * 1024.0));
+	}
+
+	if (headlessFrames)
+	{
+		headlessFramebuffer.destroy();
+		headlessContext.destroy();
+	}
+	else
+	{
+		glfwTerminate();
+	}
 	return 0;
 }
 
-void framebufferSizeCallback(GLFWwindow* window, int width, int height)
+void framebufferSizeCallback(GLFWwindow*, int width, int height)
 {
-	glViewport(0, 0, width, height);
+	framebufferWidth = width;
+	framebufferHeight = height;
+	framebufferResized = true;
 }
 
 void processInput(GLFWwindow* window)
@@ -245,4 +771,104 @@ void processInput(GLFWwindow* window)
 	{
 		glfwSetWindowShouldClose(window, true);
 	}
-}
\ No newline at end of file
+}
+
+const char* getArgumentValue(int argc, char** argv, const char* argumentName)
+{
+	for (int i = 1; i < argc - 1; i++)
+	{
+		if (strcmp(argv[i], argumentName) == 0)
+		{
+			return argv[i + 1];
+		}
+	}
+	return NULL;
+}
+
+bool hasArgument(int argc, char** argv, const char* argumentName)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], argumentName) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+double getSeconds()
+{
+	static std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void decodeTexture(void* data)
+{
+	TextureDecodeJob* job = (TextureDecodeJob*)data;
+	job->data = stbi_load(job->filePath, &job->width, &job->height, &job->nrChannels, 0);
+}
+
+// Decodes the textures of the scene in parallel and waits for them, the images are freed by the caller
+void decodeSceneTextures(JobSystem& jobSystem, TextureDecodeJob* textureDecodes)
+{
+	const char* filePaths[SceneTextureCount] = {
+		"resources/textures/wood-container.jpg",
+		"resources/textures/awesomeface.png"
+	};
+
+	JobSystem::Counter decodeCounter(0);
+	for (int i = 0; i < SceneTextureCount; i++)
+	{
+		TextureDecodeJob job = { filePaths[i], 0, 0, 0, NULL };
+		textureDecodes[i] = job;
+		jobSystem.run(decodeTexture, &textureDecodes[i], &decodeCounter);
+	}
+	jobSystem.wait(&decodeCounter);
+}
+
+int renderSoftware(int frameCount, const char* outputPath)
+{
+	JobSystem jobSystem;
+
+	TextureDecodeJob textureDecodes[SceneTextureCount];
+	decodeSceneTextures(jobSystem, textureDecodes);
+
+	SoftwareTexture textures[SceneTextureCount];
+	for (int i = 0; i < SceneTextureCount; i++)
+	{
+		if (textureDecodes[i].data)
+		{
+			textures[i].create(textureDecodes[i].data, textureDecodes[i].width, textureDecodes[i].height, textureDecodes[i].nrChannels);
+		}
+		else
+		{
+			printf("ERROR: Failed to load texture from %s\n", textureDecodes[i].filePath);
+		}
+		stbi_image_free(textureDecodes[i].data);
+	}
+
+	SoftwareRenderer renderer(framebufferWidth, framebufferHeight, &jobSystem);
+	renderer.setTextures(&textures[0], &textures[1]);
+	renderer.setMixValue(0.5f);
+
+	frameCount = frameCount > 0 ? frameCount : 1;
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		renderer.clear(0.2f, 0.3f, 0.3f, 1.0f);
+		renderer.draw(triangle_1, indices, 6, mat4::identity());
+		renderer.flush();
+	}
+
+	SoftwareRenderer::Stats stats = renderer.getStats();
+	double milliseconds = stats.setupMilliseconds + stats.rasterMilliseconds;
+	printf("Software renderer: %d frames at %dx%d on %d threads, %.3f ms/frame (%.3f setup, %.3f raster), %.1f Mpixels/s\n",
+		frameCount, renderer.getWidth(), renderer.getHeight(), jobSystem.getWorkerCount(), milliseconds / frameCount,
+		stats.setupMilliseconds / frameCount, stats.rasterMilliseconds / frameCount, stats.shadedPixels / (milliseconds * 1000.0));
+
+	if (outputPath && !renderer.writePpm(outputPath))
+	{
+		return -1;
+	}
+	return 0;
+}